@@ -0,0 +1,451 @@
+// admission.c
+#include "admission.h"
+#include "../../libvirt-utils.h"
+#define LOG_COMPONENT "admission"
+#include "../logger/logger.h"
+#include <cjson/cJSON.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Borne de l'estimation Retry-After (s) */
+#define ADMISSION_RETRY_MAX_S 60
+
+struct admission_config {
+    int max_running;                        /* requêtes simultanées par hyperviseur */
+    int reserved_interactive;               /* places jamais prises par bulk/background */
+    int class_max[ADMISSION_NCLASSES];      /* interactive : borné par max_running seul */
+    int queue_depth[ADMISSION_NCLASSES];
+    int queue_timeout_s;
+};
+
+/* Requête en file : vit sur la pile du thread de connexion qui attend */
+struct admission_waiter {
+    struct admission_waiter *next;
+    int admitted;
+};
+
+struct admission_host {
+    int    used;
+    char   uri[512];
+    int    running[ADMISSION_NCLASSES];
+    int    waiting[ADMISSION_NCLASSES];
+    struct admission_waiter *head[ADMISSION_NCLASSES];
+    struct admission_waiter *tail[ADMISSION_NCLASSES];
+    double avg_ms[ADMISSION_NCLASSES];      /* durée moyenne (EWMA) d'une requête */
+    unsigned long admitted[ADMISSION_NCLASSES];
+    unsigned long rejected[ADMISSION_NCLASSES];
+    unsigned long timed_out[ADMISSION_NCLASSES];
+};
+
+static struct admission_config config = {
+    .max_running = 8, .reserved_interactive = 2,
+    .class_max = { 0, 2, 2 },
+    .queue_depth = { 32, 8, 16 },
+    .queue_timeout_s = 30
+};
+static struct admission_host hosts[MAX_ADMISSION_HOSTS];
+static pthread_mutex_t admission_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  admission_cond = PTHREAD_COND_INITIALIZER;
+
+static const char *class_names[ADMISSION_NCLASSES] = { "interactive", "bulk", "background" };
+
+static const struct {
+    const char *url;
+    int cls;
+} route_classes[] = {
+    { "/admissionconfig",  ADMISSION_EXEMPT },
+    { "/admissionstatus",  ADMISSION_EXEMPT },
+    { "/loglevel",         ADMISSION_EXEMPT },
+    { "/traces",           ADMISSION_EXEMPT },
+
+    { "/createvm",         ADMISSION_BULK },
+    { "/deletevm",         ADMISSION_BULK },
+    { "/suspendvm",        ADMISSION_BULK },
+    { "/migratevm",        ADMISSION_BULK },
+    { "/migratepreflight", ADMISSION_BULK },
+    { "/evacuatehost",     ADMISSION_BULK },
+    { "/evacuateretry",    ADMISSION_BULK },
+    { "/snapshotcreate",   ADMISSION_BULK },
+    { "/snapshotrevert",   ADMISSION_BULK },
+    { "/snapshotdelete",   ADMISSION_BULK },
+    { "/backupstart",      ADMISSION_BULK },
+    { "/blockmaint",       ADMISSION_BULK },
+
+    { "/migratestatus",    ADMISSION_BACKGROUND },
+    { "/evacuatestatus",   ADMISSION_BACKGROUND },
+    { "/backupstatus",     ADMISSION_BACKGROUND },
+    { "/backuplist",       ADMISSION_BACKGROUND },
+    { "/blockjobstatus",   ADMISSION_BACKGROUND },
+    { "/reclaimstatus",    ADMISSION_BACKGROUND },
+    { "/balloonstatus",    ADMISSION_BACKGROUND },
+    { "/numastatus",       ADMISSION_BACKGROUND },
+    { "/snapshotlist",     ADMISSION_BACKGROUND },
+    { "/vmstats",          ADMISSION_BACKGROUND },
+    { "/fleetvms",         ADMISSION_BACKGROUND },
+    { "/hosts",            ADMISSION_BACKGROUND },
+    { "/besthost",         ADMISSION_BACKGROUND },
+};
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int admission_classify(const char *url) {
+    for (size_t i = 0; i < sizeof(route_classes) / sizeof(route_classes[0]); i++)
+        if (strcmp(route_classes[i].url, url) == 0)
+            return route_classes[i].cls;
+    return ADMISSION_INTERACTIVE;
+}
+
+/* --------------------------------------------------------------------------
+ * Files par hyperviseur (admission_lock tenu)
+ * -------------------------------------------------------------------------- */
+
+static int host_total(const struct admission_host *h) {
+    int n = 0;
+    for (int c = 0; c < ADMISSION_NCLASSES; c++)
+        n += h->running[c];
+    return n;
+}
+
+static int host_idle(const struct admission_host *h) {
+    for (int c = 0; c < ADMISSION_NCLASSES; c++)
+        if (h->running[c] || h->waiting[c])
+            return 0;
+    return 1;
+}
+
+/* Hôte de cet URI ; un hôte inactif est recyclé quand la table est pleine */
+static int get_host(const char *uri) {
+    int free_slot = -1, idle_slot = -1;
+    for (int i = 0; i < MAX_ADMISSION_HOSTS; i++) {
+        if (!hosts[i].used) {
+            if (free_slot < 0)
+                free_slot = i;
+        } else if (strcmp(hosts[i].uri, uri) == 0) {
+            return i;
+        } else if (idle_slot < 0 && host_idle(&hosts[i])) {
+            idle_slot = i;
+        }
+    }
+    int slot = free_slot >= 0 ? free_slot : idle_slot;
+    if (slot < 0)
+        return -1;
+    memset(&hosts[slot], 0, sizeof(hosts[slot]));
+    hosts[slot].used = 1;
+    snprintf(hosts[slot].uri, sizeof(hosts[slot].uri), "%s", uri);
+    return slot;
+}
+
+static int can_run(const struct admission_host *h, int cls) {
+    int total = host_total(h);
+    if (total >= config.max_running)
+        return 0;
+    if (cls == ADMISSION_INTERACTIVE)
+        return 1;
+    return h->running[cls] < config.class_max[cls] &&
+           total < config.max_running - config.reserved_interactive;
+}
+
+/* Admet les requêtes en tête de file, classe la plus prioritaire d'abord */
+static void dispatch(struct admission_host *h) {
+    int woke = 0;
+    for (int c = 0; c < ADMISSION_NCLASSES; c++) {
+        while (h->head[c] && can_run(h, c)) {
+            struct admission_waiter *w = h->head[c];
+            h->head[c] = w->next;
+            if (!h->head[c])
+                h->tail[c] = NULL;
+            w->admitted = 1;
+            h->waiting[c]--;
+            h->running[c]++;
+            h->admitted[c]++;
+            woke = 1;
+        }
+    }
+    if (woke)
+        pthread_cond_broadcast(&admission_cond);
+}
+
+static void unlink_waiter(struct admission_host *h, int cls, struct admission_waiter *w) {
+    struct admission_waiter **p = &h->head[cls], *prev = NULL;
+    while (*p && *p != w) {
+        prev = *p;
+        p = &(*p)->next;
+    }
+    if (!*p)
+        return;
+    *p = w->next;
+    if (h->tail[cls] == w)
+        h->tail[cls] = prev;
+    h->waiting[cls]--;
+}
+
+/* Temps estimé avant qu'une place de cette classe se libère (s) */
+static int retry_after(const struct admission_host *h, int cls) {
+    int slots = cls == ADMISSION_INTERACTIVE ? config.max_running : config.class_max[cls];
+    if (slots < 1)
+        slots = 1;
+    double avg = h->avg_ms[cls] > 0 ? h->avg_ms[cls] : 1000;
+    int s = (int)(avg * (h->waiting[cls] + 1) / slots / 1000) + 1;
+    return s > ADMISSION_RETRY_MAX_S ? ADMISSION_RETRY_MAX_S : s;
+}
+
+/* --------------------------------------------------------------------------
+ * Entrée / sortie d'une requête
+ * -------------------------------------------------------------------------- */
+
+/*
+ * File d'une requête : champ "uri" ; pour /createvm, /connect et /listallvms,
+ * l'URI construite comme le handler (protocol, user, host, port, path) ;
+ * "(placement)" / "(fleet)" pour les requêtes qui visent plusieurs hôtes.
+ * "" seulement pour les requêtes sans hyperviseur (suivi de job par jobId...).
+ */
+static void admission_key(const char *url, const cJSON *root, char *out, size_t outlen) {
+    out[0] = '\0';
+    if (strcmp(url, "/fleetvms") == 0) {
+        snprintf(out, outlen, "(fleet)");
+        return;
+    }
+    if (!root)
+        return;
+
+    cJSON *uri_item = cJSON_GetObjectItem(root, "uri");
+    if (cJSON_IsString(uri_item)) {
+        snprintf(out, outlen, "%s", uri_item->valuestring);
+        return;
+    }
+    if (strcmp(url, "/createvm") != 0 && strcmp(url, "/connect") != 0 &&
+        strcmp(url, "/listallvms") != 0)
+        return;
+
+    cJSON *placement = cJSON_GetObjectItem(root, "placement");
+    if (cJSON_IsString(placement) && strcmp(placement->valuestring, "auto") == 0) {
+        snprintf(out, outlen, "(placement)");
+        return;
+    }
+
+    cJSON *j;
+#define GETSTR(name) ((j = cJSON_GetObjectItemCaseSensitive(root, name)) && \
+                      cJSON_IsString(j) ? j->valuestring : NULL)
+    const char *protocol = GETSTR("protocol");
+    const char *user     = GETSTR("user");
+    const char *host     = GETSTR("host");
+    const char *path     = GETSTR("path");
+#undef GETSTR
+    int port = (j = cJSON_GetObjectItemCaseSensitive(root, "port")) && cJSON_IsNumber(j)
+               ? j->valueint : 0;
+    build_libvirt_uri(out, outlen, protocol ? protocol : "qemu", user, host, port,
+                      path ? path : "system");
+}
+
+int admission_enter(const char *url, const char *post_data,
+                    struct admission_ticket *t, int *retry_after_s) {
+    t->host = -1;
+    t->cls = admission_classify(url);
+    if (t->cls == ADMISSION_EXEMPT)
+        return 0;
+
+    char uri[512];
+    cJSON *root = post_data && post_data[0] ? cJSON_Parse(post_data) : NULL;
+    admission_key(url, root, uri, sizeof(uri));
+    cJSON_Delete(root);
+
+    pthread_mutex_lock(&admission_lock);
+    int hi = get_host(uri);
+    if (hi < 0) {
+        /* Table pleine de files actives : la requête passe sans être comptée */
+        pthread_mutex_unlock(&admission_lock);
+        return 0;
+    }
+    struct admission_host *h = &hosts[hi];
+
+    if (!h->head[t->cls] && can_run(h, t->cls)) {
+        h->running[t->cls]++;
+        h->admitted[t->cls]++;
+    } else if (h->waiting[t->cls] >= config.queue_depth[t->cls]) {
+        h->rejected[t->cls]++;
+        *retry_after_s = retry_after(h, t->cls);
+        pthread_mutex_unlock(&admission_lock);
+        LOG_WARN("%s on %s rejected: %s queue full", url, uri[0] ? uri : "(local)",
+                 class_names[t->cls]);
+        return -1;
+    } else {
+        struct admission_waiter w = { NULL, 0 };
+        if (h->tail[t->cls])
+            h->tail[t->cls]->next = &w;
+        else
+            h->head[t->cls] = &w;
+        h->tail[t->cls] = &w;
+        h->waiting[t->cls]++;
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += config.queue_timeout_s;
+        while (!w.admitted) {
+            if (pthread_cond_timedwait(&admission_cond, &admission_lock, &deadline) == ETIMEDOUT &&
+                !w.admitted) {
+                unlink_waiter(h, t->cls, &w);
+                h->timed_out[t->cls]++;
+                *retry_after_s = retry_after(h, t->cls);
+                pthread_mutex_unlock(&admission_lock);
+                LOG_WARN("%s on %s rejected: queued more than %d s", url,
+                         uri[0] ? uri : "(local)", config.queue_timeout_s);
+                return -1;
+            }
+        }
+    }
+    pthread_mutex_unlock(&admission_lock);
+
+    t->host = hi;
+    t->started_ms = now_ms();
+    return 0;
+}
+
+void admission_leave(struct admission_ticket *t) {
+    if (t->host < 0)
+        return;
+    long long elapsed = now_ms() - t->started_ms;
+
+    pthread_mutex_lock(&admission_lock);
+    struct admission_host *h = &hosts[t->host];
+    h->running[t->cls]--;
+    h->avg_ms[t->cls] = h->avg_ms[t->cls] > 0 ? h->avg_ms[t->cls] * 0.8 + (double)elapsed * 0.2
+                                              : (double)elapsed;
+    dispatch(h);
+    pthread_mutex_unlock(&admission_lock);
+    t->host = -1;
+}
+
+/* --------------------------------------------------------------------------
+ * Handlers
+ * -------------------------------------------------------------------------- */
+
+static cJSON *per_class_json(const int *vals) {
+    cJSON *o = cJSON_CreateObject();
+    for (int c = 0; c < ADMISSION_NCLASSES; c++)
+        cJSON_AddNumberToObject(o, class_names[c], vals[c]);
+    return o;
+}
+
+static cJSON *config_to_json(const struct admission_config *c) {
+    cJSON *o = cJSON_CreateObject();
+    cJSON_AddNumberToObject(o, "maxRunning", c->max_running);
+    cJSON_AddNumberToObject(o, "reservedInteractive", c->reserved_interactive);
+    cJSON_AddNumberToObject(o, "bulkMax", c->class_max[ADMISSION_BULK]);
+    cJSON_AddNumberToObject(o, "backgroundMax", c->class_max[ADMISSION_BACKGROUND]);
+    cJSON_AddItemToObject(o, "queueDepth", per_class_json(c->queue_depth));
+    cJSON_AddNumberToObject(o, "queueTimeoutS", c->queue_timeout_s);
+    return o;
+}
+
+static cJSON *host_to_json(const struct admission_host *h) {
+    cJSON *o = cJSON_CreateObject();
+    cJSON_AddStringToObject(o, "uri", h->uri);
+    cJSON_AddItemToObject(o, "running", per_class_json(h->running));
+    cJSON_AddItemToObject(o, "waiting", per_class_json(h->waiting));
+    cJSON *avg = cJSON_AddObjectToObject(o, "avgMs");
+    cJSON *adm = cJSON_AddObjectToObject(o, "admitted");
+    cJSON *rej = cJSON_AddObjectToObject(o, "rejected");
+    cJSON *tmo = cJSON_AddObjectToObject(o, "timedOut");
+    for (int c = 0; c < ADMISSION_NCLASSES; c++) {
+        cJSON_AddNumberToObject(avg, class_names[c], (double)(long long)h->avg_ms[c]);
+        cJSON_AddNumberToObject(adm, class_names[c], (double)h->admitted[c]);
+        cJSON_AddNumberToObject(rej, class_names[c], (double)h->rejected[c]);
+        cJSON_AddNumberToObject(tmo, class_names[c], (double)h->timed_out[c]);
+    }
+    return o;
+}
+
+char *handle_admissionconfig(const char *post_data) {
+    cJSON *root = post_data && post_data[0] ? cJSON_Parse(post_data) : NULL;
+    if (post_data && post_data[0] && !root)
+        return make_json_error("invalid JSON");
+
+    pthread_mutex_lock(&admission_lock);
+    struct admission_config c = config;
+    cJSON *j;
+    if (root) {
+        if ((j = cJSON_GetObjectItem(root, "maxRunning")) && cJSON_IsNumber(j))
+            c.max_running = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "reservedInteractive")) && cJSON_IsNumber(j))
+            c.reserved_interactive = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "bulkMax")) && cJSON_IsNumber(j))
+            c.class_max[ADMISSION_BULK] = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "backgroundMax")) && cJSON_IsNumber(j))
+            c.class_max[ADMISSION_BACKGROUND] = j->valueint;
+        cJSON *depth = cJSON_GetObjectItem(root, "queueDepth");
+        for (int k = 0; k < ADMISSION_NCLASSES && cJSON_IsObject(depth); k++) {
+            if ((j = cJSON_GetObjectItem(depth, class_names[k])) && cJSON_IsNumber(j))
+                c.queue_depth[k] = j->valueint;
+        }
+        if ((j = cJSON_GetObjectItem(root, "queueTimeoutS")) && cJSON_IsNumber(j))
+            c.queue_timeout_s = j->valueint;
+    }
+
+    int depth_ok = 1;
+    for (int k = 0; k < ADMISSION_NCLASSES; k++)
+        depth_ok = depth_ok && c.queue_depth[k] >= 0;
+    if (c.max_running < 1 || c.reserved_interactive < 0 ||
+        c.reserved_interactive >= c.max_running ||
+        c.class_max[ADMISSION_BULK] < 1 || c.class_max[ADMISSION_BACKGROUND] < 1 ||
+        !depth_ok || c.queue_timeout_s < 1) {
+        pthread_mutex_unlock(&admission_lock);
+        cJSON_Delete(root);
+        return make_json_error("invalid config (maxRunning >= 1, 0 <= reservedInteractive < maxRunning, "
+                               "bulkMax/backgroundMax >= 1, queueDepth >= 0, queueTimeoutS >= 1)");
+    }
+    config = c;
+
+    /* Limites relevées : les files en attente peuvent avancer tout de suite */
+    for (int i = 0; i < MAX_ADMISSION_HOSTS; i++)
+        if (hosts[i].used)
+            dispatch(&hosts[i]);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddItemToObject(resp, "config", config_to_json(&config));
+    pthread_mutex_unlock(&admission_lock);
+    cJSON_Delete(root);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+char *handle_admissionstatus(const char *post_data) {
+    cJSON *root = post_data && post_data[0] ? cJSON_Parse(post_data) : NULL;
+    cJSON *uri_item = root ? cJSON_GetObjectItem(root, "uri") : NULL;
+    const char *uri = cJSON_IsString(uri_item) ? uri_item->valuestring : NULL;
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    pthread_mutex_lock(&admission_lock);
+    cJSON_AddItemToObject(resp, "config", config_to_json(&config));
+    cJSON *arr = cJSON_AddArrayToObject(resp, "hosts");
+    for (int i = 0; i < MAX_ADMISSION_HOSTS; i++) {
+        if (hosts[i].used && (!uri || strcmp(hosts[i].uri, uri) == 0))
+            cJSON_AddItemToArray(arr, host_to_json(&hosts[i]));
+    }
+    pthread_mutex_unlock(&admission_lock);
+    cJSON_Delete(root);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
@@ -0,0 +1,54 @@
+// admission.h
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+/* Nombre max d'hyperviseurs suivis (une file par URI) */
+#define MAX_ADMISSION_HOSTS 64
+
+/*
+ * Classes de requêtes, par priorité décroissante. Une requête interactive
+ * en attente passe toujours avant une requête bulk ou background du même
+ * hyperviseur.
+ */
+enum admission_class {
+    ADMISSION_EXEMPT = -1,      /* jamais mise en file (admin, diagnostic) */
+    ADMISSION_INTERACTIVE = 0,  /* actions d'un utilisateur : start, stop, console... */
+    ADMISSION_BULK,             /* travail lourd : createvm, migratevm, backup... */
+    ADMISSION_BACKGROUND,       /* suivi / polling : *status, vmstats... */
+    ADMISSION_NCLASSES
+};
+
+struct admission_ticket {
+    int host;                   /* -1 : requête non comptée */
+    int cls;
+    long long started_ms;
+};
+
+/* Classe d'une route POST */
+int admission_classify(const char *url);
+
+/*
+ * Admet une requête (clé : champ "uri" du corps JSON, ou l'URI construite
+ * depuis protocol/host/port/path pour /createvm, /connect, /listallvms). Bloque
+ * tant qu'elle est en file. Retourne 0 une fois admise, ou -1 si la file
+ * de sa classe est pleine ou si l'attente dépasse le délai : *retry_after_s
+ * donne alors une estimation pour l'en-tête Retry-After.
+ * Toute requête admise doit être rendue avec admission_leave().
+ */
+int admission_enter(const char *url, const char *post_data,
+                    struct admission_ticket *t, int *retry_after_s);
+void admission_leave(struct admission_ticket *t);
+
+/*
+ * Réglages (valables pour chaque hyperviseur) :
+ * { "maxRunning": 8, "reservedInteractive": 2,
+ *   "bulkMax": 2, "backgroundMax": 2,
+ *   "queueDepth": { "interactive": 32, "bulk": 8, "background": 16 },
+ *   "queueTimeoutS": 30 }
+ */
+char *handle_admissionconfig(const char *post_data);
+
+/* Requêtes en cours / en file par hyperviseur et classe ("uri" optionnel) */
+char *handle_admissionstatus(const char *post_data);
+
+#endif
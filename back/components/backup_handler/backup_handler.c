@@ -0,0 +1,1123 @@
+// backup_handler.c
+#include "backup_handler.h"
+#include "../../libvirt-utils.h"
+#include "../domdesc/domdesc.h"
+#define LOG_COMPONENT "backup"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Intervalle de lecture de la progression (ms) */
+#define BACKUP_POLL_INTERVAL_MS 1000
+
+/* Disques sauvegardés au plus par VM */
+#define MAX_BACKUP_DISKS 16
+
+/* Préfixe des checkpoints gérés ici (les autres ne sont jamais supprimés) */
+#define CHECKPOINT_PREFIX "bk-"
+
+enum backup_job_state {
+    BACKUP_JOB_FREE = 0,
+    BACKUP_JOB_QUEUED,                  /* attend que l'hôte soit libre */
+    BACKUP_JOB_RUNNING,
+    BACKUP_JOB_COMPLETED,
+    BACKUP_JOB_FAILED,
+    BACKUP_JOB_CANCELLED
+};
+
+struct backup_job {
+    enum backup_job_state state;
+    int    id;
+    char   uri[512];
+    char   vm_name[256];
+    char   type[16];                    /* "full" ou "incremental" (effectif) */
+    char   checkpoint[64];              /* checkpoint créé par cette sauvegarde */
+    char   parent[64];                  /* base incrémentale, "" pour une full */
+    char   message[256];
+    char   req_id[LOG_REQUEST_ID_LEN];  /* requête HTTP à l'origine du job */
+    int    retention;
+    time_t queued_at;
+    time_t started_at;
+    time_t finished_at;
+    int    cancel_requested;
+    virDomainPtr dom;                   /* valide tant que le job copie */
+    unsigned long long data_total;
+    unsigned long long data_processed;
+};
+
+struct backup_schedule {
+    int    in_use;
+    char   uri[512];
+    char   vm_name[256];
+    int    full_every_s;
+    int    incr_every_s;                /* 0 = full uniquement */
+    int    retention;
+    time_t last_full;
+    time_t last_run;
+};
+
+static struct backup_job jobs[MAX_BACKUP_JOBS];
+static int next_job_id = 1;
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  slot_free = PTHREAD_COND_INITIALIZER;
+
+static struct backup_schedule schedules[MAX_BACKUP_SCHEDULES];
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  sched_once = PTHREAD_ONCE_INIT;
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("%s: libvirt error (code=%d, domain=%d): %s",
+                  prefix, err->code, err->domain,
+                  err->message ? err->message : "(no message)");
+    } else {
+        LOG_ERROR("%s: unknown libvirt error", prefix);
+    }
+}
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+/* Le nom de VM sert de répertoire sous BACKUP_BASE */
+static int valid_vm_name(const char *name) {
+    size_t len = strlen(name);
+    if (len == 0 || len > 128 || name[0] == '.')
+        return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)name[i]) && !strchr("._-", name[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/* --------------------------------------------------------------------------
+ * Table des jobs
+ * -------------------------------------------------------------------------- */
+
+static const char *job_state_name(enum backup_job_state state) {
+    switch (state) {
+    case BACKUP_JOB_QUEUED:    return "queued";
+    case BACKUP_JOB_RUNNING:   return "running";
+    case BACKUP_JOB_COMPLETED: return "completed";
+    case BACKUP_JOB_FAILED:    return "failed";
+    case BACKUP_JOB_CANCELLED: return "cancelled";
+    default:                   return "unknown";
+    }
+}
+
+static int job_is_active(const struct backup_job *job) {
+    return job->state == BACKUP_JOB_QUEUED ||
+           job->state == BACKUP_JOB_RUNNING;
+}
+
+/* Retrouve un job par id (jobs_lock doit être tenu) */
+static struct backup_job *find_job(int id) {
+    for (int i = 0; i < MAX_BACKUP_JOBS; i++) {
+        if (jobs[i].state != BACKUP_JOB_FREE && jobs[i].id == id)
+            return &jobs[i];
+    }
+    return NULL;
+}
+
+/* Slot libre, sinon le job terminé le plus ancien (jobs_lock doit être tenu) */
+static struct backup_job *alloc_job(void) {
+    struct backup_job *oldest = NULL;
+    for (int i = 0; i < MAX_BACKUP_JOBS; i++) {
+        if (jobs[i].state == BACKUP_JOB_FREE)
+            return &jobs[i];
+        if (!job_is_active(&jobs[i]) &&
+            (!oldest || jobs[i].finished_at < oldest->finished_at))
+            oldest = &jobs[i];
+    }
+    return oldest;
+}
+
+/*
+ * Une seule sauvegarde copie à la fois par hôte, dans l'ordre d'arrivée :
+ * libvirt n'offre pas de limite de débit pour les jobs de backup, c'est donc
+ * le nombre de flux simultanés vers le partage qui est borné.
+ * (jobs_lock doit être tenu)
+ */
+static int host_busy(const struct backup_job *job) {
+    for (int i = 0; i < MAX_BACKUP_JOBS; i++) {
+        const struct backup_job *other = &jobs[i];
+        if (other == job || strcmp(other->uri, job->uri) != 0)
+            continue;
+        if (other->state == BACKUP_JOB_RUNNING)
+            return 1;
+        if (other->state == BACKUP_JOB_QUEUED && other->id < job->id)
+            return 1;
+    }
+    return 0;
+}
+
+static void finish_job(struct backup_job *job, enum backup_job_state state,
+                       const char *message) {
+    pthread_mutex_lock(&jobs_lock);
+    job->state = state;
+    job->finished_at = time(NULL);
+    snprintf(job->message, sizeof(job->message), "%s", message);
+    pthread_cond_broadcast(&slot_free);
+    pthread_mutex_unlock(&jobs_lock);
+}
+
+/* --------------------------------------------------------------------------
+ * Catalogue : BACKUP_BASE/<vm>/catalog.json
+ * -------------------------------------------------------------------------- */
+
+static void catalog_path(const char *vm_name, char *out, size_t outlen) {
+    snprintf(out, outlen, "%s/%s/catalog.json", BACKUP_BASE, vm_name);
+}
+
+/* Retourne toujours un objet { "backups": [...] } (vide si absent ou illisible) */
+static cJSON *catalog_load(const char *vm_name) {
+    char path[512];
+    catalog_path(vm_name, path, sizeof(path));
+
+    uint64_t t0 = trace_begin();
+    cJSON *cat = NULL;
+    FILE *f = fopen(path, "r");
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        char *buf = size > 0 ? malloc((size_t)size + 1) : NULL;
+        if (buf && fread(buf, 1, (size_t)size, f) == (size_t)size) {
+            buf[size] = '\0';
+            cat = cJSON_Parse(buf);
+        }
+        free(buf);
+        fclose(f);
+    }
+    trace_end_detail("io", "catalog_load", t0, path);
+
+    if (!cJSON_IsObject(cat) || !cJSON_IsArray(cJSON_GetObjectItem(cat, "backups"))) {
+        if (cat)
+            LOG_WARN("%s: unreadable catalog, starting a new one", path);
+        cJSON_Delete(cat);
+        cat = cJSON_CreateObject();
+        cJSON_AddArrayToObject(cat, "backups");
+    }
+    return cat;
+}
+
+/* Écriture atomique (fichier temporaire + rename) */
+static int catalog_save(const char *vm_name, cJSON *cat) {
+    char path[512], tmp[520];
+    catalog_path(vm_name, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    char *text = cJSON_Print(cat);
+    if (!text)
+        return -1;
+    uint64_t t0 = trace_begin();
+    FILE *f = fopen(tmp, "w");
+    int ok = f && fputs(text, f) >= 0;
+    if (f && fclose(f) != 0)
+        ok = 0;
+    free(text);
+    ok = ok && rename(tmp, path) == 0;
+    trace_end_detail("io", "catalog_save", t0, path);
+    if (!ok) {
+        LOG_WARN("cannot write catalog %s: %s", path, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static void unlink_files(cJSON *files) {
+    cJSON *file;
+    cJSON_ArrayForEach(file, files) {
+        if (cJSON_IsString(file) && unlink(file->valuestring) < 0 && errno != ENOENT)
+            LOG_WARN("cannot remove %s: %s",
+                     file->valuestring, strerror(errno));
+    }
+}
+
+/*
+ * Garde les `retention` dernières chaînes (une full et ses incrémentales) ;
+ * les fichiers des chaînes plus anciennes sont supprimés.
+ */
+static void apply_retention(cJSON *cat, int retention) {
+    cJSON *arr = cJSON_GetObjectItem(cat, "backups");
+    int n = cJSON_GetArraySize(arr);
+
+    int fulls = 0, keep_from = -1;
+    for (int i = n - 1; i >= 0; i--) {
+        cJSON *type = cJSON_GetObjectItem(cJSON_GetArrayItem(arr, i), "type");
+        if (cJSON_IsString(type) && strcmp(type->valuestring, "full") == 0 &&
+            ++fulls == retention) {
+            keep_from = i;
+            break;
+        }
+    }
+
+    for (int i = 0; i < keep_from; i++) {
+        cJSON *entry = cJSON_DetachItemFromArray(arr, 0);
+        unlink_files(cJSON_GetObjectItem(entry, "files"));
+        cJSON_Delete(entry);
+    }
+}
+
+/* Date de fin de la dernière full (et de la dernière sauvegarde) du catalogue */
+static void catalog_last_times(const char *vm_name, time_t *last_full, time_t *last_run) {
+    cJSON *cat = catalog_load(vm_name);
+    cJSON *entry;
+    *last_full = 0;
+    *last_run = 0;
+    cJSON_ArrayForEach(entry, cJSON_GetObjectItem(cat, "backups")) {
+        cJSON *type = cJSON_GetObjectItem(entry, "type");
+        cJSON *fin  = cJSON_GetObjectItem(entry, "finishedAt");
+        if (!cJSON_IsNumber(fin))
+            continue;
+        *last_run = (time_t)fin->valuedouble;
+        if (cJSON_IsString(type) && strcmp(type->valuestring, "full") == 0)
+            *last_full = (time_t)fin->valuedouble;
+    }
+    cJSON_Delete(cat);
+}
+
+/* --------------------------------------------------------------------------
+ * XML de backup / checkpoint
+ * -------------------------------------------------------------------------- */
+
+/* Cibles (vda, vdb, ...) des disques de la VM, lecteurs CD exclus */
+static int list_backup_disks(const char *uri, virDomainPtr dom, char devs[][32], int max) {
+    struct domdesc *desc = malloc(sizeof(*desc));
+    if (!desc || domdesc_get(uri, dom, 0, desc) < 0) {
+        free(desc);
+        return -1;
+    }
+
+    int n = 0;
+    for (int i = 0; i < desc->ndisks && n < max; i++) {
+        const struct domdesc_disk *d = &desc->disks[i];
+        if (strcmp(d->device, "disk") == 0 && d->target[0])
+            snprintf(devs[n++], 32, "%s", d->target);
+    }
+    free(desc);
+    return n;
+}
+
+static void backup_file_path(const struct backup_job *job, const char *dev,
+                             char *out, size_t outlen) {
+    snprintf(out, outlen, "%s/%s/%s.%s.qcow2", BACKUP_BASE, job->vm_name, job->checkpoint, dev);
+}
+
+/*
+ * <domainbackup mode='push'> : qemu écrit lui-même un qcow2 par disque.
+ * Avec <incremental>, seuls les blocs marqués dans le bitmap du checkpoint
+ * parent sont copiés.
+ */
+static int build_backup_xml(const struct backup_job *job, char devs[][32], int ndisks,
+                            char *out, size_t outlen) {
+    size_t o = (size_t)snprintf(out, outlen, "<domainbackup mode='push'>");
+    if (job->parent[0])
+        o += (size_t)snprintf(out + o, outlen - o, "<incremental>%s</incremental>", job->parent);
+    o += (size_t)snprintf(out + o, outlen - o, "<disks>");
+    for (int i = 0; i < ndisks && o < outlen; i++) {
+        char file[768];
+        backup_file_path(job, devs[i], file, sizeof(file));
+        o += (size_t)snprintf(out + o, outlen - o,
+                              "<disk name='%s' backup='yes' type='file'>"
+                              "<target file='%s'/><driver type='qcow2'/></disk>",
+                              devs[i], file);
+    }
+    if (o < outlen)
+        o += (size_t)snprintf(out + o, outlen - o, "</disks></domainbackup>");
+    return o < outlen ? 0 : -1;
+}
+
+/* Checkpoint créé atomiquement au démarrage du backup : base de la prochaine incrémentale */
+static int build_checkpoint_xml(const struct backup_job *job, char devs[][32], int ndisks,
+                                char *out, size_t outlen) {
+    size_t o = (size_t)snprintf(out, outlen, "<domaincheckpoint><name>%s</name><disks>",
+                                job->checkpoint);
+    for (int i = 0; i < ndisks && o < outlen; i++)
+        o += (size_t)snprintf(out + o, outlen - o,
+                              "<disk name='%s' checkpoint='bitmap'/>", devs[i]);
+    if (o < outlen)
+        o += (size_t)snprintf(out + o, outlen - o, "</disks></domaincheckpoint>");
+    return o < outlen ? 0 : -1;
+}
+
+/* --------------------------------------------------------------------------
+ * Checkpoints
+ * -------------------------------------------------------------------------- */
+
+static void delete_checkpoint(virDomainPtr dom, const char *name) {
+    virDomainCheckpointPtr cp = TRACE_VIRT(virDomainCheckpointLookupByName, dom, name, 0);
+    if (!cp)
+        return;
+    if (TRACE_VIRT(virDomainCheckpointDelete, cp, 0) < 0)
+        log_libvirt_error("virDomainCheckpointDelete");
+    virDomainCheckpointFree(cp);
+}
+
+/*
+ * Après une full, les checkpoints précédents ne servent plus de base :
+ * chaque bitmap actif coûte à chaque écriture du guest, on les supprime.
+ */
+static void prune_checkpoints(virDomainPtr dom, const char *keep) {
+    virDomainCheckpointPtr *cps = NULL;
+    int n = TRACE_VIRT(virDomainListAllCheckpoints, dom, &cps, 0);
+    if (n < 0) {
+        log_libvirt_error("virDomainListAllCheckpoints");
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        const char *name = virDomainCheckpointGetName(cps[i]);
+        if (name && strncmp(name, CHECKPOINT_PREFIX, strlen(CHECKPOINT_PREFIX)) == 0 &&
+            strcmp(name, keep) != 0 &&
+            TRACE_VIRT(virDomainCheckpointDelete, cps[i], 0) < 0)
+            log_libvirt_error("virDomainCheckpointDelete");
+        virDomainCheckpointFree(cps[i]);
+    }
+    free(cps);
+}
+
+/* --------------------------------------------------------------------------
+ * Suivi du job libvirt
+ * -------------------------------------------------------------------------- */
+
+static void read_progress(virTypedParameterPtr params, int nparams,
+                          unsigned long long *total, unsigned long long *processed) {
+    if (virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_DISK_TOTAL, total) <= 0)
+        virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_DATA_TOTAL, total);
+    if (virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_DISK_PROCESSED, processed) <= 0)
+        virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_DATA_PROCESSED, processed);
+}
+
+/* 1 tant que le backup tourne, 0 quand il est terminé, -1 en cas d'erreur */
+static int poll_backup(struct backup_job *job, virDomainPtr dom) {
+    int type = VIR_DOMAIN_JOB_NONE;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+
+    if (TRACE_VIRT(virDomainGetJobStats, dom, &type, &params, &nparams, 0) < 0) {
+        log_libvirt_error("virDomainGetJobStats");
+        return -1;
+    }
+
+    unsigned long long total = 0, processed = 0;
+    read_progress(params, nparams, &total, &processed);
+    virTypedParamsFree(params, nparams);
+    if (type == VIR_DOMAIN_JOB_NONE)
+        return 0;
+
+    pthread_mutex_lock(&jobs_lock);
+    job->data_total = total;
+    job->data_processed = processed;
+    pthread_mutex_unlock(&jobs_lock);
+    return 1;
+}
+
+/* Statut final du backup (statistiques du dernier job terminé) */
+static enum backup_job_state backup_result(struct backup_job *job, virDomainPtr dom,
+                                           char *msg, size_t msglen) {
+    int type = VIR_DOMAIN_JOB_NONE;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+
+    if (TRACE_VIRT(virDomainGetJobStats, dom, &type, &params, &nparams, VIR_DOMAIN_JOB_STATS_COMPLETED) < 0) {
+        log_libvirt_error("virDomainGetJobStats(completed)");
+        snprintf(msg, msglen, "backup finished, completion status unavailable");
+        return BACKUP_JOB_FAILED;
+    }
+
+    unsigned long long total = 0, processed = 0;
+    read_progress(params, nparams, &total, &processed);
+    const char *errmsg = NULL;
+    virTypedParamsGetString(params, nparams, VIR_DOMAIN_JOB_ERRMSG, &errmsg);
+
+    enum backup_job_state state;
+    if (type == VIR_DOMAIN_JOB_COMPLETED) {
+        state = BACKUP_JOB_COMPLETED;
+        snprintf(msg, msglen, "Backup completed");
+    } else if (type == VIR_DOMAIN_JOB_CANCELLED) {
+        state = BACKUP_JOB_CANCELLED;
+        snprintf(msg, msglen, "Backup cancelled");
+    } else {
+        state = BACKUP_JOB_FAILED;
+        snprintf(msg, msglen, "%s", errmsg ? errmsg : "backup failed");
+    }
+    virTypedParamsFree(params, nparams);
+
+    pthread_mutex_lock(&jobs_lock);
+    if (total)
+        job->data_total = total;
+    if (processed)
+        job->data_processed = processed;
+    pthread_mutex_unlock(&jobs_lock);
+    return state;
+}
+
+/* --------------------------------------------------------------------------
+ * Thread de sauvegarde
+ * -------------------------------------------------------------------------- */
+
+static void *backup_job_thread(void *arg) {
+    struct backup_job *job = arg;
+    log_set_request_id(job->req_id);
+
+    pthread_mutex_lock(&jobs_lock);
+    while (!job->cancel_requested && host_busy(job))
+        pthread_cond_wait(&slot_free, &jobs_lock);
+    if (job->cancel_requested) {
+        pthread_mutex_unlock(&jobs_lock);
+        finish_job(job, BACKUP_JOB_CANCELLED, "Backup cancelled");
+        return NULL;
+    }
+    job->state = BACKUP_JOB_RUNNING;
+    job->started_at = time(NULL);
+    snprintf(job->message, sizeof(job->message), "Backup running");
+    pthread_mutex_unlock(&jobs_lock);
+
+    virConnectPtr conn = libvirt_pool_open(job->uri);
+    if (!conn) {
+        log_libvirt_error("virConnectOpen");
+        finish_job(job, BACKUP_JOB_FAILED, "cannot connect to hypervisor");
+        return NULL;
+    }
+
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, job->vm_name);
+    if (!dom) {
+        log_libvirt_error("virDomainLookupByName");
+        virConnectClose(conn);
+        finish_job(job, BACKUP_JOB_FAILED, "domain not found");
+        return NULL;
+    }
+
+    // Le backup push de qemu ne fonctionne que sur une VM active
+    char devs[MAX_BACKUP_DISKS][32];
+    int ndisks = TRACE_VIRT(virDomainIsActive, dom) == 1 ? list_backup_disks(job->uri, dom, devs, MAX_BACKUP_DISKS) : -2;
+    if (ndisks <= 0) {
+        virDomainFree(dom);
+        virConnectClose(conn);
+        finish_job(job, BACKUP_JOB_FAILED,
+                   ndisks == -2 ? "domain must be running" : "no disk to back up");
+        return NULL;
+    }
+
+    /* Base incrémentale : dernier checkpoint du catalogue, s'il existe encore */
+    cJSON *cat = catalog_load(job->vm_name);
+    if (strcmp(job->type, "incremental") == 0) {
+        cJSON *arr  = cJSON_GetObjectItem(cat, "backups");
+        cJSON *last = cJSON_GetArrayItem(arr, cJSON_GetArraySize(arr) - 1);
+        cJSON *name = last ? cJSON_GetObjectItem(last, "checkpoint") : NULL;
+        virDomainCheckpointPtr parent = cJSON_IsString(name)
+            ? TRACE_VIRT(virDomainCheckpointLookupByName, dom, name->valuestring, 0) : NULL;
+        pthread_mutex_lock(&jobs_lock);
+        if (parent)
+            snprintf(job->parent, sizeof(job->parent), "%s", name->valuestring);
+        else
+            snprintf(job->type, sizeof(job->type), "full");
+        pthread_mutex_unlock(&jobs_lock);
+
+        if (parent)
+            virDomainCheckpointFree(parent);
+        else
+            LOG_INFO("job %d: no usable checkpoint for %s, running a full backup",
+                     job->id, job->vm_name);
+    }
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/%s", BACKUP_BASE, job->vm_name);
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+        LOG_WARN("cannot create %s: %s", dir, strerror(errno));
+
+    char backup_xml[8192], checkpoint_xml[2048];
+    if (build_backup_xml(job, devs, ndisks, backup_xml, sizeof(backup_xml)) < 0 ||
+        build_checkpoint_xml(job, devs, ndisks, checkpoint_xml, sizeof(checkpoint_xml)) < 0) {
+        cJSON_Delete(cat);
+        virDomainFree(dom);
+        virConnectClose(conn);
+        finish_job(job, BACKUP_JOB_FAILED, "too many disks");
+        return NULL;
+    }
+
+    LOG_INFO("job %d: %s backup of %s (checkpoint %s%s%s)",
+             job->id, job->type, job->vm_name, job->checkpoint,
+             job->parent[0] ? ", since " : "", job->parent);
+
+    if (TRACE_VIRT(virDomainBackupBegin, dom, backup_xml, checkpoint_xml, 0) < 0) {
+        log_libvirt_error("virDomainBackupBegin");
+        virErrorPtr err = virGetLastError();
+        char msg[256];
+        snprintf(msg, sizeof(msg), "%s", err && err->message ? err->message : "cannot start backup");
+        cJSON_Delete(cat);
+        virDomainFree(dom);
+        virConnectClose(conn);
+        finish_job(job, BACKUP_JOB_FAILED, msg);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&jobs_lock);
+    job->dom = dom;
+    pthread_mutex_unlock(&jobs_lock);
+
+    while (poll_backup(job, dom) > 0)
+        usleep(BACKUP_POLL_INTERVAL_MS * 1000);
+
+    pthread_mutex_lock(&jobs_lock);
+    job->dom = NULL;
+    int cancelled = job->cancel_requested;
+    pthread_mutex_unlock(&jobs_lock);
+
+    char msg[256];
+    enum backup_job_state state = backup_result(job, dom, msg, sizeof(msg));
+    if (state == BACKUP_JOB_FAILED && cancelled) {
+        state = BACKUP_JOB_CANCELLED;
+        snprintf(msg, sizeof(msg), "Backup cancelled");
+    }
+
+    cJSON *files = cJSON_CreateArray();
+    for (int i = 0; i < ndisks; i++) {
+        char file[768];
+        backup_file_path(job, devs[i], file, sizeof(file));
+        cJSON_AddItemToArray(files, cJSON_CreateString(file));
+    }
+
+    if (state == BACKUP_JOB_COMPLETED) {
+        cJSON *entry = cJSON_CreateObject();
+        cJSON_AddStringToObject(entry, "checkpoint", job->checkpoint);
+        cJSON_AddStringToObject(entry, "type", job->type);
+        if (job->parent[0])
+            cJSON_AddStringToObject(entry, "parent", job->parent);
+        cJSON_AddStringToObject(entry, "uri", job->uri);
+        cJSON_AddNumberToObject(entry, "startedAt", (double)job->started_at);
+        cJSON_AddNumberToObject(entry, "finishedAt", (double)time(NULL));
+        cJSON_AddNumberToObject(entry, "bytes", (double)job->data_processed);
+        cJSON_AddItemToObject(entry, "files", files);
+        cJSON_AddItemToArray(cJSON_GetObjectItem(cat, "backups"), entry);
+
+        if (strcmp(job->type, "full") == 0) {
+            prune_checkpoints(dom, job->checkpoint);
+            apply_retention(cat, job->retention);
+        }
+        if (catalog_save(job->vm_name, cat) < 0)
+            snprintf(msg, sizeof(msg), "Backup completed, catalog not written");
+    } else {
+        // Checkpoint sans sauvegarde associée : la prochaine incrémentale serait fausse
+        delete_checkpoint(dom, job->checkpoint);
+        unlink_files(files);
+        cJSON_Delete(files);
+    }
+
+    LOG_INFO("job %d: %s", job->id, msg);
+    cJSON_Delete(cat);
+    virDomainFree(dom);
+    virConnectClose(conn);
+    finish_job(job, state, msg);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * API interne
+ * -------------------------------------------------------------------------- */
+
+/* Rétention de la planification de la VM, sinon BACKUP_RETENTION_DEFAULT */
+static int schedule_retention(const char *uri, const char *vm_name) {
+    int retention = BACKUP_RETENTION_DEFAULT;
+    pthread_mutex_lock(&sched_lock);
+    for (int i = 0; i < MAX_BACKUP_SCHEDULES; i++) {
+        if (schedules[i].in_use && strcmp(schedules[i].uri, uri) == 0 &&
+            strcmp(schedules[i].vm_name, vm_name) == 0) {
+            retention = schedules[i].retention;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sched_lock);
+    return retention;
+}
+
+static int backup_job_start(const char *uri, const char *vm_name, const char *type,
+                            int retention, char *err, size_t errlen) {
+    pthread_mutex_lock(&jobs_lock);
+
+    // Un seul job par VM : le catalogue et la chaîne de checkpoints sont par VM
+    for (int i = 0; i < MAX_BACKUP_JOBS; i++) {
+        if (job_is_active(&jobs[i]) && strcmp(jobs[i].vm_name, vm_name) == 0) {
+            pthread_mutex_unlock(&jobs_lock);
+            snprintf(err, errlen, "a backup is already queued or running for this VM");
+            return -1;
+        }
+    }
+
+    struct backup_job *job = alloc_job();
+    if (!job) {
+        pthread_mutex_unlock(&jobs_lock);
+        snprintf(err, errlen, "too many backups in progress");
+        return -1;
+    }
+
+    memset(job, 0, sizeof(*job));
+    job->id = next_job_id++;
+    job->state = BACKUP_JOB_QUEUED;
+    snprintf(job->req_id, sizeof(job->req_id), "%s", log_request_id());
+    job->queued_at = time(NULL);
+    job->retention = retention;
+    snprintf(job->uri, sizeof(job->uri), "%s", uri);
+    snprintf(job->vm_name, sizeof(job->vm_name), "%s", vm_name);
+    snprintf(job->type, sizeof(job->type), "%s", type);
+    snprintf(job->message, sizeof(job->message), "Backup queued");
+
+    struct tm tm;
+    localtime_r(&job->queued_at, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    snprintf(job->checkpoint, sizeof(job->checkpoint), CHECKPOINT_PREFIX "%s-%d", stamp, job->id);
+
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&tid, &attr, backup_job_thread, job);
+    pthread_attr_destroy(&attr);
+
+    if (rc != 0) {
+        job->state = BACKUP_JOB_FREE;
+        pthread_mutex_unlock(&jobs_lock);
+        snprintf(err, errlen, "cannot start backup thread");
+        return -1;
+    }
+
+    int id = job->id;
+    pthread_mutex_unlock(&jobs_lock);
+    return id;
+}
+
+/* --------------------------------------------------------------------------
+ * Planificateur
+ * -------------------------------------------------------------------------- */
+
+struct due_backup {
+    int  slot;
+    int  full;
+    int  retention;
+    char uri[512];
+    char vm_name[256];
+};
+
+static void run_due_backups(void) {
+    static struct due_backup due[MAX_BACKUP_SCHEDULES];
+    int ndue = 0;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&sched_lock);
+    for (int i = 0; i < MAX_BACKUP_SCHEDULES; i++) {
+        const struct backup_schedule *s = &schedules[i];
+        if (!s->in_use)
+            continue;
+        int full = now - s->last_full >= s->full_every_s;
+        int incr = s->incr_every_s > 0 && now - s->last_run >= s->incr_every_s;
+        if (!full && !incr)
+            continue;
+        due[ndue].slot = i;
+        due[ndue].full = full;
+        due[ndue].retention = s->retention;
+        snprintf(due[ndue].uri, sizeof(due[ndue].uri), "%s", s->uri);
+        snprintf(due[ndue].vm_name, sizeof(due[ndue].vm_name), "%s", s->vm_name);
+        ndue++;
+    }
+    pthread_mutex_unlock(&sched_lock);
+
+    for (int i = 0; i < ndue; i++) {
+        char err[128];
+        if (backup_job_start(due[i].uri, due[i].vm_name, due[i].full ? "full" : "incremental",
+                             due[i].retention, err, sizeof(err)) < 0) {
+            LOG_WARN("scheduled backup of %s skipped: %s", due[i].vm_name, err);
+            continue;
+        }
+
+        // Heures de passage avancées seulement si le job est bien lancé
+        pthread_mutex_lock(&sched_lock);
+        struct backup_schedule *s = &schedules[due[i].slot];
+        if (s->in_use && strcmp(s->vm_name, due[i].vm_name) == 0) {
+            s->last_run = now;
+            if (due[i].full)
+                s->last_full = now;
+        }
+        pthread_mutex_unlock(&sched_lock);
+    }
+}
+
+static void *backup_scheduler_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        run_due_backups();
+        sleep(BACKUP_SCHED_TICK_S);
+    }
+    return NULL;
+}
+
+static void start_scheduler(void) {
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, backup_scheduler_thread, NULL) != 0)
+        LOG_ERROR("cannot start scheduler thread");
+    pthread_attr_destroy(&attr);
+}
+
+/* --------------------------------------------------------------------------
+ * Sérialisation JSON
+ * -------------------------------------------------------------------------- */
+
+static cJSON *job_to_json(const struct backup_job *job) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "jobId", job->id);
+    cJSON_AddStringToObject(obj, "vmName", job->vm_name);
+    cJSON_AddStringToObject(obj, "uri", job->uri);
+    cJSON_AddStringToObject(obj, "type", job->type);
+    cJSON_AddStringToObject(obj, "checkpoint", job->checkpoint);
+    if (job->parent[0])
+        cJSON_AddStringToObject(obj, "parent", job->parent);
+    cJSON_AddStringToObject(obj, "state", job_state_name(job->state));
+    cJSON_AddStringToObject(obj, "message", job->message);
+    cJSON_AddNumberToObject(obj, "queuedAt", (double)job->queued_at);
+    if (job->started_at)
+        cJSON_AddNumberToObject(obj, "startedAt", (double)job->started_at);
+    if (job->finished_at)
+        cJSON_AddNumberToObject(obj, "finishedAt", (double)job->finished_at);
+
+    cJSON *prog = cJSON_CreateObject();
+    double percent = 0;
+    if (job->state == BACKUP_JOB_COMPLETED)
+        percent = 100;
+    else if (job->data_total > 0)
+        percent = 100.0 * (double)job->data_processed / (double)job->data_total;
+    cJSON_AddNumberToObject(prog, "percent", percent);
+    cJSON_AddNumberToObject(prog, "dataTotal", (double)job->data_total);
+    cJSON_AddNumberToObject(prog, "dataProcessed", (double)job->data_processed);
+    cJSON_AddItemToObject(obj, "progress", prog);
+    return obj;
+}
+
+static cJSON *schedule_to_json(const struct backup_schedule *s) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "uri", s->uri);
+    cJSON_AddStringToObject(obj, "vmName", s->vm_name);
+    cJSON_AddNumberToObject(obj, "fullEveryHours", s->full_every_s / 3600.0);
+    cJSON_AddNumberToObject(obj, "incrementalEveryHours", s->incr_every_s / 3600.0);
+    cJSON_AddNumberToObject(obj, "retention", s->retention);
+    cJSON_AddNumberToObject(obj, "lastFull", (double)s->last_full);
+    cJSON_AddNumberToObject(obj, "lastRun", (double)s->last_run);
+    return obj;
+}
+
+/* Extrait "jobId" du body ; retourne -1 si absent */
+static int parse_job_id(const char *post_data) {
+    if (!post_data)
+        return -1;
+    cJSON *root = cJSON_Parse(post_data);
+    if (!root)
+        return -1;
+    cJSON *id_item = cJSON_GetObjectItem(root, "jobId");
+    int id = cJSON_IsNumber(id_item) ? id_item->valueint : -1;
+    cJSON_Delete(root);
+    return id;
+}
+
+/* --------------------------------------------------------------------------
+ * Handlers HTTP
+ * -------------------------------------------------------------------------- */
+
+/**
+ * POST /backupstart
+ * BODY JSON:
+ * {
+ *   "uri": "qemu:///system",
+ *   "vmName": "debian13",
+ *   "type": "incremental",     // optionnel : "incremental" (défaut) ou "full"
+ *   "retention": 2             // optionnel : chaînes gardées après une full
+ * }
+ *
+ * La sauvegarde tourne en arrière-plan : la réponse contient un "jobId"
+ * à suivre avec /backupstatus et à annuler avec /backupcancel.
+ */
+char *handle_backupstart(const char *post_data) {
+    if (!post_data)
+        return make_json_error("missing body");
+
+    cJSON *root = cJSON_Parse(post_data);
+    if (!root)
+        return make_json_error("invalid JSON");
+
+    cJSON *uri_item  = cJSON_GetObjectItem(root, "uri");
+    cJSON *vm_item   = cJSON_GetObjectItem(root, "vmName");
+    cJSON *type_item = cJSON_GetObjectItem(root, "type");
+    cJSON *ret_item  = cJSON_GetObjectItem(root, "retention");
+
+    if (!cJSON_IsString(uri_item) || !cJSON_IsString(vm_item)) {
+        cJSON_Delete(root);
+        return make_json_error("uri or vmName missing or invalid");
+    }
+    if (!valid_vm_name(vm_item->valuestring)) {
+        cJSON_Delete(root);
+        return make_json_error("vmName not usable as a backup directory");
+    }
+
+    const char *type = cJSON_IsString(type_item) ? type_item->valuestring : "incremental";
+    if (strcmp(type, "full") != 0 && strcmp(type, "incremental") != 0) {
+        cJSON_Delete(root);
+        return make_json_error("type must be full or incremental");
+    }
+
+    int retention = cJSON_IsNumber(ret_item) && ret_item->valueint > 0
+                    ? ret_item->valueint
+                    : schedule_retention(uri_item->valuestring, vm_item->valuestring);
+
+    char err[128];
+    int id = backup_job_start(uri_item->valuestring, vm_item->valuestring, type,
+                              retention, err, sizeof(err));
+    cJSON_Delete(root);
+    if (id < 0)
+        return make_json_error(err);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddNumberToObject(resp, "jobId", id);
+    cJSON_AddStringToObject(resp, "message", "Backup queued");
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/**
+ * POST /backupstatus
+ * BODY JSON: { "jobId": 3 }   // sans jobId : tous les jobs
+ */
+char *handle_backupstatus(const char *post_data) {
+    int id = parse_job_id(post_data);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+
+    pthread_mutex_lock(&jobs_lock);
+    if (id >= 0) {
+        struct backup_job *job = find_job(id);
+        if (!job) {
+            pthread_mutex_unlock(&jobs_lock);
+            cJSON_Delete(resp);
+            return make_json_error("unknown backup job");
+        }
+        cJSON_AddItemToObject(resp, "job", job_to_json(job));
+    } else {
+        cJSON *arr = cJSON_AddArrayToObject(resp, "jobs");
+        for (int i = 0; i < MAX_BACKUP_JOBS; i++) {
+            if (jobs[i].state != BACKUP_JOB_FREE)
+                cJSON_AddItemToArray(arr, job_to_json(&jobs[i]));
+        }
+    }
+    pthread_mutex_unlock(&jobs_lock);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/**
+ * POST /backupcancel
+ * BODY JSON: { "jobId": 3 }
+ */
+char *handle_backupcancel(const char *post_data) {
+    int id = parse_job_id(post_data);
+    if (id < 0)
+        return make_json_error("jobId missing or invalid");
+
+    pthread_mutex_lock(&jobs_lock);
+    struct backup_job *job = find_job(id);
+    if (!job || !job_is_active(job)) {
+        pthread_mutex_unlock(&jobs_lock);
+        return make_json_error(job ? "backup job is not running" : "unknown backup job");
+    }
+
+    job->cancel_requested = 1;
+    pthread_cond_broadcast(&slot_free);     // réveille un job en attente de l'hôte
+    virDomainPtr dom = job->dom;
+    if (dom)
+        virDomainRef(dom);
+    pthread_mutex_unlock(&jobs_lock);
+
+    if (dom) {
+        LOG_WARN("job %d: aborting backup", id);
+        int rc = TRACE_VIRT(virDomainAbortJob, dom);
+        if (rc < 0)
+            log_libvirt_error("virDomainAbortJob");
+        virDomainFree(dom);
+        if (rc < 0)
+            return make_json_error("failed to abort backup");
+    }
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddNumberToObject(resp, "jobId", id);
+    cJSON_AddStringToObject(resp, "message", "Cancellation requested");
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/**
+ * POST /backuplist
+ * BODY JSON: { "uri": "qemu:///system", "vmName": "debian13" }
+ *
+ * Réponse : catalogue de la VM, du plus ancien au plus récent. Une
+ * restauration applique la full puis ses incrémentales dans l'ordre.
+ */
+char *handle_backuplist(const char *post_data) {
+    if (!post_data)
+        return make_json_error("missing body");
+
+    cJSON *root = cJSON_Parse(post_data);
+    if (!root)
+        return make_json_error("invalid JSON");
+
+    cJSON *uri_item = cJSON_GetObjectItem(root, "uri");
+    cJSON *vm_item  = cJSON_GetObjectItem(root, "vmName");
+    if (!cJSON_IsString(vm_item) || !valid_vm_name(vm_item->valuestring)) {
+        cJSON_Delete(root);
+        return make_json_error("vmName missing or invalid");
+    }
+
+    cJSON *resp = catalog_load(vm_item->valuestring);
+    cJSON_AddStringToObject(resp, "status", "ok");
+
+    pthread_mutex_lock(&sched_lock);
+    for (int i = 0; i < MAX_BACKUP_SCHEDULES; i++) {
+        const struct backup_schedule *s = &schedules[i];
+        if (s->in_use && strcmp(s->vm_name, vm_item->valuestring) == 0 &&
+            (!cJSON_IsString(uri_item) || strcmp(s->uri, uri_item->valuestring) == 0)) {
+            cJSON_AddItemToObject(resp, "schedule", schedule_to_json(s));
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sched_lock);
+    cJSON_Delete(root);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/**
+ * POST /backupschedule
+ * BODY JSON:
+ * {
+ *   "uri": "qemu:///system",
+ *   "vmName": "debian13",
+ *   "fullEveryHours": 168,        // optionnel (défaut : 1 semaine)
+ *   "incrementalEveryHours": 24,  // optionnel, 0 = pas d'incrémentale
+ *   "retention": 2,               // optionnel : chaînes gardées
+ *   "enabled": true               // false : supprime la planification
+ * }
+ *
+ * Les planifications sont en mémoire ; les dates de dernière sauvegarde
+ * sont reprises du catalogue, un redémarrage ne relance donc pas de full.
+ */
+char *handle_backupschedule(const char *post_data) {
+    if (!post_data)
+        return make_json_error("missing body");
+
+    cJSON *root = cJSON_Parse(post_data);
+    if (!root)
+        return make_json_error("invalid JSON");
+
+    cJSON *uri_item = cJSON_GetObjectItem(root, "uri");
+    cJSON *vm_item  = cJSON_GetObjectItem(root, "vmName");
+    if (!cJSON_IsString(uri_item) || !cJSON_IsString(vm_item) ||
+        !valid_vm_name(vm_item->valuestring)) {
+        cJSON_Delete(root);
+        return make_json_error("uri or vmName missing or invalid");
+    }
+
+    cJSON *j;
+    double full_h = (j = cJSON_GetObjectItem(root, "fullEveryHours")) && cJSON_IsNumber(j)
+                    ? j->valuedouble : 168;
+    double incr_h = (j = cJSON_GetObjectItem(root, "incrementalEveryHours")) && cJSON_IsNumber(j)
+                    ? j->valuedouble : 24;
+    int retention = (j = cJSON_GetObjectItem(root, "retention")) && cJSON_IsNumber(j)
+                    ? j->valueint : BACKUP_RETENTION_DEFAULT;
+    int enabled = !cJSON_IsFalse(cJSON_GetObjectItem(root, "enabled"));
+
+    if (full_h < 1 || incr_h < 0 || retention < 1) {
+        cJSON_Delete(root);
+        return make_json_error("fullEveryHours >= 1, incrementalEveryHours >= 0, retention >= 1");
+    }
+
+    time_t last_full = 0, last_run = 0;
+    if (enabled)
+        catalog_last_times(vm_item->valuestring, &last_full, &last_run);
+
+    pthread_mutex_lock(&sched_lock);
+    int slot = -1, free_slot = -1;
+    for (int i = 0; i < MAX_BACKUP_SCHEDULES; i++) {
+        if (schedules[i].in_use && strcmp(schedules[i].uri, uri_item->valuestring) == 0 &&
+            strcmp(schedules[i].vm_name, vm_item->valuestring) == 0)
+            slot = i;
+        else if (!schedules[i].in_use && free_slot < 0)
+            free_slot = i;
+    }
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+
+    if (!enabled) {
+        if (slot >= 0)
+            schedules[slot].in_use = 0;
+        pthread_mutex_unlock(&sched_lock);
+        cJSON_AddStringToObject(resp, "message", slot >= 0 ? "Schedule removed" : "No schedule");
+    } else {
+        if (slot < 0)
+            slot = free_slot;
+        if (slot < 0) {
+            pthread_mutex_unlock(&sched_lock);
+            cJSON_Delete(resp);
+            cJSON_Delete(root);
+            return make_json_error("too many backup schedules");
+        }
+
+        struct backup_schedule *s = &schedules[slot];
+        if (!s->in_use) {
+            memset(s, 0, sizeof(*s));
+            s->in_use = 1;
+            snprintf(s->uri, sizeof(s->uri), "%s", uri_item->valuestring);
+            snprintf(s->vm_name, sizeof(s->vm_name), "%s", vm_item->valuestring);
+            s->last_full = last_full;
+            s->last_run = last_run;
+        }
+        s->full_every_s = (int)(full_h * 3600);
+        s->incr_every_s = (int)(incr_h * 3600);
+        s->retention = retention;
+        cJSON_AddItemToObject(resp, "schedule", schedule_to_json(s));
+        pthread_mutex_unlock(&sched_lock);
+
+        pthread_once(&sched_once, start_scheduler);
+    }
+    cJSON_Delete(root);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
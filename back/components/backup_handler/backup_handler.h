@@ -0,0 +1,42 @@
+// backup_handler.h
+#ifndef BACKUP_HANDLER_H
+#define BACKUP_HANDLER_H
+
+/*
+ * Partage des sauvegardes : monté sur chaque hyperviseur (qemu y écrit les
+ * fichiers) et sur le backend (catalogue, rétention), comme /mnt/vmstore.
+ */
+#define BACKUP_BASE "/mnt/vmbackup"
+
+/* Nombre max de jobs de sauvegarde gardés en mémoire (actifs + terminés) */
+#define MAX_BACKUP_JOBS 64
+
+/* Nombre max de VMs ayant une planification */
+#define MAX_BACKUP_SCHEDULES 128
+
+/* Chaînes (full + incrémentales) conservées par défaut */
+#define BACKUP_RETENTION_DEFAULT 2
+
+/* Période du planificateur (s) */
+#define BACKUP_SCHED_TICK_S 60
+
+/*
+ * Lance une sauvegarde en arrière-plan (virDomainBackupBegin, mode push).
+ * "incremental" ne copie que les blocs modifiés depuis le dernier checkpoint ;
+ * sans checkpoint utilisable, la sauvegarde devient full.
+ */
+char *handle_backupstart(const char *post_data);
+
+/* Progression d'un job ou de tous les jobs */
+char *handle_backupstatus(const char *post_data);
+
+/* Annule un job en attente ou en cours (virDomainAbortJob) */
+char *handle_backupcancel(const char *post_data);
+
+/* Catalogue des sauvegardes d'une VM (chaînes full + incrémentales) */
+char *handle_backuplist(const char *post_data);
+
+/* Planifie des sauvegardes full / incrémentales périodiques et la rétention */
+char *handle_backupschedule(const char *post_data);
+
+#endif
@@ -0,0 +1,497 @@
+// balloon.c
+#include "balloon.h"
+#include "../../libvirt-utils.h"
+#include "../placement/placement.h"
+#define LOG_COMPONENT "balloon"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Plancher absolu d'un invité, quel que soit floorPercent (KiB) */
+#define BALLOON_ABS_FLOOR_KIB (256ULL * 1024)
+
+struct balloon_config {
+    int    enabled;
+    int    interval_s;
+    unsigned long long step_mib;            /* variation max par passage et par VM */
+    unsigned long long host_reserve_mib;    /* mémoire libre gardée sur l'hôte */
+    int    target_free_pct;                 /* marge libre visée dans l'invité */
+    int    low_free_pct;                    /* en dessous : l'invité regonfle */
+    int    floor_pct;                       /* plancher par défaut, % du max */
+    unsigned long long major_faults_threshold;  /* par passage */
+};
+
+struct balloon_vm {
+    int    used;
+    char   uri[512];
+    char   name[256];
+
+    /* Surcharges posées par /balloonconfig (0 = défaut) */
+    unsigned long long floor_kib;
+    unsigned long long ceiling_kib;
+    unsigned long long target_kib;          /* posée par /resizevm : ballon figé */
+    int    exclude;
+
+    /* Dernier passage */
+    unsigned long long actual_kib;
+    unsigned long long usable_kib;
+    unsigned long long available_kib;
+    unsigned long long floor_eff_kib;
+    unsigned long long ceiling_eff_kib;
+    unsigned long long last_major;
+    int    has_major;
+    long long major_delta;
+    const char *last_action;
+    time_t updated_at;
+    time_t changed_at;
+};
+
+static struct balloon_config config = {
+    .enabled = 0, .interval_s = 10, .step_mib = 256, .host_reserve_mib = 2048,
+    .target_free_pct = 20, .low_free_pct = 10, .floor_pct = 25,
+    .major_faults_threshold = 100
+};
+static struct balloon_vm vms[MAX_BALLOON_VMS];
+static pthread_mutex_t balloon_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  balloon_once = PTHREAD_ONCE_INIT;
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("%s: libvirt error (code=%d, domain=%d): %s",
+                  prefix, err->code, err->domain,
+                  err->message ? err->message : "(no message)");
+    } else {
+        LOG_ERROR("%s: unknown libvirt error", prefix);
+    }
+}
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+/* --------------------------------------------------------------------------
+ * Table des VMs (balloon_lock tenu)
+ * -------------------------------------------------------------------------- */
+
+static struct balloon_vm *find_vm(const char *uri, const char *name) {
+    for (int i = 0; i < MAX_BALLOON_VMS; i++)
+        if (vms[i].used && strcmp(vms[i].uri, uri) == 0 && strcmp(vms[i].name, name) == 0)
+            return &vms[i];
+    return NULL;
+}
+
+static struct balloon_vm *get_vm(const char *uri, const char *name) {
+    struct balloon_vm *vm = find_vm(uri, name);
+    if (vm)
+        return vm;
+    for (int i = 0; i < MAX_BALLOON_VMS; i++) {
+        if (!vms[i].used) {
+            memset(&vms[i], 0, sizeof(vms[i]));
+            vms[i].used = 1;
+            snprintf(vms[i].uri, sizeof(vms[i].uri), "%s", uri);
+            snprintf(vms[i].name, sizeof(vms[i].name), "%s", name);
+            vms[i].last_action = "new";
+            return &vms[i];
+        }
+    }
+    return NULL;
+}
+
+/* Oublie les VMs disparues (éteintes, migrées) sans surcharge à conserver */
+static void prune_vms(time_t now, int interval_s) {
+    for (int i = 0; i < MAX_BALLOON_VMS; i++) {
+        struct balloon_vm *vm = &vms[i];
+        if (vm->used && !vm->floor_kib && !vm->ceiling_kib && !vm->target_kib && !vm->exclude &&
+            vm->updated_at && now - vm->updated_at > 10 * interval_s)
+            vm->used = 0;
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Décision par VM
+ * -------------------------------------------------------------------------- */
+
+static unsigned long long stat_val(const virDomainMemoryStatStruct *st, int n, int tag,
+                                   int *found) {
+    for (int i = 0; i < n; i++) {
+        if (st[i].tag == tag) {
+            *found = 1;
+            return st[i].val;
+        }
+    }
+    *found = 0;
+    return 0;
+}
+
+/*
+ * Nouvelle taille du ballon (KiB) pour une VM, host_free_kib étant la mémoire
+ * encore libre sur l'hôte (mise à jour au fil des décisions du passage).
+ */
+static void rebalance_vm(const char *uri, virDomainPtr dom, const struct balloon_config *c,
+                         long long *host_free_kib) {
+    const char *name = virDomainGetName(dom);
+    virDomainMemoryStatStruct st[VIR_DOMAIN_MEMORY_STAT_NR];
+    int n = TRACE_VIRT(virDomainMemoryStats, dom, st, VIR_DOMAIN_MEMORY_STAT_NR, 0);
+    if (n < 0) {
+        log_libvirt_error("virDomainMemoryStats");
+        return;
+    }
+
+    int has_actual, has_avail, has_usable, has_unused, has_major;
+    unsigned long long actual = stat_val(st, n, VIR_DOMAIN_MEMORY_STAT_ACTUAL_BALLOON, &has_actual);
+    unsigned long long avail  = stat_val(st, n, VIR_DOMAIN_MEMORY_STAT_AVAILABLE, &has_avail);
+    /* usable compte le cache récupérable, unused non : on préfère usable */
+    unsigned long long usable = stat_val(st, n, VIR_DOMAIN_MEMORY_STAT_USABLE, &has_usable);
+    unsigned long long unused = stat_val(st, n, VIR_DOMAIN_MEMORY_STAT_UNUSED, &has_unused);
+    unsigned long long major  = stat_val(st, n, VIR_DOMAIN_MEMORY_STAT_MAJOR_FAULT, &has_major);
+    if (!has_usable) {
+        usable = unused;
+        has_usable = has_unused;
+    }
+
+    pthread_mutex_lock(&balloon_lock);
+    struct balloon_vm *vm = get_vm(uri, name);
+    if (!vm) {
+        pthread_mutex_unlock(&balloon_lock);
+        return;
+    }
+    vm->updated_at = time(NULL);
+
+    if (!has_actual || !has_avail || !has_usable || avail == 0) {
+        /* Stats invité pas encore collectées : on les active pour le prochain passage */
+        vm->last_action = "no-stats";
+        pthread_mutex_unlock(&balloon_lock);
+        if (TRACE_VIRT(virDomainSetMemoryStatsPeriod, dom, BALLOON_STATS_PERIOD_S, VIR_DOMAIN_AFFECT_LIVE) < 0)
+            log_libvirt_error("virDomainSetMemoryStatsPeriod");
+        return;
+    }
+
+    long long major_delta = vm->has_major && has_major && major >= vm->last_major
+                            ? (long long)(major - vm->last_major) : 0;
+    vm->last_major = major;
+    vm->has_major = has_major;
+    vm->major_delta = major_delta;
+    vm->actual_kib = actual;
+    vm->usable_kib = usable;
+    vm->available_kib = avail;
+    int exclude = vm->exclude;
+    unsigned long long floor_kib = vm->floor_kib, ceiling_kib = vm->ceiling_kib;
+    unsigned long long pinned_kib = vm->target_kib;
+    pthread_mutex_unlock(&balloon_lock);
+
+    unsigned long long max_kib = TRACE_VIRT(virDomainGetMaxMemory, dom);
+    if (max_kib == 0) {
+        log_libvirt_error("virDomainGetMaxMemory");
+        return;
+    }
+    if (!ceiling_kib || ceiling_kib > max_kib)
+        ceiling_kib = max_kib;
+    if (!floor_kib) {
+        floor_kib = max_kib * (unsigned long long)c->floor_pct / 100;
+        if (floor_kib < BALLOON_ABS_FLOOR_KIB)
+            floor_kib = BALLOON_ABS_FLOOR_KIB;
+    }
+    if (floor_kib > ceiling_kib)
+        floor_kib = ceiling_kib;
+    if (pinned_kib)
+        floor_kib = ceiling_kib = pinned_kib;
+
+    unsigned long long step = c->step_mib * 1024;
+    unsigned long long reserve = c->host_reserve_mib * 1024;
+    unsigned long long want_free = avail * (unsigned long long)c->target_free_pct / 100;
+    unsigned long long low_free  = avail * (unsigned long long)c->low_free_pct / 100;
+    unsigned long long target = actual;
+    const char *action = "hold";
+
+    if (exclude) {
+        action = "excluded";
+    } else if (pinned_kib) {
+        /* Taille choisie par l'utilisateur : on ne la défait pas */
+        action = "pinned";
+    } else if ((unsigned long long)major_delta > c->major_faults_threshold || usable < low_free) {
+        /* Invité sous pression : on regonfle, si l'hôte peut suivre */
+        unsigned long long grow = step;
+        if (*host_free_kib - (long long)reserve < (long long)grow)
+            grow = *host_free_kib > (long long)reserve ? (unsigned long long)(*host_free_kib - (long long)reserve) : 0;
+        target = actual + grow;
+        action = grow ? "grow" : "host-full";
+    } else if (usable > want_free + step / 2) {
+        /* Marge excédentaire : on la rend, sans dépasser un pas (sauf hôte sous pression) */
+        unsigned long long excess = usable - want_free;
+        if (*host_free_kib >= (long long)reserve && excess > step)
+            excess = step;
+        target = actual > excess ? actual - excess : 0;
+        action = "shrink";
+    }
+
+    if (target < floor_kib)
+        target = floor_kib;
+    if (target > ceiling_kib)
+        target = ceiling_kib;
+
+    unsigned long long diff = target > actual ? target - actual : actual - target;
+    if (strcmp(action, "grow") == 0 || strcmp(action, "shrink") == 0) {
+        /* Le bornage peut inverser le sens (plancher relevé entre deux passages) */
+        action = target > actual ? "grow" : "shrink";
+        if (diff < BALLOON_MIN_CHANGE_KIB) {
+            action = "hold";
+        } else if (TRACE_VIRT(virDomainSetMemoryFlags, dom, (unsigned long)target, VIR_DOMAIN_AFFECT_LIVE) < 0) {
+            log_libvirt_error("virDomainSetMemoryFlags");
+            action = "error";
+        } else {
+            *host_free_kib += (long long)actual - (long long)target;
+            LOG_INFO("%s on %s: %s %llu -> %llu MiB (usable %llu MiB, %lld major faults)",
+                     name, uri, action, actual / 1024, target / 1024, usable / 1024, major_delta);
+        }
+    }
+
+    pthread_mutex_lock(&balloon_lock);
+    if ((vm = find_vm(uri, name)) != NULL) {
+        vm->floor_eff_kib = floor_kib;
+        vm->ceiling_eff_kib = ceiling_kib;
+        vm->last_action = action;
+        if (strcmp(action, "grow") == 0 || strcmp(action, "shrink") == 0) {
+            vm->actual_kib = target;
+            vm->changed_at = time(NULL);
+        }
+    }
+    pthread_mutex_unlock(&balloon_lock);
+}
+
+/* --------------------------------------------------------------------------
+ * Passage périodique sur tous les hôtes
+ * -------------------------------------------------------------------------- */
+
+static void rebalance_host(const char *uri, const struct balloon_config *c) {
+    virConnectPtr conn = libvirt_pool_open(uri);
+    if (!conn) {
+        log_libvirt_error("virConnectOpen");
+        return;
+    }
+
+    unsigned long long free_bytes = TRACE_VIRT(virNodeGetFreeMemory, conn);
+    if (free_bytes == 0) {
+        /* 0 = erreur : sans mémoire libre connue, ni regonflage ni bornage du pas */
+        log_libvirt_error("virNodeGetFreeMemory");
+        LOG_WARN("%s skipped this pass: host free memory unknown", uri);
+        virConnectClose(conn);
+        return;
+    }
+    long long host_free_kib = (long long)(free_bytes / 1024);
+    virDomainPtr *doms = NULL;
+    int ndoms = TRACE_VIRT(virConnectListAllDomains, conn, &doms, VIR_CONNECT_LIST_DOMAINS_RUNNING);
+    for (int i = 0; i < ndoms; i++) {
+        rebalance_vm(uri, doms[i], c, &host_free_kib);
+        virDomainFree(doms[i]);
+    }
+    free(doms);
+    virConnectClose(conn);
+}
+
+static void *balloon_thread(void *arg) {
+    (void)arg;
+    static char uris[MAX_PLACEMENT_HOSTS][512];
+    for (;;) {
+        pthread_mutex_lock(&balloon_lock);
+        struct balloon_config c = config;
+        prune_vms(time(NULL), c.interval_s);
+        pthread_mutex_unlock(&balloon_lock);
+
+        if (c.enabled) {
+            int nhosts = placement_list_hosts(uris, MAX_PLACEMENT_HOSTS);
+            for (int h = 0; h < nhosts; h++)
+                rebalance_host(uris[h], &c);
+        }
+        sleep((unsigned int)c.interval_s);
+    }
+    return NULL;
+}
+
+static void start_rebalancer(void) {
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, balloon_thread, NULL) != 0)
+        LOG_ERROR("cannot start rebalancer thread");
+    pthread_attr_destroy(&attr);
+}
+
+/* --------------------------------------------------------------------------
+ * Handlers
+ * -------------------------------------------------------------------------- */
+
+static cJSON *config_to_json(const struct balloon_config *c) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddBoolToObject(obj, "enabled", c->enabled);
+    cJSON_AddNumberToObject(obj, "intervalS", c->interval_s);
+    cJSON_AddNumberToObject(obj, "stepMiB", (double)c->step_mib);
+    cJSON_AddNumberToObject(obj, "hostReserveMiB", (double)c->host_reserve_mib);
+    cJSON_AddNumberToObject(obj, "targetFreePercent", c->target_free_pct);
+    cJSON_AddNumberToObject(obj, "lowFreePercent", c->low_free_pct);
+    cJSON_AddNumberToObject(obj, "floorPercent", c->floor_pct);
+    cJSON_AddNumberToObject(obj, "majorFaultsThreshold", (double)c->major_faults_threshold);
+    return obj;
+}
+
+static cJSON *vm_to_json(const struct balloon_vm *vm) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "uri", vm->uri);
+    cJSON_AddStringToObject(obj, "vmName", vm->name);
+    cJSON_AddStringToObject(obj, "lastAction", vm->last_action);
+    cJSON_AddBoolToObject(obj, "exclude", vm->exclude);
+    cJSON_AddNumberToObject(obj, "actualMiB", (double)(vm->actual_kib / 1024));
+    cJSON_AddNumberToObject(obj, "usableMiB", (double)(vm->usable_kib / 1024));
+    cJSON_AddNumberToObject(obj, "availableMiB", (double)(vm->available_kib / 1024));
+    cJSON_AddNumberToObject(obj, "floorMiB", (double)(vm->floor_eff_kib / 1024));
+    cJSON_AddNumberToObject(obj, "ceilingMiB", (double)(vm->ceiling_eff_kib / 1024));
+    if (vm->target_kib)
+        cJSON_AddNumberToObject(obj, "targetMiB", (double)(vm->target_kib / 1024));
+    cJSON_AddNumberToObject(obj, "majorFaults", (double)vm->major_delta);
+    cJSON_AddNumberToObject(obj, "updatedAt", (double)vm->updated_at);
+    if (vm->changed_at)
+        cJSON_AddNumberToObject(obj, "changedAt", (double)vm->changed_at);
+    return obj;
+}
+
+/* Surcharges par VM ; retourne un message d'erreur ou NULL */
+static const char *apply_vm_overrides(const cJSON *list) {
+    const cJSON *item;
+    cJSON_ArrayForEach(item, list) {
+        const cJSON *uri  = cJSON_GetObjectItem(item, "uri");
+        const cJSON *name = cJSON_GetObjectItem(item, "vmName");
+        if (!cJSON_IsString(uri) || !cJSON_IsString(name))
+            return "vms entries need uri and vmName";
+        const cJSON *floor_item   = cJSON_GetObjectItem(item, "floorMiB");
+        const cJSON *ceiling_item = cJSON_GetObjectItem(item, "ceilingMiB");
+        const cJSON *target_item  = cJSON_GetObjectItem(item, "targetMiB");
+        const cJSON *exclude_item = cJSON_GetObjectItem(item, "exclude");
+        double floor_mib   = cJSON_IsNumber(floor_item) ? floor_item->valuedouble : 0;
+        double ceiling_mib = cJSON_IsNumber(ceiling_item) ? ceiling_item->valuedouble : 0;
+        double target_mib  = cJSON_IsNumber(target_item) ? target_item->valuedouble : 0;
+        if (floor_mib < 0 || ceiling_mib < 0 || (ceiling_mib && floor_mib > ceiling_mib))
+            return "invalid floorMiB / ceilingMiB";
+        if (target_mib < 0)
+            return "invalid targetMiB";
+
+        struct balloon_vm *vm = get_vm(uri->valuestring, name->valuestring);
+        if (!vm)
+            return "too many tracked VMs";
+        if (floor_item)
+            vm->floor_kib = (unsigned long long)floor_mib * 1024;
+        if (ceiling_item)
+            vm->ceiling_kib = (unsigned long long)ceiling_mib * 1024;
+        if (target_item)
+            vm->target_kib = (unsigned long long)target_mib * 1024;
+        if (cJSON_IsBool(exclude_item))
+            vm->exclude = cJSON_IsTrue(exclude_item);
+    }
+    return NULL;
+}
+
+char *handle_balloonconfig(const char *post_data) {
+    cJSON *root = post_data && post_data[0] ? cJSON_Parse(post_data) : NULL;
+    if (post_data && post_data[0] && !root)
+        return make_json_error("invalid JSON");
+
+    pthread_mutex_lock(&balloon_lock);
+    struct balloon_config c = config;
+    cJSON *j;
+    if (root) {
+        if ((j = cJSON_GetObjectItem(root, "enabled")) && cJSON_IsBool(j))
+            c.enabled = cJSON_IsTrue(j);
+        if ((j = cJSON_GetObjectItem(root, "intervalS")) && cJSON_IsNumber(j))
+            c.interval_s = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "stepMiB")) && cJSON_IsNumber(j))
+            c.step_mib = j->valuedouble > 0 ? (unsigned long long)j->valuedouble : 0;
+        if ((j = cJSON_GetObjectItem(root, "hostReserveMiB")) && cJSON_IsNumber(j))
+            c.host_reserve_mib = j->valuedouble > 0 ? (unsigned long long)j->valuedouble : 0;
+        if ((j = cJSON_GetObjectItem(root, "targetFreePercent")) && cJSON_IsNumber(j))
+            c.target_free_pct = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "lowFreePercent")) && cJSON_IsNumber(j))
+            c.low_free_pct = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "floorPercent")) && cJSON_IsNumber(j))
+            c.floor_pct = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "majorFaultsThreshold")) && cJSON_IsNumber(j))
+            c.major_faults_threshold = j->valuedouble > 0 ? (unsigned long long)j->valuedouble : 0;
+    }
+
+    if (c.interval_s < 1 || c.step_mib == 0 ||
+        c.low_free_pct < 0 || c.target_free_pct <= c.low_free_pct || c.target_free_pct > 90 ||
+        c.floor_pct < 1 || c.floor_pct > 100) {
+        pthread_mutex_unlock(&balloon_lock);
+        cJSON_Delete(root);
+        return make_json_error("invalid config (intervalS >= 1, stepMiB > 0, "
+                               "lowFreePercent < targetFreePercent <= 90, floorPercent 1-100)");
+    }
+    const char *err = root ? apply_vm_overrides(cJSON_GetObjectItem(root, "vms")) : NULL;
+    if (err) {
+        pthread_mutex_unlock(&balloon_lock);
+        cJSON_Delete(root);
+        return make_json_error(err);
+    }
+    config = c;
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddItemToObject(resp, "config", config_to_json(&config));
+    int enabled = config.enabled;
+    pthread_mutex_unlock(&balloon_lock);
+    cJSON_Delete(root);
+
+    if (enabled)
+        pthread_once(&balloon_once, start_rebalancer);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+char *handle_balloonstatus(const char *post_data) {
+    cJSON *root = post_data && post_data[0] ? cJSON_Parse(post_data) : NULL;
+    cJSON *uri_item = root ? cJSON_GetObjectItem(root, "uri") : NULL;
+    const char *uri = cJSON_IsString(uri_item) ? uri_item->valuestring : NULL;
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    pthread_mutex_lock(&balloon_lock);
+    cJSON_AddItemToObject(resp, "config", config_to_json(&config));
+    cJSON *arr = cJSON_AddArrayToObject(resp, "vms");
+    for (int i = 0; i < MAX_BALLOON_VMS; i++) {
+        if (vms[i].used && (!uri || strcmp(vms[i].uri, uri) == 0))
+            cJSON_AddItemToArray(arr, vm_to_json(&vms[i]));
+    }
+    pthread_mutex_unlock(&balloon_lock);
+    cJSON_Delete(root);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+void balloon_set_target(const char *uri, const char *name, unsigned long long target_kib) {
+    pthread_mutex_lock(&balloon_lock);
+    struct balloon_vm *vm = get_vm(uri, name);
+    if (vm) {
+        vm->target_kib = target_kib;
+        vm->actual_kib = target_kib;
+        vm->changed_at = time(NULL);
+    } else {
+        LOG_WARN("%s on %s: too many tracked VMs, resize target not recorded", name, uri);
+    }
+    pthread_mutex_unlock(&balloon_lock);
+}
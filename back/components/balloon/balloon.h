@@ -0,0 +1,38 @@
+// balloon.h
+#ifndef BALLOON_H
+#define BALLOON_H
+
+/* Nombre max de VMs suivies par le rééquilibreur (tous hôtes confondus) */
+#define MAX_BALLOON_VMS 512
+
+/* Période de collecte des stats du ballon demandée à l'invité (s) */
+#define BALLOON_STATS_PERIOD_S 5
+
+/* Écart en dessous duquel on ne touche pas au ballon (KiB) */
+#define BALLOON_MIN_CHANGE_KIB (16ULL * 1024)
+
+/*
+ * Rééquilibreur de mémoire : lit les stats du ballon virtio de chaque VM
+ * active des hôtes enregistrés (mémoire libre de l'invité, défauts de page
+ * majeurs) et rend la mémoire inutilisée à l'hôte, ou en redonne aux invités
+ * sous pression, entre un plancher et un plafond par VM.
+ *
+ * Réglages globaux et surcharges par VM :
+ * { "enabled": true, "intervalS": 10, "stepMiB": 256, "hostReserveMiB": 2048,
+ *   "targetFreePercent": 20, "lowFreePercent": 10, "floorPercent": 25,
+ *   "majorFaultsThreshold": 100,
+ *   "vms": [ { "uri", "vmName", "floorMiB", "ceilingMiB", "targetMiB", "exclude": false } ] }
+ */
+char *handle_balloonconfig(const char *post_data);
+
+/* Dernière décision par VM ("uri" optionnel pour filtrer un hôte) */
+char *handle_balloonstatus(const char *post_data);
+
+/*
+ * Mémoire fixée explicitement (/resizevm, KiB) : le rééquilibreur ne touche
+ * plus au ballon de la VM tant que /balloonconfig ne la libère pas
+ * ("vms": [ { "uri", "vmName", "targetMiB": 0 } ]).
+ */
+void balloon_set_target(const char *uri, const char *name, unsigned long long target_kib);
+
+#endif
@@ -1,6 +1,9 @@
 #include "handler_connect.h"
 #include "../../libvirt-utils.h"
 #include "../displayVms_handler/displayvms_handler.h"
+#include "../placement/placement.h"
+#include "../inventory/inventory.h"
+#include "../qos_handler/qos_handler.h"
 #include <cjson/cJSON.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -24,6 +27,9 @@ char *handle_connect(const char *json_body)
     path     = GET("path");
     if ((j = cJSON_GetObjectItemCaseSensitive(root, "port")) && cJSON_IsNumber(j))
         port = j->valueint;
+    int timeout_ms = 0;             /* 0 : LIBVIRT_PROBE_TIMEOUT_MS */
+    if ((j = cJSON_GetObjectItemCaseSensitive(root, "timeoutMs")) && cJSON_IsNumber(j))
+        timeout_ms = j->valueint;
 #undef GET
 
     if (!protocol) protocol = "qemu";
@@ -33,16 +39,30 @@ char *handle_connect(const char *json_body)
     char uri[512];
     build_libvirt_uri(uri, sizeof(uri), protocol, user, host, port, path);
 
-    /* Test the connection */
-    int ok = test_libvirt_connection(uri);
+    /* Sonde bornée : la connexion réussie reste dans le pool */
+    struct libvirt_probe_result probe;
+    int status = libvirt_probe(uri, timeout_ms, &probe);
+    int ok = status == LIBVIRT_PROBE_OK;
+
+    /* Hôte joignable : suivi par le service de placement */
+    if (ok)
+        placement_register_host(uri);
 
     /* Build JSON response */
     cJSON *resp = cJSON_CreateObject();
     cJSON_AddStringToObject(resp, "uri", uri);
-    cJSON_AddBoolToObject(resp, "success", ok == 0);
+    cJSON_AddBoolToObject(resp, "success", ok);
     cJSON_AddStringToObject(resp, "message",
-                            ok == 0 ? "connected successfully"
-                                    : "failed to connect to hypervisor");
+                            ok ? "connected successfully"
+                               : status == LIBVIRT_PROBE_TIMEOUT
+                                   ? "hypervisor did not answer in time"
+                                   : "failed to connect to hypervisor");
+    cJSON_AddBoolToObject(resp, "cached", probe.cached);
+    cJSON_AddNumberToObject(resp, "elapsedMs", (double)probe.elapsed_ms);
+    if (!ok) {
+        cJSON_AddStringToObject(resp, "error", probe.error);
+        cJSON_AddNumberToObject(resp, "retryAfterS", probe.retry_after_s);
+    }
 
     char *out = cJSON_PrintUnformatted(resp);
     cJSON_Delete(resp);
@@ -77,18 +97,79 @@ char *handle_listallvms(const char *json_body)
     if (!protocol) protocol = "qemu";
     if (!path)     path     = "system";
 
+    /* Delta : seulement ce qui a changé depuis cette génération */
+    int has_since = 0;
+    unsigned long long since = 0;
+    if ((j = cJSON_GetObjectItemCaseSensitive(root, "since")) && cJSON_IsNumber(j)) {
+        has_since = 1;
+        since = (unsigned long long)j->valuedouble;
+    }
+
+    /* Page filtrée/triée dès qu'un paramètre de requête est présent */
+    struct inventory_query q;
+    memset(&q, 0, sizeof(q));
+    int paged = 0;
+#define GETSTR(name) ((j = cJSON_GetObjectItemCaseSensitive(root, name)) && \
+                      cJSON_IsString(j) ? (paged = 1, j->valuestring) : NULL)
+#define GETNUM(name) ((j = cJSON_GetObjectItemCaseSensitive(root, name)) && \
+                      cJSON_IsNumber(j) ? (paged = 1, j->valuedouble) : 0)
+    q.state          = GETSTR("state");
+    q.name           = GETSTR("name");
+    q.cursor         = GETSTR("cursor");
+    q.min_memory_mib = (unsigned long long)GETNUM("minMemoryMiB");
+    q.max_memory_mib = (unsigned long long)GETNUM("maxMemoryMiB");
+    q.min_vcpus      = (int)GETNUM("minVcpus");
+    q.max_vcpus      = (int)GETNUM("maxVcpus");
+    q.limit          = (int)GETNUM("limit");
+    const char *sort  = GETSTR("sort");
+    const char *order = GETSTR("order");
+#undef GETSTR
+#undef GETNUM
+
+    /* Un delta ne se filtre pas : une VM sortie du filtre ne serait jamais retirée */
+    if (has_since && paged) {
+        cJSON_Delete(root);
+        return strdup("{\"success\":false,\"error\":\"since cannot be combined with "
+                      "filters, sort or paging\"}");
+    }
+
+    if (sort) {
+        int key = inventory_sort_from_name(sort);
+        if (key < 0) {
+            cJSON_Delete(root);
+            return strdup("{\"success\":false,\"error\":\"invalid sort key\"}");
+        }
+        q.sort = key;
+    }
+    q.descending = order && strcmp(order, "desc") == 0;
+
     char uri[512];
     build_libvirt_uri(uri, sizeof(uri), protocol, user, host, port, path);
 
-    char *vms_json = get_all_vms_json(uri);
+    if (inventory_refresh(uri, 0) < 0) {
+        cJSON_Delete(root);
+        return strdup("{\"success\":false,\"error\":\"cannot connect to hypervisor\"}");
+    }
 
     cJSON *resp = cJSON_CreateObject();
     cJSON_AddStringToObject(resp, "uri", uri);
-    cJSON_AddItemToObject(resp, "vms", cJSON_Parse(vms_json));
+    if (paged) {
+        char err[64];
+        if (inventory_query_json(uri, &q, resp, err, sizeof(err)) < 0) {
+            cJSON_Delete(resp);
+            cJSON_Delete(root);
+            return strdup("{\"success\":false,\"error\":\"invalid cursor\"}");
+        }
+    } else {
+        inventory_list_json(uri, has_since, since, resp);
+    }
+
+    /* Limites QoS courantes (un XML par VM de la page) : sur demande seulement */
+    if (cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(root, "withQos")))
+        qos_annotate_vms(uri, cJSON_GetObjectItemCaseSensitive(resp, "vms"));
 
     char *out = cJSON_PrintUnformatted(resp);
     cJSON_Delete(resp);
     cJSON_Delete(root);
-    free(vms_json);
     return out;
 }
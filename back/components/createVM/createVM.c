@@ -2,6 +2,12 @@
 
 #include "createVM.h"
 #include "../../libvirt-utils.h"
+#include "../placement/placement.h"
+#include "../inventory/inventory.h"
+#include "../qos_handler/qos_handler.h"
+#include "../numa/numa.h"
+#include "../hostinfo/hostinfo.h"
+#include "../trace/trace.h"
 
 #include <libvirt/libvirt.h>
 #include <cjson/cJSON.h>
@@ -31,12 +37,17 @@ static void build_nfs_path(char *out, size_t out_size, const char *basename) {
 /* Teste l’existence d’un fichier */
 static int file_exists(const char *path) {
     struct stat st;
-    return (stat(path, &st) == 0);
+    uint64_t t0 = trace_begin();
+    int rc = stat(path, &st);
+    trace_end_detail("io", "stat", t0, path);
+    return rc == 0;
 }
 
 /* Exécute une commande système et retourne son code de sortie normalisé */
 static int run_command(const char *cmd) {
+    uint64_t t0 = trace_begin();
     int rc = system(cmd);
+    trace_end_detail("exec", "system", t0, cmd);
     if (rc == -1) {
         return -1;
     }
@@ -59,14 +70,30 @@ static int run_command(const char *cmd) {
  *     "vmName": "vm-test",
  *     "cpu": 2,
  *     "memory": 1024,
+ *     "maxCpu": 8,                // optionnel : vCPUs branchables à chaud (/resizevm)
+ *     "maxMemory": 8192,          // optionnel, MiB : plafond du ballon
+ *     "memoryHotplug": false,     // optionnel : maxMemory devient le plafond de DIMM
+ *                                 // ajoutables à chaud (NUMA à un nœud)
  *     "iso": "ubuntu-11.04-server-amd64.iso",
+ *     "baseImage": "debian-13-golden.qcow2", // optionnel : overlay qcow2 sur une
+ *                                 // image préinstallée (iso alors optionnel)
  *     "disk_size": 8192,
  *     "network": "default",       // optionnel, "default" si absent
  *     "protocol": "qemu",         // optionnel
  *     "user": null,               // optionnel
  *     "host": "192.168.122.1",    // optionnel
  *     "port": 16509,              // optionnel
- *     "path": "system"            // optionnel
+ *     "path": "system",           // optionnel
+ *     "arch": "x86_64",           // optionnel : architecture de l'hôte par défaut
+ *     "machine": "q35",           // optionnel : type de machine (défaut libvirt)
+ *     "cpuModel": "host-passthrough", // optionnel : ou un modèle de /hostinfo
+ *     "numa": "auto",             // optionnel : "auto" (défaut), "none" ou n° de nœud ;
+ *                                 // vCPUs, émulateur, iothread et mémoire liés au nœud
+ *     "qos": {                    // optionnel : limites posées dès la création
+ *       "disk": { "totalIops": 500, "totalBytesSec": 104857600 },
+ *       "net":  { "inboundKBps": 12800, "outboundKBps": 12800 },
+ *       "cpu":  { "shares": 512, "vcpuQuotaPercent": 50 }
+ *     }
  *   }
  *
  * @return : JSON alloué dynamiquement (char*) à libérer par l’appelant.
@@ -84,9 +111,14 @@ char *handle_create_vm(const char *json_body) {
     cJSON *j_iso       = cJSON_GetObjectItemCaseSensitive(root, "iso");
     cJSON *j_disk_size = cJSON_GetObjectItemCaseSensitive(root, "disk_size");
     cJSON *j_network   = cJSON_GetObjectItemCaseSensitive(root, "network");
+    cJSON *j_base      = cJSON_GetObjectItemCaseSensitive(root, "baseImage");
+
+    /* Provisioning rapide : disque en overlay sur une image de base, sans ISO */
+    const char *base_image =
+        (cJSON_IsString(j_base) && j_base->valuestring[0]) ? j_base->valuestring : NULL;
 
     if (!cJSON_IsString(j_vmName) || !cJSON_IsNumber(j_cpu) ||
-        !cJSON_IsNumber(j_memory) || !cJSON_IsString(j_iso) ||
+        !cJSON_IsNumber(j_memory) || (!cJSON_IsString(j_iso) && !base_image) ||
         !cJSON_IsNumber(j_disk_size)) {
         cJSON_Delete(root);
         return strdup("{\"success\":false,\"error\":\"missing or invalid fields\"}");
@@ -95,7 +127,7 @@ char *handle_create_vm(const char *json_body) {
     const char *vmName      = j_vmName->valuestring;
     int         cpu         = j_cpu->valueint;
     int         memory      = j_memory->valueint;        // en MiB
-    const char *iso         = j_iso->valuestring;
+    const char *iso         = cJSON_IsString(j_iso) ? j_iso->valuestring : NULL;
     int         disk_size_mb = j_disk_size->valueint;    // en MiB
 
     /* Network : optionnel, default si absent */
@@ -113,6 +145,36 @@ char *handle_create_vm(const char *json_body) {
         return strdup("{\"success\":false,\"error\":\"field values out of bounds\"}");
     }
 
+    /* Limites d'E/S et CPU : un invité bruyant ne sature pas le NFS partagé */
+    struct vm_qos qos;
+    char qos_err[128];
+    if (qos_from_json(cJSON_GetObjectItemCaseSensitive(root, "qos"), &qos,
+                      qos_err, sizeof(qos_err)) < 0) {
+        cJSON *err = cJSON_CreateObject();
+        cJSON_AddBoolToObject(err, "success", false);
+        cJSON_AddStringToObject(err, "error", qos_err);
+        char *out = cJSON_PrintUnformatted(err);
+        cJSON_Delete(err);
+        cJSON_Delete(root);
+        return out;
+    }
+
+    /*
+     * Marge pour /resizevm : vCPUs déclarés mais éteints, et mémoire au-delà
+     * de la valeur courante (ballon, ou slots DIMM avec memoryHotplug).
+     */
+    cJSON *j_max_cpu = cJSON_GetObjectItemCaseSensitive(root, "maxCpu");
+    cJSON *j_max_mem = cJSON_GetObjectItemCaseSensitive(root, "maxMemory");
+    int max_cpu    = cJSON_IsNumber(j_max_cpu) ? j_max_cpu->valueint : cpu;
+    int max_memory = cJSON_IsNumber(j_max_mem) ? j_max_mem->valueint : memory;
+    bool memory_hotplug = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(root, "memoryHotplug"));
+
+    if (max_cpu < cpu || max_cpu > 64 ||
+        max_memory < memory || max_memory > 524288) {
+        cJSON_Delete(root);
+        return strdup("{\"success\":false,\"error\":\"field values out of bounds\"}");
+    }
+
     /* Paramètres optionnels de connexion libvirt */
     const char *protocol = NULL;
     const char *user     = NULL;
@@ -142,26 +204,110 @@ char *handle_create_vm(const char *json_body) {
      * Connexion à libvirt
      * ------------------------------------------------------------------ */
     char uri[512];
-    build_libvirt_uri(uri, sizeof(uri), protocol, user, host, port, path);
+    cJSON *j_placement = cJSON_GetObjectItemCaseSensitive(root, "placement");
+    if (cJSON_IsString(j_placement) && strcmp(j_placement->valuestring, "auto") == 0) {
+        /* Hôte choisi par le service de placement ("placementStrategy" optionnel) */
+        cJSON *j_strategy = cJSON_GetObjectItemCaseSensitive(root, "placementStrategy");
+        const char *strategy = cJSON_IsString(j_strategy) ? j_strategy->valuestring : NULL;
+        if (placement_best_host(strategy, (unsigned long long)memory, cpu, NULL,
+                                uri, sizeof(uri)) < 0) {
+            cJSON_Delete(root);
+            return strdup("{\"success\":false,\"error\":\"no registered host can receive this VM\"}");
+        }
+    } else {
+        build_libvirt_uri(uri, sizeof(uri), protocol, user, host, port, path);
+    }
 
-    virConnectPtr conn = virConnectOpen(uri);
+    virConnectPtr conn = TRACE_VIRT(virConnectOpen, uri);
     if (!conn) {
         cJSON_Delete(root);
         return strdup("{\"success\":false,\"error\":\"cannot connect to libvirt\"}");
     }
 
+    /* ------------------------------------------------------------------
+     * Validation contre les capabilities de l'hôte (cache hostinfo)
+     * ------------------------------------------------------------------ */
+    struct hostinfo *caps = malloc(sizeof(*caps));
+    if (!caps || hostinfo_get(uri, conn, 0, caps) < 0) {
+        free(caps);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return strdup("{\"success\":false,\"error\":\"cannot read hypervisor capabilities\"}");
+    }
+
+    cJSON *j_arch = cJSON_GetObjectItemCaseSensitive(root, "arch");
+    cJSON *j_machine = cJSON_GetObjectItemCaseSensitive(root, "machine");
+    cJSON *j_cpu_model = cJSON_GetObjectItemCaseSensitive(root, "cpuModel");
+    const char *arch = cJSON_IsString(j_arch) && j_arch->valuestring[0] ? j_arch->valuestring
+                       : caps->arch[0] ? caps->arch : "x86_64";
+    const char *machine = cJSON_IsString(j_machine) && j_machine->valuestring[0]
+                          ? j_machine->valuestring : NULL;
+    const char *cpu_model = cJSON_IsString(j_cpu_model) && j_cpu_model->valuestring[0]
+                            ? j_cpu_model->valuestring : NULL;
+
+    /* kvm seulement pour l'architecture native, sinon émulation TCG */
+    const struct hostinfo_guest *guest = hostinfo_guest(caps, arch);
+    const char *dom_type = guest && guest->kvm && strcmp(arch, caps->arch) == 0 ? "kvm" : "qemu";
+    const char *caps_err = NULL;
+    if (!guest)
+        caps_err = "architecture not supported by this host";
+    else if (machine && !hostinfo_has_machine(guest, machine))
+        caps_err = "machine type not supported by this host";
+    else if (caps->vcpu_max > 0 && strcmp(dom_type, caps->dom_type) == 0 && max_cpu > caps->vcpu_max)
+        caps_err = "too many vCPUs for this hypervisor";
+    else if (caps->memory_kib && (unsigned long long)max_memory * 1024 > caps->memory_kib)
+        caps_err = "memory exceeds host memory";
+    else if (cpu_model && strcmp(cpu_model, "host-passthrough") == 0 &&
+             (strcmp(dom_type, "kvm") != 0 || !caps->host_passthrough))
+        caps_err = "host-passthrough needs kvm";
+    else if (cpu_model && strcmp(cpu_model, "host-passthrough") != 0 &&
+             !hostinfo_has_cpu_model(caps, cpu_model))
+        caps_err = "cpu model not usable on this host";
+    if (caps_err) {
+        cJSON *err = cJSON_CreateObject();
+        cJSON_AddBoolToObject(err, "success", false);
+        cJSON_AddStringToObject(err, "error", caps_err);
+        char *out = cJSON_PrintUnformatted(err);
+        cJSON_Delete(err);
+        free(caps);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return out;
+    }
+    char emulator[256];
+    snprintf(emulator, sizeof(emulator), "%s", guest->emulator);
+    free(caps);
+
     /* ------------------------------------------------------------------
      * Préparation chemins ISO et disque
      * ------------------------------------------------------------------ */
 
     /* Chemin complet de l'ISO sur le NFS */
-    char iso_path[1024];
-    build_nfs_path(iso_path, sizeof(iso_path), iso);
+    char iso_path[1024] = "";
+    if (iso) {
+        build_nfs_path(iso_path, sizeof(iso_path), iso);
+
+        if (!file_exists(iso_path)) {
+            virConnectClose(conn);
+            cJSON_Delete(root);
+            return strdup("{\"success\":false,\"error\":\"iso not found on server\"}");
+        }
+    }
 
-    if (!file_exists(iso_path)) {
-        virConnectClose(conn);
-        cJSON_Delete(root);
-        return strdup("{\"success\":false,\"error\":\"iso not found on server\"}");
+    /* Image de base : simple nom de fichier sous NFS_BASE (passé au shell) */
+    char base_path[1024] = "";
+    if (base_image) {
+        if (strchr(base_image, '/') || strchr(base_image, '\'')) {
+            virConnectClose(conn);
+            cJSON_Delete(root);
+            return strdup("{\"success\":false,\"error\":\"invalid base image name\"}");
+        }
+        build_nfs_path(base_path, sizeof(base_path), base_image);
+        if (!file_exists(base_path)) {
+            virConnectClose(conn);
+            cJSON_Delete(root);
+            return strdup("{\"success\":false,\"error\":\"base image not found on server\"}");
+        }
     }
 
     /* Nom de fichier disque : <vmName>.qcow2 sous NFS_BASE */
@@ -175,13 +321,37 @@ char *handle_create_vm(const char *json_body) {
         return strdup("{\"success\":false,\"error\":\"disk already exists\"}");
     }
 
+    /*
+     * NUMA : sur un hôte multi-sockets, la VM est liée à un seul nœud (cache
+     * et mémoire locaux). Le plafond mémoire et tous les vCPUs doivent y tenir.
+     */
+    struct numa_plan numa = { .node = -1 };
+    cJSON *j_numa = cJSON_GetObjectItemCaseSensitive(root, "numa");
+    if (!(cJSON_IsString(j_numa) && strcmp(j_numa->valuestring, "none") == 0)) {
+        int forced_node = cJSON_IsNumber(j_numa) ? j_numa->valueint : -1;
+        if (numa_plan_vm(conn, max_cpu, (unsigned long long)max_memory, forced_node, &numa) < 0) {
+            virConnectClose(conn);
+            cJSON_Delete(root);
+            return strdup("{\"success\":false,\"error\":\"requested NUMA node cannot hold this VM\"}");
+        }
+    }
+
     /* ------------------------------------------------------------------
      * Création de l'image disque qcow2
      * ------------------------------------------------------------------ */
 
-    char cmd[2048];
-    /* On utilise une taille en MiB : ex: qemu-img create -f qcow2 /path/vm.qcow2 8192M */
-    snprintf(cmd, sizeof(cmd), "qemu-img create -f qcow2 '%s' %dM", disk_path, disk_size_mb);
+    char cmd[4096];
+    if (base_image) {
+        /*
+         * Overlay copy-on-write : création instantanée, l'image de base reste
+         * partagée en lecture seule entre toutes les VMs qui en dérivent.
+         */
+        snprintf(cmd, sizeof(cmd), "qemu-img create -f qcow2 -b '%s' -F qcow2 '%s' %dM",
+                 base_path, disk_path, disk_size_mb);
+    } else {
+        /* On utilise une taille en MiB : ex: qemu-img create -f qcow2 /path/vm.qcow2 8192M */
+        snprintf(cmd, sizeof(cmd), "qemu-img create -f qcow2 '%s' %dM", disk_path, disk_size_mb);
+    }
 
     int rc = run_command(cmd);
     if (rc != 0) {
@@ -198,17 +368,79 @@ char *handle_create_vm(const char *json_body) {
     /* ------------------------------------------------------------------
      * Construction du XML de domaine libvirt
      * ------------------------------------------------------------------ */
-    char xml[12288];
+    char xml[16384];
+
+    /* Sans ISO (image de base), le lecteur CD reste vide */
+    char cdrom_source[1100] = "";
+    if (iso)
+        snprintf(cdrom_source, sizeof(cdrom_source), "<source file='%s'/>", iso_path);
+
+    /*
+     * Ballon : la VM démarre avec <memory> = maxMemory, gonflé jusqu'à
+     * currentMemory. DIMM : <memory> = mémoire de boot, maxMemory réserve
+     * des slots sur un nœud NUMA unique (requis par QEMU pour le hotplug).
+     */
+    char memory_xml[256], numa_cells[192] = "";
+    if (memory_hotplug && max_memory > memory) {
+        snprintf(memory_xml, sizeof(memory_xml),
+                 "<maxMemory slots='16' unit='MiB'>%d</maxMemory>"
+                 "<memory unit='MiB'>%d</memory>", max_memory, memory);
+        snprintf(numa_cells, sizeof(numa_cells),
+                 "<numa><cell id='0' cpus='0-%d' memory='%d' unit='MiB'/></numa>",
+                 max_cpu - 1, memory);
+    } else {
+        snprintf(memory_xml, sizeof(memory_xml),
+                 "<memory unit='MiB'>%d</memory>"
+                 "<currentMemory unit='MiB'>%d</currentMemory>", max_memory, memory);
+    }
+
+    /* Modèle CPU (validé plus haut contre /hostinfo) et cellule NUMA du hotplug */
+    char cpu_xml[320] = "";
+    if (cpu_model && strcmp(cpu_model, "host-passthrough") == 0)
+        snprintf(cpu_xml, sizeof(cpu_xml), "<cpu mode='host-passthrough'>%s</cpu>", numa_cells);
+    else if (cpu_model)
+        snprintf(cpu_xml, sizeof(cpu_xml),
+                 "<cpu mode='custom' match='exact'><model fallback='forbid'>%s</model>%s</cpu>",
+                 cpu_model, numa_cells);
+    else if (numa_cells[0])
+        snprintf(cpu_xml, sizeof(cpu_xml), "<cpu>%s</cpu>", numa_cells);
+
+    char machine_attr[80] = "";
+    if (machine)
+        snprintf(machine_attr, sizeof(machine_attr), " machine='%s'", machine);
+
+    char iotune_xml[512], bandwidth_xml[256], qos_cpu_xml[256];
+    char pin_xml[4096], numatune_xml[128], cputune_xml[4608] = "";
+    if (qos_xml_fragments(&qos, iotune_xml, sizeof(iotune_xml),
+                          bandwidth_xml, sizeof(bandwidth_xml),
+                          qos_cpu_xml, sizeof(qos_cpu_xml)) < 0 ||
+        numa_xml_fragments(&numa, max_cpu, pin_xml, sizeof(pin_xml),
+                           numatune_xml, sizeof(numatune_xml)) < 0) {
+        unlink(disk_path);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return strdup("{\"success\":false,\"error\":\"xml build failed\"}");
+    }
+    if (qos_cpu_xml[0] || pin_xml[0])
+        snprintf(cputune_xml, sizeof(cputune_xml), "<cputune>%s%s</cputune>", qos_cpu_xml, pin_xml);
+
+    /* VM liée à un nœud : les E/S disque passent par un iothread épinglé avec elle */
+    const char *iothreads_xml = numa.node >= 0 ? "<iothreads>1</iothreads>" : "";
+    const char *disk_iothread = numa.node >= 0 ? " iothread='1'" : "";
 
     int r = snprintf(
         xml,
         sizeof(xml),
-        "<domain type='kvm'>"
+        "<domain type='%s'>"
           "<name>%s</name>"
-          "<memory unit='MiB'>%d</memory>"
-          "<vcpu>%d</vcpu>"
+          "%s"
+          "<vcpu placement='static' current='%d'>%d</vcpu>"
+          "%s"
+          "%s"
+          "%s"
+          "%s"
           "<os>"
-            "<type arch='x86_64'>hvm</type>"
+            "<type arch='%s'%s>hvm</type>"
             "<boot dev='hd'/>"
             "<boot dev='cdrom'/>"
           "</os>"
@@ -218,34 +450,49 @@ char *handle_create_vm(const char *json_body) {
           "<on_reboot>restart</on_reboot>"
           "<on_crash>restart</on_crash>"
           "<devices>"
-            "<emulator>/usr/bin/qemu-system-x86_64</emulator>"
+            "<emulator>%s</emulator>"
             "<disk type='file' device='disk'>"
-              "<driver name='qemu' type='qcow2' cache='none'/>"
+              "<driver name='qemu' type='qcow2' cache='none' discard='unmap'%s/>"
               "<source file='%s'/>"
               "<target dev='vda' bus='virtio'/>"
+              "%s"
             "</disk>"
             "<disk type='file' device='cdrom'>"
               "<driver name='qemu' type='raw'/>"
-              "<source file='%s'/>"
+              "%s"
               "<target dev='hdc' bus='ide'/>"
               "<readonly/>"
             "</disk>"
             "<interface type='network'>"
               "<source network='%s'/>"
+              "%s"
             "</interface>"
             "<serial type='pty'><target port='0'/></serial>"
             "<console type='pty'><target type='serial' port='0'/></console>"
             "<graphics type='vnc' port='-1' autoport='yes' listen='0.0.0.0'/>"
             "<video><model type='cirrus' vram='9216' heads='1'/></video>"
-            "<memballoon model='virtio'/>"
+            /* stats du ballon pour le rééquilibreur (BALLOON_STATS_PERIOD_S) */
+            "<memballoon model='virtio'><stats period='5'/></memballoon>"
           "</devices>"
         "</domain>",
+        dom_type,    // %s
         vmName,      // %s
-        memory,      // %d
+        memory_xml,  // %s
         cpu,         // %d
+        max_cpu,     // %d
+        iothreads_xml, // %s
+        cputune_xml, // %s
+        numatune_xml, // %s
+        cpu_xml,     // %s
+        arch,        // %s
+        machine_attr, // %s
+        emulator,    // %s
+        disk_iothread, // %s
         disk_path,   // %s
-        iso_path,    // %s
-        network_name // %s
+        iotune_xml,  // %s
+        cdrom_source, // %s
+        network_name, // %s
+        bandwidth_xml // %s
     );
 
     if (r < 0 || (size_t)r >= sizeof(xml)) {
@@ -259,7 +506,7 @@ char *handle_create_vm(const char *json_body) {
     /* ------------------------------------------------------------------
      * Création du domaine libvirt
      * ------------------------------------------------------------------ */
-    virDomainPtr dom = virDomainCreateXML(conn, xml, 0);
+    virDomainPtr dom = TRACE_VIRT(virDomainCreateXML, conn, xml, 0);
 
     cJSON *resp = cJSON_CreateObject();
     if (!resp) {
@@ -277,6 +524,9 @@ char *handle_create_vm(const char *json_body) {
     } else {
         cJSON_AddBoolToObject(resp, "success", true);
         cJSON_AddStringToObject(resp, "message", "VM created and started");
+        cJSON_AddStringToObject(resp, "uri", uri);
+        if (numa.node >= 0)
+            cJSON_AddNumberToObject(resp, "numaNode", numa.node);
 
         char uuid_str[37];
         if (virDomainGetUUIDString(dom, uuid_str) == 0) {
@@ -290,6 +540,7 @@ char *handle_create_vm(const char *json_body) {
         }
 
         virDomainFree(dom);
+        inventory_invalidate(uri);
     }
 
     virConnectClose(conn);
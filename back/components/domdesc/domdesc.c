@@ -0,0 +1,560 @@
+// domdesc.c
+#include "domdesc.h"
+#include "../../libvirt-utils.h"
+#define LOG_COMPONENT "domdesc"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Hyperviseurs suivis par événements (comme le pool de connexions) */
+#define MAX_DOMDESC_WATCHES 32
+
+/* Événements qui modifient ce que décrit le modèle */
+static const int watched_events[] = {
+    VIR_DOMAIN_EVENT_ID_LIFECYCLE,      /* define/undefine, start/stop : ports, pty, vnetN */
+    VIR_DOMAIN_EVENT_ID_DEVICE_ADDED,
+    VIR_DOMAIN_EVENT_ID_DEVICE_REMOVED,
+    VIR_DOMAIN_EVENT_ID_BLOCK_JOB_2,    /* pivot, commit : la chaîne de disques change */
+    VIR_DOMAIN_EVENT_ID_BALLOON_CHANGE, /* <currentMemory> */
+};
+#define DOMDESC_NEVENTS ((int)(sizeof(watched_events) / sizeof(watched_events[0])))
+
+struct domdesc_entry {
+    struct domdesc *desc;               /* NULL : place libre */
+};
+
+/* Abonnement aux événements d'un hyperviseur, sur la connexion du pool */
+struct domdesc_watch {
+    char uri[512];                      /* fixé à la création, jamais réutilisé */
+    virConnectPtr conn;                 /* référence gardée tant que l'abonnement vit */
+    int  callbacks[DOMDESC_NEVENTS];
+    int  active;                        /* tous les callbacks enregistrés */
+};
+
+static struct domdesc_entry entries[MAX_DOMDESC_CACHE];
+static unsigned long cache_gen;         /* incrémenté à chaque invalidation */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct domdesc_watch watches[MAX_DOMDESC_WATCHES];
+static pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+static int event_loop_ok;
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("%s: libvirt error (code=%d, domain=%d): %s",
+                  prefix, err->code, err->domain,
+                  err->message ? err->message : "(no message)");
+    } else {
+        LOG_ERROR("%s: unknown libvirt error", prefix);
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Lecture du XML (balises produites par libvirt, sans parseur générique)
+ * -------------------------------------------------------------------------- */
+
+/* Début de la première balise open dans [p, end), NULL sinon */
+static const char *find_in(const char *p, const char *end, const char *open) {
+    const char *m = p ? strstr(p, open) : NULL;
+    return m && m < end ? m : NULL;
+}
+
+/* Texte de <tag ...>texte</tag> commençant à p ; "" si balise vide */
+static void tag_text(const char *p, const char *end, char *out, size_t outlen) {
+    out[0] = '\0';
+    const char *gt = p ? strchr(p, '>') : NULL;
+    if (!gt || gt >= end || gt[-1] == '/')
+        return;
+    const char *lt = strchr(gt + 1, '<');
+    if (!lt || lt > end)
+        return;
+    size_t n = (size_t)(lt - gt - 1);
+    if (n >= outlen)
+        n = outlen - 1;
+    memcpy(out, gt + 1, n);
+    out[n] = '\0';
+}
+
+/* Valeur de attr='...' dans la balise commençant à p ("" si p NULL) */
+static void attr_value(const char *p, const char *attr, char *out, size_t outlen) {
+    out[0] = '\0';
+    if (!p)
+        return;
+    const char *gt = strchr(p, '>');
+    char key[48];
+    snprintf(key, sizeof(key), " %s='", attr);
+    const char *a = strstr(p, key);
+    if (!a || (gt && a > gt))
+        return;
+    a += strlen(key);
+    const char *q = strchr(a, '\'');
+    if (!q)
+        return;
+    size_t n = (size_t)(q - a);
+    if (n >= outlen)
+        n = outlen - 1;
+    memcpy(out, a, n);
+    out[n] = '\0';
+}
+
+/* Fin de l'élément ouvert en p : après "/>" ou au début de close */
+static const char *elem_end(const char *p, const char *close) {
+    const char *gt = strchr(p, '>');
+    if (!gt)
+        return NULL;
+    if (gt[-1] == '/')
+        return gt + 1;
+    return strstr(gt, close);
+}
+
+/* Premier attribut présent parmi file, dev, name (chemin d'une <source>) */
+static void source_path(const char *src, char *out, size_t outlen) {
+    attr_value(src, "file", out, outlen);
+    if (!out[0])
+        attr_value(src, "dev", out, outlen);
+    if (!out[0])
+        attr_value(src, "name", out, outlen);
+}
+
+static unsigned long long tag_kib(const char *p, const char *end) {
+    char v[32];
+    tag_text(p, end, v, sizeof(v));
+    return strtoull(v, NULL, 10);        /* libvirt normalise en KiB */
+}
+
+/* Retourne 1 si la chaîne de backing dépasse MAX_DOMDESC_BACKING */
+static int parse_disk(const char *p, const char *end, struct domdesc_disk *d) {
+    attr_value(p, "device", d->device, sizeof(d->device));
+    attr_value(p, "type", d->type, sizeof(d->type));
+    attr_value(find_in(p, end, "<driver "), "type", d->format, sizeof(d->format));
+
+    const char *target = find_in(p, end, "<target ");
+    attr_value(target, "dev", d->target, sizeof(d->target));
+    attr_value(target, "bus", d->bus, sizeof(d->bus));
+
+    /* La <source> du disque précède sa chaîne <backingStore> */
+    const char *chain = find_in(p, end, "<backingStore ");
+    const char *src = find_in(p, chain ? chain : end, "<source ");
+    if (src)
+        source_path(src, d->source, sizeof(d->source));
+
+    int truncated = 0;
+    while (chain) {
+        if (d->nbacking == MAX_DOMDESC_BACKING) {
+            truncated = 1;
+            break;
+        }
+        const char *next = find_in(chain + 1, end, "<backingStore ");
+        src = find_in(chain, next ? next : end, "<source ");
+        if (src) {
+            source_path(src, d->backing[d->nbacking], sizeof(d->backing[0]));
+            if (d->backing[d->nbacking][0])
+                d->nbacking++;
+        }
+        chain = next;
+    }
+
+    d->readonly = find_in(p, end, "<readonly/>") != NULL;
+    d->shareable = find_in(p, end, "<shareable/>") != NULL;
+    return truncated;
+}
+
+static void parse_nic(const char *p, const char *end, struct domdesc_nic *n) {
+    attr_value(p, "type", n->type, sizeof(n->type));
+    attr_value(find_in(p, end, "<mac "), "address", n->mac, sizeof(n->mac));
+    const char *src = find_in(p, end, "<source ");
+    attr_value(src, "network", n->source, sizeof(n->source));
+    if (!n->source[0])
+        attr_value(src, "bridge", n->source, sizeof(n->source));
+    if (!n->source[0])
+        attr_value(src, "dev", n->source, sizeof(n->source));
+    attr_value(find_in(p, end, "<model "), "type", n->model, sizeof(n->model));
+    attr_value(find_in(p, end, "<target "), "dev", n->target, sizeof(n->target));
+}
+
+static void parse_graphics(const char *p, const char *end, struct domdesc_graphics *g) {
+    char v[16];
+    attr_value(p, "type", g->type, sizeof(g->type));
+    attr_value(p, "port", v, sizeof(v));
+    g->port = v[0] ? atoi(v) : -1;
+    attr_value(p, "autoport", v, sizeof(v));
+    g->autoport = strcmp(v, "yes") == 0;
+    attr_value(p, "listen", g->listen, sizeof(g->listen));
+    if (!g->listen[0])
+        attr_value(find_in(p, end, "<listen "), "address", g->listen, sizeof(g->listen));
+}
+
+static void parse_console(const char *p, const char *end, const char *kind,
+                          struct domdesc_console *c) {
+    snprintf(c->kind, sizeof(c->kind), "%s", kind);
+    attr_value(p, "type", c->type, sizeof(c->type));
+    attr_value(find_in(p, end, "<target "), "type", c->target_type, sizeof(c->target_type));
+    attr_value(find_in(p, end, "<source "), "path", c->path, sizeof(c->path));
+    if (!c->path[0])
+        attr_value(p, "tty", c->path, sizeof(c->path));
+}
+
+static void parse_consoles(const char *dev, const char *dev_end, const char *kind,
+                           struct domdesc *d) {
+    char open[16], close[16];
+    snprintf(open, sizeof(open), "<%s ", kind);
+    snprintf(close, sizeof(close), "</%s>", kind);
+    for (const char *p = dev; (p = find_in(p, dev_end, open)) != NULL; ) {
+        const char *end = elem_end(p, close);
+        if (!end)
+            break;
+        if (d->nconsoles == MAX_DOMDESC_CONSOLES) {
+            d->truncated = 1;
+            break;
+        }
+        parse_console(p, end, kind, &d->consoles[d->nconsoles++]);
+        p = end;
+    }
+}
+
+int domdesc_parse(const char *xml, struct domdesc *d) {
+    const char *dom = xml ? strstr(xml, "<domain ") : NULL;
+    if (!dom)
+        return -1;
+    const char *xml_end = xml + strlen(xml);
+    const char *dev = strstr(dom, "<devices>");
+    const char *dev_end = dev ? strstr(dev, "</devices>") : NULL;
+    const char *head_end = dev ? dev : xml_end;
+
+    tag_text(find_in(dom, head_end, "<name>"), head_end, d->name, sizeof(d->name));
+
+    /* <vcpu placement='static' current='2'>4</vcpu> */
+    const char *vcpu = find_in(dom, head_end, "<vcpu ");
+    if (!vcpu)
+        vcpu = find_in(dom, head_end, "<vcpu>");
+    if (vcpu) {
+        char v[16];
+        tag_text(vcpu, head_end, v, sizeof(v));
+        d->max_vcpus = atoi(v);
+        attr_value(vcpu, "current", v, sizeof(v));
+        d->vcpus = v[0] ? atoi(v) : d->max_vcpus;
+    }
+
+    d->memory_kib = tag_kib(find_in(dom, head_end, "<memory "), head_end);
+    d->current_memory_kib = tag_kib(find_in(dom, head_end, "<currentMemory "), head_end);
+    d->max_memory_kib = tag_kib(find_in(dom, head_end, "<maxMemory "), head_end);
+    if (d->current_memory_kib == 0)
+        d->current_memory_kib = d->memory_kib;
+
+    if (!dev || !dev_end)
+        return 0;
+
+    for (const char *p = dev; (p = find_in(p, dev_end, "<disk ")) != NULL; ) {
+        const char *end = elem_end(p, "</disk>");
+        if (!end)
+            break;
+        if (d->ndisks == MAX_DOMDESC_DISKS) {
+            d->truncated = 1;
+            break;
+        }
+        if (parse_disk(p, end, &d->disks[d->ndisks++]))
+            d->truncated = 1;
+        p = end;
+    }
+
+    for (const char *p = dev; (p = find_in(p, dev_end, "<interface ")) != NULL; ) {
+        const char *end = elem_end(p, "</interface>");
+        if (!end)
+            break;
+        if (d->nnics == MAX_DOMDESC_NICS) {
+            d->truncated = 1;
+            break;
+        }
+        parse_nic(p, end, &d->nics[d->nnics++]);
+        p = end;
+    }
+
+    for (const char *p = dev; (p = find_in(p, dev_end, "<graphics ")) != NULL; ) {
+        const char *end = elem_end(p, "</graphics>");
+        if (!end)
+            break;
+        if (d->ngraphics == MAX_DOMDESC_GRAPHICS) {
+            d->truncated = 1;
+            break;
+        }
+        parse_graphics(p, end, &d->graphics[d->ngraphics++]);
+        p = end;
+    }
+
+    parse_consoles(dev, dev_end, "serial", d);
+    parse_consoles(dev, dev_end, "console", d);
+    if (d->truncated)
+        LOG_WARN("%s: description truncated (limits: %d disks, %d backing files per disk, "
+                 "%d NICs, %d graphics, %d consoles)", d->name, MAX_DOMDESC_DISKS,
+                 MAX_DOMDESC_BACKING, MAX_DOMDESC_NICS, MAX_DOMDESC_GRAPHICS,
+                 MAX_DOMDESC_CONSOLES);
+    return 0;
+}
+
+static int fetch(const char *uri, virDomainPtr dom, const char *uuid, struct domdesc *d) {
+    memset(d, 0, sizeof(*d));
+    snprintf(d->uri, sizeof(d->uri), "%s", uri);
+    snprintf(d->uuid, sizeof(d->uuid), "%s", uuid);
+
+    char *xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+    if (!xml) {
+        log_libvirt_error("virDomainGetXMLDesc");
+        return -1;
+    }
+    int rc = domdesc_parse(xml, d);
+    free(xml);
+    if (rc < 0) {
+        LOG_WARN("%s: unexpected domain XML for %s", uri, uuid);
+        return -1;
+    }
+    d->fetched_at = time(NULL);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Événements libvirt : invalidation du cache
+ * -------------------------------------------------------------------------- */
+
+static void *event_loop(void *arg) {
+    (void)arg;
+    for (;;) {
+        if (virEventRunDefaultImpl() < 0) {
+            log_libvirt_error("virEventRunDefaultImpl");
+            sleep(1);
+        }
+    }
+    return NULL;
+}
+
+void domdesc_init(void) {
+    if (virEventRegisterDefaultImpl() < 0) {
+        log_libvirt_error("virEventRegisterDefaultImpl");
+        return;
+    }
+    pthread_t th;
+    if (pthread_create(&th, NULL, event_loop, NULL) != 0) {
+        LOG_ERROR("cannot start libvirt event loop");
+        return;
+    }
+    pthread_detach(th);
+    event_loop_ok = 1;
+}
+
+static void invalidate_event(virDomainPtr dom, void *opaque, const char *what) {
+    const struct domdesc_watch *w = opaque;
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    if (virDomainGetUUIDString(dom, uuid) < 0)
+        return;
+    LOG_DEBUG("%s: %s on %s", w->uri, what, uuid);
+    domdesc_invalidate(w->uri, uuid);
+}
+
+static void on_lifecycle(virConnectPtr conn, virDomainPtr dom, int event, int detail,
+                         void *opaque) {
+    (void)conn; (void)event; (void)detail;
+    invalidate_event(dom, opaque, "lifecycle event");
+}
+
+static void on_device(virConnectPtr conn, virDomainPtr dom, const char *alias, void *opaque) {
+    (void)conn; (void)alias;
+    invalidate_event(dom, opaque, "device event");
+}
+
+static void on_block_job(virConnectPtr conn, virDomainPtr dom, const char *disk,
+                         int type, int status, void *opaque) {
+    (void)conn; (void)disk; (void)type; (void)status;
+    invalidate_event(dom, opaque, "block job event");
+}
+
+static void on_balloon(virConnectPtr conn, virDomainPtr dom, unsigned long long actual,
+                       void *opaque) {
+    (void)conn; (void)actual;
+    invalidate_event(dom, opaque, "balloon event");
+}
+
+static virConnectDomainEventGenericCallback event_callback(int id) {
+    switch (id) {
+    case VIR_DOMAIN_EVENT_ID_LIFECYCLE:
+        return VIR_DOMAIN_EVENT_CALLBACK(on_lifecycle);
+    case VIR_DOMAIN_EVENT_ID_BLOCK_JOB_2:
+        return VIR_DOMAIN_EVENT_CALLBACK(on_block_job);
+    case VIR_DOMAIN_EVENT_ID_BALLOON_CHANGE:
+        return VIR_DOMAIN_EVENT_CALLBACK(on_balloon);
+    default:
+        return VIR_DOMAIN_EVENT_CALLBACK(on_device);
+    }
+}
+
+static void unregister_all(virConnectPtr conn, const int *callbacks) {
+    for (int i = 0; i < DOMDESC_NEVENTS; i++)
+        if (callbacks[i] >= 0)
+            virConnectDomainEventDeregisterAny(conn, callbacks[i]);
+}
+
+/*
+ * Abonne le cache aux événements de uri sur la connexion courante du pool.
+ * Retourne 1 si les événements arrivent (cache long), 0 sinon (TTL court).
+ * Une nouvelle connexion a pu manquer des événements : on repart de zéro.
+ */
+static int watch_events(const char *uri) {
+    if (!event_loop_ok)
+        return 0;
+    virConnectPtr conn = libvirt_pool_open(uri);
+    if (!conn)
+        return 0;
+
+    pthread_mutex_lock(&watch_lock);
+    struct domdesc_watch *w = NULL;
+    for (int i = 0; i < MAX_DOMDESC_WATCHES && !w; i++)
+        if (watches[i].uri[0] && strcmp(watches[i].uri, uri) == 0)
+            w = &watches[i];
+    for (int i = 0; i < MAX_DOMDESC_WATCHES && !w; i++)
+        if (!watches[i].uri[0]) {
+            w = &watches[i];
+            snprintf(w->uri, sizeof(w->uri), "%s", uri);
+        }
+    if (!w || w->conn == conn) {
+        int active = w ? w->active : 0;
+        pthread_mutex_unlock(&watch_lock);
+        virConnectClose(conn);
+        return active;
+    }
+
+    /* Connexion neuve : les autres threads la voient déjà, sans événements */
+    virConnectPtr old = w->conn;
+    int old_callbacks[DOMDESC_NEVENTS];
+    memcpy(old_callbacks, w->callbacks, sizeof(old_callbacks));
+    w->conn = conn;                     /* la référence du pool_open passe au watch */
+    w->active = 0;
+    pthread_mutex_unlock(&watch_lock);
+
+    if (old) {
+        unregister_all(old, old_callbacks);
+        virConnectClose(old);
+    }
+    domdesc_invalidate(uri, NULL);
+
+    /* Enregistrement hors verrou : un aller-retour réseau par événement */
+    int callbacks[DOMDESC_NEVENTS];
+    int ok = 1;
+    for (int i = 0; i < DOMDESC_NEVENTS; i++) {
+        callbacks[i] = TRACE_VIRT(virConnectDomainEventRegisterAny, conn, NULL,
+                                  watched_events[i], event_callback(watched_events[i]),
+                                  w, NULL);
+        if (callbacks[i] < 0)
+            ok = 0;
+    }
+    if (!ok) {
+        log_libvirt_error("virConnectDomainEventRegisterAny");
+        LOG_WARN("%s: no domain events, descriptors kept %ds", uri, DOMDESC_TTL_S);
+    }
+
+    pthread_mutex_lock(&watch_lock);
+    int current = w->conn == conn;
+    if (current) {
+        memcpy(w->callbacks, callbacks, sizeof(callbacks));
+        w->active = ok;
+    }
+    pthread_mutex_unlock(&watch_lock);
+    if (!current)
+        unregister_all(conn, callbacks);   /* remplacée entre-temps par un autre thread */
+    return current && ok;
+}
+
+/* --------------------------------------------------------------------------
+ * Cache
+ * -------------------------------------------------------------------------- */
+
+static struct domdesc_entry *find_entry(const char *uri, const char *uuid) {
+    for (int i = 0; i < MAX_DOMDESC_CACHE; i++)
+        if (entries[i].desc && strcmp(entries[i].desc->uuid, uuid) == 0 &&
+            strcmp(entries[i].desc->uri, uri) == 0)
+            return &entries[i];
+    return NULL;
+}
+
+/* Place pour (uri, uuid) : la sienne, une libre, sinon la plus anciennement lue */
+static struct domdesc_entry *alloc_entry(const char *uri, const char *uuid) {
+    struct domdesc_entry *e = find_entry(uri, uuid), *oldest = NULL;
+    if (e)
+        return e;
+    for (int i = 0; i < MAX_DOMDESC_CACHE; i++) {
+        if (!entries[i].desc)
+            return &entries[i];
+        if (!oldest || entries[i].desc->fetched_at < oldest->desc->fetched_at)
+            oldest = &entries[i];
+    }
+    return oldest;
+}
+
+int domdesc_get(const char *uri, virDomainPtr dom, int refresh, struct domdesc *out) {
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    if (virDomainGetUUIDString(dom, uuid) < 0) {
+        log_libvirt_error("virDomainGetUUIDString");
+        return -1;
+    }
+    int ttl = watch_events(uri) ? DOMDESC_EVENT_TTL_S : DOMDESC_TTL_S;
+
+    pthread_mutex_lock(&cache_lock);
+    struct domdesc_entry *e = find_entry(uri, uuid);
+    if (e && !refresh && time(NULL) - e->desc->fetched_at < ttl) {
+        *out = *e->desc;
+        pthread_mutex_unlock(&cache_lock);
+        return 0;
+    }
+    unsigned long gen = cache_gen;
+    pthread_mutex_unlock(&cache_lock);
+
+    /* Lecture hors verrou ; gardée seulement si rien n'a été invalidé pendant */
+    struct domdesc *fresh = malloc(sizeof(*fresh));
+    if (!fresh || fetch(uri, dom, uuid, fresh) < 0) {
+        free(fresh);
+        return -1;
+    }
+    *out = *fresh;
+
+    pthread_mutex_lock(&cache_lock);
+    if (gen == cache_gen && (e = alloc_entry(uri, uuid)) != NULL) {
+        free(e->desc);
+        e->desc = fresh;
+        fresh = NULL;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    free(fresh);
+    return 0;
+}
+
+void domdesc_invalidate(const char *uri, const char *uuid) {
+    pthread_mutex_lock(&cache_lock);
+    for (int i = 0; i < MAX_DOMDESC_CACHE; i++) {
+        struct domdesc *d = entries[i].desc;
+        if (d && strcmp(d->uri, uri) == 0 && (!uuid || strcmp(d->uuid, uuid) == 0)) {
+            free(d);
+            entries[i].desc = NULL;
+        }
+    }
+    cache_gen++;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void domdesc_invalidate_dom(const char *uri, virDomainPtr dom) {
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    if (dom && virDomainGetUUIDString(dom, uuid) == 0)
+        domdesc_invalidate(uri, uuid);
+    else
+        domdesc_invalidate(uri, NULL);
+}
+
+const struct domdesc_graphics *domdesc_graphics(const struct domdesc *d, const char *type) {
+    for (int i = 0; i < d->ngraphics; i++)
+        if (strcmp(d->graphics[i].type, type) == 0)
+            return &d->graphics[i];
+    return NULL;
+}
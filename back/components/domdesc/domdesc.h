@@ -0,0 +1,110 @@
+// domdesc.h
+#ifndef DOMDESC_H
+#define DOMDESC_H
+
+#include <time.h>
+#include <libvirt/libvirt.h>
+
+/* Descripteurs gardés en cache (tous hyperviseurs confondus) */
+#define MAX_DOMDESC_CACHE 256
+
+/*
+ * Âge max d'un descripteur : court si l'hyperviseur n'envoie pas d'événements,
+ * long sinon (les événements invalident, l'âge n'est qu'un filet de sécurité)
+ */
+#define DOMDESC_TTL_S 10
+#define DOMDESC_EVENT_TTL_S 300
+
+/* Limites du modèle (le surplus est ignoré, signalé par truncated) */
+#define MAX_DOMDESC_DISKS 16
+#define MAX_DOMDESC_BACKING 4
+#define MAX_DOMDESC_NICS 8
+#define MAX_DOMDESC_GRAPHICS 2
+#define MAX_DOMDESC_CONSOLES 4
+
+struct domdesc_disk {
+    char device[16];                    /* disk, cdrom, floppy, lun */
+    char type[16];                      /* file, block, network, volume */
+    char target[32];                    /* vda, sdb... */
+    char bus[16];
+    char format[16];                    /* <driver type=...> : qcow2, raw */
+    char source[512];                   /* file=, dev= ou name= */
+    int  readonly;
+    int  shareable;
+    int  nbacking;
+    char backing[MAX_DOMDESC_BACKING][512];   /* chaîne <backingStore> */
+};
+
+struct domdesc_nic {
+    char type[16];                      /* network, bridge, direct... */
+    char mac[24];
+    char source[128];                   /* réseau ou bridge */
+    char model[32];
+    char target[32];                    /* vnetN (VM active) */
+};
+
+struct domdesc_graphics {
+    char type[16];                      /* vnc, spice */
+    int  port;                          /* -1 : autoport non encore attribué */
+    int  autoport;
+    char listen[64];
+};
+
+struct domdesc_console {
+    char kind[16];                      /* serial, console */
+    char type[16];                      /* pty, file, tcp... */
+    char target_type[16];               /* isa-serial, virtio, serial */
+    char path[128];                     /* /dev/pts/N (VM active) */
+};
+
+/* Modèle d'un domaine, extrait de virDomainGetXMLDesc (copié à chaque lecture) */
+struct domdesc {
+    char uri[512];
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    char name[256];
+
+    int  vcpus;                         /* <vcpu current=...> ou <vcpu> */
+    int  max_vcpus;
+    unsigned long long memory_kib;      /* <memory> */
+    unsigned long long current_memory_kib;
+    unsigned long long max_memory_kib;  /* <maxMemory slots=...>, 0 sans hotplug */
+
+    int  ndisks;
+    struct domdesc_disk disks[MAX_DOMDESC_DISKS];
+    int  nnics;
+    struct domdesc_nic nics[MAX_DOMDESC_NICS];
+    int  ngraphics;
+    struct domdesc_graphics graphics[MAX_DOMDESC_GRAPHICS];
+    int  nconsoles;
+    struct domdesc_console consoles[MAX_DOMDESC_CONSOLES];
+    int  truncated;                     /* une limite ci-dessus a été atteinte */
+
+    time_t fetched_at;
+};
+
+/*
+ * Démarre la boucle d'événements libvirt. À appeler avant toute connexion :
+ * seules les connexions ouvertes ensuite peuvent recevoir des événements.
+ */
+void domdesc_init(void);
+
+/*
+ * Descripteur du domaine dom de l'hyperviseur uri, relu si absent, périmé,
+ * invalidé par un événement ou si refresh. Retourne 0, ou -1 si le XML ne
+ * peut être lu.
+ */
+int domdesc_get(const char *uri, virDomainPtr dom, int refresh, struct domdesc *out);
+
+/* Oublie un domaine (uuid) ou tous ceux de l'hyperviseur (uuid NULL) */
+void domdesc_invalidate(const char *uri, const char *uuid);
+
+/* Idem à partir du domaine (après une modification faite par le backend) */
+void domdesc_invalidate_dom(const char *uri, virDomainPtr dom);
+
+/* Analyse un XML de domaine (sans cache) ; 0 ou -1 si ce n'est pas un <domain> */
+int domdesc_parse(const char *xml, struct domdesc *out);
+
+/* Premier affichage graphique du type donné, NULL si absent */
+const struct domdesc_graphics *domdesc_graphics(const struct domdesc *d, const char *type);
+
+#endif
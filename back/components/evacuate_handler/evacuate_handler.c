@@ -0,0 +1,732 @@
+// evacuate_handler.c
+#include "evacuate_handler.h"
+#include "../migratevm_handler/migratevm_handler.h"
+#define LOG_COMPONENT "evacuate"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Nombre max d'évacuations gardées en mémoire (actives + terminées) */
+#define MAX_EVACUATIONS 8
+
+/* Nombre max d'hyperviseurs de destination par évacuation */
+#define MAX_EVACUATION_DESTS 8
+
+/* Bornes sur le nombre de migrations simultanées */
+#define DEFAULT_EVACUATION_CONCURRENCY 2
+#define MAX_EVACUATION_CONCURRENCY 8
+
+#define DEFAULT_EVACUATION_RETRIES 2
+
+/* Durée de la mesure de dirty rate lancée avant l'ordonnancement (s) */
+#define EVACUATION_DIRTYRATE_SECONDS 1
+
+/*
+ * Poids du dirty rate dans le coût d'une VM : une VM qui salit 100 MiB/s
+ * coûte comme 100 * 30 MiB de RAM supplémentaires à transférer.
+ */
+#define EVACUATION_DIRTY_WEIGHT_S 30
+
+enum evac_guest_state {
+    EVAC_GUEST_PENDING = 0,
+    EVAC_GUEST_MIGRATING,
+    EVAC_GUEST_DONE,
+    EVAC_GUEST_FAILED,
+    EVAC_GUEST_CANCELLED
+};
+
+enum evacuation_state {
+    EVACUATION_FREE = 0,
+    EVACUATION_RUNNING,
+    EVACUATION_COMPLETED,
+    EVACUATION_FAILED,      /* terminé avec au moins une VM en échec */
+    EVACUATION_CANCELLED
+};
+
+struct evac_guest {
+    char   name[256];
+    unsigned long long memory_kib;
+    unsigned long long dirty_rate_mib;  /* MiB/s, 0 si inconnu */
+    double cost;
+    enum evac_guest_state state;
+    int    attempts;
+    int    job_id;                      /* job de migration courant, -1 sinon */
+    int    dest_index;                  /* destination du dernier essai */
+    double percent;
+    char   message[256];
+};
+
+struct evacuation {
+    enum evacuation_state state;
+    int    id;
+    char   src_uri[512];
+    char   dest_uris[MAX_EVACUATION_DESTS][512];
+    int    ndests;
+    int    concurrency;
+    int    max_retries;
+    int    cancel_requested;
+    int    scheduler_running;
+    time_t started_at;
+    time_t finished_at;
+    char   message[256];
+    struct migration_profile profile;
+    struct evac_guest *guests;          /* trié par coût croissant */
+    int    nguests;
+};
+
+static struct evacuation evacuations[MAX_EVACUATIONS];
+static int next_evacuation_id = 1;
+static pthread_mutex_t evac_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("[%s] Libvirt error: %s (code=%d domain=%d)",
+                  prefix, err->message, err->code, err->domain);
+    } else {
+        LOG_ERROR("[%s] Unknown libvirt error", prefix);
+    }
+}
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static const char *guest_state_name(enum evac_guest_state state) {
+    switch (state) {
+    case EVAC_GUEST_PENDING:   return "pending";
+    case EVAC_GUEST_MIGRATING: return "migrating";
+    case EVAC_GUEST_DONE:      return "done";
+    case EVAC_GUEST_FAILED:    return "failed";
+    case EVAC_GUEST_CANCELLED: return "cancelled";
+    default:                   return "unknown";
+    }
+}
+
+static const char *evacuation_state_name(enum evacuation_state state) {
+    switch (state) {
+    case EVACUATION_RUNNING:   return "running";
+    case EVACUATION_COMPLETED: return "completed";
+    case EVACUATION_FAILED:    return "failed";
+    case EVACUATION_CANCELLED: return "cancelled";
+    default:                   return "unknown";
+    }
+}
+
+/* (evac_lock doit être tenu) */
+static struct evacuation *find_evacuation(int id) {
+    for (int i = 0; i < MAX_EVACUATIONS; i++) {
+        if (evacuations[i].state != EVACUATION_FREE && evacuations[i].id == id)
+            return &evacuations[i];
+    }
+    return NULL;
+}
+
+/* Slot libre sinon l'évacuation terminée la plus ancienne (evac_lock tenu) */
+static struct evacuation *alloc_evacuation(void) {
+    struct evacuation *oldest = NULL;
+    for (int i = 0; i < MAX_EVACUATIONS; i++) {
+        struct evacuation *ev = &evacuations[i];
+        if (ev->state == EVACUATION_FREE)
+            return ev;
+        if (ev->state != EVACUATION_RUNNING && !ev->scheduler_running &&
+            (!oldest || ev->finished_at < oldest->finished_at))
+            oldest = ev;
+    }
+    return oldest;
+}
+
+/* --------------------------------------------------------------------------
+ * Inventaire + tri des VMs à évacuer
+ * -------------------------------------------------------------------------- */
+
+static int compare_guest_cost(const void *a, const void *b) {
+    const struct evac_guest *ga = a, *gb = b;
+    if (ga->cost < gb->cost) return -1;
+    if (ga->cost > gb->cost) return 1;
+    return strcmp(ga->name, gb->name);
+}
+
+/*
+ * Liste les VMs actives de la source, mesure leur dirty rate et les trie :
+ * les VMs petites et calmes partent d'abord (elles convergent vite et
+ * libèrent l'hôte), les grosses VMs très actives partent en dernier quand
+ * elles ont moins de concurrence sur le lien.
+ */
+static int collect_guests(const char *src_uri, struct evac_guest **out, int *nout) {
+    virConnectPtr conn = TRACE_VIRT(virConnectOpen, src_uri);
+    if (!conn) {
+        log_libvirt_error("evacuate:virConnectOpen");
+        return -1;
+    }
+
+    virDomainPtr *doms = NULL;
+    int ndoms = TRACE_VIRT(virConnectListAllDomains, conn, &doms, VIR_CONNECT_LIST_DOMAINS_ACTIVE);
+    if (ndoms < 0) {
+        log_libvirt_error("evacuate:virConnectListAllDomains");
+        virConnectClose(conn);
+        return -1;
+    }
+
+    struct evac_guest *guests = calloc(ndoms > 0 ? ndoms : 1, sizeof(*guests));
+    if (!guests) {
+        for (int i = 0; i < ndoms; i++)
+            virDomainFree(doms[i]);
+        free(doms);
+        virConnectClose(conn);
+        return -1;
+    }
+
+    /* Mesure du dirty rate en parallèle sur toutes les VMs */
+    int measuring = 0;
+    for (int i = 0; i < ndoms; i++) {
+        if (TRACE_VIRT(virDomainStartDirtyRateCalc, doms[i], EVACUATION_DIRTYRATE_SECONDS, 0) == 0)
+            measuring = 1;
+    }
+    if (measuring)
+        sleep(EVACUATION_DIRTYRATE_SECONDS + 1);
+
+    virDomainStatsRecordPtr *records = NULL;
+    int nrecords = ndoms > 0 ? TRACE_VIRT(virDomainListGetStats, doms, VIR_DOMAIN_STATS_DIRTYRATE, &records, 0) : 0;
+    if (nrecords < 0)
+        nrecords = 0;
+
+    for (int i = 0; i < ndoms; i++) {
+        struct evac_guest *g = &guests[i];
+        snprintf(g->name, sizeof(g->name), "%s", virDomainGetName(doms[i]));
+        g->job_id = -1;
+        g->dest_index = -1;
+
+        virDomainInfo info;
+        if (TRACE_VIRT(virDomainGetInfo, doms[i], &info) == 0)
+            g->memory_kib = info.memory;
+
+        for (int r = 0; r < nrecords; r++) {
+            if (strcmp(virDomainGetName(records[r]->dom), g->name) != 0)
+                continue;
+            long long rate = 0;
+            if (virTypedParamsGetLLong(records[r]->params, records[r]->nparams,
+                                       "dirtyrate.megabytes_per_second", &rate) == 1 && rate > 0)
+                g->dirty_rate_mib = (unsigned long long)rate;
+            break;
+        }
+
+        g->cost = (double)g->memory_kib / 1024.0 +
+                  (double)g->dirty_rate_mib * EVACUATION_DIRTY_WEIGHT_S;
+        virDomainFree(doms[i]);
+    }
+
+    if (records)
+        virDomainStatsRecordListFree(records);
+    free(doms);
+    virConnectClose(conn);
+
+    qsort(guests, ndoms, sizeof(*guests), compare_guest_cost);
+    *out = guests;
+    *nout = ndoms;
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Ordonnanceur
+ * -------------------------------------------------------------------------- */
+
+/*
+ * Choisit la destination la moins chargée par cette évacuation, en évitant
+ * celle du dernier essai en cas de retry. (evac_lock tenu)
+ */
+static int pick_destination(const struct evacuation *ev, const struct evac_guest *g) {
+    int best = -1, best_load = 0;
+    for (int d = 0; d < ev->ndests; d++) {
+        if (ev->ndests > 1 && d == g->dest_index)
+            continue;
+        int load = 0;
+        for (int i = 0; i < ev->nguests; i++) {
+            if (ev->guests[i].state == EVAC_GUEST_MIGRATING && ev->guests[i].dest_index == d)
+                load++;
+        }
+        if (best < 0 || load < best_load) {
+            best = d;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+/* Met à jour les VMs en cours de migration ; retourne le nombre encore actives */
+static int poll_running_guests(struct evacuation *ev) {
+    int running = 0;
+    for (int i = 0; i < ev->nguests; i++) {
+        struct evac_guest *g = &ev->guests[i];
+        if (g->state != EVAC_GUEST_MIGRATING)
+            continue;
+
+        struct migration_job_snapshot snap;
+        if (migration_job_get(g->job_id, &snap) < 0) {
+            snap.state = MIGRATION_JOB_FAILED;
+            snprintf(snap.message, sizeof(snap.message), "migration job lost");
+        }
+
+        g->percent = snap.percent;
+        switch (snap.state) {
+        case MIGRATION_JOB_STARTING:
+        case MIGRATION_JOB_RUNNING:
+            running++;
+            break;
+        case MIGRATION_JOB_COMPLETED:
+            g->state = EVAC_GUEST_DONE;
+            g->percent = 100;
+            g->job_id = -1;
+            snprintf(g->message, sizeof(g->message), "migrated to %s",
+                     ev->dest_uris[g->dest_index]);
+            break;
+        case MIGRATION_JOB_CANCELLED:
+            g->state = EVAC_GUEST_CANCELLED;
+            g->job_id = -1;
+            snprintf(g->message, sizeof(g->message), "%s", snap.message);
+            break;
+        default:
+            g->job_id = -1;
+            snprintf(g->message, sizeof(g->message), "%s", snap.message);
+            g->state = (g->attempts <= ev->max_retries && !ev->cancel_requested)
+                       ? EVAC_GUEST_PENDING : EVAC_GUEST_FAILED;
+            LOG_WARN("%d: '%s' attempt %d failed: %s",
+                     ev->id, g->name, g->attempts, snap.message);
+            break;
+        }
+    }
+    return running;
+}
+
+/* Lance des migrations jusqu'à la limite de concurrence (evac_lock tenu) */
+static void launch_pending_guests(struct evacuation *ev, int running) {
+    for (int i = 0; i < ev->nguests && running < ev->concurrency; i++) {
+        struct evac_guest *g = &ev->guests[i];
+        if (g->state != EVAC_GUEST_PENDING)
+            continue;
+
+        int d = pick_destination(ev, g);
+        char err[128];
+        g->attempts++;
+        g->dest_index = d;
+        int id = migration_job_start(ev->src_uri, g->name, ev->dest_uris[d],
+                                     &ev->profile, err, sizeof(err));
+        if (id < 0) {
+            snprintf(g->message, sizeof(g->message), "%s", err);
+            if (g->attempts > ev->max_retries)
+                g->state = EVAC_GUEST_FAILED;
+            continue;
+        }
+
+        LOG_INFO("%d: '%s' -> %s (job %d, attempt %d)",
+                 ev->id, g->name, ev->dest_uris[d], id, g->attempts);
+        g->job_id = id;
+        g->state = EVAC_GUEST_MIGRATING;
+        g->percent = 0;
+        snprintf(g->message, sizeof(g->message), "migrating");
+        running++;
+    }
+}
+
+static void *evacuation_thread(void *arg) {
+    struct evacuation *ev = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&evac_lock);
+
+        int running = poll_running_guests(ev);
+
+        if (ev->cancel_requested) {
+            for (int i = 0; i < ev->nguests; i++) {
+                struct evac_guest *g = &ev->guests[i];
+                if (g->state == EVAC_GUEST_PENDING) {
+                    g->state = EVAC_GUEST_CANCELLED;
+                    snprintf(g->message, sizeof(g->message), "evacuation cancelled");
+                }
+            }
+        } else {
+            launch_pending_guests(ev, running);
+        }
+
+        int pending = 0, failed = 0;
+        running = 0;
+        for (int i = 0; i < ev->nguests; i++) {
+            if (ev->guests[i].state == EVAC_GUEST_PENDING)   pending++;
+            if (ev->guests[i].state == EVAC_GUEST_MIGRATING) running++;
+            if (ev->guests[i].state == EVAC_GUEST_FAILED)    failed++;
+        }
+
+        if (pending == 0 && running == 0) {
+            ev->state = ev->cancel_requested ? EVACUATION_CANCELLED
+                      : failed > 0           ? EVACUATION_FAILED
+                                             : EVACUATION_COMPLETED;
+            snprintf(ev->message, sizeof(ev->message), "%s",
+                     ev->state == EVACUATION_COMPLETED ? "host evacuated"
+                     : ev->state == EVACUATION_FAILED  ? "some guests could not be migrated"
+                                                       : "evacuation cancelled");
+            ev->finished_at = time(NULL);
+            ev->scheduler_running = 0;
+            LOG_INFO("%d: %s", ev->id, ev->message);
+            pthread_mutex_unlock(&evac_lock);
+            break;
+        }
+
+        pthread_mutex_unlock(&evac_lock);
+        sleep(1);
+    }
+    return NULL;
+}
+
+/* Thread initial : inventaire (lent, hors verrou) puis ordonnanceur */
+static void *evacuation_start_thread(void *arg) {
+    struct evacuation *ev = arg;
+
+    struct evac_guest *guests = NULL;
+    int nguests = 0;
+    int rc = collect_guests(ev->src_uri, &guests, &nguests);
+
+    pthread_mutex_lock(&evac_lock);
+    if (rc < 0) {
+        ev->state = EVACUATION_FAILED;
+        ev->finished_at = time(NULL);
+        ev->scheduler_running = 0;
+        snprintf(ev->message, sizeof(ev->message), "cannot list guests on source hypervisor");
+        pthread_mutex_unlock(&evac_lock);
+        return NULL;
+    }
+    ev->guests = guests;
+    ev->nguests = nguests;
+    snprintf(ev->message, sizeof(ev->message), "evacuating %d guest(s)", nguests);
+    pthread_mutex_unlock(&evac_lock);
+
+    LOG_INFO("%d: %d guest(s) to move off %s",
+             ev->id, nguests, ev->src_uri);
+    return evacuation_thread(ev);
+}
+
+static int spawn_detached(void *(*fn)(void *), void *arg) {
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&tid, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return rc;
+}
+
+/* --------------------------------------------------------------------------
+ * Sérialisation JSON
+ * -------------------------------------------------------------------------- */
+
+static cJSON *evacuation_to_json(const struct evacuation *ev) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "evacuationId", ev->id);
+    cJSON_AddStringToObject(obj, "uri", ev->src_uri);
+    cJSON *dests = cJSON_AddArrayToObject(obj, "destUris");
+    for (int d = 0; d < ev->ndests; d++)
+        cJSON_AddItemToArray(dests, cJSON_CreateString(ev->dest_uris[d]));
+    cJSON_AddStringToObject(obj, "state", evacuation_state_name(ev->state));
+    cJSON_AddStringToObject(obj, "message", ev->message);
+    cJSON_AddNumberToObject(obj, "concurrency", ev->concurrency);
+    cJSON_AddNumberToObject(obj, "maxRetries", ev->max_retries);
+    cJSON_AddStringToObject(obj, "profile", ev->profile.name);
+    cJSON_AddNumberToObject(obj, "startedAt", (double)ev->started_at);
+    if (ev->finished_at)
+        cJSON_AddNumberToObject(obj, "finishedAt", (double)ev->finished_at);
+
+    /* Progression agrégée, pondérée par la RAM de chaque VM */
+    int counts[EVAC_GUEST_CANCELLED + 1] = {0};
+    double weight_total = 0, weight_done = 0;
+    cJSON *arr = cJSON_CreateArray();
+    for (int i = 0; i < ev->nguests; i++) {
+        const struct evac_guest *g = &ev->guests[i];
+        counts[g->state]++;
+        double w = g->memory_kib > 0 ? (double)g->memory_kib : 1.0;
+        weight_total += w;
+        weight_done += w * (g->state == EVAC_GUEST_DONE ? 100.0 : g->percent) / 100.0;
+
+        cJSON *go = cJSON_CreateObject();
+        cJSON_AddStringToObject(go, "vmName", g->name);
+        cJSON_AddStringToObject(go, "state", guest_state_name(g->state));
+        cJSON_AddNumberToObject(go, "memoryMiB", (double)(g->memory_kib / 1024));
+        cJSON_AddNumberToObject(go, "dirtyRateMiBs", (double)g->dirty_rate_mib);
+        cJSON_AddNumberToObject(go, "attempts", g->attempts);
+        cJSON_AddNumberToObject(go, "percent", g->percent);
+        if (g->dest_index >= 0)
+            cJSON_AddStringToObject(go, "destUri", ev->dest_uris[g->dest_index]);
+        if (g->job_id >= 0)
+            cJSON_AddNumberToObject(go, "jobId", g->job_id);
+        cJSON_AddStringToObject(go, "message", g->message);
+        cJSON_AddItemToArray(arr, go);
+    }
+
+    cJSON *summary = cJSON_CreateObject();
+    cJSON_AddNumberToObject(summary, "total", ev->nguests);
+    cJSON_AddNumberToObject(summary, "pending", counts[EVAC_GUEST_PENDING]);
+    cJSON_AddNumberToObject(summary, "migrating", counts[EVAC_GUEST_MIGRATING]);
+    cJSON_AddNumberToObject(summary, "done", counts[EVAC_GUEST_DONE]);
+    cJSON_AddNumberToObject(summary, "failed", counts[EVAC_GUEST_FAILED]);
+    cJSON_AddNumberToObject(summary, "cancelled", counts[EVAC_GUEST_CANCELLED]);
+    cJSON_AddNumberToObject(summary, "percent",
+                            weight_total > 0 ? 100.0 * weight_done / weight_total
+                            : (ev->state == EVACUATION_COMPLETED ? 100 : 0));
+    cJSON_AddItemToObject(obj, "summary", summary);
+    cJSON_AddItemToObject(obj, "guests", arr);
+    return obj;
+}
+
+/* Extrait "evacuationId" du body ; retourne -1 si absent */
+static int parse_evacuation_id(const char *post_data) {
+    if (!post_data)
+        return -1;
+    cJSON *root = cJSON_Parse(post_data);
+    if (!root)
+        return -1;
+    cJSON *id_item = cJSON_GetObjectItem(root, "evacuationId");
+    int id = cJSON_IsNumber(id_item) ? id_item->valueint : -1;
+    cJSON_Delete(root);
+    return id;
+}
+
+static char *evacuation_response(int id) {
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+
+    pthread_mutex_lock(&evac_lock);
+    struct evacuation *ev = find_evacuation(id);
+    if (!ev) {
+        pthread_mutex_unlock(&evac_lock);
+        cJSON_Delete(resp);
+        return make_json_error("unknown evacuation");
+    }
+    cJSON_AddItemToObject(resp, "evacuation", evacuation_to_json(ev));
+    pthread_mutex_unlock(&evac_lock);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/* --------------------------------------------------------------------------
+ * Handlers HTTP
+ * -------------------------------------------------------------------------- */
+
+/**
+ * POST /evacuatehost
+ * BODY JSON:
+ * {
+ *   "uri": "qemu:///system",                       // hyperviseur à vider
+ *   "destUris": ["qemu+ssh://user@IP/system"],     // une ou plusieurs destinations
+ *   "concurrency": 2,                              // optionnel, migrations simultanées
+ *   "maxRetries": 2,                               // optionnel, essais en plus du premier
+ *   "profile": "multifd"                           // optionnel, cf. /migratevm
+ * }
+ */
+char *handle_evacuatehost(const char *post_data) {
+    if (!post_data)
+        return make_json_error("missing body");
+
+    cJSON *root = cJSON_Parse(post_data);
+    if (!root)
+        return make_json_error("invalid JSON");
+
+    cJSON *uri_item  = cJSON_GetObjectItem(root, "uri");
+    cJSON *dest_item = cJSON_GetObjectItem(root, "destUris");
+
+    if (!cJSON_IsString(uri_item) || !cJSON_IsArray(dest_item) ||
+        cJSON_GetArraySize(dest_item) == 0) {
+        cJSON_Delete(root);
+        return make_json_error("uri or destUris missing or invalid");
+    }
+    if (cJSON_GetArraySize(dest_item) > MAX_EVACUATION_DESTS) {
+        cJSON_Delete(root);
+        return make_json_error("too many destination hypervisors");
+    }
+
+    struct migration_profile profile;
+    char err[128];
+    if (migration_profile_from_json(cJSON_GetObjectItem(root, "profile"),
+                                    &profile, err, sizeof(err)) < 0) {
+        cJSON_Delete(root);
+        return make_json_error(err);
+    }
+
+    int concurrency = DEFAULT_EVACUATION_CONCURRENCY;
+    int max_retries = DEFAULT_EVACUATION_RETRIES;
+    cJSON *j;
+    if ((j = cJSON_GetObjectItem(root, "concurrency")) && cJSON_IsNumber(j))
+        concurrency = j->valueint;
+    if ((j = cJSON_GetObjectItem(root, "maxRetries")) && cJSON_IsNumber(j))
+        max_retries = j->valueint;
+    if (concurrency < 1 || concurrency > MAX_EVACUATION_CONCURRENCY || max_retries < 0) {
+        cJSON_Delete(root);
+        return make_json_error("concurrency or maxRetries out of bounds");
+    }
+
+    pthread_mutex_lock(&evac_lock);
+
+    // Une seule évacuation à la fois par hyperviseur source
+    for (int i = 0; i < MAX_EVACUATIONS; i++) {
+        if (evacuations[i].state == EVACUATION_RUNNING &&
+            strcmp(evacuations[i].src_uri, uri_item->valuestring) == 0) {
+            pthread_mutex_unlock(&evac_lock);
+            cJSON_Delete(root);
+            return make_json_error("an evacuation is already running for this hypervisor");
+        }
+    }
+
+    struct evacuation *ev = alloc_evacuation();
+    if (!ev) {
+        pthread_mutex_unlock(&evac_lock);
+        cJSON_Delete(root);
+        return make_json_error("too many evacuations in progress");
+    }
+
+    free(ev->guests);
+    memset(ev, 0, sizeof(*ev));
+    ev->id = next_evacuation_id++;
+    ev->state = EVACUATION_RUNNING;
+    ev->scheduler_running = 1;
+    ev->started_at = time(NULL);
+    ev->concurrency = concurrency;
+    ev->max_retries = max_retries;
+    ev->profile = profile;
+    snprintf(ev->src_uri, sizeof(ev->src_uri), "%s", uri_item->valuestring);
+    snprintf(ev->message, sizeof(ev->message), "measuring guests");
+
+    cJSON *d;
+    cJSON_ArrayForEach(d, dest_item) {
+        if (cJSON_IsString(d) && strcmp(d->valuestring, ev->src_uri) != 0)
+            snprintf(ev->dest_uris[ev->ndests++], sizeof(ev->dest_uris[0]), "%s", d->valuestring);
+    }
+    cJSON_Delete(root);
+
+    if (ev->ndests == 0) {
+        ev->state = EVACUATION_FREE;
+        pthread_mutex_unlock(&evac_lock);
+        return make_json_error("no valid destination hypervisor");
+    }
+
+    if (spawn_detached(evacuation_start_thread, ev) != 0) {
+        ev->state = EVACUATION_FREE;
+        pthread_mutex_unlock(&evac_lock);
+        return make_json_error("cannot start evacuation thread");
+    }
+
+    int id = ev->id;
+    LOG_INFO("%d: started for %s (%d destination(s), concurrency=%d)",
+             id, ev->src_uri, ev->ndests, ev->concurrency);
+    pthread_mutex_unlock(&evac_lock);
+
+    return evacuation_response(id);
+}
+
+/**
+ * POST /evacuatestatus
+ * BODY JSON: { "evacuationId": 1 }
+ */
+char *handle_evacuatestatus(const char *post_data) {
+    int id = parse_evacuation_id(post_data);
+    if (id < 0)
+        return make_json_error("evacuationId missing or invalid");
+    return evacuation_response(id);
+}
+
+/**
+ * POST /evacuatecancel
+ * BODY JSON: { "evacuationId": 1 }
+ * Les VMs en attente ne partent plus, les migrations en cours sont annulées.
+ */
+char *handle_evacuatecancel(const char *post_data) {
+    int id = parse_evacuation_id(post_data);
+    if (id < 0)
+        return make_json_error("evacuationId missing or invalid");
+
+    pthread_mutex_lock(&evac_lock);
+    struct evacuation *ev = find_evacuation(id);
+    if (!ev || ev->state != EVACUATION_RUNNING) {
+        pthread_mutex_unlock(&evac_lock);
+        return make_json_error(ev ? "evacuation is not running" : "unknown evacuation");
+    }
+    ev->cancel_requested = 1;
+
+    int job_ids[MAX_EVACUATION_CONCURRENCY];
+    int njobs = 0;
+    for (int i = 0; i < ev->nguests && njobs < MAX_EVACUATION_CONCURRENCY; i++) {
+        if (ev->guests[i].state == EVAC_GUEST_MIGRATING)
+            job_ids[njobs++] = ev->guests[i].job_id;
+    }
+    pthread_mutex_unlock(&evac_lock);
+
+    // virDomainAbortJob hors verrou : l'ordonnanceur constatera l'annulation
+    char err[128];
+    for (int i = 0; i < njobs; i++)
+        migration_job_cancel(job_ids[i], err, sizeof(err));
+
+    return evacuation_response(id);
+}
+
+/**
+ * POST /evacuateretry
+ * BODY JSON: { "evacuationId": 1 }
+ * Remet en file les VMs en échec (ou annulées) et relance l'ordonnanceur
+ * si l'évacuation était terminée.
+ */
+char *handle_evacuateretry(const char *post_data) {
+    int id = parse_evacuation_id(post_data);
+    if (id < 0)
+        return make_json_error("evacuationId missing or invalid");
+
+    pthread_mutex_lock(&evac_lock);
+    struct evacuation *ev = find_evacuation(id);
+    if (!ev) {
+        pthread_mutex_unlock(&evac_lock);
+        return make_json_error("unknown evacuation");
+    }
+    if (ev->state == EVACUATION_RUNNING && ev->cancel_requested) {
+        pthread_mutex_unlock(&evac_lock);
+        return make_json_error("evacuation is being cancelled");
+    }
+
+    int requeued = 0;
+    for (int i = 0; i < ev->nguests; i++) {
+        struct evac_guest *g = &ev->guests[i];
+        if (g->state == EVAC_GUEST_FAILED || g->state == EVAC_GUEST_CANCELLED) {
+            g->state = EVAC_GUEST_PENDING;
+            g->attempts = 0;
+            g->percent = 0;
+            snprintf(g->message, sizeof(g->message), "requeued");
+            requeued++;
+        }
+    }
+
+    if (requeued > 0 && !ev->scheduler_running) {
+        ev->state = EVACUATION_RUNNING;
+        ev->cancel_requested = 0;
+        ev->finished_at = 0;
+        ev->scheduler_running = 1;
+        snprintf(ev->message, sizeof(ev->message), "retrying %d guest(s)", requeued);
+        if (spawn_detached(evacuation_thread, ev) != 0) {
+            ev->state = EVACUATION_FAILED;
+            ev->scheduler_running = 0;
+            ev->finished_at = time(NULL);
+            snprintf(ev->message, sizeof(ev->message), "cannot start evacuation thread");
+        }
+    }
+    pthread_mutex_unlock(&evac_lock);
+
+    return evacuation_response(id);
+}
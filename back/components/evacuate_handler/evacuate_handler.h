@@ -0,0 +1,17 @@
+// evacuate_handler.h
+#ifndef EVACUATE_HANDLER_H
+#define EVACUATE_HANDLER_H
+
+/* Vide un hyperviseur : migre toutes ses VMs actives vers une ou plusieurs destinations */
+char *handle_evacuatehost(const char *post_data);
+
+/* Progression agrégée + état par VM */
+char *handle_evacuatestatus(const char *post_data);
+
+/* Stoppe l'évacuation (VMs en attente + migrations en cours) */
+char *handle_evacuatecancel(const char *post_data);
+
+/* Remet en file les VMs en échec et relance l'évacuation */
+char *handle_evacuateretry(const char *post_data);
+
+#endif
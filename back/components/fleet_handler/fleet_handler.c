@@ -0,0 +1,266 @@
+// fleet_handler.c
+#include "fleet_handler.h"
+#include "../placement/placement.h"
+#include "../inventory/inventory.h"
+#include <cjson/cJSON.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Un appel /fleetvms partage ce contexte avec ses threads de scan. Les
+ * threads encore bloqués sur un hôte à l'expiration du délai continuent
+ * seuls : le dernier (thread ou handler) qui lâche sa référence libère.
+ */
+struct fleet_host {
+    char   uri[512];
+    int    started;                     /* un thread de scan a été lancé */
+    int    done;
+    int    ok;
+    long long elapsed_ms;
+};
+
+struct fleet_call {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int    refs;
+    int    pending;
+    int    nhosts;
+    struct fleet_host hosts[MAX_PLACEMENT_HOSTS];
+};
+
+struct fleet_arg {
+    struct fleet_call *call;
+    int    index;
+};
+
+/*
+ * Hôtes ayant déjà un scan en vol (appel précédent encore bloqué) : on
+ * n'empile pas un thread de plus sur un hyperviseur qui ne répond pas.
+ */
+static char busy_uris[MAX_PLACEMENT_HOSTS][512];
+static pthread_mutex_t busy_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int mark_busy(const char *uri) {
+    int slot = -1;
+    pthread_mutex_lock(&busy_lock);
+    for (int i = 0; i < MAX_PLACEMENT_HOSTS; i++) {
+        if (busy_uris[i][0] && strcmp(busy_uris[i], uri) == 0) {
+            pthread_mutex_unlock(&busy_lock);
+            return -1;
+        }
+        if (!busy_uris[i][0] && slot < 0)
+            slot = i;
+    }
+    if (slot >= 0)
+        snprintf(busy_uris[slot], sizeof(busy_uris[slot]), "%s", uri);
+    pthread_mutex_unlock(&busy_lock);
+    return slot >= 0 ? 0 : -1;
+}
+
+static void clear_busy(const char *uri) {
+    pthread_mutex_lock(&busy_lock);
+    for (int i = 0; i < MAX_PLACEMENT_HOSTS; i++) {
+        if (strcmp(busy_uris[i], uri) == 0) {
+            busy_uris[i][0] = '\0';
+            break;
+        }
+    }
+    pthread_mutex_unlock(&busy_lock);
+}
+
+static void release_call(struct fleet_call *call) {
+    pthread_mutex_lock(&call->lock);
+    int last = --call->refs == 0;
+    pthread_mutex_unlock(&call->lock);
+
+    if (last) {
+        pthread_mutex_destroy(&call->lock);
+        pthread_cond_destroy(&call->cond);
+        free(call);
+    }
+}
+
+static void *fleet_scan_thread(void *arg) {
+    struct fleet_arg *a = arg;
+    struct fleet_call *call = a->call;
+    struct fleet_host *h = &call->hosts[a->index];
+    free(a);
+
+    long long t0 = now_ms();
+    int ok = inventory_refresh(h->uri, 0) == 0;
+    clear_busy(h->uri);
+
+    pthread_mutex_lock(&call->lock);
+    h->done = 1;
+    h->ok = ok;
+    h->elapsed_ms = now_ms() - t0;
+    call->pending--;
+    pthread_cond_signal(&call->cond);
+    pthread_mutex_unlock(&call->lock);
+
+    release_call(call);
+    return NULL;
+}
+
+static int start_scan(struct fleet_call *call, int index) {
+    struct fleet_arg *a = malloc(sizeof(*a));
+    if (!a)
+        return -1;
+    a->call = call;
+    a->index = index;
+
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&tid, &attr, fleet_scan_thread, a);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        free(a);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * POST /fleetvms
+ * BODY JSON (optionnel) :
+ * {
+ *   "timeoutMs": 3000      // attente max des hôtes
+ * }
+ *
+ * Réponse :
+ * {
+ *   "status": "ok",
+ *   "hosts": [ { "uri", "status": "ok"|"timeout"|"busy"|"error", "elapsedMs", "stale", "count" } ],
+ *   "vms":   [ { ...champs de /listallvms..., "host": "<uri>" } ]
+ * }
+ */
+char *handle_fleetvms(const char *post_data) {
+    int timeout_ms = FLEET_TIMEOUT_DEFAULT_MS;
+    if (post_data && post_data[0]) {
+        cJSON *root = cJSON_Parse(post_data);
+        if (!root)
+            return make_json_error("Invalid JSON");
+        cJSON *t = cJSON_GetObjectItem(root, "timeoutMs");
+        if (cJSON_IsNumber(t) && t->valueint > 0)
+            timeout_ms = t->valueint < FLEET_TIMEOUT_MAX_MS ? t->valueint : FLEET_TIMEOUT_MAX_MS;
+        cJSON_Delete(root);
+    }
+
+    struct fleet_call *call = calloc(1, sizeof(*call));
+    if (!call)
+        return make_json_error("out of memory");
+    pthread_mutex_init(&call->lock, NULL);
+    pthread_cond_init(&call->cond, NULL);
+    call->refs = 1;
+
+    char uris[MAX_PLACEMENT_HOSTS][512];
+    call->nhosts = placement_list_hosts(uris, MAX_PLACEMENT_HOSTS);
+
+    /* Un thread par hôte ; tous partent avant la première attente */
+    pthread_mutex_lock(&call->lock);
+    for (int i = 0; i < call->nhosts; i++) {
+        struct fleet_host *h = &call->hosts[i];
+        snprintf(h->uri, sizeof(h->uri), "%s", uris[i]);
+        if (mark_busy(h->uri) < 0)
+            continue;
+        call->refs++;
+        call->pending++;
+        h->started = 1;
+        if (start_scan(call, i) < 0) {
+            clear_busy(h->uri);
+            call->refs--;
+            call->pending--;
+            h->started = 0;
+        }
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (call->pending > 0) {
+        if (pthread_cond_timedwait(&call->cond, &call->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+
+    /* Copie de l'état : les threads en retard peuvent encore écrire après */
+    struct fleet_host hosts[MAX_PLACEMENT_HOSTS];
+    int nhosts = call->nhosts;
+    memcpy(hosts, call->hosts, sizeof(hosts[0]) * nhosts);
+    pthread_mutex_unlock(&call->lock);
+    release_call(call);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON *host_arr = cJSON_AddArrayToObject(resp, "hosts");
+    cJSON *vm_arr = cJSON_AddArrayToObject(resp, "vms");
+    int partial = 0;
+
+    for (int i = 0; i < nhosts; i++) {
+        const struct fleet_host *h = &hosts[i];
+        const char *status = !h->started ? "busy"      /* scan précédent toujours bloqué */
+                           : !h->done   ? "timeout"
+                           : h->ok      ? "ok" : "error";
+        int fresh = h->done && h->ok;
+        if (!fresh)
+            partial = 1;
+
+        cJSON *host = cJSON_CreateObject();
+        cJSON_AddStringToObject(host, "uri", h->uri);
+        cJSON_AddStringToObject(host, "status", status);
+        if (h->done)
+            cJSON_AddNumberToObject(host, "elapsedMs", (double)h->elapsed_ms);
+
+        /* Hôte en retard ou en erreur : dernier inventaire connu, s'il existe */
+        int count = 0;
+        long long refreshed = inventory_refreshed_ms(h->uri);
+        if (refreshed > 0) {
+            cJSON *list = cJSON_CreateObject();
+            inventory_list_json(h->uri, 0, 0, list);
+            cJSON *vms = cJSON_GetObjectItem(list, "vms");
+            cJSON *vm;
+            while (vms && (vm = cJSON_DetachItemFromArray(vms, 0)) != NULL) {
+                cJSON_AddStringToObject(vm, "host", h->uri);
+                if (!fresh)
+                    cJSON_AddBoolToObject(vm, "stale", 1);
+                cJSON_AddItemToArray(vm_arr, vm);
+                count++;
+            }
+            cJSON_Delete(list);
+            cJSON_AddNumberToObject(host, "refreshedAt", (double)(refreshed / 1000));
+        }
+        cJSON_AddBoolToObject(host, "stale", !fresh);
+        cJSON_AddNumberToObject(host, "count", count);
+        cJSON_AddItemToArray(host_arr, host);
+    }
+    cJSON_AddBoolToObject(resp, "partial", partial);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
@@ -0,0 +1,17 @@
+// fleet_handler.h
+#ifndef FLEET_HANDLER_H
+#define FLEET_HANDLER_H
+
+/* Délai d'attente par défaut / maximal des hôtes pour /fleetvms (ms) */
+#define FLEET_TIMEOUT_DEFAULT_MS 3000
+#define FLEET_TIMEOUT_MAX_MS     30000
+
+/*
+ * Liste les VMs de tous les hôtes enregistrés (service de placement), en
+ * interrogeant les hyperviseurs en parallèle. Les hôtes lents ou morts
+ * n'allongent pas la réponse au-delà du délai : leur dernier inventaire
+ * connu est renvoyé, marqué "stale".
+ */
+char *handle_fleetvms(const char *post_data);
+
+#endif
@@ -0,0 +1,428 @@
+// hostinfo.c
+#include "hostinfo.h"
+#include "../../libvirt-utils.h"
+#define LOG_COMPONENT "hostinfo"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct hostinfo_entry {
+    int    used;
+    int    refreshing;                  /* un thread relit les capabilities */
+    struct hostinfo info;
+};
+
+static struct hostinfo_entry entries[MAX_HOSTINFO_HOSTS];
+static pthread_mutex_t hostinfo_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("%s: libvirt error (code=%d, domain=%d): %s",
+                  prefix, err->code, err->domain,
+                  err->message ? err->message : "(no message)");
+    } else {
+        LOG_ERROR("%s: unknown libvirt error", prefix);
+    }
+}
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+/* --------------------------------------------------------------------------
+ * Lecture du XML (balises produites par libvirt, sans parseur générique)
+ * -------------------------------------------------------------------------- */
+
+/* Début de la première balise open dans [p, end), NULL sinon */
+static const char *find_in(const char *p, const char *end, const char *open) {
+    const char *m = p ? strstr(p, open) : NULL;
+    return m && m < end ? m : NULL;
+}
+
+/* Texte de <tag ...>texte</tag> commençant à p ; "" si balise vide */
+static void tag_text(const char *p, const char *end, char *out, size_t outlen) {
+    out[0] = '\0';
+    const char *gt = p ? strchr(p, '>') : NULL;
+    if (!gt || gt >= end || gt[-1] == '/')
+        return;
+    const char *lt = strchr(gt + 1, '<');
+    if (!lt || lt > end)
+        return;
+    size_t n = (size_t)(lt - gt - 1);
+    if (n >= outlen)
+        n = outlen - 1;
+    memcpy(out, gt + 1, n);
+    out[n] = '\0';
+}
+
+/* Valeur de attr='...' dans la balise commençant à p */
+static void attr_value(const char *p, const char *attr, char *out, size_t outlen) {
+    out[0] = '\0';
+    const char *gt = strchr(p, '>');
+    char key[48];
+    snprintf(key, sizeof(key), " %s='", attr);
+    const char *a = strstr(p, key);
+    if (!a || (gt && a > gt))
+        return;
+    a += strlen(key);
+    const char *q = strchr(a, '\'');
+    if (!q)
+        return;
+    size_t n = (size_t)(q - a);
+    if (n >= outlen)
+        n = outlen - 1;
+    memcpy(out, a, n);
+    out[n] = '\0';
+}
+
+static int attr_int(const char *p, const char *attr) {
+    char v[32];
+    attr_value(p, attr, v, sizeof(v));
+    return atoi(v);
+}
+
+static void parse_host(const char *caps, struct hostinfo *h) {
+    const char *host = strstr(caps, "<host>");
+    const char *host_end = host ? strstr(host, "</host>") : NULL;
+    if (!host || !host_end)
+        return;
+
+    const char *cpu = find_in(host, host_end, "<cpu>");
+    const char *cpu_end = cpu ? strstr(cpu, "</cpu>") : NULL;
+    if (cpu && cpu_end) {
+        tag_text(find_in(cpu, cpu_end, "<arch>"), cpu_end, h->arch, sizeof(h->arch));
+        tag_text(find_in(cpu, cpu_end, "<model>"), cpu_end, h->cpu_model, sizeof(h->cpu_model));
+        tag_text(find_in(cpu, cpu_end, "<vendor>"), cpu_end, h->cpu_vendor, sizeof(h->cpu_vendor));
+        const char *topo = find_in(cpu, cpu_end, "<topology ");
+        if (topo) {
+            h->sockets = attr_int(topo, "sockets");
+            h->cores = attr_int(topo, "cores");
+            h->threads = attr_int(topo, "threads");
+        }
+        for (const char *pg = cpu; (pg = find_in(pg, cpu_end, "<pages ")) != NULL &&
+                                   h->npages < MAX_HOSTINFO_PAGES; pg++)
+            h->page_sizes_kib[h->npages++] = (unsigned int)attr_int(pg, "size");
+    }
+
+    const char *topo = find_in(host, host_end, "<topology>");
+    const char *topo_end = topo ? strstr(topo, "</topology>") : NULL;
+    for (const char *c = topo; c && topo_end && h->ncells < MAX_HOSTINFO_CELLS &&
+                               (c = find_in(c, topo_end, "<cell id='")) != NULL; ) {
+        const char *c_end = strstr(c, "</cell>");
+        if (!c_end)
+            break;
+        struct hostinfo_cell *cell = &h->cells[h->ncells++];
+        cell->id = attr_int(c, "id");
+        char mem[32];
+        tag_text(find_in(c, c_end, "<memory "), c_end, mem, sizeof(mem));
+        cell->memory_kib = strtoull(mem, NULL, 10);
+        const char *cpus = find_in(c, c_end, "<cpus num='");
+        cell->ncpus = cpus ? attr_int(cpus, "num") : 0;
+        c = c_end;
+    }
+}
+
+static void parse_guests(const char *caps, struct hostinfo *h) {
+    for (const char *g = caps; h->nguests < MAX_HOSTINFO_GUESTS &&
+                               (g = strstr(g, "<guest>")) != NULL; ) {
+        const char *g_end = strstr(g, "</guest>");
+        if (!g_end)
+            break;
+        char os_type[16];
+        tag_text(find_in(g, g_end, "<os_type>"), g_end, os_type, sizeof(os_type));
+        const char *arch = find_in(g, g_end, "<arch name='");
+        if (strcmp(os_type, "hvm") == 0 && arch) {
+            struct hostinfo_guest *gu = &h->guests[h->nguests++];
+            memset(gu, 0, sizeof(*gu));
+            attr_value(arch, "name", gu->arch, sizeof(gu->arch));
+            tag_text(find_in(arch, g_end, "<emulator>"), g_end, gu->emulator, sizeof(gu->emulator));
+            gu->kvm = find_in(arch, g_end, "<domain type='kvm'") != NULL;
+            for (const char *m = arch; gu->nmachines < MAX_HOSTINFO_MACHINES &&
+                                       (m = find_in(m, g_end, "<machine")) != NULL; m++) {
+                char name[48];
+                tag_text(m, g_end, name, sizeof(name));
+                if (name[0] && !hostinfo_has_machine(gu, name))
+                    snprintf(gu->machines[gu->nmachines++], sizeof(gu->machines[0]), "%s", name);
+            }
+        }
+        g = g_end;
+    }
+}
+
+static void parse_domcaps(const char *dc, struct hostinfo *h) {
+    const char *end = dc + strlen(dc);
+    tag_text(strstr(dc, "<path>"), end, h->dom_emulator, sizeof(h->dom_emulator));
+    tag_text(strstr(dc, "<domain>"), end, h->dom_type, sizeof(h->dom_type));
+    tag_text(strstr(dc, "<machine>"), end, h->dom_machine, sizeof(h->dom_machine));
+    const char *vcpu = strstr(dc, "<vcpu max='");
+    h->vcpu_max = vcpu ? attr_int(vcpu, "max") : 0;
+    h->host_passthrough = strstr(dc, "<mode name='host-passthrough' supported='yes'") != NULL;
+
+    const char *custom = strstr(dc, "<mode name='custom' supported='yes'");
+    const char *custom_end = custom ? strstr(custom, "</mode>") : NULL;
+    for (const char *m = custom; m && custom_end && h->ncpu_models < MAX_HOSTINFO_CPU_MODELS &&
+                                 (m = find_in(m, custom_end, "<model usable='yes'")) != NULL; m++)
+        tag_text(m, custom_end, h->cpu_models[h->ncpu_models++], sizeof(h->cpu_models[0]));
+}
+
+/* --------------------------------------------------------------------------
+ * Cache
+ * -------------------------------------------------------------------------- */
+
+static void read_free_memory(virConnectPtr conn, struct hostinfo *h) {
+    unsigned long long free_bytes = TRACE_VIRT(virNodeGetFreeMemory, conn);
+    h->free_kib = free_bytes / 1024;
+    unsigned long long frees[MAX_HOSTINFO_CELLS];
+    int n = TRACE_VIRT(virNodeGetCellsFreeMemory, conn, frees, 0, MAX_HOSTINFO_CELLS);
+    for (int i = 0; i < h->ncells; i++) {
+        int id = h->cells[i].id;
+        h->cells[i].free_kib = id >= 0 && id < n ? frees[id] / 1024 : 0;
+    }
+    h->free_at = time(NULL);
+}
+
+static int fetch(virConnectPtr conn, const char *uri, struct hostinfo *h) {
+    memset(h, 0, sizeof(*h));
+    snprintf(h->uri, sizeof(h->uri), "%s", uri);
+
+    char *caps = TRACE_VIRT(virConnectGetCapabilities, conn);
+    if (!caps) {
+        log_libvirt_error("virConnectGetCapabilities");
+        return -1;
+    }
+    parse_host(caps, h);
+    parse_guests(caps, h);
+    free(caps);
+
+    virNodeInfo info;
+    if (TRACE_VIRT(virNodeGetInfo, conn, &info) == 0) {
+        h->cpus = (int)info.cpus;
+        h->mhz = (int)info.mhz;
+        h->memory_kib = info.memory;
+    }
+
+    /* Sans argument : émulateur, machine et type de domaine par défaut de l'hôte */
+    char *dc = TRACE_VIRT(virConnectGetDomainCapabilities, conn, NULL, NULL, NULL, NULL, 0);
+    if (dc) {
+        parse_domcaps(dc, h);
+        free(dc);
+    } else {
+        log_libvirt_error("virConnectGetDomainCapabilities");
+    }
+
+    read_free_memory(conn, h);
+    h->fetched_at = h->free_at;
+    LOG_DEBUG("%s: %s %s, %d guest arch(es), %d cpu model(s)", uri, h->arch,
+              h->dom_type[0] ? h->dom_type : "?", h->nguests, h->ncpu_models);
+    return 0;
+}
+
+static struct hostinfo_entry *find_entry(const char *uri) {
+    for (int i = 0; i < MAX_HOSTINFO_HOSTS; i++)
+        if (entries[i].used && strcmp(entries[i].info.uri, uri) == 0)
+            return &entries[i];
+    return NULL;
+}
+
+/* Place pour uri : libre, sinon la plus anciennement lue */
+static struct hostinfo_entry *alloc_entry(const char *uri) {
+    struct hostinfo_entry *e = find_entry(uri), *oldest = NULL;
+    if (e)
+        return e;
+    for (int i = 0; i < MAX_HOSTINFO_HOSTS; i++) {
+        if (!entries[i].used)
+            return &entries[i];
+        if (!entries[i].refreshing &&
+            (!oldest || entries[i].info.fetched_at < oldest->info.fetched_at))
+            oldest = &entries[i];
+    }
+    return oldest;
+}
+
+int hostinfo_get(const char *uri, virConnectPtr conn, int refresh, struct hostinfo *out) {
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&hostinfo_lock);
+    struct hostinfo_entry *e = find_entry(uri);
+    int stale = !e || refresh || now - e->info.fetched_at >= HOSTINFO_TTL_S;
+    if (e && (!stale || e->refreshing)) {
+        /* À jour, ou relu par un autre thread : on sert la copie en cache */
+        int free_stale = now - e->info.free_at >= HOSTINFO_FREE_TTL_S;
+        *out = e->info;
+        pthread_mutex_unlock(&hostinfo_lock);
+        if (!free_stale)
+            return 0;
+        virConnectPtr c = conn ? conn : libvirt_pool_open(uri);
+        if (!c)
+            return 0;
+        read_free_memory(c, out);
+        if (!conn)
+            virConnectClose(c);
+        pthread_mutex_lock(&hostinfo_lock);
+        if ((e = find_entry(uri)) != NULL && e->info.fetched_at == out->fetched_at) {
+            e->info.free_kib = out->free_kib;
+            for (int i = 0; i < e->info.ncells; i++)
+                e->info.cells[i].free_kib = out->cells[i].free_kib;
+            e->info.free_at = out->free_at;
+        }
+        pthread_mutex_unlock(&hostinfo_lock);
+        return 0;
+    }
+    if (e)
+        e->refreshing = 1;
+    pthread_mutex_unlock(&hostinfo_lock);
+
+    /* Lecture hors verrou : capabilities = plusieurs dizaines de Ko de XML */
+    struct hostinfo *fresh = malloc(sizeof(*fresh));
+    virConnectPtr c = conn ? conn : libvirt_pool_open(uri);
+    int rc = fresh && c ? fetch(c, uri, fresh) : -1;
+    if (c && !conn)
+        virConnectClose(c);
+
+    pthread_mutex_lock(&hostinfo_lock);
+    e = rc == 0 ? alloc_entry(uri) : find_entry(uri);
+    if (rc == 0 && e) {
+        e->used = 1;
+        e->info = *fresh;
+    }
+    if (e) {
+        e->refreshing = 0;
+        *out = e->info;
+        rc = 0;                         /* échec de relecture : l'ancienne copie sert */
+    } else if (rc == 0) {
+        *out = *fresh;                  /* cache plein de relectures en cours */
+    }
+    pthread_mutex_unlock(&hostinfo_lock);
+    free(fresh);
+    return rc;
+}
+
+void hostinfo_invalidate(const char *uri) {
+    pthread_mutex_lock(&hostinfo_lock);
+    struct hostinfo_entry *e = find_entry(uri);
+    if (e && !e->refreshing)
+        e->used = 0;
+    pthread_mutex_unlock(&hostinfo_lock);
+}
+
+const struct hostinfo_guest *hostinfo_guest(const struct hostinfo *h, const char *arch) {
+    for (int i = 0; i < h->nguests; i++)
+        if (strcmp(h->guests[i].arch, arch) == 0)
+            return &h->guests[i];
+    return NULL;
+}
+
+int hostinfo_has_machine(const struct hostinfo_guest *g, const char *machine) {
+    for (int i = 0; i < g->nmachines; i++)
+        if (strcmp(g->machines[i], machine) == 0)
+            return 1;
+    return 0;
+}
+
+int hostinfo_has_cpu_model(const struct hostinfo *h, const char *model) {
+    for (int i = 0; i < h->ncpu_models; i++)
+        if (strcmp(h->cpu_models[i], model) == 0)
+            return 1;
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Handler
+ * -------------------------------------------------------------------------- */
+
+static cJSON *hostinfo_to_json(const struct hostinfo *h) {
+    cJSON *o = cJSON_CreateObject();
+    cJSON_AddStringToObject(o, "uri", h->uri);
+
+    cJSON *host = cJSON_AddObjectToObject(o, "host");
+    cJSON_AddStringToObject(host, "arch", h->arch);
+    cJSON_AddStringToObject(host, "cpuModel", h->cpu_model);
+    cJSON_AddStringToObject(host, "cpuVendor", h->cpu_vendor);
+    cJSON_AddNumberToObject(host, "cpus", h->cpus);
+    cJSON_AddNumberToObject(host, "mhz", h->mhz);
+    cJSON_AddNumberToObject(host, "sockets", h->sockets);
+    cJSON_AddNumberToObject(host, "cores", h->cores);
+    cJSON_AddNumberToObject(host, "threads", h->threads);
+    cJSON_AddNumberToObject(host, "memoryMiB", (double)(h->memory_kib / 1024));
+    cJSON_AddNumberToObject(host, "freeMemoryMiB", (double)(h->free_kib / 1024));
+    cJSON *pages = cJSON_AddArrayToObject(host, "pageSizesKiB");
+    for (int i = 0; i < h->npages; i++)
+        cJSON_AddItemToArray(pages, cJSON_CreateNumber(h->page_sizes_kib[i]));
+    cJSON *numa = cJSON_AddArrayToObject(host, "numa");
+    for (int i = 0; i < h->ncells; i++) {
+        cJSON *c = cJSON_CreateObject();
+        cJSON_AddNumberToObject(c, "id", h->cells[i].id);
+        cJSON_AddNumberToObject(c, "cpus", h->cells[i].ncpus);
+        cJSON_AddNumberToObject(c, "memoryMiB", (double)(h->cells[i].memory_kib / 1024));
+        cJSON_AddNumberToObject(c, "freeMemoryMiB", (double)(h->cells[i].free_kib / 1024));
+        cJSON_AddItemToArray(numa, c);
+    }
+
+    cJSON *guests = cJSON_AddArrayToObject(o, "guests");
+    for (int i = 0; i < h->nguests; i++) {
+        const struct hostinfo_guest *g = &h->guests[i];
+        cJSON *go = cJSON_CreateObject();
+        cJSON_AddStringToObject(go, "arch", g->arch);
+        cJSON_AddStringToObject(go, "emulator", g->emulator);
+        cJSON_AddBoolToObject(go, "kvm", g->kvm);
+        cJSON *machines = cJSON_AddArrayToObject(go, "machines");
+        for (int m = 0; m < g->nmachines; m++)
+            cJSON_AddItemToArray(machines, cJSON_CreateString(g->machines[m]));
+        cJSON_AddItemToArray(guests, go);
+    }
+
+    cJSON *dom = cJSON_AddObjectToObject(o, "domain");
+    cJSON_AddStringToObject(dom, "type", h->dom_type);
+    cJSON_AddStringToObject(dom, "emulator", h->dom_emulator);
+    cJSON_AddStringToObject(dom, "machine", h->dom_machine);
+    cJSON_AddNumberToObject(dom, "vcpuMax", h->vcpu_max);
+    cJSON_AddBoolToObject(dom, "hostPassthrough", h->host_passthrough);
+    cJSON *models = cJSON_AddArrayToObject(dom, "cpuModels");
+    for (int i = 0; i < h->ncpu_models; i++)
+        cJSON_AddItemToArray(models, cJSON_CreateString(h->cpu_models[i]));
+
+    cJSON_AddNumberToObject(o, "ageS", (double)(time(NULL) - h->fetched_at));
+    return o;
+}
+
+char *handle_hostinfo(const char *post_data) {
+    cJSON *root = post_data && post_data[0] ? cJSON_Parse(post_data) : NULL;
+    if (post_data && post_data[0] && !root)
+        return make_json_error("invalid JSON");
+
+    cJSON *uri_item = root ? cJSON_GetObjectItem(root, "uri") : NULL;
+    char uri[512];
+    if (cJSON_IsString(uri_item) && uri_item->valuestring[0])
+        snprintf(uri, sizeof(uri), "%s", uri_item->valuestring);
+    else
+        build_libvirt_uri(uri, sizeof(uri), NULL, NULL, NULL, 0, NULL);
+    int refresh = root && cJSON_IsTrue(cJSON_GetObjectItem(root, "refresh"));
+    cJSON_Delete(root);
+
+    struct hostinfo *h = malloc(sizeof(*h));
+    if (!h)
+        return make_json_error("out of memory");
+    if (hostinfo_get(uri, NULL, refresh, h) < 0) {
+        free(h);
+        return make_json_error("cannot read hypervisor capabilities");
+    }
+
+    cJSON *resp = hostinfo_to_json(h);
+    free(h);
+    cJSON_AddStringToObject(resp, "status", "ok");
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
@@ -0,0 +1,95 @@
+// hostinfo.h
+#ifndef HOSTINFO_H
+#define HOSTINFO_H
+
+#include <stddef.h>
+#include <time.h>
+#include <libvirt/libvirt.h>
+
+/* Hyperviseurs gardés en cache */
+#define MAX_HOSTINFO_HOSTS 32
+
+/* Capabilities relues au-delà de cet âge (s) ; mémoire libre : HOSTINFO_FREE_TTL_S */
+#define HOSTINFO_TTL_S 600
+#define HOSTINFO_FREE_TTL_S 5
+
+/* Limites du modèle (le surplus est ignoré) */
+#define MAX_HOSTINFO_GUESTS 8
+#define MAX_HOSTINFO_MACHINES 128
+#define MAX_HOSTINFO_CPU_MODELS 160
+#define MAX_HOSTINFO_CELLS 8
+#define MAX_HOSTINFO_PAGES 4
+
+/* Un <guest> des capabilities : une architecture émulable */
+struct hostinfo_guest {
+    char arch[32];
+    char emulator[256];
+    int  kvm;                           /* <domain type='kvm'/> présent */
+    int  nmachines;
+    char machines[MAX_HOSTINFO_MACHINES][48];
+};
+
+struct hostinfo_cell {
+    int id;
+    int ncpus;
+    unsigned long long memory_kib;
+    unsigned long long free_kib;
+};
+
+/* Modèle des capabilities d'un hyperviseur (copié à chaque lecture) */
+struct hostinfo {
+    char uri[512];
+
+    /* <host> */
+    char arch[32];
+    char cpu_model[64];
+    char cpu_vendor[32];
+    int  cpus;
+    int  mhz;
+    int  sockets, cores, threads;
+    unsigned long long memory_kib;
+    int  npages;
+    unsigned int page_sizes_kib[MAX_HOSTINFO_PAGES];   /* 4, 2048, 1048576... */
+    int  ncells;
+    struct hostinfo_cell cells[MAX_HOSTINFO_CELLS];
+
+    int  nguests;
+    struct hostinfo_guest guests[MAX_HOSTINFO_GUESTS];
+
+    /* Domain capabilities par défaut de l'hôte (kvm si dispo) */
+    char dom_type[8];
+    char dom_emulator[256];
+    char dom_machine[48];
+    int  vcpu_max;
+    int  host_passthrough;
+    int  ncpu_models;
+    char cpu_models[MAX_HOSTINFO_CPU_MODELS][48];      /* modèles "usable" */
+
+    unsigned long long free_kib;
+    time_t fetched_at;
+    time_t free_at;
+};
+
+/*
+ * Modèle de l'hyperviseur uri, relu si plus vieux que HOSTINFO_TTL_S (ou si
+ * refresh). conn peut être NULL (connexion prise dans le pool).
+ * Retourne 0, ou -1 si l'hôte est injoignable et absent du cache.
+ */
+int hostinfo_get(const char *uri, virConnectPtr conn, int refresh, struct hostinfo *out);
+
+/* Oublie un hyperviseur (hôte retiré) */
+void hostinfo_invalidate(const char *uri);
+
+/* Guest de cette architecture, NULL si l'hôte ne l'émule pas */
+const struct hostinfo_guest *hostinfo_guest(const struct hostinfo *h, const char *arch);
+
+int hostinfo_has_machine(const struct hostinfo_guest *g, const char *machine);
+int hostinfo_has_cpu_model(const struct hostinfo *h, const char *model);
+
+/*
+ * Modèle de l'hôte pour le frontend : { "uri", "refresh"?: false }
+ * (sans uri : qemu:///system)
+ */
+char *handle_hostinfo(const char *post_data);
+
+#endif
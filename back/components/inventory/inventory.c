@@ -0,0 +1,679 @@
+// inventory.c
+#include "inventory.h"
+#include "../../libvirt-utils.h"
+#define LOG_COMPONENT "inventory"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct inv_record {
+    char   uuid[VIR_UUID_STRING_BUFLEN];
+    char   name[256];
+    int    state;                       /* virDomainState */
+    unsigned long long memory_kib;      /* mémoire max configurée */
+    int    vcpus;
+    unsigned long long generation;      /* génération du dernier changement */
+    int    removed;                     /* tombstone */
+    time_t removed_at;
+    int    seen;                        /* marqueur du scan en cours */
+};
+
+struct inventory {
+    int    in_use;
+    char   uri[512];
+    int    stale;
+    long long refreshed_ms;
+    unsigned long long generation;      /* high-water mark */
+    unsigned long long horizon;         /* tombstones purgés jusqu'à cette génération */
+
+    struct inv_record *recs;
+    int    count;
+    int    cap;
+    int   *index;                       /* hachage uuid -> position dans recs + 1 */
+    int    index_cap;                   /* puissance de 2 */
+
+    /* Positions des VMs présentes, triées par (clé, uuid) ; construites à la demande */
+    int   *sorted[INVENTORY_SORT_COUNT];
+    int    sorted_count[INVENTORY_SORT_COUNT];
+    int    sorted_valid[INVENTORY_SORT_COUNT];
+};
+
+static struct inventory inventories[MAX_INVENTORIES];
+static pthread_mutex_t inventory_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("[%s] Libvirt error: %s (code=%d domain=%d)",
+                  prefix, err->message, err->code, err->domain);
+    } else {
+        LOG_ERROR("[%s] Unknown libvirt error", prefix);
+    }
+}
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static const char *state_name(int state) {
+    switch (state) {
+    case VIR_DOMAIN_RUNNING:     return "running";
+    case VIR_DOMAIN_BLOCKED:     return "blocked";
+    case VIR_DOMAIN_PAUSED:      return "paused";
+    case VIR_DOMAIN_SHUTDOWN:    return "shutdown";
+    case VIR_DOMAIN_SHUTOFF:     return "shutoff";
+    case VIR_DOMAIN_CRASHED:     return "crashed";
+    case VIR_DOMAIN_PMSUSPENDED: return "pmsuspended";
+    default:                     return "nostate";
+    }
+}
+
+static int state_is_active(int state) {
+    return state != VIR_DOMAIN_SHUTOFF && state != VIR_DOMAIN_NOSTATE;
+}
+
+/* --------------------------------------------------------------------------
+ * Index uuid (inventory_lock tenu)
+ * -------------------------------------------------------------------------- */
+
+static uint32_t hash_uuid(const char *s) {
+    uint32_t h = 2166136261u;           /* FNV-1a */
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int index_find(const struct inventory *inv, const char *uuid) {
+    if (!inv->index)
+        return -1;
+    uint32_t mask = (uint32_t)inv->index_cap - 1;
+    for (uint32_t i = hash_uuid(uuid) & mask; inv->index[i]; i = (i + 1) & mask) {
+        int pos = inv->index[i] - 1;
+        if (strcmp(inv->recs[pos].uuid, uuid) == 0)
+            return pos;
+    }
+    return -1;
+}
+
+static void index_insert(struct inventory *inv, int pos) {
+    uint32_t mask = (uint32_t)inv->index_cap - 1;
+    uint32_t i = hash_uuid(inv->recs[pos].uuid) & mask;
+    while (inv->index[i])
+        i = (i + 1) & mask;
+    inv->index[i] = pos + 1;
+}
+
+/* Reconstruit l'index, taille >= 2 x nombre d'entrées */
+static int index_rebuild(struct inventory *inv) {
+    int cap = 64;
+    while (cap < inv->cap * 2)
+        cap *= 2;
+
+    int *index = calloc(cap, sizeof(int));
+    if (!index)
+        return -1;
+    free(inv->index);
+    inv->index = index;
+    inv->index_cap = cap;
+    for (int i = 0; i < inv->count; i++)
+        index_insert(inv, i);
+    return 0;
+}
+
+static struct inv_record *append_record(struct inventory *inv) {
+    if (inv->count == inv->cap) {
+        int cap = inv->cap ? inv->cap * 2 : 64;
+        struct inv_record *recs = realloc(inv->recs, cap * sizeof(*recs));
+        if (!recs)
+            return NULL;
+        inv->recs = recs;
+        inv->cap = cap;
+        if (index_rebuild(inv) < 0)
+            return NULL;
+    }
+    struct inv_record *r = &inv->recs[inv->count];
+    memset(r, 0, sizeof(*r));
+    return r;
+}
+
+/* --------------------------------------------------------------------------
+ * Scan (hors verrou)
+ * -------------------------------------------------------------------------- */
+
+static void parse_record(virDomainStatsRecordPtr rec, struct inv_record *r) {
+    unsigned long long current = 0, maximum = 0;
+
+    memset(r, 0, sizeof(*r));
+    const char *name = virDomainGetName(rec->dom);
+    snprintf(r->name, sizeof(r->name), "%s", name ? name : "");
+    virDomainGetUUIDString(rec->dom, r->uuid);
+
+    for (int i = 0; i < rec->nparams; i++) {
+        const virTypedParameter *p = &rec->params[i];
+        if (strcmp(p->field, "state.state") == 0)
+            r->state = p->value.i;
+        else if (strcmp(p->field, "balloon.maximum") == 0)
+            maximum = p->value.ul;
+        else if (strcmp(p->field, "balloon.current") == 0)
+            current = p->value.ul;
+        else if (strcmp(p->field, "vcpu.current") == 0)
+            r->vcpus = (int)p->value.ui;
+    }
+    r->memory_kib = maximum ? maximum : current;
+}
+
+/*
+ * Un seul appel virConnectGetAllDomainStats pour toutes les VMs (actives et
+ * définies) au lieu d'une requête par domaine.
+ */
+static int scan_domains(const char *uri, struct inv_record **out) {
+    virConnectPtr conn = libvirt_pool_open(uri);
+    if (!conn)
+        return -1;
+
+    virDomainStatsRecordPtr *recs = NULL;
+    int n = TRACE_VIRT(virConnectGetAllDomainStats, conn,
+                                                    VIR_DOMAIN_STATS_STATE | VIR_DOMAIN_STATS_BALLOON |
+                                                    VIR_DOMAIN_STATS_VCPU,
+                                                    &recs, 0);
+    if (n < 0) {
+        log_libvirt_error("inventory:virConnectGetAllDomainStats");
+        virConnectClose(conn);
+        libvirt_pool_drop(uri);
+        return -1;
+    }
+
+    struct inv_record *scanned = calloc(n > 0 ? n : 1, sizeof(*scanned));
+    if (!scanned) {
+        virDomainStatsRecordListFree(recs);
+        virConnectClose(conn);
+        return -1;
+    }
+    for (int i = 0; i < n; i++)
+        parse_record(recs[i], &scanned[i]);
+
+    virDomainStatsRecordListFree(recs);
+    virConnectClose(conn);
+    *out = scanned;
+    return n;
+}
+
+/* --------------------------------------------------------------------------
+ * Fusion (inventory_lock tenu)
+ * -------------------------------------------------------------------------- */
+
+static struct inventory *find_inventory(const char *uri, int create) {
+    struct inventory *free_slot = NULL;
+    for (int i = 0; i < MAX_INVENTORIES; i++) {
+        if (inventories[i].in_use && strcmp(inventories[i].uri, uri) == 0)
+            return &inventories[i];
+        if (!inventories[i].in_use && !free_slot)
+            free_slot = &inventories[i];
+    }
+    if (!create || !free_slot)
+        return NULL;
+
+    memset(free_slot, 0, sizeof(*free_slot));
+    free_slot->in_use = 1;
+    free_slot->stale = 1;
+    snprintf(free_slot->uri, sizeof(free_slot->uri), "%s", uri);
+    /*
+     * Générations partant de l'heure de démarrage : après un redémarrage du
+     * backend, un "since" d'avant reste inférieur et force une resynchro.
+     */
+    free_slot->generation = (unsigned long long)time(NULL) << 20;
+    free_slot->horizon = free_slot->generation;
+    return free_slot;
+}
+
+static int record_differs(const struct inv_record *a, const struct inv_record *b) {
+    return a->state != b->state ||
+           a->memory_kib != b->memory_kib ||
+           a->vcpus != b->vcpus ||
+           strcmp(a->name, b->name) != 0;
+}
+
+/* Retire les tombstones expirés ; les "since" antérieurs deviennent invalides */
+static void prune_tombstones(struct inventory *inv, time_t now) {
+    int kept = 0, pruned = 0;
+    for (int i = 0; i < inv->count; i++) {
+        struct inv_record *r = &inv->recs[i];
+        if (r->removed && now - r->removed_at > INVENTORY_TOMBSTONE_TTL_S) {
+            if (r->generation > inv->horizon)
+                inv->horizon = r->generation;
+            pruned++;
+            continue;
+        }
+        if (kept != i)
+            inv->recs[kept] = *r;
+        kept++;
+    }
+    if (pruned) {
+        inv->count = kept;
+        index_rebuild(inv);
+    }
+}
+
+static void merge_scan(struct inventory *inv, struct inv_record *scanned, int n) {
+    unsigned long long gen = inv->generation + 1;
+    int changed = 0;
+    time_t now = time(NULL);
+
+    for (int i = 0; i < inv->count; i++)
+        inv->recs[i].seen = 0;
+
+    for (int k = 0; k < n; k++) {
+        struct inv_record *s = &scanned[k];
+        int pos = index_find(inv, s->uuid);
+
+        if (pos < 0) {
+            struct inv_record *r = append_record(inv);
+            if (!r)
+                continue;
+            *r = *s;
+            r->generation = gen;
+            r->seen = 1;
+            index_insert(inv, inv->count++);
+            changed++;
+            continue;
+        }
+
+        struct inv_record *r = &inv->recs[pos];
+        r->seen = 1;
+        if (r->removed || record_differs(r, s)) {
+            snprintf(r->name, sizeof(r->name), "%s", s->name);
+            r->state = s->state;
+            r->memory_kib = s->memory_kib;
+            r->vcpus = s->vcpus;
+            r->removed = 0;
+            r->generation = gen;
+            changed++;
+        }
+    }
+
+    for (int i = 0; i < inv->count; i++) {
+        struct inv_record *r = &inv->recs[i];
+        if (!r->seen && !r->removed) {
+            r->removed = 1;
+            r->removed_at = now;
+            r->generation = gen;
+            changed++;
+        }
+    }
+
+    int count_before = inv->count;
+    prune_tombstones(inv, now);
+
+    if (changed)
+        inv->generation = gen;
+    if (changed || inv->count != count_before) {
+        for (int k = 0; k < INVENTORY_SORT_COUNT; k++)
+            inv->sorted_valid[k] = 0;
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * API
+ * -------------------------------------------------------------------------- */
+
+int inventory_refresh(const char *uri, int force) {
+    pthread_mutex_lock(&inventory_lock);
+    struct inventory *inv = find_inventory(uri, 1);
+    if (!inv) {
+        pthread_mutex_unlock(&inventory_lock);
+        LOG_WARN("table full, cannot track %s", uri);
+        return -1;
+    }
+    int fresh = !force && !inv->stale &&
+                now_ms() - inv->refreshed_ms < INVENTORY_MAX_AGE_MS;
+    pthread_mutex_unlock(&inventory_lock);
+    if (fresh)
+        return 0;
+
+    struct inv_record *scanned = NULL;
+    int n = scan_domains(uri, &scanned);
+    if (n < 0)
+        return -1;
+
+    pthread_mutex_lock(&inventory_lock);
+    inv = find_inventory(uri, 1);
+    if (inv) {
+        merge_scan(inv, scanned, n);
+        inv->stale = 0;
+        inv->refreshed_ms = now_ms();
+    }
+    pthread_mutex_unlock(&inventory_lock);
+
+    free(scanned);
+    return inv ? 0 : -1;
+}
+
+void inventory_invalidate(const char *uri) {
+    if (!uri)
+        return;
+    pthread_mutex_lock(&inventory_lock);
+    struct inventory *inv = find_inventory(uri, 0);
+    if (inv)
+        inv->stale = 1;
+    pthread_mutex_unlock(&inventory_lock);
+}
+
+long long inventory_refreshed_ms(const char *uri) {
+    pthread_mutex_lock(&inventory_lock);
+    struct inventory *inv = find_inventory(uri, 0);
+    long long t = inv ? inv->refreshed_ms : 0;
+    pthread_mutex_unlock(&inventory_lock);
+    return t;
+}
+
+static cJSON *record_to_json(const struct inv_record *r) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "name", r->name);
+    cJSON_AddStringToObject(obj, "uuid", r->uuid);
+    cJSON_AddBoolToObject(obj, "active", state_is_active(r->state));
+    cJSON_AddStringToObject(obj, "state", state_name(r->state));
+    cJSON_AddNumberToObject(obj, "memoryMiB", (double)(r->memory_kib / 1024));
+    cJSON_AddNumberToObject(obj, "vcpus", r->vcpus);
+    cJSON_AddNumberToObject(obj, "generation", (double)r->generation);
+    return obj;
+}
+
+void inventory_list_json(const char *uri, int has_since, unsigned long long since,
+                         cJSON *resp) {
+    cJSON *vms = cJSON_AddArrayToObject(resp, "vms");
+    cJSON *removed = cJSON_AddArrayToObject(resp, "removed");
+
+    pthread_mutex_lock(&inventory_lock);
+    struct inventory *inv = find_inventory(uri, 0);
+    if (!inv) {
+        pthread_mutex_unlock(&inventory_lock);
+        cJSON_AddBoolToObject(resp, "full", 1);
+        return;
+    }
+
+    /* since inconnu (redémarrage) ou plus vieux que les tombstones gardés */
+    int full = !has_since || since < inv->horizon || since > inv->generation;
+    cJSON_AddNumberToObject(resp, "generation", (double)inv->generation);
+    cJSON_AddBoolToObject(resp, "full", full);
+
+    for (int i = 0; i < inv->count; i++) {
+        const struct inv_record *r = &inv->recs[i];
+        if (!full && r->generation <= since)
+            continue;
+        if (!r->removed) {
+            cJSON_AddItemToArray(vms, record_to_json(r));
+        } else if (!full) {
+            cJSON *obj = cJSON_CreateObject();
+            cJSON_AddStringToObject(obj, "name", r->name);
+            cJSON_AddStringToObject(obj, "uuid", r->uuid);
+            cJSON_AddNumberToObject(obj, "generation", (double)r->generation);
+            cJSON_AddItemToArray(removed, obj);
+        }
+    }
+    pthread_mutex_unlock(&inventory_lock);
+}
+
+/* --------------------------------------------------------------------------
+ * Requêtes paginées
+ * -------------------------------------------------------------------------- */
+
+int inventory_sort_from_name(const char *name) {
+    static const char *names[INVENTORY_SORT_COUNT] = { "name", "memory", "vcpus", "state" };
+    for (int k = 0; k < INVENTORY_SORT_COUNT; k++) {
+        if (strcmp(name, names[k]) == 0)
+            return k;
+    }
+    return -1;
+}
+
+#define CMP(a, b) (((a) > (b)) - ((a) < (b)))
+
+/* Ordre total (clé, uuid) : deux VMs ne sont jamais égales */
+static int compare_records(const struct inv_record *a, const struct inv_record *b,
+                           enum inventory_sort key) {
+    int c = 0;
+    switch (key) {
+    case INVENTORY_SORT_NAME:   c = strcmp(a->name, b->name); break;
+    case INVENTORY_SORT_MEMORY: c = CMP(a->memory_kib, b->memory_kib); break;
+    case INVENTORY_SORT_VCPUS:  c = CMP(a->vcpus, b->vcpus); break;
+    case INVENTORY_SORT_STATE:  c = CMP(a->state, b->state); break;
+    default: break;
+    }
+    return c ? c : strcmp(a->uuid, b->uuid);
+}
+
+/* Contexte de qsort, protégé par inventory_lock */
+static const struct inv_record *sort_recs;
+static enum inventory_sort sort_key;
+
+static int compare_positions(const void *pa, const void *pb) {
+    return compare_records(&sort_recs[*(const int *)pa], &sort_recs[*(const int *)pb], sort_key);
+}
+
+/* (inventory_lock tenu) */
+static const int *sorted_index(struct inventory *inv, enum inventory_sort key, int *count) {
+    if (!inv->sorted_valid[key]) {
+        int *idx = realloc(inv->sorted[key], (inv->count > 0 ? inv->count : 1) * sizeof(int));
+        if (!idx)
+            return NULL;
+        int n = 0;
+        for (int i = 0; i < inv->count; i++) {
+            if (!inv->recs[i].removed)
+                idx[n++] = i;
+        }
+        sort_recs = inv->recs;
+        sort_key = key;
+        qsort(idx, n, sizeof(int), compare_positions);
+
+        inv->sorted[key] = idx;
+        inv->sorted_count[key] = n;
+        inv->sorted_valid[key] = 1;
+    }
+    *count = inv->sorted_count[key];
+    return inv->sorted[key];
+}
+
+/* Curseur : "<uuid>:<valeur de la clé de tri>" de la dernière VM examinée */
+static void encode_cursor(const struct inv_record *r, enum inventory_sort key,
+                          char *out, size_t outlen) {
+    switch (key) {
+    case INVENTORY_SORT_NAME:
+        snprintf(out, outlen, "%s:%s", r->uuid, r->name);
+        break;
+    case INVENTORY_SORT_MEMORY:
+        snprintf(out, outlen, "%s:%llu", r->uuid, r->memory_kib);
+        break;
+    case INVENTORY_SORT_VCPUS:
+        snprintf(out, outlen, "%s:%d", r->uuid, r->vcpus);
+        break;
+    default:
+        snprintf(out, outlen, "%s:%d", r->uuid, r->state);
+        break;
+    }
+}
+
+static int decode_cursor(const char *cursor, enum inventory_sort key, struct inv_record *out) {
+    size_t uuid_len = VIR_UUID_STRING_BUFLEN - 1;
+
+    memset(out, 0, sizeof(*out));
+    if (strlen(cursor) <= uuid_len || cursor[uuid_len] != ':')
+        return -1;
+    memcpy(out->uuid, cursor, uuid_len);
+    out->uuid[uuid_len] = '\0';
+
+    const char *value = cursor + uuid_len + 1;
+    char *end = NULL;
+    switch (key) {
+    case INVENTORY_SORT_NAME:
+        snprintf(out->name, sizeof(out->name), "%s", value);
+        return 0;
+    case INVENTORY_SORT_MEMORY:
+        out->memory_kib = strtoull(value, &end, 10);
+        break;
+    case INVENTORY_SORT_VCPUS:
+        out->vcpus = (int)strtol(value, &end, 10);
+        break;
+    default:
+        out->state = (int)strtol(value, &end, 10);
+        break;
+    }
+    return end && end != value && *end == '\0' ? 0 : -1;
+}
+
+/* Premier rang de idx (trié) pour lequel above(rec) est vrai ; above monotone */
+static int lower_bound(const struct inventory *inv, const int *idx, int n,
+                       int (*above)(const struct inv_record *, const void *), const void *arg) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (above(&inv->recs[idx[mid]], arg))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+struct cursor_arg {
+    const struct inv_record *cursor;
+    enum inventory_sort key;
+};
+
+static int after_cursor(const struct inv_record *r, const void *arg) {
+    const struct cursor_arg *c = arg;
+    return compare_records(r, c->cursor, c->key) > 0;
+}
+
+static int not_before_cursor(const struct inv_record *r, const void *arg) {
+    const struct cursor_arg *c = arg;
+    return compare_records(r, c->cursor, c->key) >= 0;
+}
+
+static int name_at_least(const struct inv_record *r, const void *prefix) {
+    return strncmp(r->name, prefix, strlen(prefix)) >= 0;
+}
+
+static int name_past(const struct inv_record *r, const void *prefix) {
+    return strncmp(r->name, prefix, strlen(prefix)) > 0;
+}
+
+static int has_glob(const char *s) {
+    return strpbrk(s, "*?[") != NULL;
+}
+
+static int state_matches(int state, const char *filter) {
+    if (strcmp(filter, "active") == 0)
+        return state_is_active(state);
+    if (strcmp(filter, "inactive") == 0)
+        return !state_is_active(state);
+    return strcmp(filter, state_name(state)) == 0;
+}
+
+static int record_matches(const struct inv_record *r, const struct inventory_query *q) {
+    if (q->state && !state_matches(r->state, q->state))
+        return 0;
+    if (q->name) {
+        if (has_glob(q->name) ? fnmatch(q->name, r->name, 0) != 0
+                              : strncmp(r->name, q->name, strlen(q->name)) != 0)
+            return 0;
+    }
+    unsigned long long mem_mib = r->memory_kib / 1024;
+    if (q->min_memory_mib && mem_mib < q->min_memory_mib)
+        return 0;
+    if (q->max_memory_mib && mem_mib > q->max_memory_mib)
+        return 0;
+    if (q->min_vcpus && r->vcpus < q->min_vcpus)
+        return 0;
+    if (q->max_vcpus && r->vcpus > q->max_vcpus)
+        return 0;
+    return 1;
+}
+
+int inventory_query_json(const char *uri, const struct inventory_query *q, cJSON *resp,
+                         char *err, size_t errlen) {
+    struct inv_record cursor;
+    if (q->cursor && decode_cursor(q->cursor, q->sort, &cursor) < 0) {
+        snprintf(err, errlen, "invalid cursor");
+        return -1;
+    }
+
+    int limit = q->limit > 0 ? q->limit : INVENTORY_PAGE_DEFAULT;
+    if (limit > INVENTORY_PAGE_MAX)
+        limit = INVENTORY_PAGE_MAX;
+
+    cJSON *vms = cJSON_AddArrayToObject(resp, "vms");
+
+    pthread_mutex_lock(&inventory_lock);
+    struct inventory *inv = find_inventory(uri, 0);
+    int n = 0;
+    const int *idx = inv ? sorted_index(inv, q->sort, &n) : NULL;
+    if (!idx) {
+        pthread_mutex_unlock(&inventory_lock);
+        cJSON_AddNullToObject(resp, "nextCursor");
+        return 0;
+    }
+    cJSON_AddNumberToObject(resp, "generation", (double)inv->generation);
+
+    /*
+     * Bornes du parcours : reprise après le curseur, et, pour un tri par nom
+     * avec un filtre préfixe, saut direct sur la plage du préfixe.
+     */
+    int prefix_range = q->sort == INVENTORY_SORT_NAME && q->name && !has_glob(q->name);
+    int lo = 0, hi = n;                 /* [lo, hi) */
+    struct cursor_arg carg = { &cursor, q->sort };
+    if (prefix_range) {
+        lo = lower_bound(inv, idx, n, name_at_least, q->name);
+        hi = lower_bound(inv, idx, n, name_past, q->name);
+    }
+    if (q->cursor) {
+        if (!q->descending) {
+            int from = lower_bound(inv, idx, n, after_cursor, &carg);
+            if (from > lo)
+                lo = from;
+        } else {
+            int to = lower_bound(inv, idx, n, not_before_cursor, &carg);
+            if (to < hi)
+                hi = to;
+        }
+    }
+
+    int step = q->descending ? -1 : 1;
+    int i = q->descending ? hi - 1 : lo;
+    int matched = 0, scanned = 0;
+    const struct inv_record *last = NULL;
+
+    while (i >= lo && i < hi && matched < limit && scanned < INVENTORY_SCAN_BUDGET) {
+        const struct inv_record *r = &inv->recs[idx[i]];
+        if (record_matches(r, q)) {
+            cJSON_AddItemToArray(vms, record_to_json(r));
+            matched++;
+        }
+        last = r;
+        scanned++;
+        i += step;
+    }
+
+    /* Reste-t-il des VMs à examiner après la dernière vue ? */
+    if (last && i >= lo && i < hi) {
+        char next[VIR_UUID_STRING_BUFLEN + 300];
+        encode_cursor(last, q->sort, next, sizeof(next));
+        cJSON_AddStringToObject(resp, "nextCursor", next);
+    } else {
+        cJSON_AddNullToObject(resp, "nextCursor");
+    }
+    cJSON_AddNumberToObject(resp, "scanned", scanned);
+    pthread_mutex_unlock(&inventory_lock);
+    return 0;
+}
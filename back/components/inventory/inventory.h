@@ -0,0 +1,82 @@
+// inventory.h
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <stddef.h>
+#include <cjson/cJSON.h>
+
+/* Nombre max d'hyperviseurs dont l'inventaire est gardé en mémoire */
+#define MAX_INVENTORIES 32
+
+/* Âge max de l'inventaire avant un nouveau scan libvirt (ms) */
+#define INVENTORY_MAX_AGE_MS 2000
+
+/* Durée de conservation des VMs supprimées (tombstones) pour les deltas (s) */
+#define INVENTORY_TOMBSTONE_TTL_S 600
+
+/*
+ * Met à jour l'inventaire de l'hyperviseur s'il est plus vieux que
+ * INVENTORY_MAX_AGE_MS, invalidé, ou si force != 0. Chaque VM ajoutée,
+ * modifiée ou supprimée reçoit la nouvelle génération de l'inventaire.
+ * Retourne 0, ou -1 si l'hyperviseur est injoignable.
+ */
+int inventory_refresh(const char *uri, int force);
+
+/* Force un scan au prochain inventory_refresh (après start/stop/create/...) */
+void inventory_invalidate(const char *uri);
+
+/* Date (ms epoch) du dernier scan réussi, 0 si l'hyperviseur n'a jamais été scanné */
+long long inventory_refreshed_ms(const char *uri);
+
+/*
+ * Ajoute à resp la liste des VMs de l'hyperviseur :
+ *   "generation" : high-water mark courant,
+ *   "vms"        : VMs ajoutées/modifiées depuis since (toutes si !has_since),
+ *   "removed"    : VMs supprimées depuis since,
+ *   "full"       : 1 si la liste est complète (pas de since, ou since trop
+ *                  ancien / inconnu : le client doit remplacer sa copie).
+ */
+void inventory_list_json(const char *uri, int has_since, unsigned long long since,
+                         cJSON *resp);
+
+/* Pagination : taille max d'une page, et nombre max de VMs examinées par page */
+#define INVENTORY_PAGE_DEFAULT 50
+#define INVENTORY_PAGE_MAX     500
+#define INVENTORY_SCAN_BUDGET  10000
+
+enum inventory_sort {
+    INVENTORY_SORT_NAME = 0,
+    INVENTORY_SORT_MEMORY,
+    INVENTORY_SORT_VCPUS,
+    INVENTORY_SORT_STATE,
+    INVENTORY_SORT_COUNT
+};
+
+/* Filtres, tri et curseur d'une page de /listallvms */
+struct inventory_query {
+    const char *state;                  /* NULL, "running", ..., "active" ou "inactive" */
+    const char *name;                   /* préfixe, ou glob s'il contient * ? [ */
+    unsigned long long min_memory_mib;  /* 0 = pas de borne */
+    unsigned long long max_memory_mib;
+    int min_vcpus;
+    int max_vcpus;
+    enum inventory_sort sort;
+    int descending;
+    int limit;
+    const char *cursor;                 /* "nextCursor" de la page précédente */
+};
+
+/* "name", "memory", "vcpus", "state" ; -1 si inconnu */
+int inventory_sort_from_name(const char *name);
+
+/*
+ * Ajoute à resp une page de VMs filtrées et triées ("vms", "nextCursor",
+ * "generation"). Parcourt un index trié par clé (reconstruit seulement
+ * quand l'inventaire change) à partir du curseur, en examinant au plus
+ * INVENTORY_SCAN_BUDGET VMs : une page peut donc être incomplète tout en
+ * ayant un nextCursor. Retourne -1 avec un message si le curseur est invalide.
+ */
+int inventory_query_json(const char *uri, const struct inventory_query *q, cJSON *resp,
+                         char *err, size_t errlen);
+
+#endif
@@ -0,0 +1,312 @@
+// logger.c
+#include "logger.h"
+#include <cjson/cJSON.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Attente du thread d'écriture quand tous les anneaux sont vides (ms) */
+#define LOG_DRAIN_INTERVAL_MS 20
+
+/* Lot écrit en un seul write() */
+#define LOG_BATCH_BYTES (64 * 1024)
+
+struct log_record {
+    struct timespec ts;
+    int    level;
+    char   component[24];
+    char   request_id[LOG_REQUEST_ID_LEN];
+    char   msg[LOG_MSG_MAX];
+};
+
+/*
+ * Anneau mono-producteur / mono-consommateur. Les anneaux ne sont jamais
+ * libérés : à la sortie d'un thread, le sien est rendu (owned = 0) et repris
+ * par le prochain thread qui journalise.
+ */
+struct log_ring {
+    struct log_ring *next;
+    atomic_int  owned;
+    atomic_uint head;                   /* écrit par le producteur */
+    atomic_uint tail;                   /* écrit par le consommateur */
+    struct log_record slots[LOG_RING_SLOTS];
+};
+
+atomic_int log_min_level = LOG_LEVEL_INFO;
+
+static _Atomic(struct log_ring *) rings;
+static atomic_ulong dropped;
+static atomic_ulong next_request;
+static unsigned long boot_id;
+
+static _Thread_local struct log_ring *my_ring;
+static _Thread_local char my_request_id[LOG_REQUEST_ID_LEN];
+
+static pthread_key_t   ring_key;
+static pthread_once_t  log_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *level_names[] = { "debug", "info", "warn", "error", "off" };
+
+const char *log_level_name(int level) {
+    return level >= LOG_LEVEL_DEBUG && level <= LOG_LEVEL_OFF ? level_names[level] : "unknown";
+}
+
+int log_level_from_name(const char *name) {
+    for (int l = LOG_LEVEL_DEBUG; l <= LOG_LEVEL_OFF; l++)
+        if (name && strcasecmp(name, level_names[l]) == 0)
+            return l;
+    return -1;
+}
+
+/* --------------------------------------------------------------------------
+ * Consommateur
+ * -------------------------------------------------------------------------- */
+
+static void write_all(const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(STDERR_FILENO, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+/* Format logfmt : ts=... level=... component=... req=... msg="..." */
+static size_t format_record(const struct log_record *r, char *out, size_t outlen) {
+    struct tm tm;
+    gmtime_r(&r->ts.tv_sec, &tm);
+    int n = snprintf(out, outlen,
+                     "ts=%04d-%02d-%02dT%02d:%02d:%02d.%03ldZ level=%s component=%s",
+                     tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                     tm.tm_hour, tm.tm_min, tm.tm_sec, r->ts.tv_nsec / 1000000,
+                     log_level_name(r->level), r->component);
+    if (n < 0 || (size_t)n >= outlen)
+        return 0;
+    size_t off = (size_t)n;
+    if (r->request_id[0]) {
+        n = snprintf(out + off, outlen - off, " req=%s", r->request_id);
+        if (n < 0 || (size_t)n >= outlen - off)
+            return 0;
+        off += (size_t)n;
+    }
+
+    /* msg entre guillemets, échappé ; 2 octets gardés pour '"' et '\n' */
+    const char *prefix = " msg=\"";
+    size_t plen = strlen(prefix);
+    if (off + plen + 2 > outlen)
+        return 0;
+    memcpy(out + off, prefix, plen);
+    off += plen;
+    for (const char *m = r->msg; *m && off + 4 < outlen; m++) {
+        char c = *m;
+        if (c == '"' || c == '\\') {
+            out[off++] = '\\';
+            out[off++] = c;
+        } else if (c == '\n') {
+            out[off++] = '\\';
+            out[off++] = 'n';
+        } else if ((unsigned char)c >= 0x20) {
+            out[off++] = c;
+        }
+    }
+    out[off++] = '"';
+    out[off++] = '\n';
+    return off;
+}
+
+/* Vide tous les anneaux ; retourne le nombre d'enregistrements écrits */
+static int drain_rings(void) {
+    static char batch[LOG_BATCH_BYTES];
+    static unsigned long reported_drops;
+    size_t used = 0;
+    int count = 0;
+
+    pthread_mutex_lock(&drain_lock);
+    for (struct log_ring *r = atomic_load(&rings); r; r = r->next) {
+        unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&r->head, memory_order_acquire);
+        while (tail != head) {
+            const struct log_record *rec = &r->slots[tail % LOG_RING_SLOTS];
+            if (LOG_BATCH_BYTES - used < LOG_MSG_MAX * 2 + 256) {
+                write_all(batch, used);
+                used = 0;
+            }
+            used += format_record(rec, batch + used, LOG_BATCH_BYTES - used);
+            tail++;
+            count++;
+        }
+        atomic_store_explicit(&r->tail, tail, memory_order_release);
+    }
+
+    unsigned long drops = atomic_load(&dropped);
+    if (drops != reported_drops) {
+        struct log_record rec = { .level = LOG_LEVEL_WARN, .component = "logger" };
+        clock_gettime(CLOCK_REALTIME, &rec.ts);
+        snprintf(rec.msg, sizeof(rec.msg), "%lu record(s) dropped (ring full)",
+                 drops - reported_drops);
+        if (LOG_BATCH_BYTES - used < LOG_MSG_MAX * 2 + 256) {
+            write_all(batch, used);
+            used = 0;
+        }
+        used += format_record(&rec, batch + used, LOG_BATCH_BYTES - used);
+        reported_drops = drops;
+    }
+    if (used)
+        write_all(batch, used);
+    pthread_mutex_unlock(&drain_lock);
+    return count;
+}
+
+static void *writer_thread(void *arg) {
+    (void)arg;
+    struct timespec pause = { 0, LOG_DRAIN_INTERVAL_MS * 1000000L };
+    for (;;) {
+        if (drain_rings() == 0)
+            nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+void log_flush(void) {
+    drain_rings();
+}
+
+/* --------------------------------------------------------------------------
+ * Producteurs
+ * -------------------------------------------------------------------------- */
+
+static void release_ring(void *ring) {
+    atomic_store(&((struct log_ring *)ring)->owned, 0);
+}
+
+static void start_logger(void) {
+    const char *env = getenv("LOG_LEVEL");
+    int level = log_level_from_name(env);
+    if (level >= 0)
+        atomic_store(&log_min_level, level);
+
+    boot_id = (unsigned long)time(NULL) & 0xffffff;
+    pthread_key_create(&ring_key, release_ring);
+    atexit(log_flush);
+
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, writer_thread, NULL) != 0)
+        fprintf(stderr, "[logger] cannot start writer thread\n");
+    pthread_attr_destroy(&attr);
+}
+
+void log_init(void) {
+    pthread_once(&log_once, start_logger);
+}
+
+static struct log_ring *thread_ring(void) {
+    if (my_ring)
+        return my_ring;
+    log_init();
+
+    /* Anneau rendu par un thread terminé, sinon nouvel anneau en tête de liste */
+    for (struct log_ring *r = atomic_load(&rings); r; r = r->next) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&r->owned, &expected, 1)) {
+            my_ring = r;
+            break;
+        }
+    }
+    if (!my_ring) {
+        struct log_ring *r = calloc(1, sizeof(*r));
+        if (!r)
+            return NULL;
+        atomic_store(&r->owned, 1);
+        r->next = atomic_load(&rings);
+        while (!atomic_compare_exchange_weak(&rings, &r->next, r))
+            ;
+        my_ring = r;
+    }
+    pthread_setspecific(ring_key, my_ring);
+    return my_ring;
+}
+
+void log_write(int level, const char *component, const char *fmt, ...) {
+    struct log_ring *r = thread_ring();
+    if (!r) {
+        atomic_fetch_add(&dropped, 1);
+        return;
+    }
+
+    unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_SLOTS) {
+        atomic_fetch_add(&dropped, 1);
+        return;
+    }
+
+    struct log_record *rec = &r->slots[head % LOG_RING_SLOTS];
+    clock_gettime(CLOCK_REALTIME, &rec->ts);
+    rec->level = level;
+    snprintf(rec->component, sizeof(rec->component), "%s", component);
+    memcpy(rec->request_id, my_request_id, sizeof(rec->request_id));
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(rec->msg, sizeof(rec->msg), fmt, ap);
+    va_end(ap);
+
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+/* --------------------------------------------------------------------------
+ * Identifiants de requête
+ * -------------------------------------------------------------------------- */
+
+void log_set_request_id(const char *id) {
+    snprintf(my_request_id, sizeof(my_request_id), "%s", id ? id : "");
+}
+
+const char *log_request_id(void) {
+    return my_request_id;
+}
+
+void log_new_request_id(char *out, size_t len) {
+    log_init();
+    snprintf(out, len, "%06lx-%lu", boot_id, atomic_fetch_add(&next_request, 1) + 1);
+}
+
+/* --------------------------------------------------------------------------
+ * Handler
+ * -------------------------------------------------------------------------- */
+
+char *handle_loglevel(const char *post_data) {
+    cJSON *root = post_data && post_data[0] ? cJSON_Parse(post_data) : NULL;
+    cJSON *resp = cJSON_CreateObject();
+
+    cJSON *level_item = root ? cJSON_GetObjectItem(root, "level") : NULL;
+    int level = cJSON_IsString(level_item) ? log_level_from_name(level_item->valuestring)
+                                           : atomic_load(&log_min_level);
+    if (level < 0) {
+        cJSON_AddStringToObject(resp, "status", "error");
+        cJSON_AddStringToObject(resp, "message", "unknown level (debug, info, warn, error, off)");
+    } else {
+        atomic_store(&log_min_level, level);
+        cJSON_AddStringToObject(resp, "status", "ok");
+        cJSON_AddStringToObject(resp, "level", log_level_name(level));
+        cJSON_AddNumberToObject(resp, "dropped", (double)atomic_load(&dropped));
+    }
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    cJSON_Delete(root);
+    return out;
+}
@@ -0,0 +1,82 @@
+// logger.h
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+/*
+ * Journal asynchrone : chaque thread écrit dans son propre anneau (sans
+ * verrou, un seul producteur), un thread de fond les vide vers stderr par
+ * lots. Si un anneau est plein, l'enregistrement est perdu (compté) plutôt
+ * que de bloquer le handler.
+ *
+ * Usage, dans un .c :
+ *   #define LOG_COMPONENT "migratevm"
+ *   #include "../logger/logger.h"
+ *   LOG_INFO("job %d: migrating %s", id, name);
+ *
+ * Sous le niveau courant, LOG_xxx coûte une lecture atomique : les
+ * arguments ne sont pas évalués et rien n'est formaté.
+ */
+
+enum log_level {
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_OFF
+};
+
+/* Enregistrements par anneau (un anneau par thread) */
+#define LOG_RING_SLOTS 256
+
+/* Taille max d'un message formaté (tronqué au-delà) */
+#define LOG_MSG_MAX 400
+
+/* Identifiant de requête, propagé aux threads de job */
+#define LOG_REQUEST_ID_LEN 24
+
+#ifndef LOG_COMPONENT
+#define LOG_COMPONENT "backend"
+#endif
+
+extern atomic_int log_min_level;
+
+#define LOG_AT(level, ...)                                                        \
+    do {                                                                          \
+        if ((level) >= atomic_load_explicit(&log_min_level, memory_order_relaxed)) \
+            log_write((level), LOG_COMPONENT, __VA_ARGS__);                       \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+/* Niveau initial depuis LOG_LEVEL (debug|info|warn|error|off) et thread d'écriture */
+void log_init(void);
+
+void log_write(int level, const char *component, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/* Vide tous les anneaux de façon synchrone (arrêt du serveur) */
+void log_flush(void);
+
+int log_level_from_name(const char *name);
+const char *log_level_name(int level);
+
+/*
+ * Identifiant de requête du thread courant, ajouté à chaque ligne.
+ * NULL ou "" l'efface. log_request_id() retourne "" si aucun.
+ */
+void log_set_request_id(const char *id);
+const char *log_request_id(void);
+
+/* Nouvel identifiant unique dans le processus */
+void log_new_request_id(char *out, size_t len);
+
+/* Lecture / changement du niveau à chaud : { "level": "debug" } */
+char *handle_loglevel(const char *post_data);
+
+#endif
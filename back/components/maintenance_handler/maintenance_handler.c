@@ -0,0 +1,967 @@
+// maintenance_handler.c
+#include "maintenance_handler.h"
+#include "../../libvirt-utils.h"
+#include "../placement/placement.h"
+#include "../reclaim/reclaim.h"
+#define LOG_COMPONENT "maintenance"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Même partage NFS que createVM.c */
+static const char *NFS_BASE = "/mnt/vmstore";
+
+/* Intervalle de lecture de la progression (ms) */
+#define MAINT_POLL_INTERVAL_MS 1000
+
+/* Disques examinés au plus par VM */
+#define MAX_MAINT_DISKS 16
+
+enum maint_op {
+    MAINT_PULL = 0,
+    MAINT_COMMIT,
+    MAINT_TRIM
+};
+
+enum maint_job_state {
+    MAINT_JOB_FREE = 0,
+    MAINT_JOB_QUEUED,                   /* attend que l'hôte soit libre */
+    MAINT_JOB_RUNNING,
+    MAINT_JOB_COMPLETED,
+    MAINT_JOB_FAILED,
+    MAINT_JOB_CANCELLED
+};
+
+struct maint_job {
+    enum maint_job_state state;
+    enum maint_op op;
+    int    id;
+    char   uri[512];
+    char   vm_name[256];
+    char   disk[32];                    /* "" pour trim (tous les FS de l'invité) */
+    int    scheduled;                   /* lancé par le planificateur */
+    unsigned long bandwidth_mib;
+    unsigned long bandwidth_req;        /* nouveau débit demandé, 0 = aucun */
+    int    depth_before;
+    int    depth_after;
+    char   message[256];
+    char   req_id[LOG_REQUEST_ID_LEN];  /* requête HTTP à l'origine du job */
+    time_t queued_at;
+    time_t started_at;
+    time_t finished_at;
+    int    cancel_requested;
+    unsigned long long cur;
+    unsigned long long end;
+};
+
+/* Fenêtre de maintenance [start_hour, end_hour), heure locale */
+struct maint_schedule {
+    int    enabled;
+    int    max_depth;                   /* chaînes plus longues => pull */
+    unsigned long bandwidth_mib;
+    int    start_hour;
+    int    end_hour;
+    int    trim;
+    int    last_pass_day;               /* tm_year * 1000 + tm_yday du dernier passage */
+};
+
+static struct maint_job jobs[MAX_MAINT_JOBS];
+static int next_job_id = 1;
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  slot_free = PTHREAD_COND_INITIALIZER;
+
+static struct maint_schedule schedule = {
+    .enabled = 0, .max_depth = 1, .bandwidth_mib = MAINT_BANDWIDTH_DEFAULT_MIB,
+    .start_hour = 2, .end_hour = 5, .trim = 1, .last_pass_day = -1
+};
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  sched_once = PTHREAD_ONCE_INIT;
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("%s: libvirt error (code=%d, domain=%d): %s",
+                  prefix, err->code, err->domain,
+                  err->message ? err->message : "(no message)");
+    } else {
+        LOG_ERROR("%s: unknown libvirt error", prefix);
+    }
+}
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static const char *op_name(enum maint_op op) {
+    switch (op) {
+    case MAINT_PULL:   return "pull";
+    case MAINT_COMMIT: return "commit";
+    case MAINT_TRIM:   return "trim";
+    default:           return "unknown";
+    }
+}
+
+static int op_from_name(const char *name, enum maint_op *out) {
+    for (int op = MAINT_PULL; op <= MAINT_TRIM; op++) {
+        if (strcmp(name, op_name((enum maint_op)op)) == 0) {
+            *out = (enum maint_op)op;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* --------------------------------------------------------------------------
+ * Chaînes de backing (XML live du domaine)
+ * -------------------------------------------------------------------------- */
+
+/* Valeur de l'attribut file='...' suivant p, dans [p, end) */
+static int file_attr(const char *p, const char *end, char *out, size_t outlen) {
+    const char *f = strstr(p, "<source file='");
+    if (!f || f >= end)
+        return -1;
+    f += strlen("<source file='");
+    size_t len = strcspn(f, "'");
+    if (len == 0 || len >= outlen)
+        return -1;
+    memcpy(out, f, len);
+    out[len] = '\0';
+    return 0;
+}
+
+/*
+ * Profondeur de la chaîne d'un disque (nombre d'images de backing), et
+ * chemins de l'image active et de son backing immédiat.
+ * Retourne -1 si le disque n'existe pas.
+ */
+static int disk_chain(const char *xml, const char *dev, int *depth,
+                      char *top, char *backing, size_t pathlen) {
+    char target[64];
+    snprintf(target, sizeof(target), "<target dev='%s'", dev);
+
+    const char *p = xml;
+    while ((p = strstr(p, "<disk ")) != NULL) {
+        const char *end = strstr(p, "</disk>");
+        if (!end)
+            break;
+        const char *t = strstr(p, target);
+        if (t && t < end) {
+            *depth = 0;
+            const char *b = p, *first = NULL;
+            while ((b = strstr(b, "<backingStore type=")) != NULL && b < end) {
+                if (!first)
+                    first = b;
+                (*depth)++;
+                b++;
+            }
+            top[0] = backing[0] = '\0';
+            file_attr(p, first ? first : end, top, pathlen);
+            if (first)
+                file_attr(first, end, backing, pathlen);
+            return 0;
+        }
+        p = end;
+    }
+    return -1;
+}
+
+/* Disques (device='disk') d'une VM et profondeur de leur chaîne */
+static int list_disks(const char *xml, char devs[][32], int *depths, int max) {
+    int n = 0;
+    const char *p = xml;
+    while (n < max && (p = strstr(p, "<disk ")) != NULL) {
+        const char *end = strstr(p, "</disk>");
+        const char *tag_end = strchr(p, '>');
+        if (!end || !tag_end)
+            break;
+        const char *device = strstr(p, "device='disk'");
+        const char *target = strstr(p, "<target dev='");
+        if (device && device < tag_end && target && target < end) {
+            target += strlen("<target dev='");
+            size_t len = strcspn(target, "'");
+            if (len > 0 && len < 32) {
+                memcpy(devs[n], target, len);
+                devs[n][len] = '\0';
+                depths[n] = 0;
+                for (const char *b = p; (b = strstr(b, "<backingStore type=")) != NULL && b < end; b++)
+                    depths[n]++;
+                n++;
+            }
+        }
+        p = end;
+    }
+    return n;
+}
+
+/* Image propre à la VM (NFS_BASE/<vm>.*), jamais une image de base partagée */
+static int owned_by_vm(const char *path, const char *vm_name) {
+    size_t base_len = strlen(NFS_BASE);
+    size_t vm_len   = strlen(vm_name);
+    if (strncmp(path, NFS_BASE, base_len) != 0 || path[base_len] != '/')
+        return 0;
+    const char *name = path + base_len + 1;
+    return !strchr(name, '/') && strncmp(name, vm_name, vm_len) == 0 && name[vm_len] == '.';
+}
+
+/* --------------------------------------------------------------------------
+ * Table des jobs
+ * -------------------------------------------------------------------------- */
+
+static const char *job_state_name(enum maint_job_state state) {
+    switch (state) {
+    case MAINT_JOB_QUEUED:    return "queued";
+    case MAINT_JOB_RUNNING:   return "running";
+    case MAINT_JOB_COMPLETED: return "completed";
+    case MAINT_JOB_FAILED:    return "failed";
+    case MAINT_JOB_CANCELLED: return "cancelled";
+    default:                  return "unknown";
+    }
+}
+
+static int job_is_active(const struct maint_job *job) {
+    return job->state == MAINT_JOB_QUEUED ||
+           job->state == MAINT_JOB_RUNNING;
+}
+
+/* Retrouve un job par id (jobs_lock doit être tenu) */
+static struct maint_job *find_job(int id) {
+    for (int i = 0; i < MAX_MAINT_JOBS; i++) {
+        if (jobs[i].state != MAINT_JOB_FREE && jobs[i].id == id)
+            return &jobs[i];
+    }
+    return NULL;
+}
+
+/* Slot libre, sinon le job terminé le plus ancien (jobs_lock doit être tenu) */
+static struct maint_job *alloc_job(void) {
+    struct maint_job *oldest = NULL;
+    for (int i = 0; i < MAX_MAINT_JOBS; i++) {
+        if (jobs[i].state == MAINT_JOB_FREE)
+            return &jobs[i];
+        if (!job_is_active(&jobs[i]) &&
+            (!oldest || jobs[i].finished_at < oldest->finished_at))
+            oldest = &jobs[i];
+    }
+    return oldest;
+}
+
+/*
+ * Un seul block job de maintenance à la fois par hôte, dans l'ordre
+ * d'arrivée ; chacun est en plus limité en débit. (jobs_lock doit être tenu)
+ */
+static int host_busy(const struct maint_job *job) {
+    for (int i = 0; i < MAX_MAINT_JOBS; i++) {
+        const struct maint_job *other = &jobs[i];
+        if (other == job || strcmp(other->uri, job->uri) != 0)
+            continue;
+        if (other->state == MAINT_JOB_RUNNING)
+            return 1;
+        if (other->state == MAINT_JOB_QUEUED && other->id < job->id)
+            return 1;
+    }
+    return 0;
+}
+
+static void finish_job(struct maint_job *job, enum maint_job_state state,
+                       const char *message) {
+    pthread_mutex_lock(&jobs_lock);
+    job->state = state;
+    job->finished_at = time(NULL);
+    snprintf(job->message, sizeof(job->message), "%s", message);
+    pthread_cond_broadcast(&slot_free);
+    pthread_mutex_unlock(&jobs_lock);
+}
+
+static int in_window(const struct maint_schedule *s, int hour) {
+    if (s->start_hour <= s->end_hour)
+        return hour >= s->start_hour && hour < s->end_hour;
+    return hour >= s->start_hour || hour < s->end_hour;
+}
+
+static int current_hour(void) {
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    return tm.tm_hour;
+}
+
+/* --------------------------------------------------------------------------
+ * Thread de maintenance
+ * -------------------------------------------------------------------------- */
+
+/* Suit le block job jusqu'à sa fin ; pivote un commit actif quand il est prêt */
+static void follow_block_job(struct maint_job *job, virDomainPtr dom, int *aborted) {
+    int pivoted = 0;
+    *aborted = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&jobs_lock);
+        int cancel = job->cancel_requested;
+        unsigned long bw_req = job->bandwidth_req;
+        job->bandwidth_req = 0;
+        pthread_mutex_unlock(&jobs_lock);
+
+        if (cancel && !*aborted) {
+            if (TRACE_VIRT(virDomainBlockJobAbort, dom, job->disk, 0) < 0)
+                log_libvirt_error("virDomainBlockJobAbort");
+            *aborted = 1;
+        }
+        if (bw_req) {
+            if (TRACE_VIRT(virDomainBlockJobSetSpeed, dom, job->disk, bw_req, 0) < 0) {
+                log_libvirt_error("virDomainBlockJobSetSpeed");
+            } else {
+                pthread_mutex_lock(&jobs_lock);
+                job->bandwidth_mib = bw_req;
+                pthread_mutex_unlock(&jobs_lock);
+            }
+        }
+
+        virDomainBlockJobInfo info;
+        int rc = TRACE_VIRT(virDomainGetBlockJobInfo, dom, job->disk, &info, 0);
+        if (rc < 0) {
+            log_libvirt_error("virDomainGetBlockJobInfo");
+            break;
+        }
+        if (rc == 0)
+            break;                      /* plus de job sur ce disque */
+
+        pthread_mutex_lock(&jobs_lock);
+        job->cur = info.cur;
+        job->end = info.end;
+        pthread_mutex_unlock(&jobs_lock);
+
+        // Commit actif : l'overlay est recopié, on bascule sur le backing
+        if (job->op == MAINT_COMMIT && !pivoted && !*aborted &&
+            info.end > 0 && info.cur == info.end) {
+            if (TRACE_VIRT(virDomainBlockJobAbort, dom, job->disk, VIR_DOMAIN_BLOCK_JOB_ABORT_PIVOT) < 0)
+                log_libvirt_error("virDomainBlockJobAbort(pivot)");
+            else
+                pivoted = 1;
+        }
+        usleep(MAINT_POLL_INTERVAL_MS * 1000);
+    }
+}
+
+static void *maint_job_thread(void *arg) {
+    struct maint_job *job = arg;
+    log_set_request_id(job->req_id);
+
+    pthread_mutex_lock(&jobs_lock);
+    while (!job->cancel_requested && host_busy(job))
+        pthread_cond_wait(&slot_free, &jobs_lock);
+    int cancelled = job->cancel_requested;
+    pthread_mutex_unlock(&jobs_lock);
+
+    if (cancelled) {
+        finish_job(job, MAINT_JOB_CANCELLED, "Maintenance cancelled");
+        return NULL;
+    }
+
+    // Job planifié sorti de la fenêtre pendant son attente
+    if (job->scheduled) {
+        pthread_mutex_lock(&sched_lock);
+        int open = in_window(&schedule, current_hour());
+        pthread_mutex_unlock(&sched_lock);
+        if (!open) {
+            finish_job(job, MAINT_JOB_CANCELLED, "maintenance window closed");
+            return NULL;
+        }
+    }
+
+    pthread_mutex_lock(&jobs_lock);
+    job->state = MAINT_JOB_RUNNING;
+    job->started_at = time(NULL);
+    snprintf(job->message, sizeof(job->message), "Running");
+    pthread_mutex_unlock(&jobs_lock);
+
+    virConnectPtr conn = libvirt_pool_open(job->uri);
+    if (!conn) {
+        log_libvirt_error("virConnectOpen");
+        finish_job(job, MAINT_JOB_FAILED, "cannot connect to hypervisor");
+        return NULL;
+    }
+
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, job->vm_name);
+    if (!dom || TRACE_VIRT(virDomainIsActive, dom) != 1) {
+        if (dom)
+            virDomainFree(dom);
+        virConnectClose(conn);
+        finish_job(job, MAINT_JOB_FAILED, dom ? "domain must be running" : "domain not found");
+        return NULL;
+    }
+
+    if (job->op == MAINT_TRIM) {
+        // Nécessite l'agent invité et discard='unmap' sur le disque
+        int ok = TRACE_VIRT(virDomainFSTrim, dom, NULL, 0, 0) == 0;
+        if (!ok)
+            log_libvirt_error("virDomainFSTrim");
+        virErrorPtr err = ok ? NULL : virGetLastError();
+        char msg[256];
+        snprintf(msg, sizeof(msg), "%s", ok ? "Guest filesystems trimmed"
+                 : err && err->message ? err->message : "fstrim failed");
+        virDomainFree(dom);
+        virConnectClose(conn);
+        finish_job(job, ok ? MAINT_JOB_COMPLETED : MAINT_JOB_FAILED, msg);
+        return NULL;
+    }
+
+    char top[1024], backing[1024];
+    int depth = 0, found = -1;
+    char *xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+    if (xml) {
+        found = disk_chain(xml, job->disk, &depth, top, backing, sizeof(top));
+        free(xml);
+    }
+
+    const char *error = NULL;
+    if (found < 0)
+        error = "disk not found";
+    else if (depth == 0)
+        error = "";                     /* rien à faire */
+    else if (job->op == MAINT_COMMIT && !owned_by_vm(backing, job->vm_name))
+        error = "backing image is shared (base image), use pull";
+
+    pthread_mutex_lock(&jobs_lock);
+    job->depth_before = depth;
+    job->depth_after = depth;
+    pthread_mutex_unlock(&jobs_lock);
+
+    if (error) {
+        virDomainFree(dom);
+        virConnectClose(conn);
+        finish_job(job, error[0] ? MAINT_JOB_FAILED : MAINT_JOB_COMPLETED,
+                   error[0] ? error : "no backing chain");
+        return NULL;
+    }
+
+    LOG_INFO("job %d: %s %s/%s (depth %d, %lu MiB/s)",
+             job->id, op_name(job->op), job->vm_name, job->disk, depth, job->bandwidth_mib);
+
+    int rc;
+    if (job->op == MAINT_PULL) {
+        rc = TRACE_VIRT(virDomainBlockPull, dom, job->disk, job->bandwidth_mib, 0);
+    } else {
+        // SHALLOW : fusion dans le backing immédiat seulement, jamais plus bas
+        rc = TRACE_VIRT(virDomainBlockCommit, dom, job->disk, NULL, NULL, job->bandwidth_mib,
+                                              VIR_DOMAIN_BLOCK_COMMIT_ACTIVE | VIR_DOMAIN_BLOCK_COMMIT_SHALLOW);
+    }
+    if (rc < 0) {
+        log_libvirt_error(job->op == MAINT_PULL ? "virDomainBlockPull" : "virDomainBlockCommit");
+        virErrorPtr err = virGetLastError();
+        char msg[256];
+        snprintf(msg, sizeof(msg), "%s", err && err->message ? err->message : "cannot start block job");
+        virDomainFree(dom);
+        virConnectClose(conn);
+        finish_job(job, MAINT_JOB_FAILED, msg);
+        return NULL;
+    }
+
+    int aborted;
+    follow_block_job(job, dom, &aborted);
+
+    // Le résultat se lit sur la chaîne : elle doit avoir raccourci
+    int depth_after = depth;
+    char new_top[1024], new_backing[1024];
+    xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+    if (xml) {
+        disk_chain(xml, job->disk, &depth_after, new_top, new_backing, sizeof(new_top));
+        free(xml);
+    }
+    pthread_mutex_lock(&jobs_lock);
+    job->depth_after = depth_after;
+    pthread_mutex_unlock(&jobs_lock);
+
+    if (aborted) {
+        finish_job(job, MAINT_JOB_CANCELLED, "Maintenance cancelled");
+    } else if (depth_after < depth) {
+        // Commit : l'ancien overlay n'est plus référencé, il part à la suppression
+        if (job->op == MAINT_COMMIT && top[0] && strcmp(top, new_top) != 0 &&
+            owned_by_vm(top, job->vm_name))
+            reclaim_enqueue(job->vm_name, top, 0);
+        finish_job(job, MAINT_JOB_COMPLETED,
+                   job->op == MAINT_PULL ? "Chain flattened" : "Overlay committed");
+    } else {
+        finish_job(job, MAINT_JOB_FAILED, "block job ended without shortening the chain");
+    }
+
+    virDomainFree(dom);
+    virConnectClose(conn);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * API interne
+ * -------------------------------------------------------------------------- */
+
+static int maint_job_start(const char *uri, const char *vm_name, enum maint_op op,
+                           const char *disk, unsigned long bandwidth_mib, int scheduled,
+                           char *err, size_t errlen) {
+    pthread_mutex_lock(&jobs_lock);
+
+    // Un seul job par disque (trim : un par VM)
+    for (int i = 0; i < MAX_MAINT_JOBS; i++) {
+        if (job_is_active(&jobs[i]) && strcmp(jobs[i].uri, uri) == 0 &&
+            strcmp(jobs[i].vm_name, vm_name) == 0 && strcmp(jobs[i].disk, disk) == 0) {
+            pthread_mutex_unlock(&jobs_lock);
+            snprintf(err, errlen, "a maintenance job is already queued or running for this disk");
+            return -1;
+        }
+    }
+
+    struct maint_job *job = alloc_job();
+    if (!job) {
+        pthread_mutex_unlock(&jobs_lock);
+        snprintf(err, errlen, "too many maintenance jobs in progress");
+        return -1;
+    }
+
+    memset(job, 0, sizeof(*job));
+    job->id = next_job_id++;
+    job->state = MAINT_JOB_QUEUED;
+    snprintf(job->req_id, sizeof(job->req_id), "%s", log_request_id());
+    job->op = op;
+    job->scheduled = scheduled;
+    job->bandwidth_mib = bandwidth_mib;
+    job->queued_at = time(NULL);
+    snprintf(job->uri, sizeof(job->uri), "%s", uri);
+    snprintf(job->vm_name, sizeof(job->vm_name), "%s", vm_name);
+    snprintf(job->disk, sizeof(job->disk), "%s", disk);
+    snprintf(job->message, sizeof(job->message), "Queued");
+
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&tid, &attr, maint_job_thread, job);
+    pthread_attr_destroy(&attr);
+
+    if (rc != 0) {
+        job->state = MAINT_JOB_FREE;
+        pthread_mutex_unlock(&jobs_lock);
+        snprintf(err, errlen, "cannot start maintenance thread");
+        return -1;
+    }
+
+    int id = job->id;
+    pthread_mutex_unlock(&jobs_lock);
+    return id;
+}
+
+/*
+ * Lance les jobs d'une VM : pull/commit sur chaque disque dont la chaîne
+ * dépasse min_depth (ou sur `disk` seul), trim sur la VM entière.
+ * Les ids sont ajoutés à ids (peut être NULL). Retourne le nombre de jobs.
+ */
+static int start_vm_jobs(const char *uri, virDomainPtr dom, enum maint_op op,
+                         const char *disk, int min_depth, unsigned long bandwidth_mib,
+                         int scheduled, cJSON *ids, char *err, size_t errlen) {
+    const char *vm_name = virDomainGetName(dom);
+    int started = 0, matched = 0;
+
+    if (op == MAINT_TRIM) {
+        int id = maint_job_start(uri, vm_name, op, "", bandwidth_mib, scheduled, err, errlen);
+        if (id >= 0 && ids)
+            cJSON_AddItemToArray(ids, cJSON_CreateNumber(id));
+        return id >= 0 ? 1 : 0;
+    }
+
+    char *xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+    if (!xml) {
+        snprintf(err, errlen, "cannot read domain XML");
+        return 0;
+    }
+    char devs[MAX_MAINT_DISKS][32];
+    int depths[MAX_MAINT_DISKS];
+    int n = list_disks(xml, devs, depths, MAX_MAINT_DISKS);
+    free(xml);
+
+    for (int i = 0; i < n; i++) {
+        if (disk ? strcmp(devs[i], disk) != 0 : depths[i] <= min_depth)
+            continue;
+        matched = 1;
+        int id = maint_job_start(uri, vm_name, op, devs[i], bandwidth_mib, scheduled, err, errlen);
+        if (id < 0)
+            continue;
+        if (ids)
+            cJSON_AddItemToArray(ids, cJSON_CreateNumber(id));
+        started++;
+    }
+    if (disk && !matched)
+        snprintf(err, errlen, "disk not found");
+    return started;
+}
+
+/* --------------------------------------------------------------------------
+ * Planificateur
+ * -------------------------------------------------------------------------- */
+
+/* Un passage par nuit sur tous les hôtes enregistrés (service de placement) */
+static void maintenance_pass(const struct maint_schedule *s) {
+    static char uris[MAX_PLACEMENT_HOSTS][512];
+    int nhosts = placement_list_hosts(uris, MAX_PLACEMENT_HOSTS);
+    int queued = 0;
+
+    for (int h = 0; h < nhosts; h++) {
+        virConnectPtr conn = libvirt_pool_open(uris[h]);
+        if (!conn) {
+            log_libvirt_error("virConnectOpen");
+            continue;
+        }
+
+        virDomainPtr *doms = NULL;
+        int ndoms = TRACE_VIRT(virConnectListAllDomains, conn, &doms, VIR_CONNECT_LIST_DOMAINS_ACTIVE);
+        for (int i = 0; i < ndoms; i++) {
+            char err[128];
+            queued += start_vm_jobs(uris[h], doms[i], MAINT_PULL, NULL, s->max_depth,
+                                    s->bandwidth_mib, 1, NULL, err, sizeof(err));
+            if (s->trim)
+                queued += start_vm_jobs(uris[h], doms[i], MAINT_TRIM, NULL, 0,
+                                        s->bandwidth_mib, 1, NULL, err, sizeof(err));
+            virDomainFree(doms[i]);
+        }
+        free(doms);
+        virConnectClose(conn);
+    }
+    LOG_INFO("nightly pass: %d job(s) queued on %d host(s)", queued, nhosts);
+}
+
+static void *maintenance_scheduler_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        time_t now = time(NULL);
+        struct tm tm;
+        localtime_r(&now, &tm);
+        int today = tm.tm_year * 1000 + tm.tm_yday;
+
+        pthread_mutex_lock(&sched_lock);
+        int due = schedule.enabled && in_window(&schedule, tm.tm_hour) &&
+                  schedule.last_pass_day != today;
+        struct maint_schedule copy = schedule;
+        if (due)
+            schedule.last_pass_day = today;
+        pthread_mutex_unlock(&sched_lock);
+
+        if (due)
+            maintenance_pass(&copy);
+        sleep(MAINT_SCHED_TICK_S);
+    }
+    return NULL;
+}
+
+static void start_scheduler(void) {
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, maintenance_scheduler_thread, NULL) != 0)
+        LOG_ERROR("cannot start scheduler thread");
+    pthread_attr_destroy(&attr);
+}
+
+/* --------------------------------------------------------------------------
+ * Sérialisation JSON
+ * -------------------------------------------------------------------------- */
+
+static cJSON *job_to_json(const struct maint_job *job) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "jobId", job->id);
+    cJSON_AddStringToObject(obj, "op", op_name(job->op));
+    cJSON_AddStringToObject(obj, "vmName", job->vm_name);
+    cJSON_AddStringToObject(obj, "uri", job->uri);
+    if (job->disk[0])
+        cJSON_AddStringToObject(obj, "disk", job->disk);
+    cJSON_AddStringToObject(obj, "state", job_state_name(job->state));
+    cJSON_AddStringToObject(obj, "message", job->message);
+    cJSON_AddBoolToObject(obj, "scheduled", job->scheduled);
+    cJSON_AddNumberToObject(obj, "bandwidthMiB", (double)job->bandwidth_mib);
+    if (job->op != MAINT_TRIM) {
+        cJSON_AddNumberToObject(obj, "chainDepthBefore", job->depth_before);
+        cJSON_AddNumberToObject(obj, "chainDepthAfter", job->depth_after);
+    }
+    cJSON_AddNumberToObject(obj, "queuedAt", (double)job->queued_at);
+    if (job->started_at)
+        cJSON_AddNumberToObject(obj, "startedAt", (double)job->started_at);
+    if (job->finished_at)
+        cJSON_AddNumberToObject(obj, "finishedAt", (double)job->finished_at);
+
+    cJSON *prog = cJSON_CreateObject();
+    double percent = 0;
+    if (job->state == MAINT_JOB_COMPLETED)
+        percent = 100;
+    else if (job->end > 0)
+        percent = 100.0 * (double)job->cur / (double)job->end;
+    cJSON_AddNumberToObject(prog, "percent", percent);
+    cJSON_AddNumberToObject(prog, "cur", (double)job->cur);
+    cJSON_AddNumberToObject(prog, "end", (double)job->end);
+    cJSON_AddItemToObject(obj, "progress", prog);
+    return obj;
+}
+
+static cJSON *schedule_to_json(const struct maint_schedule *s) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddBoolToObject(obj, "enabled", s->enabled);
+    cJSON_AddNumberToObject(obj, "maxChainDepth", s->max_depth);
+    cJSON_AddNumberToObject(obj, "bandwidthMiB", (double)s->bandwidth_mib);
+    cJSON_AddNumberToObject(obj, "windowStartHour", s->start_hour);
+    cJSON_AddNumberToObject(obj, "windowEndHour", s->end_hour);
+    cJSON_AddBoolToObject(obj, "trim", s->trim);
+    return obj;
+}
+
+/* Extrait "jobId" du body ; retourne -1 si absent */
+static int parse_job_id(cJSON *root) {
+    cJSON *id_item = root ? cJSON_GetObjectItem(root, "jobId") : NULL;
+    return cJSON_IsNumber(id_item) ? id_item->valueint : -1;
+}
+
+/* --------------------------------------------------------------------------
+ * Handlers HTTP
+ * -------------------------------------------------------------------------- */
+
+/**
+ * POST /blockmaint
+ * BODY JSON:
+ * {
+ *   "uri": "qemu:///system",
+ *   "vmName": "debian13",
+ *   "op": "pull",            // "pull" | "commit" | "trim"
+ *   "disk": "vda",           // optionnel : sinon chaque disque ayant un backing
+ *   "bandwidthMiB": 50       // optionnel : débit max du block job
+ * }
+ */
+char *handle_blockmaint(const char *post_data) {
+    if (!post_data)
+        return make_json_error("missing body");
+
+    cJSON *root = cJSON_Parse(post_data);
+    if (!root)
+        return make_json_error("invalid JSON");
+
+    cJSON *uri_item  = cJSON_GetObjectItem(root, "uri");
+    cJSON *vm_item   = cJSON_GetObjectItem(root, "vmName");
+    cJSON *op_item   = cJSON_GetObjectItem(root, "op");
+    cJSON *disk_item = cJSON_GetObjectItem(root, "disk");
+    cJSON *bw_item   = cJSON_GetObjectItem(root, "bandwidthMiB");
+
+    enum maint_op op;
+    if (!cJSON_IsString(uri_item) || !cJSON_IsString(vm_item) ||
+        !cJSON_IsString(op_item) || op_from_name(op_item->valuestring, &op) < 0) {
+        cJSON_Delete(root);
+        return make_json_error("uri, vmName or op (pull, commit, trim) missing or invalid");
+    }
+    unsigned long bandwidth = cJSON_IsNumber(bw_item) && bw_item->valuedouble > 0
+                              ? (unsigned long)bw_item->valuedouble : MAINT_BANDWIDTH_DEFAULT_MIB;
+
+    virConnectPtr conn = libvirt_pool_open(uri_item->valuestring);
+    if (!conn) {
+        log_libvirt_error("virConnectOpen");
+        cJSON_Delete(root);
+        return make_json_error("cannot connect to hypervisor");
+    }
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, vm_item->valuestring);
+    if (!dom) {
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return make_json_error("domain not found");
+    }
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON *ids = cJSON_AddArrayToObject(resp, "jobIds");
+
+    char err[128] = "";
+    int started = start_vm_jobs(uri_item->valuestring, dom, op,
+                                cJSON_IsString(disk_item) ? disk_item->valuestring : NULL,
+                                0, bandwidth, 0, ids, err, sizeof(err));
+    virDomainFree(dom);
+    virConnectClose(conn);
+    cJSON_Delete(root);
+
+    if (started == 0 && err[0]) {
+        cJSON_Delete(resp);
+        return make_json_error(err);
+    }
+    cJSON_AddStringToObject(resp, "message", started ? "Maintenance queued" : "No backing chain to flatten");
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/**
+ * POST /blockjobstatus
+ * BODY JSON: { "jobId": 3 }   // sans jobId : tous les jobs
+ */
+char *handle_blockjobstatus(const char *post_data) {
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    int id = parse_job_id(root);
+    cJSON_Delete(root);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+
+    pthread_mutex_lock(&jobs_lock);
+    if (id >= 0) {
+        struct maint_job *job = find_job(id);
+        if (!job) {
+            pthread_mutex_unlock(&jobs_lock);
+            cJSON_Delete(resp);
+            return make_json_error("unknown maintenance job");
+        }
+        cJSON_AddItemToObject(resp, "job", job_to_json(job));
+    } else {
+        cJSON *arr = cJSON_AddArrayToObject(resp, "jobs");
+        for (int i = 0; i < MAX_MAINT_JOBS; i++) {
+            if (jobs[i].state != MAINT_JOB_FREE)
+                cJSON_AddItemToArray(arr, job_to_json(&jobs[i]));
+        }
+    }
+    pthread_mutex_unlock(&jobs_lock);
+
+    pthread_mutex_lock(&sched_lock);
+    cJSON_AddItemToObject(resp, "schedule", schedule_to_json(&schedule));
+    pthread_mutex_unlock(&sched_lock);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/**
+ * POST /blockjobspeed
+ * BODY JSON: { "jobId": 3, "bandwidthMiB": 20 }
+ * Appliqué par le thread du job à sa prochaine lecture de progression.
+ */
+char *handle_blockjobspeed(const char *post_data) {
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    int id = parse_job_id(root);
+    cJSON *bw_item = root ? cJSON_GetObjectItem(root, "bandwidthMiB") : NULL;
+    double bandwidth = cJSON_IsNumber(bw_item) ? bw_item->valuedouble : 0;
+    cJSON_Delete(root);
+
+    if (id < 0 || bandwidth < 1)
+        return make_json_error("jobId or bandwidthMiB missing or invalid");
+
+    pthread_mutex_lock(&jobs_lock);
+    struct maint_job *job = find_job(id);
+    if (!job || !job_is_active(job) || job->op == MAINT_TRIM) {
+        pthread_mutex_unlock(&jobs_lock);
+        return make_json_error(!job ? "unknown maintenance job" : "job has no block job to throttle");
+    }
+    if (job->state == MAINT_JOB_QUEUED)
+        job->bandwidth_mib = (unsigned long)bandwidth;
+    else
+        job->bandwidth_req = (unsigned long)bandwidth;
+    pthread_mutex_unlock(&jobs_lock);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddNumberToObject(resp, "jobId", id);
+    cJSON_AddNumberToObject(resp, "bandwidthMiB", (double)(unsigned long)bandwidth);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/**
+ * POST /blockjobcancel
+ * BODY JSON: { "jobId": 3 }
+ */
+char *handle_blockjobcancel(const char *post_data) {
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    int id = parse_job_id(root);
+    cJSON_Delete(root);
+    if (id < 0)
+        return make_json_error("jobId missing or invalid");
+
+    pthread_mutex_lock(&jobs_lock);
+    struct maint_job *job = find_job(id);
+    if (!job || !job_is_active(job)) {
+        pthread_mutex_unlock(&jobs_lock);
+        return make_json_error(job ? "maintenance job is not running" : "unknown maintenance job");
+    }
+    job->cancel_requested = 1;
+    pthread_cond_broadcast(&slot_free);     // réveille un job en attente de l'hôte
+    pthread_mutex_unlock(&jobs_lock);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddNumberToObject(resp, "jobId", id);
+    cJSON_AddStringToObject(resp, "message", "Cancellation requested");
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/**
+ * POST /blockmaintschedule
+ * BODY JSON (tous les champs optionnels) :
+ * {
+ *   "enabled": true,
+ *   "maxChainDepth": 1,        // chaînes plus longues aplaties (pull)
+ *   "bandwidthMiB": 50,
+ *   "windowStartHour": 2,      // fenêtre [start, end), heure locale
+ *   "windowEndHour": 5,
+ *   "trim": true               // fstrim des invités actifs à chaque passage
+ * }
+ *
+ * Un passage par jour dans la fenêtre, sur tous les hôtes enregistrés ;
+ * les jobs encore en attente à la fermeture de la fenêtre sont annulés.
+ */
+char *handle_blockmaintschedule(const char *post_data) {
+    cJSON *root = post_data && post_data[0] ? cJSON_Parse(post_data) : NULL;
+    if (post_data && post_data[0] && !root)
+        return make_json_error("invalid JSON");
+
+    pthread_mutex_lock(&sched_lock);
+    struct maint_schedule s = schedule;
+    cJSON *j;
+    if (root) {
+        if ((j = cJSON_GetObjectItem(root, "enabled")) && cJSON_IsBool(j))
+            s.enabled = cJSON_IsTrue(j);
+        if ((j = cJSON_GetObjectItem(root, "maxChainDepth")) && cJSON_IsNumber(j))
+            s.max_depth = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "bandwidthMiB")) && cJSON_IsNumber(j))
+            s.bandwidth_mib = j->valuedouble > 0 ? (unsigned long)j->valuedouble : 0;
+        if ((j = cJSON_GetObjectItem(root, "windowStartHour")) && cJSON_IsNumber(j))
+            s.start_hour = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "windowEndHour")) && cJSON_IsNumber(j))
+            s.end_hour = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "trim")) && cJSON_IsBool(j))
+            s.trim = cJSON_IsTrue(j);
+    }
+    cJSON_Delete(root);
+
+    if (s.max_depth < 0 || s.bandwidth_mib == 0 ||
+        s.start_hour < 0 || s.start_hour > 23 || s.end_hour < 0 || s.end_hour > 23 ||
+        s.start_hour == s.end_hour) {
+        pthread_mutex_unlock(&sched_lock);
+        return make_json_error("invalid schedule (hours 0-23, start != end, bandwidthMiB > 0)");
+    }
+    schedule = s;
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddItemToObject(resp, "schedule", schedule_to_json(&schedule));
+    int enabled = schedule.enabled;
+    pthread_mutex_unlock(&sched_lock);
+
+    if (enabled)
+        pthread_once(&sched_once, start_scheduler);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
@@ -0,0 +1,36 @@
+// maintenance_handler.h
+#ifndef MAINTENANCE_HANDLER_H
+#define MAINTENANCE_HANDLER_H
+
+/* Nombre max de jobs de maintenance gardés en mémoire (actifs + terminés) */
+#define MAX_MAINT_JOBS 128
+
+/* Débit par défaut des block jobs (MiB/s) : la prod garde la main sur le NFS */
+#define MAINT_BANDWIDTH_DEFAULT_MIB 50
+
+/* Période du planificateur (s) */
+#define MAINT_SCHED_TICK_S 600
+
+/*
+ * Lance une opération de maintenance des disques qcow2 d'une VM active :
+ *   "pull"   : virDomainBlockPull, recopie la chaîne de backing dans l'overlay
+ *   "commit" : virDomainBlockCommit actif, fusionne l'overlay dans son backing
+ *              (possédé par la VM uniquement) puis pivote
+ *   "trim"   : virDomainFSTrim via l'agent invité, rend les blocs libres
+ * Un job par disque ; la progression est suivie avec /blockjobstatus.
+ */
+char *handle_blockmaint(const char *post_data);
+
+/* Progression (virDomainGetBlockJobInfo) d'un job ou de tous les jobs */
+char *handle_blockjobstatus(const char *post_data);
+
+/* Change le débit d'un job en cours (virDomainBlockJobSetSpeed) */
+char *handle_blockjobspeed(const char *post_data);
+
+/* Annule un job en attente ou en cours (virDomainBlockJobAbort) */
+char *handle_blockjobcancel(const char *post_data);
+
+/* Planification nocturne : aplatit les chaînes trop longues, trim des invités */
+char *handle_blockmaintschedule(const char *post_data);
+
+#endif
@@ -1,19 +1,71 @@
 // migratevm_handler.c
 #include "migratevm_handler.h"
+#include "../../libvirt-utils.h"
+#include "../placement/placement.h"
+#include "../inventory/inventory.h"
+#define LOG_COMPONENT "migratevm"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
 #include <libvirt/libvirt.h>
 #include <libvirt/virterror.h>
 #include <cjson/cJSON.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Nombre max de jobs de migration gardés en mémoire (actifs + terminés) */
+#define MAX_MIGRATION_JOBS 64
+
+/* Intervalle d'échantillonnage de virDomainGetJobStats (ms) */
+#define MIGRATION_SAMPLE_INTERVAL_MS 1000
+
+/* Dernier échantillon de progression lu via virDomainGetJobStats */
+struct migration_progress {
+    unsigned long long time_elapsed_ms;
+    unsigned long long time_remaining_ms;
+    unsigned long long data_total;
+    unsigned long long data_processed;
+    unsigned long long data_remaining;
+    unsigned long long memory_bps;
+    unsigned long long dirty_rate_bps;
+    unsigned long long iteration;
+    unsigned long long expected_downtime_ms;
+    time_t sampled_at;
+};
+
+struct migration_job {
+    enum migration_job_state state;
+    int    id;
+    char   vm_name[256];
+    char   src_uri[512];
+    char   dest_uri[512];
+    char   message[256];
+    char   req_id[LOG_REQUEST_ID_LEN];  /* requête HTTP à l'origine du job */
+    time_t started_at;
+    time_t finished_at;
+    int    cancel_requested;
+    int    migrate_done;          /* virDomainMigrate3 a rendu la main */
+    int    downtime_applied;      /* max downtime déjà poussé à l'hyperviseur */
+    int    postcopy_started;      /* virDomainMigrateStartPostCopy déjà appelé */
+    virDomainPtr dom;             /* domaine source, valide tant que le job tourne */
+    struct migration_profile profile;
+    struct migration_progress progress;
+};
+
+static struct migration_job jobs[MAX_MIGRATION_JOBS];
+static int next_job_id = 1;
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void log_libvirt_error(const char *prefix) {
     virErrorPtr err = virGetLastError();
     if (err) {
-        fprintf(stderr, "[%s] Libvirt error: %s (code=%d domain=%d)\n",
-                prefix, err->message, err->code, err->domain);
+        LOG_ERROR("[%s] Libvirt error: %s (code=%d domain=%d)",
+                  prefix, err->message, err->code, err->domain);
     } else {
-        fprintf(stderr, "[%s] Unknown libvirt error\n", prefix);
+        LOG_ERROR("[%s] Unknown libvirt error", prefix);
     }
 }
 
@@ -26,15 +78,637 @@ static char *make_json_error(const char *msg) {
     return out;
 }
 
-static char *make_json_ok(const char *vmName, const char *destUri) {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "status", "ok");
-    cJSON_AddStringToObject(root, "vmName", vmName);
-    cJSON_AddStringToObject(root, "destUri", destUri);
-    cJSON_AddStringToObject(root, "message", "Migration completed successfully");
-    char *out = cJSON_PrintUnformatted(root);
+/* --------------------------------------------------------------------------
+ * Profils de migration
+ * -------------------------------------------------------------------------- */
+
+int migration_profile_preset(const char *name, struct migration_profile *out) {
+    memset(out, 0, sizeof(*out));
+
+    if (!name || strcmp(name, "plain") == 0) {
+        // migration live classique
+    } else if (strcmp(name, "compressed") == 0) {
+        snprintf(out->compression, sizeof(out->compression), "xbzrle");
+        out->auto_converge = 1;
+    } else if (strcmp(name, "multifd") == 0) {
+        out->parallel_connections = 4;
+    } else if (strcmp(name, "postcopy") == 0) {
+        out->postcopy = 1;
+        out->postcopy_after_iterations = 3;
+    } else {
+        return -1;
+    }
+
+    snprintf(out->name, sizeof(out->name), "%s", name ? name : "plain");
+    return 0;
+}
+
+int migration_profile_from_json(const cJSON *item, struct migration_profile *out,
+                                char *err, size_t errlen) {
+    if (!item || cJSON_IsNull(item))
+        return migration_profile_preset("plain", out);
+
+    if (cJSON_IsString(item)) {
+        if (migration_profile_preset(item->valuestring, out) < 0) {
+            snprintf(err, errlen, "unknown migration profile '%s'", item->valuestring);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (!cJSON_IsObject(item)) {
+        snprintf(err, errlen, "profile must be a preset name or an object");
+        return -1;
+    }
+
+    cJSON *j = cJSON_GetObjectItem(item, "preset");
+    const char *preset = cJSON_IsString(j) ? j->valuestring : "plain";
+    if (migration_profile_preset(preset, out) < 0) {
+        snprintf(err, errlen, "unknown migration profile '%s'", preset);
+        return -1;
+    }
+    if (!cJSON_IsString(j))
+        snprintf(out->name, sizeof(out->name), "custom");
+
+    if ((j = cJSON_GetObjectItem(item, "parallelConnections")) && cJSON_IsNumber(j))
+        out->parallel_connections = j->valueint;
+    if ((j = cJSON_GetObjectItem(item, "compression")) && cJSON_IsString(j))
+        snprintf(out->compression, sizeof(out->compression), "%s", j->valuestring);
+    if ((j = cJSON_GetObjectItem(item, "bandwidth")) && cJSON_IsNumber(j) && j->valuedouble > 0)
+        out->bandwidth_mib = (unsigned long long)j->valuedouble;
+    if ((j = cJSON_GetObjectItem(item, "maxDowntime")) && cJSON_IsNumber(j) && j->valuedouble > 0)
+        out->max_downtime_ms = (unsigned long long)j->valuedouble;
+    if ((j = cJSON_GetObjectItem(item, "autoConverge")) && cJSON_IsBool(j))
+        out->auto_converge = cJSON_IsTrue(j);
+    if ((j = cJSON_GetObjectItem(item, "postcopy")) && cJSON_IsBool(j))
+        out->postcopy = cJSON_IsTrue(j);
+    if ((j = cJSON_GetObjectItem(item, "postcopyAfterIterations")) && cJSON_IsNumber(j))
+        out->postcopy_after_iterations = j->valueint;
+    if ((j = cJSON_GetObjectItem(item, "peer2peer")) && cJSON_IsBool(j))
+        out->peer2peer = cJSON_IsTrue(j);
+
+    /* Validation */
+    if (out->parallel_connections < 0 || out->parallel_connections > 64) {
+        snprintf(err, errlen, "parallelConnections must be between 0 and 64");
+        return -1;
+    }
+    if (out->compression[0] &&
+        strcmp(out->compression, "xbzrle") != 0 &&
+        strcmp(out->compression, "zstd") != 0) {
+        snprintf(err, errlen, "compression must be 'xbzrle' or 'zstd'");
+        return -1;
+    }
+    if (strcmp(out->compression, "zstd") == 0 && out->parallel_connections == 0) {
+        snprintf(err, errlen, "zstd compression requires parallelConnections");
+        return -1;
+    }
+    if (out->postcopy_after_iterations < 0) {
+        snprintf(err, errlen, "postcopyAfterIterations must be >= 0");
+        return -1;
+    }
+    if (out->postcopy_after_iterations > 0)
+        out->postcopy = 1;
+
+    return 0;
+}
+
+static cJSON *profile_to_json(const struct migration_profile *profile) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "name", profile->name);
+    cJSON_AddNumberToObject(obj, "parallelConnections", profile->parallel_connections);
+    cJSON_AddStringToObject(obj, "compression", profile->compression);
+    cJSON_AddNumberToObject(obj, "bandwidth", (double)profile->bandwidth_mib);
+    cJSON_AddNumberToObject(obj, "maxDowntime", (double)profile->max_downtime_ms);
+    cJSON_AddBoolToObject(obj, "autoConverge", profile->auto_converge);
+    cJSON_AddBoolToObject(obj, "postcopy", profile->postcopy);
+    cJSON_AddNumberToObject(obj, "postcopyAfterIterations", profile->postcopy_after_iterations);
+    cJSON_AddBoolToObject(obj, "peer2peer", profile->peer2peer);
+    return obj;
+}
+
+/* Traduit le profil en flags + paramètres typés pour virDomainMigrate3 */
+static int build_migrate_params(const struct migration_profile *profile,
+                                virTypedParameterPtr *params, int *nparams,
+                                unsigned int *flags) {
+    int maxparams = 0;
+
+    // Flags de base (live + persiste sur dest + undefine sur source).
+    *flags = VIR_MIGRATE_LIVE |
+             VIR_MIGRATE_PERSIST_DEST |
+             VIR_MIGRATE_UNDEFINE_SOURCE;
+
+    if (profile->peer2peer)
+        *flags |= VIR_MIGRATE_PEER2PEER;
+
+    if (profile->bandwidth_mib > 0 &&
+        virTypedParamsAddULLong(params, nparams, &maxparams,
+                                VIR_MIGRATE_PARAM_BANDWIDTH, profile->bandwidth_mib) < 0)
+        return -1;
+
+    if (profile->parallel_connections > 0) {
+        *flags |= VIR_MIGRATE_PARALLEL;
+        if (virTypedParamsAddInt(params, nparams, &maxparams,
+                                 VIR_MIGRATE_PARAM_PARALLEL_CONNECTIONS,
+                                 profile->parallel_connections) < 0)
+            return -1;
+    }
+
+    if (profile->compression[0]) {
+        *flags |= VIR_MIGRATE_COMPRESSED;
+        if (virTypedParamsAddString(params, nparams, &maxparams,
+                                    VIR_MIGRATE_PARAM_COMPRESSION, profile->compression) < 0)
+            return -1;
+    }
+
+    if (profile->auto_converge)
+        *flags |= VIR_MIGRATE_AUTO_CONVERGE;
+
+    if (profile->postcopy)
+        *flags |= VIR_MIGRATE_POSTCOPY;
+
+    return 0;
+}
+
+static const char *job_state_name(enum migration_job_state state) {
+    switch (state) {
+    case MIGRATION_JOB_STARTING:  return "starting";
+    case MIGRATION_JOB_RUNNING:   return "running";
+    case MIGRATION_JOB_COMPLETED: return "completed";
+    case MIGRATION_JOB_FAILED:    return "failed";
+    case MIGRATION_JOB_CANCELLED: return "cancelled";
+    default:                      return "unknown";
+    }
+}
+
+static int job_is_active(const struct migration_job *job) {
+    return job->state == MIGRATION_JOB_STARTING ||
+           job->state == MIGRATION_JOB_RUNNING;
+}
+
+/* Retrouve un job par id (jobs_lock doit être tenu) */
+static struct migration_job *find_job(int id) {
+    for (int i = 0; i < MAX_MIGRATION_JOBS; i++) {
+        if (jobs[i].state != MIGRATION_JOB_FREE && jobs[i].id == id)
+            return &jobs[i];
+    }
+    return NULL;
+}
+
+/*
+ * Réserve un slot : un slot libre sinon le job terminé le plus ancien.
+ * Retourne NULL si tous les slots sont occupés par des jobs actifs.
+ * (jobs_lock doit être tenu)
+ */
+static struct migration_job *alloc_job(void) {
+    struct migration_job *oldest = NULL;
+    for (int i = 0; i < MAX_MIGRATION_JOBS; i++) {
+        if (jobs[i].state == MIGRATION_JOB_FREE)
+            return &jobs[i];
+        if (!job_is_active(&jobs[i]) &&
+            (!oldest || jobs[i].finished_at < oldest->finished_at))
+            oldest = &jobs[i];
+    }
+    return oldest;
+}
+
+static void finish_job(struct migration_job *job, enum migration_job_state state,
+                       const char *message) {
+    pthread_mutex_lock(&jobs_lock);
+    job->state = state;
+    job->finished_at = time(NULL);
+    snprintf(job->message, sizeof(job->message), "%s", message);
+    pthread_mutex_unlock(&jobs_lock);
+}
+
+/* --------------------------------------------------------------------------
+ * Échantillonnage de la progression
+ * -------------------------------------------------------------------------- */
+
+static void sample_job_stats(struct migration_job *job, virDomainPtr dom) {
+    int type = VIR_DOMAIN_JOB_NONE;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+
+    if (TRACE_VIRT(virDomainGetJobStats, dom, &type, &params, &nparams, 0) < 0)
+        return;
+
+    if (type == VIR_DOMAIN_JOB_NONE) {
+        virTypedParamsFree(params, nparams);
+        return;
+    }
+
+    struct migration_progress p;
+    memset(&p, 0, sizeof(p));
+    unsigned long long dirty_pages = 0, page_size = 0;
+
+    virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_TIME_ELAPSED, &p.time_elapsed_ms);
+    virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_TIME_REMAINING, &p.time_remaining_ms);
+    virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_DATA_TOTAL, &p.data_total);
+    virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_DATA_PROCESSED, &p.data_processed);
+    virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_DATA_REMAINING, &p.data_remaining);
+    virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_MEMORY_BPS, &p.memory_bps);
+    virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_MEMORY_ITERATION, &p.iteration);
+    virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_DOWNTIME, &p.expected_downtime_ms);
+    virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_MEMORY_DIRTY_RATE, &dirty_pages);
+    virTypedParamsGetULLong(params, nparams, VIR_DOMAIN_JOB_MEMORY_PAGE_SIZE, &page_size);
+    virTypedParamsFree(params, nparams);
+
+    /* Le dirty rate est exprimé en pages/s côté libvirt */
+    p.dirty_rate_bps = dirty_pages * (page_size ? page_size : 4096);
+    p.sampled_at = time(NULL);
+
+    pthread_mutex_lock(&jobs_lock);
+    job->progress = p;
+    pthread_mutex_unlock(&jobs_lock);
+}
+
+/*
+ * Réglages qui ne peuvent être poussés qu'une fois le job actif côté
+ * hyperviseur : max downtime et bascule en postcopy après N itérations.
+ */
+static void apply_runtime_tuning(struct migration_job *job, virDomainPtr dom) {
+    const struct migration_profile *profile = &job->profile;
+
+    pthread_mutex_lock(&jobs_lock);
+    unsigned long long iteration = job->progress.iteration;
+    int job_active = job->progress.sampled_at != 0;
+    int need_downtime = profile->max_downtime_ms > 0 && !job->downtime_applied;
+    int need_postcopy = profile->postcopy_after_iterations > 0 &&
+                        !job->postcopy_started &&
+                        iteration >= (unsigned long long)profile->postcopy_after_iterations;
+    pthread_mutex_unlock(&jobs_lock);
+
+    if (!job_active)
+        return;
+
+    if (need_downtime) {
+        /* Échec (job pas encore prêt côté QEMU) : réessayé au prochain relevé */
+        if (TRACE_VIRT(virDomainMigrateSetMaxDowntime, dom, profile->max_downtime_ms, 0) < 0) {
+            log_libvirt_error("virDomainMigrateSetMaxDowntime");
+        } else {
+            pthread_mutex_lock(&jobs_lock);
+            job->downtime_applied = 1;
+            pthread_mutex_unlock(&jobs_lock);
+        }
+    }
+
+    if (need_postcopy) {
+        LOG_INFO("job %d: iteration %llu, switching to postcopy",
+                 job->id, iteration);
+        if (TRACE_VIRT(virDomainMigrateStartPostCopy, dom, 0) < 0)
+            log_libvirt_error("virDomainMigrateStartPostCopy");
+        pthread_mutex_lock(&jobs_lock);
+        job->postcopy_started = 1;
+        pthread_mutex_unlock(&jobs_lock);
+    }
+}
+
+/* Tourne à côté de virDomainMigrate3 tant que la migration n'a pas rendu la main */
+static void *migration_monitor_thread(void *arg) {
+    struct migration_job *job = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&jobs_lock);
+        int done = job->migrate_done;
+        virDomainPtr dom = job->dom;
+        pthread_mutex_unlock(&jobs_lock);
+
+        if (done || !dom)
+            break;
+
+        sample_job_stats(job, dom);
+        apply_runtime_tuning(job, dom);
+        usleep(MIGRATION_SAMPLE_INTERVAL_MS * 1000);
+    }
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * Thread de migration
+ * -------------------------------------------------------------------------- */
+
+static void *migration_job_thread(void *arg) {
+    struct migration_job *job = arg;
+    log_set_request_id(job->req_id);
+
+    // Connexion source
+    virConnectPtr src_conn = TRACE_VIRT(virConnectOpen, job->src_uri);
+    if (!src_conn) {
+        log_libvirt_error("virConnectOpen(src)");
+        finish_job(job, MIGRATION_JOB_FAILED, "cannot connect to source hypervisor");
+        return NULL;
+    }
+
+    // Domaine sur la source
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, src_conn, job->vm_name);
+    if (!dom) {
+        log_libvirt_error("virDomainLookupByName");
+        virConnectClose(src_conn);
+        finish_job(job, MIGRATION_JOB_FAILED, "VM not found on source hypervisor");
+        return NULL;
+    }
+
+    // Connexion destination (inutile en peer2peer : libvirtd source s'en charge)
+    virConnectPtr dest_conn = NULL;
+    if (!job->profile.peer2peer) {
+        dest_conn = TRACE_VIRT(virConnectOpen, job->dest_uri);
+        if (!dest_conn) {
+            log_libvirt_error("virConnectOpen(dest)");
+            virDomainFree(dom);
+            virConnectClose(src_conn);
+            finish_job(job, MIGRATION_JOB_FAILED, "cannot connect to destination hypervisor");
+            return NULL;
+        }
+    }
+
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    unsigned int flags = 0;
+    if (build_migrate_params(&job->profile, &params, &nparams, &flags) < 0) {
+        log_libvirt_error("virTypedParamsAdd");
+        virTypedParamsFree(params, nparams);
+        virDomainFree(dom);
+        if (dest_conn)
+            virConnectClose(dest_conn);
+        virConnectClose(src_conn);
+        finish_job(job, MIGRATION_JOB_FAILED, "cannot build migration parameters");
+        return NULL;
+    }
+
+    pthread_mutex_lock(&jobs_lock);
+    if (job->cancel_requested) {
+        // Annulé avant même le lancement de la migration
+        pthread_mutex_unlock(&jobs_lock);
+        virTypedParamsFree(params, nparams);
+        virDomainFree(dom);
+        if (dest_conn)
+            virConnectClose(dest_conn);
+        virConnectClose(src_conn);
+        finish_job(job, MIGRATION_JOB_CANCELLED, "Migration cancelled");
+        return NULL;
+    }
+    job->dom = dom;
+    job->state = MIGRATION_JOB_RUNNING;
+    pthread_mutex_unlock(&jobs_lock);
+
+    pthread_t monitor;
+    int monitor_started = pthread_create(&monitor, NULL, migration_monitor_thread, job) == 0;
+
+    LOG_INFO("job %d: migrating '%s' from '%s' to '%s' (profile=%s, flags=%u)",
+             job->id, job->vm_name, job->src_uri, job->dest_uri, job->profile.name, flags);
+
+    int ok;
+    if (job->profile.peer2peer) {
+        ok = TRACE_VIRT(virDomainMigrateToURI3, dom, job->dest_uri, params, nparams, flags) == 0;
+    } else {
+        virDomainPtr migrated_dom = TRACE_VIRT(virDomainMigrate3, dom, dest_conn, params, nparams, flags);
+        ok = migrated_dom != NULL;
+        if (migrated_dom)
+            virDomainFree(migrated_dom);
+    }
+    virTypedParamsFree(params, nparams);
+
+    if (!ok)
+        log_libvirt_error("virDomainMigrate3");
+
+    pthread_mutex_lock(&jobs_lock);
+    job->migrate_done = 1;
+    int cancelled = job->cancel_requested;
+    pthread_mutex_unlock(&jobs_lock);
+
+    if (monitor_started)
+        pthread_join(monitor, NULL);
+
+    pthread_mutex_lock(&jobs_lock);
+    job->dom = NULL;
+    pthread_mutex_unlock(&jobs_lock);
+
+    if (ok) {
+        LOG_INFO("job %d: migration of %s to %s successful",
+                 job->id, job->vm_name, job->dest_uri);
+        inventory_invalidate(job->src_uri);
+        inventory_invalidate(job->dest_uri);
+        finish_job(job, MIGRATION_JOB_COMPLETED, "Migration completed successfully");
+    } else if (cancelled) {
+        finish_job(job, MIGRATION_JOB_CANCELLED, "Migration cancelled");
+    } else {
+        virErrorPtr err = virGetLastError();
+        finish_job(job, MIGRATION_JOB_FAILED,
+                   err && err->message ? err->message : "migration failed");
+    }
+
+    virDomainFree(dom);
+    if (dest_conn)
+        virConnectClose(dest_conn);
+    virConnectClose(src_conn);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * Sérialisation JSON d'un job
+ * -------------------------------------------------------------------------- */
+
+static cJSON *job_to_json(const struct migration_job *job) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "jobId", job->id);
+    cJSON_AddStringToObject(obj, "vmName", job->vm_name);
+    cJSON_AddStringToObject(obj, "srcUri", job->src_uri);
+    cJSON_AddStringToObject(obj, "destUri", job->dest_uri);
+    cJSON_AddStringToObject(obj, "state", job_state_name(job->state));
+    cJSON_AddStringToObject(obj, "message", job->message);
+    cJSON_AddNumberToObject(obj, "startedAt", (double)job->started_at);
+    if (job->finished_at)
+        cJSON_AddNumberToObject(obj, "finishedAt", (double)job->finished_at);
+    cJSON_AddItemToObject(obj, "profile", profile_to_json(&job->profile));
+    cJSON_AddBoolToObject(obj, "postcopyActive", job->postcopy_started);
+
+    const struct migration_progress *p = &job->progress;
+    cJSON *prog = cJSON_CreateObject();
+    double percent = 0;
+    if (job->state == MIGRATION_JOB_COMPLETED)
+        percent = 100;
+    else if (p->data_total > 0)
+        percent = 100.0 * (double)p->data_processed / (double)p->data_total;
+    cJSON_AddNumberToObject(prog, "percent", percent);
+    cJSON_AddNumberToObject(prog, "timeElapsedMs", (double)p->time_elapsed_ms);
+    cJSON_AddNumberToObject(prog, "timeRemainingMs", (double)p->time_remaining_ms);
+    cJSON_AddNumberToObject(prog, "dataTotal", (double)p->data_total);
+    cJSON_AddNumberToObject(prog, "dataProcessed", (double)p->data_processed);
+    cJSON_AddNumberToObject(prog, "dataRemaining", (double)p->data_remaining);
+    cJSON_AddNumberToObject(prog, "memoryBps", (double)p->memory_bps);
+    cJSON_AddNumberToObject(prog, "dirtyRateBps", (double)p->dirty_rate_bps);
+    cJSON_AddNumberToObject(prog, "iteration", (double)p->iteration);
+    cJSON_AddNumberToObject(prog, "expectedDowntimeMs", (double)p->expected_downtime_ms);
+    cJSON_AddNumberToObject(prog, "sampledAt", (double)p->sampled_at);
+    cJSON_AddItemToObject(obj, "progress", prog);
+    return obj;
+}
+
+/* Extrait "jobId" du body ; retourne -1 si absent */
+static int parse_job_id(const char *post_data) {
+    if (!post_data)
+        return -1;
+    cJSON *root = cJSON_Parse(post_data);
+    if (!root)
+        return -1;
+    cJSON *id_item = cJSON_GetObjectItem(root, "jobId");
+    int id = cJSON_IsNumber(id_item) ? id_item->valueint : -1;
     cJSON_Delete(root);
-    return out;
+    return id;
+}
+
+/*
+ * Demande au service de placement un hôte pouvant accueillir la VM
+ * (taille lue sur la source, hôte source exclu).
+ */
+static int pick_destination(const char *src_uri, const char *vm_name, const char *strategy,
+                            char *out, size_t outlen, char *err, size_t errlen) {
+    virConnectPtr conn = libvirt_pool_open(src_uri);
+    if (!conn) {
+        log_libvirt_error("virConnectOpen(src)");
+        snprintf(err, errlen, "cannot connect to source hypervisor");
+        return -1;
+    }
+
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, vm_name);
+    virDomainInfo info;
+    if (!dom || TRACE_VIRT(virDomainGetInfo, dom, &info) < 0) {
+        log_libvirt_error("virDomainGetInfo");
+        if (dom)
+            virDomainFree(dom);
+        virConnectClose(conn);
+        snprintf(err, errlen, "VM not found on source hypervisor");
+        return -1;
+    }
+    virDomainFree(dom);
+    virConnectClose(conn);
+
+    if (placement_best_host(strategy, info.memory / 1024, info.nrVirtCpu, src_uri,
+                            out, outlen) < 0) {
+        snprintf(err, errlen, "no registered host can receive this VM");
+        return -1;
+    }
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * API interne (utilisée aussi par l'évacuation d'hôte)
+ * -------------------------------------------------------------------------- */
+
+int migration_job_start(const char *src_uri, const char *vm_name,
+                        const char *dest_uri, const struct migration_profile *profile,
+                        char *err, size_t errlen) {
+    pthread_mutex_lock(&jobs_lock);
+
+    // Une seule migration à la fois par VM
+    for (int i = 0; i < MAX_MIGRATION_JOBS; i++) {
+        if (job_is_active(&jobs[i]) &&
+            strcmp(jobs[i].vm_name, vm_name) == 0 &&
+            strcmp(jobs[i].src_uri, src_uri) == 0) {
+            pthread_mutex_unlock(&jobs_lock);
+            snprintf(err, errlen, "a migration is already running for this VM");
+            return -1;
+        }
+    }
+
+    struct migration_job *job = alloc_job();
+    if (!job) {
+        pthread_mutex_unlock(&jobs_lock);
+        snprintf(err, errlen, "too many migrations in progress");
+        return -1;
+    }
+
+    memset(job, 0, sizeof(*job));
+    job->id = next_job_id++;
+    job->state = MIGRATION_JOB_STARTING;
+    snprintf(job->req_id, sizeof(job->req_id), "%s", log_request_id());
+    job->started_at = time(NULL);
+    snprintf(job->vm_name, sizeof(job->vm_name), "%s", vm_name);
+    snprintf(job->src_uri, sizeof(job->src_uri), "%s", src_uri);
+    snprintf(job->dest_uri, sizeof(job->dest_uri), "%s", dest_uri);
+    snprintf(job->message, sizeof(job->message), "Migration started");
+    job->profile = *profile;
+
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&tid, &attr, migration_job_thread, job);
+    pthread_attr_destroy(&attr);
+
+    if (rc != 0) {
+        job->state = MIGRATION_JOB_FREE;
+        pthread_mutex_unlock(&jobs_lock);
+        snprintf(err, errlen, "cannot start migration thread");
+        return -1;
+    }
+
+    int id = job->id;
+    pthread_mutex_unlock(&jobs_lock);
+    return id;
+}
+
+int migration_job_get(int id, struct migration_job_snapshot *out) {
+    pthread_mutex_lock(&jobs_lock);
+    struct migration_job *job = find_job(id);
+    if (!job) {
+        pthread_mutex_unlock(&jobs_lock);
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->id = job->id;
+    out->state = job->state;
+    snprintf(out->message, sizeof(out->message), "%s", job->message);
+    out->data_total = job->progress.data_total;
+    out->data_remaining = job->progress.data_remaining;
+    if (job->state == MIGRATION_JOB_COMPLETED)
+        out->percent = 100;
+    else if (job->progress.data_total > 0)
+        out->percent = 100.0 * (double)job->progress.data_processed /
+                       (double)job->progress.data_total;
+    pthread_mutex_unlock(&jobs_lock);
+    return 0;
+}
+
+int migration_job_cancel(int id, char *err, size_t errlen) {
+    pthread_mutex_lock(&jobs_lock);
+    struct migration_job *job = find_job(id);
+    if (!job) {
+        pthread_mutex_unlock(&jobs_lock);
+        snprintf(err, errlen, "unknown migration job");
+        return -1;
+    }
+    if (!job_is_active(job)) {
+        pthread_mutex_unlock(&jobs_lock);
+        snprintf(err, errlen, "migration job is not running");
+        return -1;
+    }
+
+    job->cancel_requested = 1;
+    virDomainPtr dom = job->dom;
+    if (dom)
+        virDomainRef(dom);
+    pthread_mutex_unlock(&jobs_lock);
+
+    // Pas encore de domaine : le thread verra cancel_requested avant de migrer
+    if (dom) {
+        LOG_WARN("job %d: aborting migration", id);
+        int rc = TRACE_VIRT(virDomainAbortJob, dom);
+        if (rc < 0)
+            log_libvirt_error("virDomainAbortJob");
+        virDomainFree(dom);
+        if (rc < 0) {
+            /* La migration continue : un échec ultérieur garde sa vraie cause */
+            pthread_mutex_lock(&jobs_lock);
+            if ((job = find_job(id)) != NULL && job_is_active(job))
+                job->cancel_requested = 0;
+            pthread_mutex_unlock(&jobs_lock);
+            snprintf(err, errlen, "failed to abort migration");
+            return -1;
+        }
+    }
+    return 0;
 }
 
 /**
@@ -43,12 +717,28 @@ static char *make_json_ok(const char *vmName, const char *destUri) {
  * {
  *   "uri": "qemu:///system",             // source hypervisor (déjà utilisé partout)
  *   "vmName": "debian13",                // VM à migrer
- *   "destUri": "qemu+ssh://user@IP/system"  // hyperviseur de destination
+ *   "destUri": "qemu+ssh://user@IP/system", // hyperviseur de destination, ou "auto"
+ *   "placementStrategy": "least-loaded", // optionnel avec "auto" : ou "binpack"
+ *   "profile": "multifd"                 // optionnel : preset ou objet
+ * }
+ *
+ * "profile" objet (tous les champs optionnels) :
+ * {
+ *   "preset": "compressed",              // base : plain | compressed | multifd | postcopy
+ *   "parallelConnections": 4,            // multifd
+ *   "compression": "zstd",               // xbzrle | zstd (zstd => parallelConnections)
+ *   "bandwidth": 500,                    // MiB/s
+ *   "maxDowntime": 300,                  // ms
+ *   "autoConverge": true,
+ *   "postcopy": true,
+ *   "postcopyAfterIterations": 3,        // bascule auto en postcopy
+ *   "peer2peer": true                    // VIR_MIGRATE_PEER2PEER
  * }
+ *
+ * La migration tourne en arrière-plan : la réponse contient un "jobId"
+ * à suivre avec /migratestatus et à annuler avec /migratecancel.
  */
 char *handle_migratevm(const char *post_data) {
-    fprintf(stderr, "[handle_migratevm] BODY=%s\n", post_data ? post_data : "(null)");
-
     if (!post_data)
         return make_json_error("missing body");
 
@@ -59,6 +749,7 @@ char *handle_migratevm(const char *post_data) {
     cJSON *uri_item     = cJSON_GetObjectItem(root, "uri");
     cJSON *vm_item      = cJSON_GetObjectItem(root, "vmName");
     cJSON *dest_item    = cJSON_GetObjectItem(root, "destUri");
+    cJSON *strat_item   = cJSON_GetObjectItem(root, "placementStrategy");
 
     if (!cJSON_IsString(uri_item) ||
         !cJSON_IsString(vm_item) ||
@@ -71,62 +762,96 @@ char *handle_migratevm(const char *post_data) {
     const char *vmName  = vm_item->valuestring;
     const char *destUri = dest_item->valuestring;
 
-    // Connexion source
-    virConnectPtr src_conn = virConnectOpen(srcUri);
-    if (!src_conn) {
-        log_libvirt_error("virConnectOpen(src)");
+    struct migration_profile profile;
+    char err[128];
+    if (migration_profile_from_json(cJSON_GetObjectItem(root, "profile"),
+                                    &profile, err, sizeof(err)) < 0) {
         cJSON_Delete(root);
-        return make_json_error("cannot connect to source hypervisor");
+        return make_json_error(err);
     }
 
-    // Domaine sur la source
-    virDomainPtr dom = virDomainLookupByName(src_conn, vmName);
-    if (!dom) {
-        log_libvirt_error("virDomainLookupByName");
-        virConnectClose(src_conn);
-        cJSON_Delete(root);
-        return make_json_error("VM not found on source hypervisor");
+    // Destination choisie par le service de placement
+    char placed_uri[512];
+    if (strcmp(destUri, "auto") == 0) {
+        const char *strategy = cJSON_IsString(strat_item) ? strat_item->valuestring : NULL;
+        if (pick_destination(srcUri, vmName, strategy, placed_uri, sizeof(placed_uri),
+                             err, sizeof(err)) < 0) {
+            cJSON_Delete(root);
+            return make_json_error(err);
+        }
+        destUri = placed_uri;
+        LOG_INFO("placement picked %s for '%s'", destUri, vmName);
     }
 
-    // Connexion destination
-    virConnectPtr dest_conn = virConnectOpen(destUri);
-    if (!dest_conn) {
-        log_libvirt_error("virConnectOpen(dest)");
-        virDomainFree(dom);
-        virConnectClose(src_conn);
-        cJSON_Delete(root);
-        return make_json_error("cannot connect to destination hypervisor");
-    }
+    int id = migration_job_start(srcUri, vmName, destUri, &profile, err, sizeof(err));
+    cJSON_Delete(root);
+    if (id < 0)
+        return make_json_error(err);
 
-    // Flags de migration (live + persiste sur dest + undefine sur source).
-    unsigned long flags = VIR_MIGRATE_LIVE |
-                          VIR_MIGRATE_PERSIST_DEST |
-                          VIR_MIGRATE_UNDEFINE_SOURCE;
+    pthread_mutex_lock(&jobs_lock);
+    struct migration_job *job = find_job(id);
+    cJSON *resp = job ? job_to_json(job) : cJSON_CreateObject();
+    pthread_mutex_unlock(&jobs_lock);
+    cJSON_AddStringToObject(resp, "status", "ok");
+    if (!job)
+        cJSON_AddNumberToObject(resp, "jobId", id);
 
-    fprintf(stderr, "[migratevm] Migrating '%s' from '%s' to '%s' (flags=%lu)\n",
-            vmName, srcUri, destUri, flags);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
 
-    virDomainPtr migrated_dom = virDomainMigrate(dom, dest_conn, flags,
-                                                 NULL,  // dname (nom sur dest, NULL => même nom)
-                                                 NULL,  // uri (transport), NULL => auto
-                                                 0);    // bandwidth, 0 => default
+/**
+ * POST /migratestatus
+ * BODY JSON: { "jobId": 3 }     // sans jobId : liste de tous les jobs connus
+ */
+char *handle_migratestatus(const char *post_data) {
+    int id = parse_job_id(post_data);
 
-    if (!migrated_dom) {
-        log_libvirt_error("virDomainMigrate");
-        virConnectClose(dest_conn);
-        virDomainFree(dom);
-        virConnectClose(src_conn);
-        cJSON_Delete(root);
-        return make_json_error("migration failed");
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+
+    pthread_mutex_lock(&jobs_lock);
+    if (id >= 0) {
+        struct migration_job *job = find_job(id);
+        if (!job) {
+            pthread_mutex_unlock(&jobs_lock);
+            cJSON_Delete(resp);
+            return make_json_error("unknown migration job");
+        }
+        cJSON_AddItemToObject(resp, "job", job_to_json(job));
+    } else {
+        cJSON *arr = cJSON_AddArrayToObject(resp, "jobs");
+        for (int i = 0; i < MAX_MIGRATION_JOBS; i++) {
+            if (jobs[i].state != MIGRATION_JOB_FREE)
+                cJSON_AddItemToArray(arr, job_to_json(&jobs[i]));
+        }
     }
+    pthread_mutex_unlock(&jobs_lock);
 
-    fprintf(stderr, "[migratevm] Migration of %s to %s successful\n", vmName, destUri);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
 
-    virDomainFree(migrated_dom);
-    virDomainFree(dom);
-    virConnectClose(dest_conn);
-    virConnectClose(src_conn);
-    cJSON_Delete(root);
+/**
+ * POST /migratecancel
+ * BODY JSON: { "jobId": 3 }
+ */
+char *handle_migratecancel(const char *post_data) {
+    int id = parse_job_id(post_data);
+    if (id < 0)
+        return make_json_error("jobId missing or invalid");
+
+    char err[128];
+    if (migration_job_cancel(id, err, sizeof(err)) < 0)
+        return make_json_error(err);
 
-    return make_json_ok(vmName, destUri);
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddNumberToObject(resp, "jobId", id);
+    cJSON_AddStringToObject(resp, "message", "Cancellation requested");
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
 }
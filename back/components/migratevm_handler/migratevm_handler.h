@@ -2,6 +2,73 @@
 #ifndef MIGRATEVM_HANDLER_H
 #define MIGRATEVM_HANDLER_H
 
+#include <stddef.h>
+#include <cjson/cJSON.h>
+
+/*
+ * Profil de migration, traduit en paramètres typés virDomainMigrate3.
+ * Tous les champs à 0 / "" => migration live classique.
+ */
+struct migration_profile {
+    char name[32];                      /* preset d'origine ("plain", "multifd", ...) */
+    int  parallel_connections;          /* multifd, 0 = un seul flux */
+    char compression[16];               /* "", "xbzrle" ou "zstd" (zstd => multifd) */
+    unsigned long long bandwidth_mib;   /* MiB/s, 0 = pas de limite */
+    unsigned long long max_downtime_ms; /* 0 = valeur par défaut de l'hyperviseur */
+    int  auto_converge;
+    int  postcopy;                      /* autorise le passage en postcopy */
+    int  postcopy_after_iterations;     /* bascule auto après N itérations, 0 = jamais */
+    int  peer2peer;                     /* libvirtd source parle directement à la dest */
+};
+
+/* Remplit un profil depuis un preset ("plain", "compressed", "multifd", "postcopy") */
+int migration_profile_preset(const char *name, struct migration_profile *out);
+
+/*
+ * Remplit un profil depuis le champ JSON "profile" : soit le nom d'un preset,
+ * soit un objet (avec éventuellement "preset" comme base). NULL => plain.
+ * Retourne 0, ou -1 avec un message dans err.
+ */
+int migration_profile_from_json(const cJSON *item, struct migration_profile *out,
+                                char *err, size_t errlen);
+
+enum migration_job_state {
+    MIGRATION_JOB_FREE = 0,
+    MIGRATION_JOB_STARTING,
+    MIGRATION_JOB_RUNNING,
+    MIGRATION_JOB_COMPLETED,
+    MIGRATION_JOB_FAILED,
+    MIGRATION_JOB_CANCELLED
+};
+
+/* Vue figée d'un job, pour les appelants internes */
+struct migration_job_snapshot {
+    int    id;
+    enum migration_job_state state;
+    char   message[256];
+    double percent;
+    unsigned long long data_total;
+    unsigned long long data_remaining;
+};
+
+/* Démarre un job de migration ; retourne son id, ou -1 avec un message dans err */
+int migration_job_start(const char *src_uri, const char *vm_name,
+                        const char *dest_uri, const struct migration_profile *profile,
+                        char *err, size_t errlen);
+
+/* Copie l'état courant d'un job ; -1 si l'id est inconnu (slot recyclé) */
+int migration_job_get(int id, struct migration_job_snapshot *out);
+
+/* Demande l'annulation (virDomainAbortJob) ; -1 avec un message dans err */
+int migration_job_cancel(int id, char *err, size_t errlen);
+
+/* Lance la migration en arrière-plan, retourne un jobId */
 char *handle_migratevm(const char *post_data);
 
-#endif  
\ No newline at end of file
+/* Progression (virDomainGetJobStats) d'un job ou de tous les jobs */
+char *handle_migratestatus(const char *post_data);
+
+/* Annule une migration en cours (virDomainAbortJob) */
+char *handle_migratecancel(const char *post_data);
+
+#endif
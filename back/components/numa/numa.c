@@ -0,0 +1,758 @@
+// numa.c
+#include "numa.h"
+#include "../../libvirt-utils.h"
+#include "../placement/placement.h"
+#define LOG_COMPONENT "numa"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Historique des déplacements gardé pour /numastatus */
+#define NUMA_MOVE_HISTORY 32
+
+/* Mémoire laissée libre sur le nœud cible lors d'un déplacement (KiB) */
+#define NUMA_MOVE_MARGIN_KIB (512ULL * 1024)
+
+struct numa_cell {
+    int    id;
+    unsigned long long memory_kib;
+    unsigned long long free_kib;
+    int    ncpus;
+    char   cpuset[512];
+};
+
+struct numa_topology {
+    int    ncells;
+    int    max_cpu;                     /* plus grand id de CPU + 1 */
+    struct numa_cell cells[MAX_NUMA_CELLS];
+    unsigned char cpumaps[MAX_NUMA_CELLS][VIR_CPU_MAPLEN(MAX_NUMA_CPUS)];
+};
+
+struct numa_config {
+    int    enabled;
+    int    interval_s;
+    int    imbalance_pct;
+    int    cooldown_s;
+};
+
+/* Mesure de charge d'une VM entre deux passages */
+struct numa_vm {
+    int    used;
+    char   uri[512];
+    char   uuid[VIR_UUID_STRING_BUFLEN];
+    char   name[256];
+    int    node;
+    unsigned long long cpu_time_ns;
+    struct timespec sampled;
+    double usage;                       /* cœurs hôte consommés */
+    time_t moved_at;
+    time_t updated_at;
+};
+
+struct numa_move {
+    time_t at;
+    char   uri[512];
+    char   vm_name[256];
+    int    from;
+    int    to;
+    int    automatic;
+    int    ok;
+};
+
+static struct numa_config config = {
+    .enabled = 0, .interval_s = 60, .imbalance_pct = 25, .cooldown_s = 600
+};
+static struct numa_vm vms[MAX_NUMA_VMS];
+static struct numa_move moves[NUMA_MOVE_HISTORY];
+static int next_move;
+static pthread_mutex_t numa_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  tuner_once = PTHREAD_ONCE_INIT;
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("%s: libvirt error (code=%d, domain=%d): %s",
+                  prefix, err->code, err->domain,
+                  err->message ? err->message : "(no message)");
+    } else {
+        LOG_ERROR("%s: unknown libvirt error", prefix);
+    }
+}
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static int appendf(char *buf, size_t len, size_t *off, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + *off, len - *off, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= len - *off)
+        return -1;
+    *off += (size_t)n;
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Topologie de l'hôte (capabilities, repli sur virNodeGetInfo)
+ * -------------------------------------------------------------------------- */
+
+/* Liste d'ids triés -> "0-7,16-23" */
+static void cpus_to_cpuset(const int *cpus, int n, char *out, size_t outlen) {
+    size_t off = 0;
+    out[0] = '\0';
+    for (int i = 0; i < n; ) {
+        int j = i;
+        while (j + 1 < n && cpus[j + 1] == cpus[j] + 1)
+            j++;
+        int rc = j > i ? appendf(out, outlen, &off, "%s%d-%d", off ? "," : "", cpus[i], cpus[j])
+                       : appendf(out, outlen, &off, "%s%d", off ? "," : "", cpus[i]);
+        if (rc < 0)
+            return;
+        i = j + 1;
+    }
+}
+
+static int cmp_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+static int parse_cell(const char *p, const char *end, struct numa_topology *t) {
+    struct numa_cell *cell = &t->cells[t->ncells];
+    int cpus[MAX_NUMA_CPUS];
+    int n = 0;
+
+    memset(cell, 0, sizeof(*cell));
+    memset(t->cpumaps[t->ncells], 0, sizeof(t->cpumaps[t->ncells]));
+    cell->id = atoi(p + strlen("<cell id='"));
+
+    const char *m = strstr(p, "<memory unit='KiB'>");
+    if (m && m < end)
+        cell->memory_kib = strtoull(m + strlen("<memory unit='KiB'>"), NULL, 10);
+
+    for (const char *c = p; (c = strstr(c, "<cpu id='")) != NULL && c < end; c++) {
+        int id = atoi(c + strlen("<cpu id='"));
+        if (id < 0 || id >= MAX_NUMA_CPUS || n >= MAX_NUMA_CPUS)
+            continue;
+        cpus[n++] = id;
+        VIR_USE_CPU(t->cpumaps[t->ncells], id);
+        if (id + 1 > t->max_cpu)
+            t->max_cpu = id + 1;
+    }
+    if (n == 0)
+        return -1;                      /* nœud mémoire seul : ignoré */
+    qsort(cpus, (size_t)n, sizeof(int), cmp_int);
+    cell->ncpus = n;
+    cpus_to_cpuset(cpus, n, cell->cpuset, sizeof(cell->cpuset));
+    t->ncells++;
+    return 0;
+}
+
+static int read_topology(virConnectPtr conn, struct numa_topology *t) {
+    memset(t, 0, sizeof(*t));
+    char *caps = TRACE_VIRT(virConnectGetCapabilities, conn);
+    if (caps) {
+        const char *topo = strstr(caps, "<topology>");
+        const char *topo_end = topo ? strstr(topo, "</topology>") : NULL;
+        for (const char *p = topo; p && topo_end && t->ncells < MAX_NUMA_CELLS &&
+                                   (p = strstr(p, "<cell id='")) != NULL && p < topo_end; ) {
+            const char *end = strstr(p, "</cell>");
+            if (!end)
+                break;
+            parse_cell(p, end, t);
+            p = end;
+        }
+        free(caps);
+    } else {
+        log_libvirt_error("virConnectGetCapabilities");
+    }
+
+    if (t->ncells == 0) {
+        /* Pas de topologie exploitable : un seul nœud, pas de pinning */
+        virNodeInfo info;
+        if (TRACE_VIRT(virNodeGetInfo, conn, &info) < 0)
+            return -1;
+        t->ncells = 1;
+        t->max_cpu = (int)info.cpus;
+        t->cells[0].ncpus = (int)info.cpus;
+        t->cells[0].memory_kib = info.memory;
+        snprintf(t->cells[0].cpuset, sizeof(t->cells[0].cpuset), "0-%u",
+                 info.cpus ? info.cpus - 1 : 0);
+    }
+
+    unsigned long long frees[MAX_NUMA_CELLS];
+    int nfree = TRACE_VIRT(virNodeGetCellsFreeMemory, conn, frees, 0, MAX_NUMA_CELLS);
+    for (int i = 0; i < t->ncells; i++) {
+        int id = t->cells[i].id;
+        t->cells[i].free_kib = id >= 0 && id < nfree ? frees[id] / 1024 : 0;
+    }
+    return 0;
+}
+
+static int cell_index(const struct numa_topology *t, int node) {
+    for (int i = 0; i < t->ncells; i++)
+        if (t->cells[i].id == node)
+            return i;
+    return -1;
+}
+
+/* Nœud d'une VM liée en mode strict à un seul nœud, -1 sinon */
+static int domain_node(const char *xml) {
+    const char *nt = strstr(xml, "<numatune>");
+    const char *end = nt ? strstr(nt, "</numatune>") : NULL;
+    const char *m = nt ? strstr(nt, "<memory mode='strict' nodeset='") : NULL;
+    if (!m || m > end)
+        return -1;
+    m += strlen("<memory mode='strict' nodeset='");
+    char *stop;
+    long node = strtol(m, &stop, 10);
+    if (stop == m || *stop != '\'')
+        return -1;                      /* plusieurs nœuds : non géré */
+    return (int)node;
+}
+
+/* --------------------------------------------------------------------------
+ * Placement à la création
+ * -------------------------------------------------------------------------- */
+
+int numa_plan_vm(virConnectPtr conn, int vcpus, unsigned long long mem_mib,
+                 int forced_node, struct numa_plan *plan) {
+    struct numa_topology t;
+    plan->node = -1;
+    plan->cpuset[0] = '\0';
+    if (read_topology(conn, &t) < 0)
+        return forced_node >= 0 ? -1 : 0;
+    if (t.ncells < 2)
+        return forced_node >= 0 && cell_index(&t, forced_node) < 0 ? -1 : 0;
+
+    unsigned long long mem_kib = mem_mib * 1024;
+    int best = -1;
+
+    if (forced_node >= 0) {
+        best = cell_index(&t, forced_node);
+        if (best < 0 || t.cells[best].ncpus < vcpus || t.cells[best].free_kib < mem_kib)
+            return -1;
+    } else {
+        /* vCPUs déjà liés par nœud */
+        int bound[MAX_NUMA_CELLS] = { 0 };
+        virDomainPtr *doms = NULL;
+        int ndoms = TRACE_VIRT(virConnectListAllDomains, conn, &doms, VIR_CONNECT_LIST_DOMAINS_ACTIVE);
+        for (int i = 0; i < ndoms; i++) {
+            char *xml = TRACE_VIRT(virDomainGetXMLDesc, doms[i], 0);
+            int idx = xml ? cell_index(&t, domain_node(xml)) : -1;
+            if (idx >= 0) {
+                int n = TRACE_VIRT(virDomainGetVcpusFlags, doms[i], VIR_DOMAIN_AFFECT_LIVE);
+                bound[idx] += n > 0 ? n : 0;
+            }
+            free(xml);
+            virDomainFree(doms[i]);
+        }
+        free(doms);
+
+        double best_load = 0;
+        for (int i = 0; i < t.ncells; i++) {
+            if (t.cells[i].ncpus < vcpus || t.cells[i].free_kib < mem_kib)
+                continue;
+            double load = (double)(bound[i] + vcpus) / t.cells[i].ncpus;
+            if (best < 0 || load < best_load ||
+                (load == best_load && t.cells[i].free_kib > t.cells[best].free_kib)) {
+                best = i;
+                best_load = load;
+            }
+        }
+        if (best < 0)
+            return 0;                   /* trop grosse pour un nœud : flottante */
+    }
+
+    plan->node = t.cells[best].id;
+    snprintf(plan->cpuset, sizeof(plan->cpuset), "%s", t.cells[best].cpuset);
+    return 0;
+}
+
+int numa_xml_fragments(const struct numa_plan *plan, int vcpus,
+                       char *pin, size_t pin_len, char *numatune, size_t numatune_len) {
+    size_t off = 0;
+    pin[0] = numatune[0] = '\0';
+    if (plan->node < 0)
+        return 0;
+
+    for (int i = 0; i < vcpus; i++)
+        if (appendf(pin, pin_len, &off, "<vcpupin vcpu='%d' cpuset='%s'/>", i, plan->cpuset) < 0)
+            return -1;
+    if (appendf(pin, pin_len, &off, "<emulatorpin cpuset='%s'/>", plan->cpuset) < 0 ||
+        appendf(pin, pin_len, &off, "<iothreadpin iothread='1' cpuset='%s'/>", plan->cpuset) < 0)
+        return -1;
+
+    off = 0;
+    return appendf(numatune, numatune_len, &off,
+                   "<numatune><memory mode='strict' nodeset='%d'/></numatune>", plan->node);
+}
+
+/* --------------------------------------------------------------------------
+ * Déplacement à chaud
+ * -------------------------------------------------------------------------- */
+
+static void record_move(const char *uri, const char *name, int from, int to, int automatic, int ok) {
+    struct numa_move *m = &moves[next_move++ % NUMA_MOVE_HISTORY];
+    m->at = time(NULL);
+    snprintf(m->uri, sizeof(m->uri), "%s", uri);
+    snprintf(m->vm_name, sizeof(m->vm_name), "%s", name);
+    m->from = from;
+    m->to = to;
+    m->automatic = automatic;
+    m->ok = ok;
+}
+
+/*
+ * Relie vCPUs, émulateur et iothread aux CPUs du nœud cible, puis change le
+ * nodeset : en mode strict, libvirt migre la mémoire (cpuset.mems).
+ */
+static int move_domain(virDomainPtr dom, const struct numa_topology *t, int idx) {
+    unsigned int flags = VIR_DOMAIN_AFFECT_LIVE;
+    if (TRACE_VIRT(virDomainIsPersistent, dom) == 1)
+        flags |= VIR_DOMAIN_AFFECT_CONFIG;
+    unsigned char *map = (unsigned char *)t->cpumaps[idx];
+    int maplen = VIR_CPU_MAPLEN(t->max_cpu);
+
+    /* vCPUs éteints compris : un hotplug ultérieur resterait sinon sur l'ancien nœud */
+    int nvcpus = TRACE_VIRT(virDomainGetVcpusFlags, dom,
+                            VIR_DOMAIN_VCPU_MAXIMUM | VIR_DOMAIN_AFFECT_LIVE);
+    if (nvcpus < 1) {
+        log_libvirt_error("virDomainGetVcpusFlags");
+        return -1;
+    }
+    for (int i = 0; i < nvcpus; i++) {
+        if (TRACE_VIRT(virDomainPinVcpuFlags, dom, (unsigned int)i, map, maplen, flags) < 0) {
+            log_libvirt_error("virDomainPinVcpuFlags");
+            return -1;
+        }
+    }
+    if (TRACE_VIRT(virDomainPinEmulator, dom, map, maplen, flags) < 0)
+        log_libvirt_error("virDomainPinEmulator");
+
+    char *xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+    if (xml && strstr(xml, "<iothreads>") &&
+        TRACE_VIRT(virDomainPinIOThread, dom, 1, map, maplen, flags) < 0)
+        log_libvirt_error("virDomainPinIOThread");
+    free(xml);
+
+    char nodeset[16];
+    snprintf(nodeset, sizeof(nodeset), "%d", t->cells[idx].id);
+    virTypedParameterPtr params = NULL;
+    int nparams = 0, maxparams = 0;
+    virTypedParamsAddString(&params, &nparams, &maxparams, VIR_DOMAIN_NUMA_NODESET, nodeset);
+    int rc = TRACE_VIRT(virDomainSetNumaParameters, dom, params, nparams, flags);
+    virTypedParamsFree(params, nparams);
+    if (rc < 0) {
+        log_libvirt_error("virDomainSetNumaParameters");
+        return -1;
+    }
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Tuner périodique
+ * -------------------------------------------------------------------------- */
+
+static struct numa_vm *get_vm(const char *uri, const char *uuid) {
+    struct numa_vm *slot = NULL;
+    for (int i = 0; i < MAX_NUMA_VMS; i++) {
+        if (vms[i].used && strcmp(vms[i].uri, uri) == 0 && strcmp(vms[i].uuid, uuid) == 0)
+            return &vms[i];
+        if (!vms[i].used && !slot)
+            slot = &vms[i];
+    }
+    if (slot) {
+        memset(slot, 0, sizeof(*slot));
+        slot->used = 1;
+        slot->node = -1;
+        snprintf(slot->uri, sizeof(slot->uri), "%s", uri);
+        snprintf(slot->uuid, sizeof(slot->uuid), "%s", uuid);
+    }
+    return slot;
+}
+
+static void prune_vms(time_t now, int interval_s) {
+    for (int i = 0; i < MAX_NUMA_VMS; i++)
+        if (vms[i].used && now - vms[i].updated_at > 10 * interval_s)
+            vms[i].used = 0;
+}
+
+struct candidate {
+    virDomainPtr dom;
+    int    idx;
+    double usage;
+    unsigned long long mem_kib;
+    time_t moved_at;
+};
+
+/* Mesure la charge des VMs liées et retourne la charge par nœud */
+static int sample_host(const char *uri, virConnectPtr conn, const struct numa_topology *t,
+                       double *node_usage, struct candidate *cands, int max_cands) {
+    virDomainPtr *doms = NULL;
+    int ndoms = TRACE_VIRT(virConnectListAllDomains, conn, &doms, VIR_CONNECT_LIST_DOMAINS_RUNNING);
+    int ncands = 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (int i = 0; i < ndoms; i++) {
+        char uuid[VIR_UUID_STRING_BUFLEN];
+        virDomainInfo info;
+        char *xml = TRACE_VIRT(virDomainGetXMLDesc, doms[i], 0);
+        int idx = xml ? cell_index(t, domain_node(xml)) : -1;
+        free(xml);
+        if (idx < 0 || virDomainGetUUIDString(doms[i], uuid) < 0 ||
+            TRACE_VIRT(virDomainGetInfo, doms[i], &info) < 0 || ncands >= max_cands) {
+            virDomainFree(doms[i]);
+            continue;
+        }
+
+        pthread_mutex_lock(&numa_lock);
+        struct numa_vm *vm = get_vm(uri, uuid);
+        double usage = 0;
+        time_t moved_at = 0;
+        if (vm) {
+            double wall_ns = (double)(now.tv_sec - vm->sampled.tv_sec) * 1e9 +
+                             (double)(now.tv_nsec - vm->sampled.tv_nsec);
+            if (vm->sampled.tv_sec && wall_ns > 0 && info.cpuTime >= vm->cpu_time_ns)
+                usage = (double)(info.cpuTime - vm->cpu_time_ns) / wall_ns;
+            vm->cpu_time_ns = info.cpuTime;
+            vm->sampled = now;
+            vm->usage = usage;
+            vm->node = t->cells[idx].id;
+            vm->updated_at = time(NULL);
+            snprintf(vm->name, sizeof(vm->name), "%s", virDomainGetName(doms[i]));
+            moved_at = vm->moved_at;
+        }
+        pthread_mutex_unlock(&numa_lock);
+
+        node_usage[idx] += usage;
+        cands[ncands].dom = doms[i];
+        cands[ncands].idx = idx;
+        cands[ncands].usage = usage;
+        cands[ncands].mem_kib = info.memory;
+        cands[ncands].moved_at = moved_at;
+        ncands++;
+    }
+    free(doms);
+    return ncands;
+}
+
+static void tune_host(const char *uri, const struct numa_config *c) {
+    virConnectPtr conn = libvirt_pool_open(uri);
+    if (!conn) {
+        log_libvirt_error("virConnectOpen");
+        return;
+    }
+    struct numa_topology t;
+    if (read_topology(conn, &t) < 0 || t.ncells < 2) {
+        virConnectClose(conn);
+        return;
+    }
+
+    static struct candidate cands[MAX_NUMA_VMS];
+    double node_usage[MAX_NUMA_CELLS] = { 0 };
+    int ncands = sample_host(uri, conn, &t, node_usage, cands, MAX_NUMA_VMS);
+
+    int hot = 0, cold = 0;
+    double load[MAX_NUMA_CELLS];
+    for (int i = 0; i < t.ncells; i++) {
+        load[i] = node_usage[i] / t.cells[i].ncpus;
+        if (load[i] > load[hot])
+            hot = i;
+        if (load[i] < load[cold])
+            cold = i;
+    }
+
+    /* Une VM au plus par passage : celle qui réduit le plus l'écart sans l'inverser */
+    int best = -1;
+    time_t now = time(NULL);
+    if (load[hot] - load[cold] >= c->imbalance_pct / 100.0) {
+        for (int i = 0; i < ncands; i++) {
+            const struct candidate *cd = &cands[i];
+            if (cd->idx != hot || cd->usage <= 0 || now - cd->moved_at < c->cooldown_s ||
+                cd->mem_kib + NUMA_MOVE_MARGIN_KIB > t.cells[cold].free_kib)
+                continue;
+            double new_hot  = load[hot] - cd->usage / t.cells[hot].ncpus;
+            double new_cold = load[cold] + cd->usage / t.cells[cold].ncpus;
+            if (new_cold > new_hot)
+                continue;
+            if (best < 0 || cd->usage > cands[best].usage)
+                best = i;
+        }
+    }
+
+    if (best >= 0) {
+        const char *name = virDomainGetName(cands[best].dom);
+        int ok = move_domain(cands[best].dom, &t, cold) == 0;
+        char uuid[VIR_UUID_STRING_BUFLEN];
+        pthread_mutex_lock(&numa_lock);
+        record_move(uri, name, t.cells[hot].id, t.cells[cold].id, 1, ok);
+        struct numa_vm *vm = virDomainGetUUIDString(cands[best].dom, uuid) == 0
+                             ? get_vm(uri, uuid) : NULL;
+        if (vm)
+            vm->moved_at = now;
+        pthread_mutex_unlock(&numa_lock);
+        LOG_WARN("%s on %s: node %d (load %.0f%%) -> node %d (load %.0f%%) %s",
+                 name, uri, t.cells[hot].id, load[hot] * 100, t.cells[cold].id, load[cold] * 100,
+                 ok ? "done" : "failed");
+    }
+
+    for (int i = 0; i < ncands; i++)
+        virDomainFree(cands[i].dom);
+    virConnectClose(conn);
+}
+
+static void *numa_tuner_thread(void *arg) {
+    (void)arg;
+    static char uris[MAX_PLACEMENT_HOSTS][512];
+    for (;;) {
+        pthread_mutex_lock(&numa_lock);
+        struct numa_config c = config;
+        prune_vms(time(NULL), c.interval_s);
+        pthread_mutex_unlock(&numa_lock);
+
+        if (c.enabled) {
+            int nhosts = placement_list_hosts(uris, MAX_PLACEMENT_HOSTS);
+            for (int h = 0; h < nhosts; h++)
+                tune_host(uris[h], &c);
+        }
+        sleep((unsigned int)c.interval_s);
+    }
+    return NULL;
+}
+
+static void start_tuner(void) {
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, numa_tuner_thread, NULL) != 0)
+        LOG_ERROR("cannot start tuner thread");
+    pthread_attr_destroy(&attr);
+}
+
+/* --------------------------------------------------------------------------
+ * Handlers
+ * -------------------------------------------------------------------------- */
+
+static cJSON *config_to_json(const struct numa_config *c) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddBoolToObject(obj, "enabled", c->enabled);
+    cJSON_AddNumberToObject(obj, "intervalS", c->interval_s);
+    cJSON_AddNumberToObject(obj, "imbalancePercent", c->imbalance_pct);
+    cJSON_AddNumberToObject(obj, "cooldownS", c->cooldown_s);
+    return obj;
+}
+
+char *handle_numaconfig(const char *post_data) {
+    cJSON *root = post_data && post_data[0] ? cJSON_Parse(post_data) : NULL;
+    if (post_data && post_data[0] && !root)
+        return make_json_error("invalid JSON");
+
+    pthread_mutex_lock(&numa_lock);
+    struct numa_config c = config;
+    cJSON *j;
+    if (root) {
+        if ((j = cJSON_GetObjectItem(root, "enabled")) && cJSON_IsBool(j))
+            c.enabled = cJSON_IsTrue(j);
+        if ((j = cJSON_GetObjectItem(root, "intervalS")) && cJSON_IsNumber(j))
+            c.interval_s = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "imbalancePercent")) && cJSON_IsNumber(j))
+            c.imbalance_pct = j->valueint;
+        if ((j = cJSON_GetObjectItem(root, "cooldownS")) && cJSON_IsNumber(j))
+            c.cooldown_s = j->valueint;
+    }
+    cJSON_Delete(root);
+
+    if (c.interval_s < 5 || c.imbalance_pct < 1 || c.imbalance_pct > 100 || c.cooldown_s < 0) {
+        pthread_mutex_unlock(&numa_lock);
+        return make_json_error("invalid config (intervalS >= 5, imbalancePercent 1-100, cooldownS >= 0)");
+    }
+    config = c;
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddItemToObject(resp, "config", config_to_json(&config));
+    int enabled = config.enabled;
+    pthread_mutex_unlock(&numa_lock);
+
+    if (enabled)
+        pthread_once(&tuner_once, start_tuner);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+char *handle_numastatus(const char *post_data) {
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    cJSON *uri_item = root ? cJSON_GetObjectItem(root, "uri") : NULL;
+    if (!cJSON_IsString(uri_item)) {
+        cJSON_Delete(root);
+        return make_json_error("missing uri");
+    }
+    const char *uri = uri_item->valuestring;
+
+    virConnectPtr conn = libvirt_pool_open(uri);
+    if (!conn) {
+        cJSON_Delete(root);
+        return make_json_error("cannot connect to hypervisor");
+    }
+    struct numa_topology t;
+    if (read_topology(conn, &t) < 0) {
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return make_json_error("cannot read host topology");
+    }
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON *nodes = cJSON_AddArrayToObject(resp, "nodes");
+    cJSON *node_vms[MAX_NUMA_CELLS];
+    double usage[MAX_NUMA_CELLS] = { 0 };
+    for (int i = 0; i < t.ncells; i++) {
+        cJSON *n = cJSON_CreateObject();
+        cJSON_AddNumberToObject(n, "node", t.cells[i].id);
+        cJSON_AddStringToObject(n, "cpus", t.cells[i].cpuset);
+        cJSON_AddNumberToObject(n, "memoryMiB", (double)(t.cells[i].memory_kib / 1024));
+        cJSON_AddNumberToObject(n, "freeMiB", (double)(t.cells[i].free_kib / 1024));
+        node_vms[i] = cJSON_AddArrayToObject(n, "vms");
+        cJSON_AddItemToArray(nodes, n);
+    }
+
+    /* VMs liées à un nœud (XML courant) et dernière charge mesurée par le tuner */
+    virDomainPtr *doms = NULL;
+    int ndoms = TRACE_VIRT(virConnectListAllDomains, conn, &doms, VIR_CONNECT_LIST_DOMAINS_ACTIVE);
+    for (int d = 0; d < ndoms; d++) {
+        char *xml = TRACE_VIRT(virDomainGetXMLDesc, doms[d], 0);
+        int idx = xml ? cell_index(&t, domain_node(xml)) : -1;
+        free(xml);
+        char uuid[VIR_UUID_STRING_BUFLEN];
+        if (idx >= 0 && virDomainGetUUIDString(doms[d], uuid) == 0) {
+            cJSON *v = cJSON_CreateObject();
+            cJSON_AddStringToObject(v, "vmName", virDomainGetName(doms[d]));
+            pthread_mutex_lock(&numa_lock);
+            for (int i = 0; i < MAX_NUMA_VMS; i++) {
+                if (vms[i].used && strcmp(vms[i].uri, uri) == 0 && strcmp(vms[i].uuid, uuid) == 0) {
+                    cJSON_AddNumberToObject(v, "cpuCores", vms[i].usage);
+                    usage[idx] += vms[i].usage;
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&numa_lock);
+            cJSON_AddItemToArray(node_vms[idx], v);
+        }
+        virDomainFree(doms[d]);
+    }
+    free(doms);
+
+    int i = 0;
+    cJSON *n;
+    cJSON_ArrayForEach(n, nodes) {
+        cJSON_AddNumberToObject(n, "loadPercent", usage[i] * 100 / t.cells[i].ncpus);
+        i++;
+    }
+
+    pthread_mutex_lock(&numa_lock);
+    cJSON_AddItemToObject(resp, "config", config_to_json(&config));
+    cJSON *hist = cJSON_AddArrayToObject(resp, "moves");
+    for (int k = 0; k < NUMA_MOVE_HISTORY; k++) {
+        const struct numa_move *m = &moves[(next_move + k) % NUMA_MOVE_HISTORY];
+        if (!m->at || strcmp(m->uri, uri) != 0)
+            continue;
+        cJSON *o = cJSON_CreateObject();
+        cJSON_AddNumberToObject(o, "at", (double)m->at);
+        cJSON_AddStringToObject(o, "vmName", m->vm_name);
+        cJSON_AddNumberToObject(o, "from", m->from);
+        cJSON_AddNumberToObject(o, "to", m->to);
+        cJSON_AddBoolToObject(o, "automatic", m->automatic);
+        cJSON_AddBoolToObject(o, "ok", m->ok);
+        cJSON_AddItemToArray(hist, o);
+    }
+    pthread_mutex_unlock(&numa_lock);
+
+    virConnectClose(conn);
+    cJSON_Delete(root);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+char *handle_numapin(const char *post_data) {
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    if (!root)
+        return make_json_error("invalid JSON");
+    cJSON *uri  = cJSON_GetObjectItem(root, "uri");
+    cJSON *name = cJSON_GetObjectItem(root, "vmName");
+    cJSON *node = cJSON_GetObjectItem(root, "node");
+    if (!cJSON_IsString(uri) || !cJSON_IsString(name) || !cJSON_IsNumber(node)) {
+        cJSON_Delete(root);
+        return make_json_error("missing uri, vmName or node");
+    }
+
+    virConnectPtr conn = libvirt_pool_open(uri->valuestring);
+    if (!conn) {
+        cJSON_Delete(root);
+        return make_json_error("cannot connect to hypervisor");
+    }
+    struct numa_topology t;
+    int idx = read_topology(conn, &t) == 0 ? cell_index(&t, node->valueint) : -1;
+    if (idx < 0 || t.ncells < 2) {
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return make_json_error("unknown NUMA node");
+    }
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, name->valuestring);
+    if (!dom) {
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return make_json_error("domain not found");
+    }
+
+    const char *err = NULL;
+    virDomainInfo info;
+    char *xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+    int from = xml ? domain_node(xml) : -1;
+    free(xml);
+    if (TRACE_VIRT(virDomainIsActive, dom) != 1)
+        err = "domain is not running";
+    else if (TRACE_VIRT(virDomainGetInfo, dom, &info) == 0 && from != node->valueint &&
+             info.memory + NUMA_MOVE_MARGIN_KIB > t.cells[idx].free_kib)
+        err = "not enough free memory on target node";
+    else if (move_domain(dom, &t, idx) < 0)
+        err = "failed to move domain";
+
+    pthread_mutex_lock(&numa_lock);
+    record_move(uri->valuestring, name->valuestring, from, node->valueint, 0, err == NULL);
+    pthread_mutex_unlock(&numa_lock);
+
+    virDomainFree(dom);
+    virConnectClose(conn);
+    cJSON_Delete(root);
+    if (err)
+        return make_json_error(err);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddNumberToObject(resp, "from", from);
+    cJSON_AddNumberToObject(resp, "node", t.cells[idx].id);
+    cJSON_AddStringToObject(resp, "cpus", t.cells[idx].cpuset);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
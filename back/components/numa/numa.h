@@ -0,0 +1,53 @@
+// numa.h
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stddef.h>
+#include <libvirt/libvirt.h>
+
+/* Limites de topologie prises en charge */
+#define MAX_NUMA_CELLS 8
+#define MAX_NUMA_CPUS 1024
+
+/* Nombre max de VMs suivies par le tuner (tous hôtes confondus) */
+#define MAX_NUMA_VMS 512
+
+/* Placement NUMA d'une nouvelle VM : node = -1 => aucun pinning */
+struct numa_plan {
+    int  node;
+    char cpuset[512];       /* CPUs hôte du nœud, ex. "0-7,16-23" */
+};
+
+/*
+ * Choisit un nœud pour une VM de vcpus vCPUs et mem_mib MiB : le nœud le
+ * moins chargé (vCPUs déjà liés par nœud) où la mémoire tient. forced_node
+ * >= 0 impose le nœud. node = -1 si l'hôte n'a qu'un nœud ou si la VM ne
+ * tient dans aucun. Retourne -1 si forced_node est invalide ou trop petit.
+ */
+int numa_plan_vm(virConnectPtr conn, int vcpus, unsigned long long mem_mib,
+                 int forced_node, struct numa_plan *plan);
+
+/*
+ * Fragments XML de createVM : contenu de <cputune> (vcpupin, emulatorpin,
+ * iothreadpin pour l'iothread 1) et bloc <numatune> en mode strict.
+ * Chaînes vides si plan->node < 0. Retourne -1 si un buffer est trop petit.
+ */
+int numa_xml_fragments(const struct numa_plan *plan, int vcpus,
+                       char *pin, size_t pin_len, char *numatune, size_t numatune_len);
+
+/*
+ * Tuner : toutes les "intervalS" secondes, mesure la charge CPU des VMs
+ * liées à un nœud et déplace à chaud (vCPUs, émulateur, iothread, mémoire)
+ * une VM du nœud le plus chargé vers le moins chargé quand l'écart dépasse
+ * "imbalancePercent".
+ * { "enabled": true, "intervalS": 60, "imbalancePercent": 25, "cooldownS": 600 }
+ */
+char *handle_numaconfig(const char *post_data);
+
+/* Topologie, charge par nœud et VMs liées : { "uri" } */
+char *handle_numastatus(const char *post_data);
+
+/* Déplacement manuel : { "uri", "vmName", "node" } */
+char *handle_numapin(const char *post_data);
+
+#endif
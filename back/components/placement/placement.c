@@ -0,0 +1,516 @@
+// placement.c
+#include "placement.h"
+#include "../../libvirt-utils.h"
+#define LOG_COMPONENT "placement"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include "../hostinfo/hostinfo.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Intervalle de rafraîchissement de la table des hôtes (s) */
+#define PLACEMENT_POLL_INTERVAL_S 10
+
+/* RAM gardée libre sur chaque hôte pour l'hyperviseur lui-même */
+#define HOST_MEM_RESERVE_MIB 1024
+
+/* Sur-allocation tolérée des vCPUs par rapport aux CPUs physiques */
+#define VCPU_OVERCOMMIT 4
+
+struct host_entry {
+    int    in_use;
+    char   uri[512];
+    int    reachable;
+    time_t last_poll;
+    char   last_error[128];
+
+    unsigned long long total_mem_kib;
+    unsigned long long free_mem_kib;
+    unsigned int cpus;
+    unsigned int mhz;
+    double cpu_usage;                   /* 0..1 entre deux polls */
+    unsigned long long prev_busy;
+    unsigned long long prev_total;
+    int    running_domains;
+    int    committed_vcpus;
+    unsigned long long committed_mem_kib;
+
+    double load_score;                  /* 0 = vide, 1 = saturé */
+};
+
+static struct host_entry hosts[MAX_PLACEMENT_HOSTS];
+static int least_loaded = -1;           /* index recalculé à chaque poll */
+static pthread_mutex_t hosts_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t poller_once = PTHREAD_ONCE_INIT;
+static pthread_cond_t poll_now = PTHREAD_COND_INITIALIZER;  /* nouvel hôte à sonder */
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("[%s] Libvirt error: %s (code=%d domain=%d)",
+                  prefix, err->message, err->code, err->domain);
+    } else {
+        LOG_ERROR("[%s] Unknown libvirt error", prefix);
+    }
+}
+
+static char *make_error_json(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "success", 0);
+    cJSON_AddStringToObject(root, "error", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+/* --------------------------------------------------------------------------
+ * Sonde d'un hôte (hors verrou)
+ * -------------------------------------------------------------------------- */
+
+struct host_sample {
+    int    ok;
+    char   error[128];
+    unsigned long long total_mem_kib;
+    unsigned long long free_mem_kib;
+    unsigned int cpus;
+    unsigned int mhz;
+    unsigned long long busy;
+    unsigned long long total;
+    int    running_domains;
+    int    committed_vcpus;
+    unsigned long long committed_mem_kib;
+};
+
+static void read_cpu_times(virConnectPtr conn, struct host_sample *s) {
+    int nparams = 0;
+    if (TRACE_VIRT(virNodeGetCPUStats, conn, VIR_NODE_CPU_STATS_ALL_CPUS, NULL, &nparams, 0) < 0 ||
+        nparams <= 0)
+        return;
+
+    virNodeCPUStatsPtr params = calloc(nparams, sizeof(*params));
+    if (!params)
+        return;
+
+    if (TRACE_VIRT(virNodeGetCPUStats, conn, VIR_NODE_CPU_STATS_ALL_CPUS, params, &nparams, 0) == 0) {
+        for (int i = 0; i < nparams; i++) {
+            s->total += params[i].value;
+            if (strcmp(params[i].field, VIR_NODE_CPU_STATS_IDLE) != 0 &&
+                strcmp(params[i].field, VIR_NODE_CPU_STATS_IOWAIT) != 0)
+                s->busy += params[i].value;
+        }
+    }
+    free(params);
+}
+
+static void probe_host(const char *uri, struct host_sample *s) {
+    memset(s, 0, sizeof(*s));
+
+    virConnectPtr conn = libvirt_pool_open(uri);
+    if (!conn) {
+        virErrorPtr err = virGetLastError();
+        snprintf(s->error, sizeof(s->error), "%s",
+                 err && err->message ? err->message : "cannot connect");
+        return;
+    }
+
+    virNodeInfo info;
+    if (TRACE_VIRT(virNodeGetInfo, conn, &info) < 0) {
+        log_libvirt_error("placement:virNodeGetInfo");
+        snprintf(s->error, sizeof(s->error), "virNodeGetInfo failed");
+        virConnectClose(conn);
+        libvirt_pool_drop(uri);
+        return;
+    }
+    s->total_mem_kib = info.memory;
+    s->cpus = info.cpus;
+    s->mhz = info.mhz;
+    s->free_mem_kib = TRACE_VIRT(virNodeGetFreeMemory, conn) / 1024;
+
+    read_cpu_times(conn, s);
+
+    virDomainPtr *doms = NULL;
+    int ndoms = TRACE_VIRT(virConnectListAllDomains, conn, &doms, VIR_CONNECT_LIST_DOMAINS_ACTIVE);
+    for (int i = 0; i < ndoms; i++) {
+        virDomainInfo dinfo;
+        if (TRACE_VIRT(virDomainGetInfo, doms[i], &dinfo) == 0) {
+            s->committed_vcpus += dinfo.nrVirtCpu;
+            s->committed_mem_kib += dinfo.memory;
+        }
+        virDomainFree(doms[i]);
+    }
+    free(doms);
+    s->running_domains = ndoms > 0 ? ndoms : 0;
+
+    s->ok = 1;
+    virConnectClose(conn);
+}
+
+/* Score de charge : moitié CPU, moitié mémoire (hosts_lock tenu) */
+static void update_score(struct host_entry *h) {
+    double mem_used = h->total_mem_kib > 0
+        ? 1.0 - (double)h->free_mem_kib / (double)h->total_mem_kib : 1.0;
+    h->load_score = 0.5 * h->cpu_usage + 0.5 * mem_used;
+}
+
+/* (hosts_lock tenu) */
+static void recompute_least_loaded(void) {
+    least_loaded = -1;
+    for (int i = 0; i < MAX_PLACEMENT_HOSTS; i++) {
+        if (!hosts[i].in_use || !hosts[i].reachable)
+            continue;
+        if (least_loaded < 0 || hosts[i].load_score < hosts[least_loaded].load_score)
+            least_loaded = i;
+    }
+}
+
+static void poll_all_hosts(void) {
+    char uris[MAX_PLACEMENT_HOSTS][512];
+    int n = 0;
+
+    pthread_mutex_lock(&hosts_lock);
+    for (int i = 0; i < MAX_PLACEMENT_HOSTS; i++) {
+        if (hosts[i].in_use)
+            snprintf(uris[n++], sizeof(uris[0]), "%s", hosts[i].uri);
+    }
+    pthread_mutex_unlock(&hosts_lock);
+
+    for (int k = 0; k < n; k++) {
+        struct host_sample s;
+        probe_host(uris[k], &s);
+
+        pthread_mutex_lock(&hosts_lock);
+        for (int i = 0; i < MAX_PLACEMENT_HOSTS; i++) {
+            struct host_entry *h = &hosts[i];
+            if (!h->in_use || strcmp(h->uri, uris[k]) != 0)
+                continue;
+
+            h->last_poll = time(NULL);
+            h->reachable = s.ok;
+            snprintf(h->last_error, sizeof(h->last_error), "%s", s.error);
+            if (s.ok) {
+                h->total_mem_kib = s.total_mem_kib;
+                h->free_mem_kib = s.free_mem_kib;
+                h->cpus = s.cpus;
+                h->mhz = s.mhz;
+                if (h->prev_total > 0 && s.total > h->prev_total) {
+                    h->cpu_usage = (double)(s.busy - h->prev_busy) /
+                                   (double)(s.total - h->prev_total);
+                }
+                h->prev_busy = s.busy;
+                h->prev_total = s.total;
+                h->running_domains = s.running_domains;
+                h->committed_vcpus = s.committed_vcpus;
+                h->committed_mem_kib = s.committed_mem_kib;
+                update_score(h);
+            }
+            break;
+        }
+        pthread_mutex_unlock(&hosts_lock);
+    }
+
+    pthread_mutex_lock(&hosts_lock);
+    recompute_least_loaded();
+    pthread_mutex_unlock(&hosts_lock);
+}
+
+static void *placement_poller_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        poll_all_hosts();
+
+        /* Attend l'intervalle, ou l'enregistrement d'un nouvel hôte */
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += PLACEMENT_POLL_INTERVAL_S;
+        pthread_mutex_lock(&hosts_lock);
+        pthread_cond_timedwait(&poll_now, &hosts_lock, &deadline);
+        pthread_mutex_unlock(&hosts_lock);
+    }
+    return NULL;
+}
+
+static void start_poller(void) {
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, placement_poller_thread, NULL) != 0)
+        LOG_ERROR("cannot start poller thread");
+    pthread_attr_destroy(&attr);
+}
+
+/* --------------------------------------------------------------------------
+ * API
+ * -------------------------------------------------------------------------- */
+
+int placement_register_host(const char *uri) {
+    if (!uri || !uri[0])
+        return -1;
+
+    pthread_mutex_lock(&hosts_lock);
+    int slot = -1;
+    for (int i = 0; i < MAX_PLACEMENT_HOSTS; i++) {
+        if (hosts[i].in_use && strcmp(hosts[i].uri, uri) == 0) {
+            pthread_mutex_unlock(&hosts_lock);
+            return 0;
+        }
+        if (!hosts[i].in_use && slot < 0)
+            slot = i;
+    }
+    if (slot < 0) {
+        pthread_mutex_unlock(&hosts_lock);
+        return -1;
+    }
+
+    memset(&hosts[slot], 0, sizeof(hosts[slot]));
+    hosts[slot].in_use = 1;
+    snprintf(hosts[slot].uri, sizeof(hosts[slot].uri), "%s", uri);
+    pthread_cond_signal(&poll_now);
+    pthread_mutex_unlock(&hosts_lock);
+
+    LOG_INFO("registered host %s", uri);
+    pthread_once(&poller_once, start_poller);
+    return 0;
+}
+
+int placement_unregister_host(const char *uri) {
+    int found = 0;
+
+    pthread_mutex_lock(&hosts_lock);
+    for (int i = 0; i < MAX_PLACEMENT_HOSTS; i++) {
+        if (hosts[i].in_use && strcmp(hosts[i].uri, uri) == 0) {
+            hosts[i].in_use = 0;
+            found = 1;
+            break;
+        }
+    }
+    recompute_least_loaded();
+    pthread_mutex_unlock(&hosts_lock);
+
+    if (found)
+        libvirt_pool_drop(uri);
+    return found ? 0 : -1;
+}
+
+int placement_list_hosts(char uris[][512], int max) {
+    int n = 0;
+    pthread_mutex_lock(&hosts_lock);
+    for (int i = 0; i < MAX_PLACEMENT_HOSTS && n < max; i++) {
+        if (hosts[i].in_use)
+            snprintf(uris[n++], 512, "%s", hosts[i].uri);
+    }
+    pthread_mutex_unlock(&hosts_lock);
+    return n;
+}
+
+/* La demande tient-elle sur l'hôte ? (hosts_lock tenu) */
+static int host_fits(const struct host_entry *h, unsigned long long mem_mib, int vcpus) {
+    if (!h->in_use || !h->reachable)
+        return 0;
+    unsigned long long need_kib = (mem_mib + HOST_MEM_RESERVE_MIB) * 1024ULL;
+    if (h->free_mem_kib < need_kib)
+        return 0;
+    if (h->cpus > 0 &&
+        h->committed_vcpus + vcpus > (int)(h->cpus * VCPU_OVERCOMMIT))
+        return 0;
+    return 1;
+}
+
+int placement_best_host(const char *strategy, unsigned long long mem_mib, int vcpus,
+                        const char *exclude_uri, char *out, size_t outlen) {
+    int binpack = strategy && strcmp(strategy, "binpack") == 0;
+    int best = -1;
+
+    pthread_mutex_lock(&hosts_lock);
+
+    if (!binpack && least_loaded >= 0 &&
+        (!exclude_uri || strcmp(hosts[least_loaded].uri, exclude_uri) != 0) &&
+        host_fits(&hosts[least_loaded], mem_mib, vcpus)) {
+        /* Cas courant : l'hôte le moins chargé pré-calculé convient */
+        best = least_loaded;
+    } else {
+        for (int i = 0; i < MAX_PLACEMENT_HOSTS; i++) {
+            struct host_entry *h = &hosts[i];
+            if (!host_fits(h, mem_mib, vcpus))
+                continue;
+            if (exclude_uri && strcmp(h->uri, exclude_uri) == 0)
+                continue;
+            if (best < 0) {
+                best = i;
+            } else if (binpack) {
+                /* best-fit : l'hôte qui garde le moins de RAM libre après placement */
+                if (h->free_mem_kib < hosts[best].free_mem_kib)
+                    best = i;
+            } else if (h->load_score < hosts[best].load_score) {
+                best = i;
+            }
+        }
+    }
+
+    if (best < 0) {
+        pthread_mutex_unlock(&hosts_lock);
+        return -1;
+    }
+
+    /*
+     * Réservation optimiste jusqu'au prochain poll, pour qu'une rafale de
+     * demandes ne tombe pas entièrement sur le même hôte.
+     */
+    struct host_entry *h = &hosts[best];
+    h->free_mem_kib -= mem_mib * 1024ULL;
+    h->committed_mem_kib += mem_mib * 1024ULL;
+    h->committed_vcpus += vcpus;
+    h->running_domains++;
+    update_score(h);
+    recompute_least_loaded();
+
+    snprintf(out, outlen, "%s", h->uri);
+    pthread_mutex_unlock(&hosts_lock);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Handlers HTTP
+ * -------------------------------------------------------------------------- */
+
+static cJSON *host_to_json(const struct host_entry *h) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "uri", h->uri);
+    cJSON_AddBoolToObject(obj, "reachable", h->reachable);
+    cJSON_AddNumberToObject(obj, "lastPoll", (double)h->last_poll);
+    if (h->last_error[0])
+        cJSON_AddStringToObject(obj, "lastError", h->last_error);
+    cJSON_AddNumberToObject(obj, "cpus", h->cpus);
+    cJSON_AddNumberToObject(obj, "mhz", h->mhz);
+    cJSON_AddNumberToObject(obj, "cpuUsage", h->cpu_usage);
+    cJSON_AddNumberToObject(obj, "totalMemoryMiB", (double)(h->total_mem_kib / 1024));
+    cJSON_AddNumberToObject(obj, "freeMemoryMiB", (double)(h->free_mem_kib / 1024));
+    cJSON_AddNumberToObject(obj, "runningDomains", h->running_domains);
+    cJSON_AddNumberToObject(obj, "committedVcpus", h->committed_vcpus);
+    cJSON_AddNumberToObject(obj, "committedMemoryMiB", (double)(h->committed_mem_kib / 1024));
+    cJSON_AddNumberToObject(obj, "loadScore", h->load_score);
+    return obj;
+}
+
+/**
+ * POST /hosts
+ * Retourne la table des hôtes connus telle que vue par le dernier poll.
+ */
+char *handle_hosts(const char *post_data) {
+    (void)post_data;
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddBoolToObject(resp, "success", 1);
+    cJSON *arr = cJSON_AddArrayToObject(resp, "hosts");
+
+    pthread_mutex_lock(&hosts_lock);
+    for (int i = 0; i < MAX_PLACEMENT_HOSTS; i++) {
+        if (hosts[i].in_use)
+            cJSON_AddItemToArray(arr, host_to_json(&hosts[i]));
+    }
+    if (least_loaded >= 0)
+        cJSON_AddStringToObject(resp, "leastLoaded", hosts[least_loaded].uri);
+    pthread_mutex_unlock(&hosts_lock);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/**
+ * POST /registerhost    { "uri": "qemu+ssh://user@IP/system" }
+ * POST /unregisterhost  { "uri": "qemu+ssh://user@IP/system" }
+ */
+static char *register_or_unregister(const char *post_data, int reg) {
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    if (!root)
+        return make_error_json("invalid json");
+
+    cJSON *uri_item = cJSON_GetObjectItem(root, "uri");
+    if (!cJSON_IsString(uri_item)) {
+        cJSON_Delete(root);
+        return make_error_json("missing uri");
+    }
+
+    int rc = reg ? placement_register_host(uri_item->valuestring)
+                 : placement_unregister_host(uri_item->valuestring);
+    if (rc < 0) {
+        cJSON_Delete(root);
+        return make_error_json(reg ? "host table full" : "unknown host");
+    }
+    if (!reg)
+        hostinfo_invalidate(uri_item->valuestring);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddBoolToObject(resp, "success", 1);
+    cJSON_AddStringToObject(resp, "uri", uri_item->valuestring);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    cJSON_Delete(root);
+    return out;
+}
+
+char *handle_registerhost(const char *post_data) {
+    return register_or_unregister(post_data, 1);
+}
+
+char *handle_unregisterhost(const char *post_data) {
+    return register_or_unregister(post_data, 0);
+}
+
+/**
+ * POST /besthost
+ * BODY JSON:
+ * {
+ *   "strategy": "least-loaded",   // ou "binpack"
+ *   "memory": 2048,               // MiB demandés
+ *   "cpu": 2,                     // vCPUs demandés
+ *   "excludeUri": "qemu:///system" // optionnel (ex : source d'une migration)
+ * }
+ */
+char *handle_besthost(const char *post_data) {
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    if (!root)
+        return make_error_json("invalid json");
+
+    cJSON *j;
+    const char *strategy = (j = cJSON_GetObjectItem(root, "strategy")) && cJSON_IsString(j)
+                           ? j->valuestring : "least-loaded";
+    const char *exclude = (j = cJSON_GetObjectItem(root, "excludeUri")) && cJSON_IsString(j)
+                          ? j->valuestring : NULL;
+    double memory = (j = cJSON_GetObjectItem(root, "memory")) && cJSON_IsNumber(j)
+                    ? j->valuedouble : 0;
+    int cpu = (j = cJSON_GetObjectItem(root, "cpu")) && cJSON_IsNumber(j) ? j->valueint : 0;
+
+    if (strcmp(strategy, "least-loaded") != 0 && strcmp(strategy, "binpack") != 0) {
+        cJSON_Delete(root);
+        return make_error_json("strategy must be 'least-loaded' or 'binpack'");
+    }
+    if (memory < 0 || cpu < 0) {
+        cJSON_Delete(root);
+        return make_error_json("memory and cpu must be positive");
+    }
+
+    char uri[512];
+    if (placement_best_host(strategy, (unsigned long long)memory, cpu, exclude,
+                            uri, sizeof(uri)) < 0) {
+        cJSON_Delete(root);
+        return make_error_json("no registered host can fit this request");
+    }
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddBoolToObject(resp, "success", 1);
+    cJSON_AddStringToObject(resp, "uri", uri);
+    cJSON_AddStringToObject(resp, "strategy", strategy);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    cJSON_Delete(root);
+    return out;
+}
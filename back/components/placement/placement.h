@@ -0,0 +1,36 @@
+// placement.h
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+
+/* Nombre max d'hyperviseurs suivis par le service de placement */
+#define MAX_PLACEMENT_HOSTS 32
+
+/*
+ * Ajoute un hyperviseur à la table des hôtes (idempotent) et démarre le
+ * poller de fond au premier appel. Retourne -1 si la table est pleine.
+ */
+int placement_register_host(const char *uri);
+
+/* Retire un hyperviseur de la table ; -1 s'il était inconnu */
+int placement_unregister_host(const char *uri);
+
+/* Copie les URIs enregistrés dans uris ; retourne leur nombre */
+int placement_list_hosts(char uris[][512], int max);
+
+/*
+ * Choisit un hôte depuis la table en cache, sans sonder les hyperviseurs.
+ * strategy : "least-loaded" (défaut) ou "binpack" (best-fit mémoire).
+ * exclude_uri peut être NULL. Retourne 0 et l'URI dans out, -1 si aucun
+ * hôte joignable ne peut accueillir la demande.
+ */
+int placement_best_host(const char *strategy, unsigned long long mem_mib, int vcpus,
+                        const char *exclude_uri, char *out, size_t outlen);
+
+char *handle_hosts(const char *post_data);
+char *handle_registerhost(const char *post_data);
+char *handle_unregisterhost(const char *post_data);
+char *handle_besthost(const char *post_data);
+
+#endif
@@ -0,0 +1,323 @@
+// preflight_handler.c
+#include "preflight_handler.h"
+#define LOG_COMPONENT "preflight"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Durée de mesure du dirty rate par défaut / max (s). La mesure bloque le
+ * thread de la connexion HTTP : le max reste de quelques secondes.
+ */
+#define DEFAULT_CALC_SECONDS 3
+#define MAX_CALC_SECONDS 5
+
+/* Attente du résultat au-delà de la période demandée */
+#define CALC_POLL_ATTEMPTS 4
+#define CALC_POLL_MS 250
+
+/* Downtime toléré par défaut en fin de precopy (ms), cf. QEMU */
+#define DEFAULT_MAX_DOWNTIME_MS 300
+
+/* Bande passante supposée quand ni la requête ni le domaine n'en donnent (1 GbE) */
+#define DEFAULT_LINK_MIB 117
+
+/* Débit qu'un seul flux de migration arrive à tenir (CPU bound côté QEMU) */
+#define SINGLE_STREAM_MAX_MIB 1200
+
+/* Gain moyen de xbzrle sur les pages renvoyées à partir du 2e passage */
+#define XBZRLE_RATIO 2.0
+
+/* Au-delà, on considère que la precopy ne converge pas */
+#define MAX_PRECOPY_ITERATIONS 30
+
+/* Pause de bascule en postcopy (ms) */
+#define POSTCOPY_SWITCH_MS 50
+
+/* Un profil plus simple est préféré s'il n'est pas plus de 25 % plus lent */
+#define PROFILE_SLACK 1.25
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("[%s] Libvirt error: %s (code=%d domain=%d)",
+                  prefix, err->message, err->code, err->domain);
+    } else {
+        LOG_ERROR("[%s] Unknown libvirt error", prefix);
+    }
+}
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+struct migration_estimate {
+    const char *profile;
+    int    converges;
+    int    iterations;
+    double total_s;
+    double downtime_ms;
+};
+
+/*
+ * Modèle precopy itératif : le 1er passage envoie toute la RAM, chaque
+ * passage suivant renvoie ce qui a été sali pendant le précédent. On
+ * s'arrête (stop-and-copy) quand le reste tient dans le downtime toléré.
+ *
+ *   mem_mib      : RAM du guest
+ *   dirty_mib    : dirty rate mesuré (MiB/s)
+ *   bw_mib       : débit effectif de la migration (MiB/s)
+ *   resend_ratio : facteur de réduction des pages renvoyées (compression)
+ */
+static void estimate_precopy(struct migration_estimate *e, double mem_mib,
+                             double dirty_mib, double bw_mib, double resend_ratio,
+                             double max_downtime_ms) {
+    double remaining = mem_mib;     /* MiB à envoyer au passage courant */
+    double total = 0;
+    int iter = 0;
+
+    e->converges = 0;
+    for (iter = 1; iter <= MAX_PRECOPY_ITERATIONS; iter++) {
+        double t = remaining / bw_mib;
+        total += t;
+        remaining = dirty_mib * t / resend_ratio;
+
+        if (remaining / bw_mib * 1000.0 <= max_downtime_ms) {
+            e->converges = 1;
+            break;
+        }
+        /* Le reste ne diminue plus : pas de convergence possible */
+        if (dirty_mib / resend_ratio >= bw_mib)
+            break;
+    }
+
+    double downtime_ms = remaining / bw_mib * 1000.0;
+    e->iterations = iter > MAX_PRECOPY_ITERATIONS ? MAX_PRECOPY_ITERATIONS : iter;
+    e->total_s = total + downtime_ms / 1000.0;
+    e->downtime_ms = downtime_ms;
+}
+
+/* Postcopy : un passage de precopy puis les pages restantes à la demande */
+static void estimate_postcopy(struct migration_estimate *e, double mem_mib,
+                              double dirty_mib, double bw_mib) {
+    double first = mem_mib / bw_mib;
+    double dirtied = dirty_mib * first;
+    if (dirtied > mem_mib)
+        dirtied = mem_mib;
+
+    e->converges = 1;
+    e->iterations = 1;
+    e->total_s = first + dirtied / bw_mib;
+    e->downtime_ms = POSTCOPY_SWITCH_MS;
+}
+
+/*
+ * Lance virDomainStartDirtyRateCalc et attend le résultat.
+ * Retourne le dirty rate en MiB/s, ou -1 si l'hyperviseur ne sait pas le mesurer.
+ */
+static long long measure_dirty_rate(virDomainPtr dom, int seconds) {
+    if (TRACE_VIRT(virDomainStartDirtyRateCalc, dom, seconds, 0) < 0) {
+        log_libvirt_error("preflight:virDomainStartDirtyRateCalc");
+        return -1;
+    }
+
+    sleep(seconds);
+
+    virDomainPtr doms[2] = { dom, NULL };
+    /* La mesure peut déborder un peu de la période demandée */
+    for (int attempt = 0; attempt < CALC_POLL_ATTEMPTS; attempt++) {
+        virDomainStatsRecordPtr *records = NULL;
+        if (TRACE_VIRT(virDomainListGetStats, doms, VIR_DOMAIN_STATS_DIRTYRATE, &records, 0) < 0) {
+            log_libvirt_error("preflight:virDomainListGetStats");
+            return -1;
+        }
+
+        int status = 0;
+        long long rate = -1;
+        if (records && records[0]) {
+            virTypedParamsGetInt(records[0]->params, records[0]->nparams,
+                                 "dirtyrate.calc_status", &status);
+            virTypedParamsGetLLong(records[0]->params, records[0]->nparams,
+                                   "dirtyrate.megabytes_per_second", &rate);
+        }
+        virDomainStatsRecordListFree(records);
+
+        if (status == VIR_DOMAIN_DIRTYRATE_MEASURED)
+            return rate < 0 ? 0 : rate;
+        usleep(CALC_POLL_MS * 1000);
+    }
+    return -1;
+}
+
+static cJSON *estimate_to_json(const struct migration_estimate *e) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "profile", e->profile);
+    cJSON_AddBoolToObject(obj, "converges", e->converges);
+    cJSON_AddNumberToObject(obj, "iterations", e->iterations);
+    cJSON_AddNumberToObject(obj, "totalSeconds", e->converges ? e->total_s : -1);
+    cJSON_AddNumberToObject(obj, "downtimeMs", e->converges ? e->downtime_ms : -1);
+    return obj;
+}
+
+/**
+ * POST /migratepreflight
+ * BODY JSON:
+ * {
+ *   "uri": "qemu:///system",
+ *   "vmName": "debian13",
+ *   "bandwidth": 1000,        // optionnel, MiB/s du lien (sinon max speed du domaine)
+ *   "calcSeconds": 3,         // optionnel, durée de mesure du dirty rate (1 à 5 s)
+ *   "maxDowntime": 300,       // optionnel, ms
+ *   "deadline": 600           // optionnel, s : la migration doit finir avant
+ * }
+ *
+ * Retourne le temps total et le downtime prévus pour chaque profil de
+ * /migratevm, et le profil recommandé.
+ */
+char *handle_migratepreflight(const char *post_data) {
+    if (!post_data)
+        return make_json_error("missing body");
+
+    cJSON *root = cJSON_Parse(post_data);
+    if (!root)
+        return make_json_error("invalid JSON");
+
+    cJSON *uri_item = cJSON_GetObjectItem(root, "uri");
+    cJSON *vm_item  = cJSON_GetObjectItem(root, "vmName");
+    if (!cJSON_IsString(uri_item) || !cJSON_IsString(vm_item)) {
+        cJSON_Delete(root);
+        return make_json_error("uri or vmName missing or invalid");
+    }
+
+    double bandwidth = 0;
+    int calc_seconds = DEFAULT_CALC_SECONDS;
+    double max_downtime_ms = DEFAULT_MAX_DOWNTIME_MS;
+    double deadline_s = 0;
+    cJSON *j;
+    if ((j = cJSON_GetObjectItem(root, "bandwidth")) && cJSON_IsNumber(j))
+        bandwidth = j->valuedouble;
+    if ((j = cJSON_GetObjectItem(root, "calcSeconds")) && cJSON_IsNumber(j))
+        calc_seconds = j->valueint;
+    if ((j = cJSON_GetObjectItem(root, "maxDowntime")) && cJSON_IsNumber(j))
+        max_downtime_ms = j->valuedouble;
+    if ((j = cJSON_GetObjectItem(root, "deadline")) && cJSON_IsNumber(j))
+        deadline_s = j->valuedouble;
+
+    if (calc_seconds < 1 || calc_seconds > MAX_CALC_SECONDS ||
+        bandwidth < 0 || max_downtime_ms <= 0) {
+        cJSON_Delete(root);
+        return make_json_error("calcSeconds, bandwidth or maxDowntime out of bounds");
+    }
+
+    virConnectPtr conn = TRACE_VIRT(virConnectOpen, uri_item->valuestring);
+    if (!conn) {
+        log_libvirt_error("preflight:virConnectOpen");
+        cJSON_Delete(root);
+        return make_json_error("cannot connect to source hypervisor");
+    }
+
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, vm_item->valuestring);
+    if (!dom) {
+        log_libvirt_error("preflight:virDomainLookupByName");
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return make_json_error("VM not found on source hypervisor");
+    }
+
+    virDomainInfo info;
+    if (TRACE_VIRT(virDomainGetInfo, dom, &info) < 0 || info.state != VIR_DOMAIN_RUNNING) {
+        virDomainFree(dom);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return make_json_error("VM must be running for a live migration estimate");
+    }
+    double mem_mib = (double)info.memory / 1024.0;
+
+    /* Bande passante : requête > max speed du domaine > lien 1 GbE */
+    const char *bandwidth_source = "request";
+    if (bandwidth <= 0) {
+        unsigned long speed = 0;
+        /* libvirt renvoie une valeur énorme quand il n'y a pas de limite */
+        if (TRACE_VIRT(virDomainMigrateGetMaxSpeed, dom, &speed, 0) == 0 &&
+            speed > 0 && speed < 1024 * 1024) {
+            bandwidth = (double)speed;
+            bandwidth_source = "domain";
+        } else {
+            bandwidth = DEFAULT_LINK_MIB;
+            bandwidth_source = "default";
+        }
+    }
+
+    LOG_INFO("measuring dirty rate of '%s' for %ds",
+             vm_item->valuestring, calc_seconds);
+    long long dirty = measure_dirty_rate(dom, calc_seconds);
+
+    virDomainFree(dom);
+    virConnectClose(conn);
+
+    if (dirty < 0) {
+        cJSON_Delete(root);
+        return make_json_error("dirty rate measurement not supported or failed");
+    }
+
+    /* Estimations par profil, du plus simple au plus intrusif */
+    double single = bandwidth < SINGLE_STREAM_MAX_MIB ? bandwidth : SINGLE_STREAM_MAX_MIB;
+    struct migration_estimate est[4];
+    memset(est, 0, sizeof(est));
+    est[0].profile = "plain";
+    estimate_precopy(&est[0], mem_mib, (double)dirty, single, 1.0, max_downtime_ms);
+    est[1].profile = "multifd";
+    estimate_precopy(&est[1], mem_mib, (double)dirty, bandwidth, 1.0, max_downtime_ms);
+    est[2].profile = "compressed";
+    estimate_precopy(&est[2], mem_mib, (double)dirty, single, XBZRLE_RATIO, max_downtime_ms);
+    est[3].profile = "postcopy";
+    estimate_postcopy(&est[3], mem_mib, (double)dirty, single);
+
+    /* Recommandation : le plus simple qui converge dans la marge du plus rapide */
+    double best_total = -1;
+    for (int i = 0; i < 4; i++) {
+        if (est[i].converges && (best_total < 0 || est[i].total_s < best_total))
+            best_total = est[i].total_s;
+    }
+    const struct migration_estimate *rec = &est[3];
+    for (int i = 0; i < 4; i++) {
+        if (est[i].converges && est[i].total_s <= best_total * PROFILE_SLACK) {
+            rec = &est[i];
+            break;
+        }
+    }
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddStringToObject(resp, "vmName", vm_item->valuestring);
+    cJSON_AddNumberToObject(resp, "memoryMiB", mem_mib);
+    cJSON_AddNumberToObject(resp, "dirtyRateMiBs", (double)dirty);
+    cJSON_AddNumberToObject(resp, "bandwidthMiBs", bandwidth);
+    cJSON_AddStringToObject(resp, "bandwidthSource", bandwidth_source);
+    cJSON_AddNumberToObject(resp, "maxDowntimeMs", max_downtime_ms);
+    cJSON_AddStringToObject(resp, "recommendedProfile", rec->profile);
+    cJSON_AddNumberToObject(resp, "predictedTotalSeconds", rec->total_s);
+    cJSON_AddNumberToObject(resp, "predictedDowntimeMs", rec->downtime_ms);
+    if (deadline_s > 0)
+        cJSON_AddBoolToObject(resp, "fitsDeadline", rec->total_s <= deadline_s);
+
+    cJSON *arr = cJSON_AddArrayToObject(resp, "estimates");
+    for (int i = 0; i < 4; i++)
+        cJSON_AddItemToArray(arr, estimate_to_json(&est[i]));
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    cJSON_Delete(root);
+    return out;
+}
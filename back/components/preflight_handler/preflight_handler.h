@@ -0,0 +1,8 @@
+// preflight_handler.h
+#ifndef PREFLIGHT_HANDLER_H
+#define PREFLIGHT_HANDLER_H
+
+/* Mesure le dirty rate d'une VM et prédit durée / downtime de sa migration */
+char *handle_migratepreflight(const char *post_data);
+
+#endif
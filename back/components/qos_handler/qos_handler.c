@@ -0,0 +1,607 @@
+// qos_handler.c
+#include "qos_handler.h"
+#include "../../libvirt-utils.h"
+#define LOG_COMPONENT "qos"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Disques / interfaces traités au plus par VM */
+#define MAX_QOS_DEVICES 16
+
+enum qos_group {
+    QOS_GROUP_DISK = 0,
+    QOS_GROUP_NET,
+    QOS_GROUP_CPU
+};
+
+static const char *group_names[] = { "disk", "net", "cpu" };
+
+/*
+ * Un champ = une clé JSON dans son groupe + le paramètre libvirt associé.
+ * Pour le disque, le nom du paramètre est aussi celui de l'élément XML
+ * sous <iotune>.
+ */
+static const struct {
+    enum qos_group group;
+    const char *json;
+    const char *param;
+} fields[QOS_NFIELDS] = {
+    [QOS_TOTAL_IOPS]     = { QOS_GROUP_DISK, "totalIops",        VIR_DOMAIN_BLOCK_IOTUNE_TOTAL_IOPS_SEC },
+    [QOS_READ_IOPS]      = { QOS_GROUP_DISK, "readIops",         VIR_DOMAIN_BLOCK_IOTUNE_READ_IOPS_SEC },
+    [QOS_WRITE_IOPS]     = { QOS_GROUP_DISK, "writeIops",        VIR_DOMAIN_BLOCK_IOTUNE_WRITE_IOPS_SEC },
+    [QOS_TOTAL_BYTES]    = { QOS_GROUP_DISK, "totalBytesSec",    VIR_DOMAIN_BLOCK_IOTUNE_TOTAL_BYTES_SEC },
+    [QOS_READ_BYTES]     = { QOS_GROUP_DISK, "readBytesSec",     VIR_DOMAIN_BLOCK_IOTUNE_READ_BYTES_SEC },
+    [QOS_WRITE_BYTES]    = { QOS_GROUP_DISK, "writeBytesSec",    VIR_DOMAIN_BLOCK_IOTUNE_WRITE_BYTES_SEC },
+    [QOS_IN_AVG]         = { QOS_GROUP_NET,  "inboundKBps",      VIR_DOMAIN_BANDWIDTH_IN_AVERAGE },
+    [QOS_IN_PEAK]        = { QOS_GROUP_NET,  "inboundPeakKBps",  VIR_DOMAIN_BANDWIDTH_IN_PEAK },
+    [QOS_OUT_AVG]        = { QOS_GROUP_NET,  "outboundKBps",     VIR_DOMAIN_BANDWIDTH_OUT_AVERAGE },
+    [QOS_OUT_PEAK]       = { QOS_GROUP_NET,  "outboundPeakKBps", VIR_DOMAIN_BANDWIDTH_OUT_PEAK },
+    [QOS_CPU_SHARES]     = { QOS_GROUP_CPU,  "shares",           VIR_DOMAIN_SCHEDULER_CPU_SHARES },
+    [QOS_VCPU_QUOTA_PCT] = { QOS_GROUP_CPU,  "vcpuQuotaPercent", VIR_DOMAIN_SCHEDULER_VCPU_QUOTA },
+};
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("%s: libvirt error (code=%d, domain=%d): %s",
+                  prefix, err->code, err->domain,
+                  err->message ? err->message : "(no message)");
+    } else {
+        LOG_ERROR("%s: unknown libvirt error", prefix);
+    }
+}
+
+static char *make_error_json(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "success", 0);
+    cJSON_AddStringToObject(root, "error", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static int has(const struct vm_qos *q, enum qos_field f) {
+    return (q->set & (1u << f)) != 0;
+}
+
+/* Champ présent avec une valeur non nulle (limite effective) */
+static int limited(const struct vm_qos *q, enum qos_field f) {
+    return has(q, f) && q->val[f] > 0;
+}
+
+static int group_set(const struct vm_qos *q, enum qos_group g) {
+    for (int f = 0; f < QOS_NFIELDS; f++)
+        if (fields[f].group == g && has(q, (enum qos_field)f))
+            return 1;
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Lecture de la requête
+ * -------------------------------------------------------------------------- */
+
+int qos_from_json(const cJSON *item, struct vm_qos *q, char *err, size_t errlen) {
+    memset(q, 0, sizeof(*q));
+    if (!item)
+        return 0;
+    if (!cJSON_IsObject(item)) {
+        snprintf(err, errlen, "qos must be an object");
+        return -1;
+    }
+
+    for (int f = 0; f < QOS_NFIELDS; f++) {
+        const char *gname = group_names[fields[f].group];
+        const cJSON *grp = cJSON_GetObjectItemCaseSensitive(item, gname);
+        if (!grp)
+            continue;
+        if (!cJSON_IsObject(grp)) {
+            snprintf(err, errlen, "qos.%s must be an object", gname);
+            return -1;
+        }
+        const cJSON *v = cJSON_GetObjectItemCaseSensitive(grp, fields[f].json);
+        if (!v)
+            continue;
+        if (!cJSON_IsNumber(v) || v->valuedouble < 0) {
+            snprintf(err, errlen, "invalid qos.%s.%s", gname, fields[f].json);
+            return -1;
+        }
+        /* Débits réseau en unsigned int côté libvirt */
+        if (fields[f].group == QOS_GROUP_NET && v->valuedouble > UINT_MAX) {
+            snprintf(err, errlen, "qos.net.%s out of range", fields[f].json);
+            return -1;
+        }
+        q->val[f] = (unsigned long long)v->valuedouble;
+        q->set |= 1u << f;
+    }
+
+    /* QEMU refuse un total combiné à une limite en lecture ou en écriture */
+    if (limited(q, QOS_TOTAL_IOPS) && (limited(q, QOS_READ_IOPS) || limited(q, QOS_WRITE_IOPS))) {
+        snprintf(err, errlen, "totalIops cannot be combined with readIops/writeIops");
+        return -1;
+    }
+    if (limited(q, QOS_TOTAL_BYTES) && (limited(q, QOS_READ_BYTES) || limited(q, QOS_WRITE_BYTES))) {
+        snprintf(err, errlen, "totalBytesSec cannot be combined with readBytesSec/writeBytesSec");
+        return -1;
+    }
+    if (limited(q, QOS_IN_PEAK) && !limited(q, QOS_IN_AVG)) {
+        snprintf(err, errlen, "inboundPeakKBps requires inboundKBps");
+        return -1;
+    }
+    if (limited(q, QOS_OUT_PEAK) && !limited(q, QOS_OUT_AVG)) {
+        snprintf(err, errlen, "outboundPeakKBps requires outboundKBps");
+        return -1;
+    }
+    /* Bornes cgroup v1 de cpu.shares */
+    if (has(q, QOS_CPU_SHARES) &&
+        (q->val[QOS_CPU_SHARES] < 2 || q->val[QOS_CPU_SHARES] > 262144)) {
+        snprintf(err, errlen, "cpu.shares must be between 2 and 262144");
+        return -1;
+    }
+    /* Un vCPU est un thread : au plus un cœur hôte */
+    if (has(q, QOS_VCPU_QUOTA_PCT) && q->val[QOS_VCPU_QUOTA_PCT] > 100) {
+        snprintf(err, errlen, "cpu.vcpuQuotaPercent must be between 0 and 100");
+        return -1;
+    }
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * XML de création
+ * -------------------------------------------------------------------------- */
+
+static int appendf(char *buf, size_t len, size_t *off, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + *off, len - *off, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= len - *off)
+        return -1;
+    *off += (size_t)n;
+    return 0;
+}
+
+static long long vcpu_quota_us(unsigned long long pct) {
+    return pct ? (long long)(pct * QOS_VCPU_PERIOD_US / 100) : -1;
+}
+
+int qos_xml_fragments(const struct vm_qos *q,
+                      char *iotune, size_t iotune_len,
+                      char *bandwidth, size_t bandwidth_len,
+                      char *cputune, size_t cputune_len) {
+    size_t off;
+    iotune[0] = bandwidth[0] = cputune[0] = '\0';
+
+    off = 0;
+    for (int f = QOS_TOTAL_IOPS; f <= QOS_WRITE_BYTES; f++) {
+        if (!limited(q, (enum qos_field)f))
+            continue;
+        if ((off == 0 && appendf(iotune, iotune_len, &off, "<iotune>") < 0) ||
+            appendf(iotune, iotune_len, &off, "<%s>%llu</%s>",
+                    fields[f].param, q->val[f], fields[f].param) < 0)
+            return -1;
+    }
+    if (off && appendf(iotune, iotune_len, &off, "</iotune>") < 0)
+        return -1;
+
+    off = 0;
+    static const char *dirs[] = { "inbound", "outbound" };
+    for (int d = 0; d < 2; d++) {
+        enum qos_field avg  = d ? QOS_OUT_AVG : QOS_IN_AVG;
+        enum qos_field peak = d ? QOS_OUT_PEAK : QOS_IN_PEAK;
+        if (!limited(q, avg))
+            continue;
+        if ((off == 0 && appendf(bandwidth, bandwidth_len, &off, "<bandwidth>") < 0) ||
+            appendf(bandwidth, bandwidth_len, &off, "<%s average='%llu'", dirs[d], q->val[avg]) < 0 ||
+            (limited(q, peak) &&
+             appendf(bandwidth, bandwidth_len, &off, " peak='%llu'", q->val[peak]) < 0) ||
+            appendf(bandwidth, bandwidth_len, &off, "/>") < 0)
+            return -1;
+    }
+    if (off && appendf(bandwidth, bandwidth_len, &off, "</bandwidth>") < 0)
+        return -1;
+
+    /* Contenu seul : createVM y ajoute le pinning NUMA dans le même <cputune> */
+    off = 0;
+    if ((has(q, QOS_CPU_SHARES) &&
+         appendf(cputune, cputune_len, &off, "<shares>%llu</shares>",
+                 q->val[QOS_CPU_SHARES]) < 0) ||
+        (limited(q, QOS_VCPU_QUOTA_PCT) &&
+         appendf(cputune, cputune_len, &off, "<period>%d</period><quota>%lld</quota>",
+                 QOS_VCPU_PERIOD_US, vcpu_quota_us(q->val[QOS_VCPU_QUOTA_PCT])) < 0))
+        return -1;
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Lecture des limites dans le XML du domaine
+ * -------------------------------------------------------------------------- */
+
+/* Valeur de <name>N</name> dans [p, end) */
+static int elem_ull(const char *p, const char *end, const char *name, unsigned long long *out) {
+    char open[64];
+    snprintf(open, sizeof(open), "<%s>", name);
+    const char *e = strstr(p, open);
+    if (!e || e >= end)
+        return -1;
+    *out = strtoull(e + strlen(open), NULL, 10);
+    return 0;
+}
+
+/* Valeur de l'attribut attr='...' de la balise commençant en tag */
+static int attr_str(const char *tag, const char *attr, char *out, size_t outlen) {
+    const char *close = strchr(tag, '>');
+    char key[64];
+    snprintf(key, sizeof(key), " %s='", attr);
+    const char *a = strstr(tag, key);
+    if (!a || !close || a > close)
+        return -1;
+    a += strlen(key);
+    size_t len = strcspn(a, "'");
+    if (len == 0 || len >= outlen)
+        return -1;
+    memcpy(out, a, len);
+    out[len] = '\0';
+    return 0;
+}
+
+static void add_attr_number(cJSON *obj, const char *key, const char *tag, const char *attr) {
+    char val[32];
+    if (attr_str(tag, attr, val, sizeof(val)) == 0)
+        cJSON_AddNumberToObject(obj, key, (double)strtoull(val, NULL, 10));
+}
+
+/* Cibles (vda, vdb...) des disques device='disk' */
+static int list_disk_targets(const char *xml, char devs[][32], int max) {
+    int n = 0;
+    const char *p = xml;
+    while (n < max && (p = strstr(p, "<disk ")) != NULL) {
+        const char *end = strstr(p, "</disk>");
+        if (!end)
+            break;
+        const char *target = strstr(p, "<target ");
+        if (attr_str(p, "device", devs[n], 32) == 0 && strcmp(devs[n], "disk") == 0 &&
+            target && target < end && attr_str(target, "dev", devs[n], 32) == 0)
+            n++;
+        p = end;
+    }
+    return n;
+}
+
+/* Adresses MAC des interfaces réseau */
+static int list_interface_macs(const char *xml, char macs[][32], int max) {
+    int n = 0;
+    const char *p = xml;
+    while (n < max && (p = strstr(p, "<interface ")) != NULL) {
+        const char *end = strstr(p, "</interface>");
+        if (!end)
+            break;
+        const char *mac = strstr(p, "<mac ");
+        if (mac && mac < end && attr_str(mac, "address", macs[n], 32) == 0)
+            n++;
+        p = end;
+    }
+    return n;
+}
+
+void qos_describe_xml(const char *xml, cJSON *out) {
+    cJSON *qos   = cJSON_AddObjectToObject(out, "qos");
+    cJSON *disks = cJSON_AddObjectToObject(qos, "disks");
+    cJSON *ifs   = cJSON_AddObjectToObject(qos, "interfaces");
+    cJSON *cpu   = cJSON_AddObjectToObject(qos, "cpu");
+    unsigned long long v;
+
+    for (const char *p = xml; (p = strstr(p, "<disk ")) != NULL; ) {
+        const char *end = strstr(p, "</disk>");
+        if (!end)
+            break;
+        char device[32], dev[32];
+        const char *target = strstr(p, "<target ");
+        if (attr_str(p, "device", device, sizeof(device)) == 0 && strcmp(device, "disk") == 0 &&
+            target && target < end && attr_str(target, "dev", dev, sizeof(dev)) == 0) {
+            cJSON *d = cJSON_AddObjectToObject(disks, dev);
+            const char *io = strstr(p, "<iotune>");
+            if (io && io < end) {
+                for (int f = QOS_TOTAL_IOPS; f <= QOS_WRITE_BYTES; f++)
+                    if (elem_ull(io, end, fields[f].param, &v) == 0 && v > 0)
+                        cJSON_AddNumberToObject(d, fields[f].json, (double)v);
+            }
+        }
+        p = end;
+    }
+
+    for (const char *p = xml; (p = strstr(p, "<interface ")) != NULL; ) {
+        const char *end = strstr(p, "</interface>");
+        if (!end)
+            break;
+        char mac_addr[32];
+        const char *mac = strstr(p, "<mac ");
+        if (mac && mac < end && attr_str(mac, "address", mac_addr, sizeof(mac_addr)) == 0) {
+            cJSON *i = cJSON_AddObjectToObject(ifs, mac_addr);
+            const char *in  = strstr(p, "<inbound ");
+            const char *outb = strstr(p, "<outbound ");
+            if (in && in < end) {
+                add_attr_number(i, "inboundKBps", in, "average");
+                add_attr_number(i, "inboundPeakKBps", in, "peak");
+            }
+            if (outb && outb < end) {
+                add_attr_number(i, "outboundKBps", outb, "average");
+                add_attr_number(i, "outboundPeakKBps", outb, "peak");
+            }
+        }
+        p = end;
+    }
+
+    const char *ct = strstr(xml, "<cputune>");
+    const char *ct_end = ct ? strstr(ct, "</cputune>") : NULL;
+    if (ct && ct_end) {
+        if (elem_ull(ct, ct_end, "shares", &v) == 0)
+            cJSON_AddNumberToObject(cpu, "shares", (double)v);
+        unsigned long long period = QOS_VCPU_PERIOD_US;
+        elem_ull(ct, ct_end, "period", &period);
+        char quota[32];
+        const char *qt = strstr(ct, "<quota>");
+        if (qt && qt < ct_end && period > 0) {
+            snprintf(quota, sizeof(quota), "%.*s", (int)strcspn(qt + 7, "<"), qt + 7);
+            long long us = strtoll(quota, NULL, 10);
+            if (us > 0)
+                cJSON_AddNumberToObject(cpu, "vcpuQuotaPercent",
+                                        (double)((unsigned long long)us * 100 / period));
+        }
+    }
+}
+
+void qos_annotate_vms(const char *uri, cJSON *vms) {
+    virConnectPtr conn = libvirt_pool_open(uri);
+    if (!conn) {
+        log_libvirt_error("qos_annotate_vms:libvirt_pool_open");
+        return;
+    }
+    cJSON *vm;
+    cJSON_ArrayForEach(vm, vms) {
+        cJSON *uuid = cJSON_GetObjectItemCaseSensitive(vm, "uuid");
+        if (!cJSON_IsString(uuid))
+            continue;
+        virDomainPtr dom = TRACE_VIRT(virDomainLookupByUUIDString, conn, uuid->valuestring);
+        if (!dom)
+            continue;
+        char *xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+        if (xml) {
+            qos_describe_xml(xml, vm);
+            free(xml);
+        }
+        virDomainFree(dom);
+    }
+    virConnectClose(conn);
+}
+
+/* --------------------------------------------------------------------------
+ * Application à chaud
+ * -------------------------------------------------------------------------- */
+
+/* Live si la VM tourne, config si elle est persistante (les deux sinon rien) */
+static unsigned int affect_flags(virDomainPtr dom) {
+    unsigned int flags = 0;
+    if (TRACE_VIRT(virDomainIsActive, dom) == 1)
+        flags |= VIR_DOMAIN_AFFECT_LIVE;
+    if (TRACE_VIRT(virDomainIsPersistent, dom) == 1)
+        flags |= VIR_DOMAIN_AFFECT_CONFIG;
+    return flags;
+}
+
+static int apply_disk(virDomainPtr dom, const char *dev, const struct vm_qos *q,
+                      unsigned int flags) {
+    virTypedParameterPtr params = NULL;
+    int nparams = 0, maxparams = 0;
+    for (int f = QOS_TOTAL_IOPS; f <= QOS_WRITE_BYTES; f++)
+        if (has(q, (enum qos_field)f))
+            virTypedParamsAddULLong(&params, &nparams, &maxparams, fields[f].param, q->val[f]);
+    int rc = TRACE_VIRT(virDomainSetBlockIoTune, dom, dev, params, nparams, flags);
+    if (rc < 0)
+        log_libvirt_error("virDomainSetBlockIoTune");
+    virTypedParamsFree(params, nparams);
+    return rc;
+}
+
+static int apply_net(virDomainPtr dom, const char *mac, const struct vm_qos *q,
+                     unsigned int flags) {
+    virTypedParameterPtr params = NULL;
+    int nparams = 0, maxparams = 0;
+    for (int f = QOS_IN_AVG; f <= QOS_OUT_PEAK; f++)
+        if (has(q, (enum qos_field)f))
+            virTypedParamsAddUInt(&params, &nparams, &maxparams, fields[f].param,
+                                  (unsigned int)q->val[f]);
+    int rc = TRACE_VIRT(virDomainSetInterfaceParameters, dom, mac, params, nparams, flags);
+    if (rc < 0)
+        log_libvirt_error("virDomainSetInterfaceParameters");
+    virTypedParamsFree(params, nparams);
+    return rc;
+}
+
+static int apply_cpu(virDomainPtr dom, const struct vm_qos *q, unsigned int flags) {
+    virTypedParameterPtr params = NULL;
+    int nparams = 0, maxparams = 0;
+    if (has(q, QOS_CPU_SHARES))
+        virTypedParamsAddULLong(&params, &nparams, &maxparams, VIR_DOMAIN_SCHEDULER_CPU_SHARES,
+                                q->val[QOS_CPU_SHARES]);
+    if (has(q, QOS_VCPU_QUOTA_PCT)) {
+        virTypedParamsAddULLong(&params, &nparams, &maxparams, VIR_DOMAIN_SCHEDULER_VCPU_PERIOD,
+                                QOS_VCPU_PERIOD_US);
+        virTypedParamsAddLLong(&params, &nparams, &maxparams, VIR_DOMAIN_SCHEDULER_VCPU_QUOTA,
+                               vcpu_quota_us(q->val[QOS_VCPU_QUOTA_PCT]));
+    }
+    int rc = TRACE_VIRT(virDomainSetSchedulerParametersFlags, dom, params, nparams, flags);
+    if (rc < 0)
+        log_libvirt_error("virDomainSetSchedulerParametersFlags");
+    virTypedParamsFree(params, nparams);
+    return rc;
+}
+
+/* Parse { uri, vmName } et ouvre le domaine (connexion du pool) */
+static virDomainPtr open_domain(cJSON *root, virConnectPtr *conn_out, char **err_json) {
+    cJSON *uri  = cJSON_GetObjectItemCaseSensitive(root, "uri");
+    cJSON *name = cJSON_GetObjectItemCaseSensitive(root, "vmName");
+    if (!cJSON_IsString(uri) || !cJSON_IsString(name)) {
+        *err_json = make_error_json("missing uri or vmName");
+        return NULL;
+    }
+    virConnectPtr conn = libvirt_pool_open(uri->valuestring);
+    if (!conn) {
+        *err_json = make_error_json("cannot connect to hypervisor");
+        return NULL;
+    }
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, name->valuestring);
+    if (!dom) {
+        virConnectClose(conn);
+        *err_json = make_error_json("domain not found");
+        return NULL;
+    }
+    *conn_out = conn;
+    return dom;
+}
+
+char *handle_vmqos(const char *post_data) {
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    if (!root)
+        return make_error_json("invalid json");
+
+    struct vm_qos q;
+    char err[128];
+    if (qos_from_json(cJSON_GetObjectItemCaseSensitive(root, "qos"), &q, err, sizeof(err)) < 0) {
+        cJSON_Delete(root);
+        return make_error_json(err);
+    }
+    if (!q.set) {
+        cJSON_Delete(root);
+        return make_error_json("no qos value given");
+    }
+    cJSON *disk_item = cJSON_GetObjectItemCaseSensitive(root, "disk");
+    const char *only_disk = cJSON_IsString(disk_item) ? disk_item->valuestring : NULL;
+
+    virConnectPtr conn = NULL;
+    char *err_json = NULL;
+    virDomainPtr dom = open_domain(root, &conn, &err_json);
+    if (!dom) {
+        cJSON_Delete(root);
+        return err_json;
+    }
+
+    char *xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+    if (!xml) {
+        log_libvirt_error("handle_vmqos:virDomainGetXMLDesc");
+        virDomainFree(dom);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return make_error_json("cannot read domain xml");
+    }
+
+    unsigned int flags = affect_flags(dom);
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "vmName", virDomainGetName(dom));
+    cJSON *applied = cJSON_AddArrayToObject(resp, "applied");
+    const char *failed = NULL;
+    char label[64];
+
+    if (group_set(&q, QOS_GROUP_DISK)) {
+        char devs[MAX_QOS_DEVICES][32];
+        int n = list_disk_targets(xml, devs, MAX_QOS_DEVICES), matched = 0;
+        for (int i = 0; i < n && !failed; i++) {
+            if (only_disk && strcmp(devs[i], only_disk) != 0)
+                continue;
+            matched++;
+            if (apply_disk(dom, devs[i], &q, flags) < 0) {
+                failed = "failed to set disk limits";
+                break;
+            }
+            snprintf(label, sizeof(label), "disk:%s", devs[i]);
+            cJSON_AddItemToArray(applied, cJSON_CreateString(label));
+        }
+        if (!matched && !failed)
+            failed = "disk not found";
+    }
+
+    if (!failed && group_set(&q, QOS_GROUP_NET)) {
+        char macs[MAX_QOS_DEVICES][32];
+        int n = list_interface_macs(xml, macs, MAX_QOS_DEVICES);
+        for (int i = 0; i < n; i++) {
+            if (apply_net(dom, macs[i], &q, flags) < 0) {
+                failed = "failed to set network bandwidth";
+                break;
+            }
+            snprintf(label, sizeof(label), "net:%s", macs[i]);
+            cJSON_AddItemToArray(applied, cJSON_CreateString(label));
+        }
+        if (n == 0 && !failed)
+            failed = "no network interface";
+    }
+
+    if (!failed && group_set(&q, QOS_GROUP_CPU)) {
+        if (apply_cpu(dom, &q, flags) < 0)
+            failed = "failed to set cpu scheduler parameters";
+        else
+            cJSON_AddItemToArray(applied, cJSON_CreateString("cpu"));
+    }
+    free(xml);
+
+    cJSON_AddBoolToObject(resp, "success", failed == NULL);
+    if (failed)
+        cJSON_AddStringToObject(resp, "error", failed);
+
+    /* Limites effectives après application (même partielle) */
+    xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+    if (xml) {
+        qos_describe_xml(xml, resp);
+        free(xml);
+    }
+
+    virDomainFree(dom);
+    virConnectClose(conn);
+    cJSON_Delete(root);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+char *handle_vmqosget(const char *post_data) {
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    if (!root)
+        return make_error_json("invalid json");
+
+    virConnectPtr conn = NULL;
+    char *err_json = NULL;
+    virDomainPtr dom = open_domain(root, &conn, &err_json);
+    if (!dom) {
+        cJSON_Delete(root);
+        return err_json;
+    }
+
+    char *xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+    if (!xml) {
+        log_libvirt_error("handle_vmqosget:virDomainGetXMLDesc");
+        virDomainFree(dom);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return make_error_json("cannot read domain xml");
+    }
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddBoolToObject(resp, "success", 1);
+    cJSON_AddStringToObject(resp, "vmName", virDomainGetName(dom));
+    cJSON_AddBoolToObject(resp, "active", TRACE_VIRT(virDomainIsActive, dom) == 1);
+    qos_describe_xml(xml, resp);
+    free(xml);
+
+    virDomainFree(dom);
+    virConnectClose(conn);
+    cJSON_Delete(root);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
@@ -0,0 +1,75 @@
+// qos_handler.h
+#ifndef QOS_HANDLER_H
+#define QOS_HANDLER_H
+
+#include <stddef.h>
+#include <cjson/cJSON.h>
+
+/* Période CFS utilisée pour les quotas vCPU (µs), valeur par défaut du noyau */
+#define QOS_VCPU_PERIOD_US 100000
+
+/* Limites d'une VM ; seuls les champs présents dans "set" sont appliqués */
+enum qos_field {
+    QOS_TOTAL_IOPS = 0,
+    QOS_READ_IOPS,
+    QOS_WRITE_IOPS,
+    QOS_TOTAL_BYTES,
+    QOS_READ_BYTES,
+    QOS_WRITE_BYTES,
+    QOS_IN_AVG,                 /* réseau, KiB/s */
+    QOS_IN_PEAK,
+    QOS_OUT_AVG,
+    QOS_OUT_PEAK,
+    QOS_CPU_SHARES,
+    QOS_VCPU_QUOTA_PCT,         /* % d'un cœur hôte par vCPU, 0 = sans limite */
+    QOS_NFIELDS
+};
+
+struct vm_qos {
+    unsigned long long val[QOS_NFIELDS];
+    unsigned int set;           /* bit (1u << champ) */
+};
+
+/*
+ * Lit un objet "qos" du frontend :
+ *   { "disk": { "totalIops", "readIops", "writeIops",
+ *               "totalBytesSec", "readBytesSec", "writeBytesSec" },
+ *     "net":  { "inboundKBps", "inboundPeakKBps", "outboundKBps", "outboundPeakKBps" },
+ *     "cpu":  { "shares", "vcpuQuotaPercent" } }
+ * Pour le disque et le réseau, 0 retire la limite. Retourne 0, ou -1 avec
+ * un message dans err (valeur négative, total et read/write mélangés...).
+ */
+int qos_from_json(const cJSON *item, struct vm_qos *q, char *err, size_t errlen);
+
+/*
+ * Fragments XML de domaine pour createVM : <iotune> (dans le <disk>),
+ * <bandwidth> (dans l'<interface>) et contenu de <cputune> (sans la balise).
+ * Chaîne vide si rien à poser.
+ * Retourne -1 si un buffer est trop petit.
+ */
+int qos_xml_fragments(const struct vm_qos *q,
+                      char *iotune, size_t iotune_len,
+                      char *bandwidth, size_t bandwidth_len,
+                      char *cputune, size_t cputune_len);
+
+/*
+ * Limites actuelles d'après le XML d'un domaine :
+ *   { "disks": { "vda": {...} }, "net": {...}, "cpu": {...} }
+ * Ajoutées à out sous la clé "qos".
+ */
+void qos_describe_xml(const char *xml, cJSON *out);
+
+/* Ajoute "qos" à chaque VM (clé "uuid") du tableau vms d'un listing */
+void qos_annotate_vms(const char *uri, cJSON *vms);
+
+/*
+ * Applique des limites à chaud (et dans la config persistante) :
+ * { "uri", "vmName", "disk"?: "vda", "qos": {...} }
+ * Sans "disk", les limites disque vont à tous les disques de la VM.
+ */
+char *handle_vmqos(const char *post_data);
+
+/* Limites actuelles d'une VM : { "uri", "vmName" } */
+char *handle_vmqosget(const char *post_data);
+
+#endif
@@ -0,0 +1,362 @@
+// reclaim.c
+#define _GNU_SOURCE                     /* fallocate, FALLOC_FL_* */
+#include "reclaim.h"
+#define LOG_COMPONENT "reclaim"
+#include "../logger/logger.h"
+#include <cjson/cJSON.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * File de suppression des disques : /deletevm undefinie la VM tout de suite
+ * et confie ses fichiers à un unique worker, qui les traite un par un pour
+ * ne pas charger le NFS, avec reprise exponentielle sur erreur.
+ */
+
+enum reclaim_state {
+    RECLAIM_FREE = 0,
+    RECLAIM_PENDING,
+    RECLAIM_RUNNING,
+    RECLAIM_DONE,
+    RECLAIM_FAILED
+};
+
+struct reclaim_task {
+    enum reclaim_state state;
+    int    id;
+    char   vm_name[256];
+    char   path[1024];
+    int    secure;
+    int    attempts;
+    char   error[256];                  /* dernière erreur, "" sinon */
+    time_t queued_at;
+    time_t next_try;
+    time_t finished_at;
+    unsigned long long bytes_total;
+    unsigned long long bytes_done;
+};
+
+static struct reclaim_task tasks[MAX_RECLAIM_TASKS];
+static int next_task_id = 1;
+static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  tasks_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t  worker_once = PTHREAD_ONCE_INIT;
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static const char *state_name(enum reclaim_state state) {
+    switch (state) {
+    case RECLAIM_PENDING: return "pending";
+    case RECLAIM_RUNNING: return "running";
+    case RECLAIM_DONE:    return "done";
+    case RECLAIM_FAILED:  return "failed";
+    default:              return "unknown";
+    }
+}
+
+static int task_is_active(const struct reclaim_task *t) {
+    return t->state == RECLAIM_PENDING || t->state == RECLAIM_RUNNING;
+}
+
+/* --------------------------------------------------------------------------
+ * Suppression d'un fichier
+ * -------------------------------------------------------------------------- */
+
+static void set_progress(struct reclaim_task *t, unsigned long long total,
+                         unsigned long long done) {
+    pthread_mutex_lock(&tasks_lock);
+    t->bytes_total = total;
+    t->bytes_done = done;
+    pthread_mutex_unlock(&tasks_lock);
+}
+
+/* Écrase [0, size) avec des zéros, puis rend les blocs au stockage si possible */
+static int secure_discard(struct reclaim_task *t, int fd, unsigned long long size) {
+    char *zeros = calloc(1, RECLAIM_CHUNK_BYTES);
+    if (!zeros)
+        return -1;
+
+    int punch = 1;
+    for (unsigned long long off = 0; off < size; off += RECLAIM_CHUNK_BYTES) {
+        size_t len = size - off < RECLAIM_CHUNK_BYTES ? (size_t)(size - off) : RECLAIM_CHUNK_BYTES;
+        for (size_t w = 0; w < len; ) {
+            ssize_t n = pwrite(fd, zeros + w, len - w, (off_t)(off + w));
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                free(zeros);
+                return -1;
+            }
+            w += (size_t)n;
+        }
+        if (fdatasync(fd) < 0) {
+            free(zeros);
+            return -1;
+        }
+        // Désallocation (DEALLOCATE en NFS 4.2) ; ignorée si non supportée
+        if (punch && fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                               (off_t)off, (off_t)len) < 0)
+            punch = 0;
+        set_progress(t, size, off + len);
+    }
+    free(zeros);
+    return 0;
+}
+
+/*
+ * Supprime le fichier par troncatures successives puis unlink : chaque
+ * appel libère au plus RECLAIM_CHUNK_BYTES côté serveur NFS.
+ * Retourne 0 (fichier absent compris) ou -1 avec errno.
+ */
+static int remove_disk_file(struct reclaim_task *t) {
+    int fd = open(t->path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return errno == ENOENT ? 0 : -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        int saved = errno ? errno : EINVAL;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    unsigned long long size = (unsigned long long)st.st_size;
+    set_progress(t, size, 0);
+
+    if (t->secure && secure_discard(t, fd, size) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    unsigned long long left = size;
+    while (left > 0) {
+        left = left > RECLAIM_CHUNK_BYTES ? left - RECLAIM_CHUNK_BYTES : 0;
+        if (ftruncate(fd, (off_t)left) < 0) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+        if (!t->secure)
+            set_progress(t, size, size - left);
+    }
+    close(fd);
+
+    if (unlink(t->path) < 0 && errno != ENOENT)
+        return -1;
+    set_progress(t, size, size);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Worker
+ * -------------------------------------------------------------------------- */
+
+/* Tâche due la plus ancienne ; sinon *wake = prochaine échéance (tasks_lock tenu) */
+static struct reclaim_task *next_due(time_t now, time_t *wake) {
+    struct reclaim_task *best = NULL;
+    *wake = 0;
+    for (int i = 0; i < MAX_RECLAIM_TASKS; i++) {
+        struct reclaim_task *t = &tasks[i];
+        if (t->state != RECLAIM_PENDING)
+            continue;
+        if (t->next_try <= now) {
+            if (!best || t->id < best->id)
+                best = t;
+        } else if (!*wake || t->next_try < *wake) {
+            *wake = t->next_try;
+        }
+    }
+    return best;
+}
+
+static void *reclaim_worker_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&tasks_lock);
+        struct reclaim_task *t;
+        time_t wake;
+        while (!(t = next_due(time(NULL), &wake))) {
+            if (wake) {
+                struct timespec deadline = { .tv_sec = wake, .tv_nsec = 0 };
+                pthread_cond_timedwait(&tasks_cond, &tasks_lock, &deadline);
+            } else {
+                pthread_cond_wait(&tasks_cond, &tasks_lock);
+            }
+        }
+        t->state = RECLAIM_RUNNING;
+        t->attempts++;
+        pthread_mutex_unlock(&tasks_lock);
+
+        LOG_INFO("task %d: removing %s (attempt %d%s)",
+                 t->id, t->path, t->attempts, t->secure ? ", secure" : "");
+
+        errno = 0;
+        int rc = remove_disk_file(t);
+        int saved = errno;
+        int gave_up = 0;
+
+        pthread_mutex_lock(&tasks_lock);
+        if (rc == 0) {
+            t->state = RECLAIM_DONE;
+            t->error[0] = '\0';
+            t->finished_at = time(NULL);
+        } else {
+            snprintf(t->error, sizeof(t->error), "%s", strerror(saved));
+            if (t->attempts >= RECLAIM_MAX_ATTEMPTS) {
+                t->state = RECLAIM_FAILED;
+                t->finished_at = time(NULL);
+                gave_up = 1;
+            } else {
+                t->state = RECLAIM_PENDING;
+                t->next_try = time(NULL) + ((time_t)RECLAIM_RETRY_BASE_S << (t->attempts - 1));
+            }
+        }
+        pthread_mutex_unlock(&tasks_lock);
+
+        if (rc != 0)
+            LOG_INFO("task %d: %s: %s%s", t->id, t->path, strerror(saved),
+                     gave_up ? " (giving up)" : ", will retry");
+    }
+    return NULL;
+}
+
+static void start_worker(void) {
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, reclaim_worker_thread, NULL) != 0)
+        LOG_ERROR("cannot start worker thread");
+    pthread_attr_destroy(&attr);
+}
+
+/* --------------------------------------------------------------------------
+ * API
+ * -------------------------------------------------------------------------- */
+
+int reclaim_enqueue(const char *vm_name, const char *path, int secure) {
+    pthread_once(&worker_once, start_worker);
+
+    pthread_mutex_lock(&tasks_lock);
+
+    // Slot libre, sinon la tâche terminée la plus ancienne
+    struct reclaim_task *slot = NULL;
+    for (int i = 0; i < MAX_RECLAIM_TASKS; i++) {
+        struct reclaim_task *t = &tasks[i];
+        if (t->state == RECLAIM_FREE) {
+            slot = t;
+            break;
+        }
+        if (!task_is_active(t) && (!slot || t->finished_at < slot->finished_at))
+            slot = t;
+    }
+    if (!slot) {
+        pthread_mutex_unlock(&tasks_lock);
+        return -1;
+    }
+
+    memset(slot, 0, sizeof(*slot));
+    slot->id = next_task_id++;
+    slot->state = RECLAIM_PENDING;
+    slot->secure = secure;
+    slot->queued_at = time(NULL);
+    slot->next_try = slot->queued_at;
+    snprintf(slot->vm_name, sizeof(slot->vm_name), "%s", vm_name);
+    snprintf(slot->path, sizeof(slot->path), "%s", path);
+
+    int id = slot->id;
+    pthread_cond_signal(&tasks_cond);
+    pthread_mutex_unlock(&tasks_lock);
+    return id;
+}
+
+static cJSON *task_to_json(const struct reclaim_task *t) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "taskId", t->id);
+    cJSON_AddStringToObject(obj, "vmName", t->vm_name);
+    cJSON_AddStringToObject(obj, "path", t->path);
+    cJSON_AddStringToObject(obj, "state", state_name(t->state));
+    cJSON_AddBoolToObject(obj, "secure", t->secure);
+    cJSON_AddNumberToObject(obj, "attempts", t->attempts);
+    if (t->error[0])
+        cJSON_AddStringToObject(obj, "error", t->error);
+    cJSON_AddNumberToObject(obj, "queuedAt", (double)t->queued_at);
+    if (t->state == RECLAIM_PENDING && t->attempts > 0)
+        cJSON_AddNumberToObject(obj, "nextTry", (double)t->next_try);
+    if (t->finished_at)
+        cJSON_AddNumberToObject(obj, "finishedAt", (double)t->finished_at);
+    cJSON_AddNumberToObject(obj, "bytesTotal", (double)t->bytes_total);
+    cJSON_AddNumberToObject(obj, "bytesDone", (double)t->bytes_done);
+    return obj;
+}
+
+/**
+ * POST /reclaimstatus
+ * BODY JSON (optionnel) :
+ * {
+ *   "taskId": 12,          // une tâche
+ *   "vmName": "debian13"   // ou les tâches d'une VM
+ * }
+ *
+ * Réponse : { "status": "ok", "tasks": [ { "taskId", "path", "state":
+ *   "pending"|"running"|"done"|"failed", "attempts", "error", ... } ] }
+ */
+char *handle_reclaimstatus(const char *post_data) {
+    int task_id = -1;
+    char vm_name[256] = "";
+
+    if (post_data && post_data[0]) {
+        cJSON *root = cJSON_Parse(post_data);
+        if (!root)
+            return make_json_error("invalid JSON");
+        cJSON *id_item = cJSON_GetObjectItem(root, "taskId");
+        cJSON *vm_item = cJSON_GetObjectItem(root, "vmName");
+        if (cJSON_IsNumber(id_item))
+            task_id = id_item->valueint;
+        if (cJSON_IsString(vm_item))
+            snprintf(vm_name, sizeof(vm_name), "%s", vm_item->valuestring);
+        cJSON_Delete(root);
+    }
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON *arr = cJSON_AddArrayToObject(resp, "tasks");
+    int pending = 0;
+
+    pthread_mutex_lock(&tasks_lock);
+    for (int i = 0; i < MAX_RECLAIM_TASKS; i++) {
+        const struct reclaim_task *t = &tasks[i];
+        if (t->state == RECLAIM_FREE)
+            continue;
+        if (task_is_active(t))
+            pending++;
+        if ((task_id >= 0 && t->id != task_id) ||
+            (vm_name[0] && strcmp(t->vm_name, vm_name) != 0))
+            continue;
+        cJSON_AddItemToArray(arr, task_to_json(t));
+    }
+    pthread_mutex_unlock(&tasks_lock);
+    cJSON_AddNumberToObject(resp, "pending", pending);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
@@ -0,0 +1,29 @@
+// reclaim.h
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+/* Nombre max de suppressions gardées en mémoire (en attente + terminées) */
+#define MAX_RECLAIM_TASKS 256
+
+/* Tentatives avant abandon ; délai avant la 2e tentative, doublé ensuite (s) */
+#define RECLAIM_MAX_ATTEMPTS 5
+#define RECLAIM_RETRY_BASE_S 30
+
+/*
+ * Taille des pas de troncature / d'effacement (octets) : chaque appel
+ * système sur le NFS reste court, même pour un disque de plusieurs centaines
+ * de Go.
+ */
+#define RECLAIM_CHUNK_BYTES (256ULL << 20)
+
+/*
+ * Met en file la suppression d'un fichier disque d'une VM déjà undefinie.
+ * Avec secure != 0, le contenu est écrasé (zéros) puis désalloué avant la
+ * suppression. Retourne l'id de la tâche, ou -1 si la file est pleine.
+ */
+int reclaim_enqueue(const char *vm_name, const char *path, int secure);
+
+/* État des suppressions : toutes, celles d'une VM ("vmName") ou une seule ("taskId") */
+char *handle_reclaimstatus(const char *post_data);
+
+#endif
@@ -5,22 +5,47 @@
 #include "../vm_actions_handler/vm_actions_handler.h"   
 #include "../session_handler_console/session_handler_console.h"         // <-- AJOUT POUR handle_consolevm()
 #include "../migratevm_handler/migratevm_handler.h"
+#include "../evacuate_handler/evacuate_handler.h"
+#include "../preflight_handler/preflight_handler.h"
+#include "../placement/placement.h"
+#include "../vmstats_handler/vmstats_handler.h"
+#include "../fleet_handler/fleet_handler.h"
+#include "../snapshot_handler/snapshot_handler.h"
+#include "../backup_handler/backup_handler.h"
+#include "../reclaim/reclaim.h"
+#include "../maintenance_handler/maintenance_handler.h"
+#include "../qos_handler/qos_handler.h"
+#include "../balloon/balloon.h"
+#include "../numa/numa.h"
+#include "../admission/admission.h"
+#include "../hostinfo/hostinfo.h"
+#include "../static_files/static_files.h"
+#define LOG_COMPONENT "http"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
 #include <microhttpd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define POSTBUFFERSIZE 512*1024
 
+/* Connexions simultanées (un thread chacune) */
+#define MAX_CONNECTIONS 256
+
 struct connection_info_struct {
     char *post_data;
     size_t post_size;
+    char request_id[LOG_REQUEST_ID_LEN];
+    struct timespec started;
 };
 
 /**
- * Envoie une réponse JSON avec CORS
+ * Envoie une réponse JSON avec CORS ; retry_after > 0 ajoute Retry-After (429)
  */
-static int send_json(struct MHD_Connection *connection, const char *json, int status_code) {
+static int send_json_retry(struct MHD_Connection *connection, const char *json, int status_code,
+                           int retry_after) {
     struct MHD_Response *response = MHD_create_response_from_buffer(
         strlen(json), (void *)json, MHD_RESPMEM_MUST_COPY);
 
@@ -30,14 +55,26 @@ static int send_json(struct MHD_Connection *connection, const char *json, int st
     MHD_add_response_header(response, "Content-Type", "application/json");
     MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
     MHD_add_response_header(response, "Access-Control-Allow-Methods", "GET, POST, OPTIONS");
-    MHD_add_response_header(response, "Access-Control-Allow-Headers", "Content-Type, Authorization");
+    MHD_add_response_header(response, "Access-Control-Allow-Headers", "Content-Type, Authorization, X-Request-Id");
+    MHD_add_response_header(response, "Access-Control-Expose-Headers", "X-Request-Id, Retry-After");
     MHD_add_response_header(response, "Access-Control-Max-Age", "86400");
+    if (log_request_id()[0])
+        MHD_add_response_header(response, "X-Request-Id", log_request_id());
+    if (retry_after > 0) {
+        char value[16];
+        snprintf(value, sizeof(value), "%d", retry_after);
+        MHD_add_response_header(response, "Retry-After", value);
+    }
 
     int ret = MHD_queue_response(connection, status_code, response);
     MHD_destroy_response(response);
     return ret;
 }
 
+static int send_json(struct MHD_Connection *connection, const char *json, int status_code) {
+    return send_json_retry(connection, json, status_code, 0);
+}
+
 /**
  * Handler principal HTTP
  */
@@ -51,7 +88,7 @@ static enum MHD_Result answer_to_connection(void *cls, struct MHD_Connection *co
         struct MHD_Response *resp = MHD_create_response_from_buffer(0, "", MHD_RESPMEM_PERSISTENT);
         MHD_add_response_header(resp, "Access-Control-Allow-Origin", "*");
         MHD_add_response_header(resp, "Access-Control-Allow-Methods", "GET, POST, OPTIONS");
-        MHD_add_response_header(resp, "Access-Control-Allow-Headers", "Content-Type, Authorization");
+        MHD_add_response_header(resp, "Access-Control-Allow-Headers", "Content-Type, Authorization, X-Request-Id");
         MHD_add_response_header(resp, "Access-Control-Max-Age", "86400");
         int ret = MHD_queue_response(connection, MHD_HTTP_OK, resp);
         MHD_destroy_response(resp);
@@ -63,6 +100,14 @@ static enum MHD_Result answer_to_connection(void *cls, struct MHD_Connection *co
         struct connection_info_struct *con_info = malloc(sizeof(struct connection_info_struct));
         con_info->post_data = NULL;
         con_info->post_size = 0;
+        clock_gettime(CLOCK_MONOTONIC, &con_info->started);
+
+        // Identifiant de corrélation : repris du client s'il en fournit un
+        const char *rid = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "X-Request-Id");
+        if (rid && rid[0])
+            snprintf(con_info->request_id, sizeof(con_info->request_id), "%s", rid);
+        else
+            log_new_request_id(con_info->request_id, sizeof(con_info->request_id));
         *con_cls = con_info;
         return MHD_YES;
     }
@@ -82,7 +127,45 @@ static enum MHD_Result answer_to_connection(void *cls, struct MHD_Connection *co
         return MHD_YES;
     }
 
+    //
+    // ------ FRONTEND (GET/HEAD) ------
+    //
+    if (strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0) {
+        unsigned int status = 0;
+        uint64_t bytes = 0;
+        int ret = static_files_serve(connection, url, &status, &bytes);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        LOG_DEBUG("%s %s %u, %llu bytes out, %ld ms", method, url, status,
+                  (unsigned long long)bytes,
+                  (now.tv_sec - con_info->started.tv_sec) * 1000 +
+                  (now.tv_nsec - con_info->started.tv_nsec) / 1000000);
+        free(con_info->post_data);
+        free(con_info);
+        *con_cls = NULL;
+        return ret;
+    }
+
     char *response_json = NULL;
+    log_set_request_id(con_info->request_id);
+    uint64_t trace_t0 = trace_begin();
+
+    //
+    // ------ ADMISSION ------
+    //
+    struct admission_ticket ticket = { -1, 0, 0 };
+    int retry_after = 0;
+    if (strcmp(method, "POST") == 0 &&
+        admission_enter(url, con_info->post_data, &ticket, &retry_after) < 0) {
+        int ret = send_json_retry(connection, "{\"success\":false,\"error\":\"too many requests\"}",
+                                  MHD_HTTP_TOO_MANY_REQUESTS, retry_after);
+        log_set_request_id(NULL);
+        free(con_info->post_data);
+        free(con_info);
+        *con_cls = NULL;
+        return ret;
+    }
 
     //
     // ------ ROUTING ------
@@ -107,14 +190,139 @@ static enum MHD_Result answer_to_connection(void *cls, struct MHD_Connection *co
         } else if (strcmp(url, "/shutdownvm") == 0) {
             response_json = handle_shutdownvm(con_info->post_data);
 
+        } else if (strcmp(url, "/pausevm") == 0) {
+            response_json = handle_pausevm(con_info->post_data);
+
+        } else if (strcmp(url, "/resumevm") == 0) {
+            response_json = handle_resumevm(con_info->post_data);
+
+        } else if (strcmp(url, "/suspendvm") == 0) {
+            response_json = handle_suspendvm(con_info->post_data);
+        } else if (strcmp(url, "/resizevm") == 0) {
+            response_json = handle_resizevm(con_info->post_data);
+
         } else if (strcmp(url, "/deletevm") == 0) {
             response_json = handle_deletevm(con_info->post_data);
 
+        } else if (strcmp(url, "/reclaimstatus") == 0) {
+            response_json = handle_reclaimstatus(con_info->post_data);
+
         } else if (strcmp(url, "/consolevm") == 0) {    
             response_json = handle_consolevm(con_info->post_data);
 
         } else if (strcmp(url, "/migratevm") == 0) {
             response_json = handle_migratevm(con_info->post_data);
+
+        } else if (strcmp(url, "/migratestatus") == 0) {
+            response_json = handle_migratestatus(con_info->post_data);
+
+        } else if (strcmp(url, "/migratecancel") == 0) {
+            response_json = handle_migratecancel(con_info->post_data);
+
+        } else if (strcmp(url, "/migratepreflight") == 0) {
+            response_json = handle_migratepreflight(con_info->post_data);
+
+        } else if (strcmp(url, "/evacuatehost") == 0) {
+            response_json = handle_evacuatehost(con_info->post_data);
+
+        } else if (strcmp(url, "/evacuatestatus") == 0) {
+            response_json = handle_evacuatestatus(con_info->post_data);
+
+        } else if (strcmp(url, "/evacuatecancel") == 0) {
+            response_json = handle_evacuatecancel(con_info->post_data);
+
+        } else if (strcmp(url, "/evacuateretry") == 0) {
+            response_json = handle_evacuateretry(con_info->post_data);
+
+        } else if (strcmp(url, "/hosts") == 0) {
+            response_json = handle_hosts(con_info->post_data);
+
+        } else if (strcmp(url, "/registerhost") == 0) {
+            response_json = handle_registerhost(con_info->post_data);
+
+        } else if (strcmp(url, "/unregisterhost") == 0) {
+            response_json = handle_unregisterhost(con_info->post_data);
+
+        } else if (strcmp(url, "/besthost") == 0) {
+            response_json = handle_besthost(con_info->post_data);
+
+        } else if (strcmp(url, "/vmstats") == 0) {
+            response_json = handle_vmstats(con_info->post_data);
+
+        } else if (strcmp(url, "/fleetvms") == 0) {
+            response_json = handle_fleetvms(con_info->post_data);
+
+        } else if (strcmp(url, "/snapshotcreate") == 0) {
+            response_json = handle_snapshotcreate(con_info->post_data);
+
+        } else if (strcmp(url, "/snapshotlist") == 0) {
+            response_json = handle_snapshotlist(con_info->post_data);
+
+        } else if (strcmp(url, "/snapshotrevert") == 0) {
+            response_json = handle_snapshotrevert(con_info->post_data);
+
+        } else if (strcmp(url, "/snapshotdelete") == 0) {
+            response_json = handle_snapshotdelete(con_info->post_data);
+
+        } else if (strcmp(url, "/backupstart") == 0) {
+            response_json = handle_backupstart(con_info->post_data);
+
+        } else if (strcmp(url, "/backupstatus") == 0) {
+            response_json = handle_backupstatus(con_info->post_data);
+
+        } else if (strcmp(url, "/backupcancel") == 0) {
+            response_json = handle_backupcancel(con_info->post_data);
+
+        } else if (strcmp(url, "/backuplist") == 0) {
+            response_json = handle_backuplist(con_info->post_data);
+
+        } else if (strcmp(url, "/backupschedule") == 0) {
+            response_json = handle_backupschedule(con_info->post_data);
+
+        } else if (strcmp(url, "/blockmaint") == 0) {
+            response_json = handle_blockmaint(con_info->post_data);
+
+        } else if (strcmp(url, "/blockjobstatus") == 0) {
+            response_json = handle_blockjobstatus(con_info->post_data);
+
+        } else if (strcmp(url, "/blockjobspeed") == 0) {
+            response_json = handle_blockjobspeed(con_info->post_data);
+
+        } else if (strcmp(url, "/blockjobcancel") == 0) {
+            response_json = handle_blockjobcancel(con_info->post_data);
+
+        } else if (strcmp(url, "/blockmaintschedule") == 0) {
+            response_json = handle_blockmaintschedule(con_info->post_data);
+
+        } else if (strcmp(url, "/vmqos") == 0) {
+            response_json = handle_vmqos(con_info->post_data);
+        } else if (strcmp(url, "/vmqosget") == 0) {
+            response_json = handle_vmqosget(con_info->post_data);
+
+        } else if (strcmp(url, "/balloonconfig") == 0) {
+            response_json = handle_balloonconfig(con_info->post_data);
+        } else if (strcmp(url, "/balloonstatus") == 0) {
+            response_json = handle_balloonstatus(con_info->post_data);
+
+        } else if (strcmp(url, "/numaconfig") == 0) {
+            response_json = handle_numaconfig(con_info->post_data);
+        } else if (strcmp(url, "/numastatus") == 0) {
+            response_json = handle_numastatus(con_info->post_data);
+        } else if (strcmp(url, "/numapin") == 0) {
+            response_json = handle_numapin(con_info->post_data);
+
+        } else if (strcmp(url, "/hostinfo") == 0) {
+            response_json = handle_hostinfo(con_info->post_data);
+
+        } else if (strcmp(url, "/loglevel") == 0) {
+            response_json = handle_loglevel(con_info->post_data);
+        } else if (strcmp(url, "/traces") == 0) {
+            response_json = handle_traces(con_info->post_data);
+
+        } else if (strcmp(url, "/admissionconfig") == 0) {
+            response_json = handle_admissionconfig(con_info->post_data);
+        } else if (strcmp(url, "/admissionstatus") == 0) {
+            response_json = handle_admissionstatus(con_info->post_data);
         }  else {
             response_json = strdup("{\"error\":\"not found\"}");
         }
@@ -126,8 +334,18 @@ static enum MHD_Result answer_to_connection(void *cls, struct MHD_Connection *co
     //
     // ------ RÉPONSE ------
     //
+    admission_leave(&ticket);
+    trace_end_detail("http", url, trace_t0, method);
     int ret = send_json(connection, response_json, MHD_HTTP_OK);
 
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    LOG_INFO("%s %s %zu bytes in, %zu bytes out, %ld ms", method, url, con_info->post_size,
+             strlen(response_json),
+             (now.tv_sec - con_info->started.tv_sec) * 1000 +
+             (now.tv_nsec - con_info->started.tv_nsec) / 1000000);
+    log_set_request_id(NULL);
+
     free(response_json);
     free(con_info->post_data);
     free(con_info);
@@ -141,16 +359,25 @@ static enum MHD_Result answer_to_connection(void *cls, struct MHD_Connection *co
  */
 int start_http_server(int port) {
     struct MHD_Daemon *daemon = MHD_start_daemon(
-        MHD_USE_SELECT_INTERNALLY | MHD_USE_POLL,
+        MHD_USE_THREAD_PER_CONNECTION | MHD_USE_SELECT_INTERNALLY | MHD_USE_POLL,
         port,
         NULL, NULL,
         &answer_to_connection, NULL,
+        MHD_OPTION_CONNECTION_LIMIT, (unsigned int)MAX_CONNECTIONS,
         MHD_OPTION_END);
 
     if (!daemon) return 1;
 
     printf("HTTP server running on http://0.0.0.0:%d\n", port);
-    printf("Routes: POST /connect, /listallvms, /createvm, /startvm, /stopvm, /shutdownvm, /deletevm, /consolevm\n");
+    printf("Routes: POST /connect, /listallvms, /createvm, /startvm, /stopvm, /shutdownvm, /pausevm, /resumevm, /suspendvm, /resizevm, /deletevm, /reclaimstatus, /consolevm, /migratevm, /migratestatus, /migratecancel, /migratepreflight\n");
+    printf("        /evacuatehost, /evacuatestatus, /evacuatecancel, /evacuateretry\n");
+    printf("        /hosts, /registerhost, /unregisterhost, /besthost, /vmstats, /fleetvms\n");
+    printf("        /snapshotcreate, /snapshotlist, /snapshotrevert, /snapshotdelete\n");
+    printf("        /backupstart, /backupstatus, /backupcancel, /backuplist, /backupschedule\n");
+    printf("        /blockmaint, /blockjobstatus, /blockjobspeed, /blockjobcancel, /blockmaintschedule\n");
+    printf("        /vmqos, /vmqosget, /balloonconfig, /balloonstatus\n");
+    printf("        /numaconfig, /numastatus, /numapin, /hostinfo, /loglevel, /traces, /admissionconfig, /admissionstatus\n");
+    printf("GET     /* : frontend (FRONT_DIST, %s by default)\n", STATIC_DEFAULT_ROOT);
 
     getchar();
     MHD_stop_daemon(daemon);
@@ -6,14 +6,20 @@
 #include <libvirt/virterror.h>
 #include <cjson/cJSON.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "../domdesc/domdesc.h"
+#define LOG_COMPONENT "console"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
 
 static void log_libvirt_error(const char *prefix) {
     virErrorPtr err = virGetLastError();
     if (err) {
-        fprintf(stderr, "[%s] Libvirt error: %s (code=%d domain=%d)\n",
-                prefix, err->message, err->code, err->domain);
+        LOG_ERROR("[%s] Libvirt error: %s (code=%d domain=%d)",
+                  prefix, err->message, err->code, err->domain);
     } else {
-        fprintf(stderr, "[%s] Unknown libvirt error\n", prefix);
+        LOG_ERROR("[%s] Unknown libvirt error", prefix);
     }
 }
 
@@ -37,18 +43,38 @@ static char *make_json_console(const char *vmName, int wsPort) {
     return out;
 }
 
+#define WS_PORT_FIRST 6900
+#define WS_PORT_COUNT 100
+
+/* Délai laissé à novnc_proxy pour écouter sur un port attribué (s) */
+#define WS_PORT_RESERVE_S 30
+
+// Ports rendus récemment : pas encore visibles dans ss, réservés sous verrou
+static time_t ws_reserved[WS_PORT_COUNT];
+static pthread_mutex_t ws_lock = PTHREAD_MUTEX_INITIALIZER;
+
 // Choose free port for websocket (novnc)
 int get_free_port() {
-    for (int p = 6900; p < 7000; p++) {
+    pthread_mutex_lock(&ws_lock);
+    time_t now = time(NULL);
+    for (int i = 0; i < WS_PORT_COUNT; i++) {
+        int p = WS_PORT_FIRST + i;
+        if (ws_reserved[i] && now - ws_reserved[i] < WS_PORT_RESERVE_S)
+            continue;
         char cmd[256];
         snprintf(cmd, sizeof(cmd), "ss -ltn | grep -q ':%d'", p);
-        if (system(cmd) != 0) return p;
+        if (TRACE_CALL("exec", "ss", system(cmd)) != 0) {
+            ws_reserved[i] = now;
+            pthread_mutex_unlock(&ws_lock);
+            return p;
+        }
     }
+    pthread_mutex_unlock(&ws_lock);
     return -1;
 }
 
 char *handle_consolevm(const char *post_data) {
-    fprintf(stderr, "[handle_consolevm] BODY=%s\n", post_data);
+    LOG_DEBUG("[handle_consolevm] BODY=%s", post_data);
     if (!post_data)
         return make_json_error("missing body");
 
@@ -72,58 +98,47 @@ char *handle_consolevm(const char *post_data) {
     cJSON_Delete(root);
 
     // connect hypervisor
-    virConnectPtr conn = virConnectOpen(uri);
+    virConnectPtr conn = TRACE_VIRT(virConnectOpen, uri);
     if (!conn) {
         log_libvirt_error("virConnectOpen");
         return make_json_error("cannot connect hypervisor");
     }
 
-    virDomainPtr dom = virDomainLookupByName(conn, vmName);
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, vmName);
     if (!dom) {
         log_libvirt_error("virDomainLookupByName");
         virConnectClose(conn);
         return make_json_error("domain not found");
     }
 
-    char *xml = virDomainGetXMLDesc(dom, 0);
-    if (!xml) {
-        log_libvirt_error("virDomainGetXMLDesc");
+    // port VNC lu dans le descripteur du domaine (cache invalidé au démarrage)
+    struct domdesc *desc = malloc(sizeof(*desc));
+    if (!desc || domdesc_get(uri, dom, 0, desc) < 0) {
+        free(desc);
         virDomainFree(dom);
         virConnectClose(conn);
         return make_json_error("cannot get domain XML");
     }
 
-    // 🔥 look for the RIGHT <graphics type='vnc' ...> block
-    char *gfx = strstr(xml, "<graphics type='vnc'");
-    if (!gfx) gfx = strstr(xml, "<graphics type=\"vnc\"");
-    if (!gfx) {
-        free(xml);
+    const struct domdesc_graphics *vnc = domdesc_graphics(desc, "vnc");
+    if (!vnc) {
+        free(desc);
         virDomainFree(dom);
         virConnectClose(conn);
         return make_json_error("VM has no VNC graphics");
     }
 
-    char *portPtr = strstr(gfx, "port='");
-    if (!portPtr) portPtr = strstr(gfx, "port=\"");
-    if (!portPtr) {
-        free(xml);
-        virDomainFree(dom);
-        virConnectClose(conn);
-        return make_json_error("cannot find VNC port attribute");
-    }
-
-    portPtr += 6;
-    int vncPort = atoi(portPtr);
-    fprintf(stderr, "[consolevm] Extracted VNC port=%d\n", vncPort);
+    int vncPort = vnc->port;
+    free(desc);
+    LOG_DEBUG("Extracted VNC port=%d", vncPort);
 
     // ❗ IF port is -1 or 0, libvirt is in autoport mode
     // In this case, FORCE a static port (e.g. 5901)
     if (vncPort <= 0) {
-        fprintf(stderr, "[consolevm] WARNING: autoport mode detected, forcing static port 5901\n");
+        LOG_WARN("autoport mode detected, forcing static port 5901");
         vncPort = 5901;
     }
 
-    free(xml);
     virDomainFree(dom);
     virConnectClose(conn);
 
@@ -141,11 +156,11 @@ char *handle_consolevm(const char *post_data) {
         ">/dev/null 2>&1 &",
         vncPort, wsPort);
 
-    fprintf(stderr, "[consolevm] Launching: %s\n", cmd);
-    system(cmd);
+    LOG_DEBUG("Launching: %s", cmd);
+    TRACE_CALL("exec", "websockify", system(cmd));
 
-    fprintf(stderr, "[noVNC] HTTPS WebSocket proxy started on %d for VM %s\n",
-            wsPort, vmName);
+    LOG_INFO("[noVNC] HTTPS WebSocket proxy started on %d for VM %s",
+             wsPort, vmName);
 
     return make_json_console(vmName, wsPort);
 }
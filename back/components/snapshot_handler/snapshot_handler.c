@@ -0,0 +1,508 @@
+// File: components/snapshot_handler/snapshot_handler.c
+
+#include "snapshot_handler.h"
+#include "../../libvirt-utils.h"
+#include "../inventory/inventory.h"
+#define LOG_COMPONENT "snapshot"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Même partage NFS que createVM.c : fichiers mémoire des snapshots externes */
+static const char *NFS_BASE = "/mnt/vmstore";
+
+/* --------------------------------------------------------------------------
+ * Helpers
+ * -------------------------------------------------------------------------- */
+
+static void log_libvirt_error(const char *context)
+{
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("[%s] libvirt error (code=%d, domain=%d): %s",
+                  context, err->code, err->domain,
+                  err->message ? err->message : "(no message)");
+    } else {
+        LOG_ERROR("[%s] libvirt error: (no details from virGetLastError)", context);
+    }
+}
+
+static char *make_error_json(const char *msg)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "success", 0);
+    cJSON_AddStringToObject(root, "error", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+/* Erreur libvirt renvoyée telle quelle au frontend (ex : "disk is not qcow2") */
+static char *make_libvirt_error_json(const char *fallback)
+{
+    virErrorPtr err = virGetLastError();
+    return make_error_json(err && err->message ? err->message : fallback);
+}
+
+static char *print_and_free(cJSON *resp)
+{
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/* Noms de snapshot : utilisés dans le XML et dans des noms de fichiers */
+static int valid_snapshot_name(const char *name)
+{
+    size_t len = strlen(name);
+    if (len == 0 || len > 64)
+        return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)name[i]) && !strchr("._-", name[i]))
+            return 0;
+    }
+    return name[0] != '.';
+}
+
+static void xml_escape(char *out, size_t outlen, const char *in)
+{
+    size_t o = 0;
+    for (; *in && o + 7 < outlen; in++) {
+        switch (*in) {
+        case '<':  o += snprintf(out + o, outlen - o, "&lt;");   break;
+        case '>':  o += snprintf(out + o, outlen - o, "&gt;");   break;
+        case '&':  o += snprintf(out + o, outlen - o, "&amp;");  break;
+        case '\'': o += snprintf(out + o, outlen - o, "&apos;"); break;
+        case '"':  o += snprintf(out + o, outlen - o, "&quot;"); break;
+        default:   out[o++] = *in; break;
+        }
+    }
+    out[o] = '\0';
+}
+
+/* Valeur texte du premier <tag>...</tag> du XML (sans décodage d'entités) */
+static int xml_tag_value(const char *xml, const char *tag, char *out, size_t outlen)
+{
+    char open[64], close[64];
+    snprintf(open, sizeof(open), "<%s>", tag);
+    snprintf(close, sizeof(close), "</%s>", tag);
+
+    const char *start = strstr(xml, open);
+    if (!start)
+        return -1;
+    start += strlen(open);
+    const char *end = strstr(start, close);
+    if (!end)
+        return -1;
+
+    size_t len = (size_t)(end - start);
+    if (len >= outlen)
+        len = outlen - 1;
+    memcpy(out, start, len);
+    out[len] = '\0';
+    return 0;
+}
+
+/*
+ * Parse le body { "uri", "vmName", ... } et ouvre le domaine.
+ * Retourne NULL (et *err_json alloué) en cas d'échec.
+ */
+static virDomainPtr open_domain(cJSON *root, const char *context,
+                                virConnectPtr *conn_out, char **err_json)
+{
+    cJSON *uri_item  = cJSON_GetObjectItem(root, "uri");
+    cJSON *name_item = cJSON_GetObjectItem(root, "vmName");
+
+    if (!cJSON_IsString(uri_item) || !cJSON_IsString(name_item)) {
+        *err_json = make_error_json("missing uri or vmName");
+        return NULL;
+    }
+
+    virConnectPtr conn = libvirt_pool_open(uri_item->valuestring);
+    if (!conn) {
+        log_libvirt_error(context);
+        *err_json = make_error_json("cannot connect to hypervisor");
+        return NULL;
+    }
+
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, name_item->valuestring);
+    if (!dom) {
+        log_libvirt_error(context);
+        virConnectClose(conn);
+        *err_json = make_error_json("domain not found");
+        return NULL;
+    }
+
+    *conn_out = conn;
+    return dom;
+}
+
+static virDomainSnapshotPtr lookup_snapshot(cJSON *root, virDomainPtr dom, char **err_json)
+{
+    cJSON *snap_item = cJSON_GetObjectItem(root, "name");
+    if (!cJSON_IsString(snap_item)) {
+        *err_json = make_error_json("missing snapshot name");
+        return NULL;
+    }
+
+    virDomainSnapshotPtr snap = TRACE_VIRT(virDomainSnapshotLookupByName, dom, snap_item->valuestring, 0);
+    if (!snap)
+        *err_json = make_error_json("snapshot not found");
+    return snap;
+}
+
+/* --------------------------------------------------------------------------
+ * handle_snapshotcreate
+ * -------------------------------------------------------------------------- */
+
+/**
+ * POST /snapshotcreate
+ * {
+ *   "uri": "qemu:///system",
+ *   "vmName": "debian-13",
+ *   "name": "clean-install",        // optionnel : horodatage sinon
+ *   "description": "...",           // optionnel
+ *   "type": "internal",             // "internal" (qcow2, défaut) ou "external"
+ *   "memory": true,                 // external : capture aussi la RAM (VM active)
+ *   "quiesce": false                // external disk-only : fsfreeze via l'agent
+ * }
+ *
+ * internal : disque + RAM dans le qcow2 (VM active), restauration en une étape.
+ * external : overlay qcow2 par disque ; avec "memory", la RAM est écrite dans
+ *            NFS_BASE/<vm>.<snap>.mem. Le disque de base devient en lecture seule.
+ */
+char *handle_snapshotcreate(const char *post_data)
+{
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    if (!root)
+        return make_error_json("invalid json");
+
+    virConnectPtr conn = NULL;
+    char *err_json = NULL;
+    virDomainPtr dom = open_domain(root, "handle_snapshotcreate", &conn, &err_json);
+    if (!dom) {
+        cJSON_Delete(root);
+        return err_json;
+    }
+
+    cJSON *j;
+    char name[65];
+    int name_ok = 1;
+    if ((j = cJSON_GetObjectItem(root, "name")) && cJSON_IsString(j)) {
+        /* Validé avant copie : un nom tronqué ne serait plus retrouvé par revert/delete */
+        name_ok = valid_snapshot_name(j->valuestring);
+        if (name_ok)
+            snprintf(name, sizeof(name), "%s", j->valuestring);
+    } else {
+        time_t now = time(NULL);
+        struct tm tm;
+        localtime_r(&now, &tm);
+        strftime(name, sizeof(name), "snap-%Y%m%d-%H%M%S", &tm);
+    }
+
+    const char *description = (j = cJSON_GetObjectItem(root, "description")) && cJSON_IsString(j)
+                              ? j->valuestring : "";
+    const char *type = (j = cJSON_GetObjectItem(root, "type")) && cJSON_IsString(j)
+                       ? j->valuestring : "internal";
+    int want_memory = !((j = cJSON_GetObjectItem(root, "memory")) && cJSON_IsFalse(j));
+    int quiesce = (j = cJSON_GetObjectItem(root, "quiesce")) && cJSON_IsTrue(j);
+    int external = strcmp(type, "external") == 0;
+
+    if (!name_ok || (!external && strcmp(type, "internal") != 0)) {
+        virDomainFree(dom);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return make_error_json("invalid snapshot name or type");
+    }
+
+    int active = TRACE_VIRT(virDomainIsActive, dom) == 1;
+    char desc_xml[1024];
+    xml_escape(desc_xml, sizeof(desc_xml), description);
+
+    char xml[2048];
+    unsigned int flags = 0;
+    if (!external) {
+        /* Interne : libvirt capture la RAM d'une VM active automatiquement */
+        snprintf(xml, sizeof(xml),
+                 "<domainsnapshot><name>%s</name><description>%s</description>"
+                 "</domainsnapshot>", name, desc_xml);
+    } else if (active && want_memory) {
+        /* Externe avec mémoire : les disques suivent (overlays externes) */
+        snprintf(xml, sizeof(xml),
+                 "<domainsnapshot><name>%s</name><description>%s</description>"
+                 "<memory snapshot='external' file='%s/%s.%s.mem'/>"
+                 "</domainsnapshot>",
+                 name, desc_xml, NFS_BASE, virDomainGetName(dom), name);
+        flags = VIR_DOMAIN_SNAPSHOT_CREATE_ATOMIC | VIR_DOMAIN_SNAPSHOT_CREATE_LIVE;
+    } else {
+        snprintf(xml, sizeof(xml),
+                 "<domainsnapshot><name>%s</name><description>%s</description>"
+                 "</domainsnapshot>", name, desc_xml);
+        flags = VIR_DOMAIN_SNAPSHOT_CREATE_DISK_ONLY | VIR_DOMAIN_SNAPSHOT_CREATE_ATOMIC;
+        if (quiesce && active)
+            flags |= VIR_DOMAIN_SNAPSHOT_CREATE_QUIESCE;
+    }
+
+    LOG_INFO("[handle_snapshotcreate] %s: %s snapshot '%s' (flags=0x%x)",
+             virDomainGetName(dom), type, name, flags);
+
+    virDomainSnapshotPtr snap = TRACE_VIRT(virDomainSnapshotCreateXML, dom, xml, flags);
+    if (!snap) {
+        log_libvirt_error("handle_snapshotcreate:virDomainSnapshotCreateXML");
+        char *out = make_libvirt_error_json("snapshot creation failed");
+        virDomainFree(dom);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return out;
+    }
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddBoolToObject(resp, "success", 1);
+    cJSON_AddStringToObject(resp, "vmName", virDomainGetName(dom));
+    cJSON_AddStringToObject(resp, "snapshot", virDomainSnapshotGetName(snap));
+    cJSON_AddStringToObject(resp, "type", type);
+    cJSON_AddBoolToObject(resp, "memory", active && (external ? want_memory : 1));
+
+    virDomainSnapshotFree(snap);
+    virDomainFree(dom);
+    virConnectClose(conn);
+    cJSON_Delete(root);
+    return print_and_free(resp);
+}
+
+/* --------------------------------------------------------------------------
+ * handle_snapshotlist
+ * -------------------------------------------------------------------------- */
+
+/*
+ * Un disque du snapshot est externe : <disk ... snapshot='external'> dans
+ * <disks>, pas <memory snapshot='external'> ni le <domain> embarqué
+ */
+static int has_external_disk(const char *xml)
+{
+    const char *p   = strstr(xml, "<disks>");
+    const char *end = p ? strstr(p, "</disks>") : NULL;
+    if (!end)
+        return 0;
+    while ((p = strstr(p, "<disk ")) != NULL && p < end) {
+        const char *tag_end = strchr(p, '>');
+        const char *attr    = strstr(p, " snapshot='external'");
+        if (tag_end && attr && attr < tag_end)
+            return 1;
+        p += strlen("<disk ");
+    }
+    return 0;
+}
+
+static cJSON *snapshot_to_json(virDomainSnapshotPtr snap)
+{
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "name", virDomainSnapshotGetName(snap));
+    cJSON_AddBoolToObject(obj, "current", TRACE_VIRT(virDomainSnapshotIsCurrent, snap, 0) == 1);
+
+    virDomainSnapshotPtr parent = TRACE_VIRT(virDomainSnapshotGetParent, snap, 0);
+    if (parent) {
+        cJSON_AddStringToObject(obj, "parent", virDomainSnapshotGetName(parent));
+        virDomainSnapshotFree(parent);
+    } else {
+        /* Racine : pas de parent, erreur libvirt attendue */
+        virResetLastError();
+    }
+
+    char *xml = TRACE_VIRT(virDomainSnapshotGetXMLDesc, snap, 0);
+    if (xml) {
+        char value[1024];
+        if (xml_tag_value(xml, "creationTime", value, sizeof(value)) == 0)
+            cJSON_AddNumberToObject(obj, "creationTime", atof(value));
+        if (xml_tag_value(xml, "state", value, sizeof(value)) == 0)
+            cJSON_AddStringToObject(obj, "state", value);
+        if (xml_tag_value(xml, "description", value, sizeof(value)) == 0)
+            cJSON_AddStringToObject(obj, "description", value);
+
+        int ext_memory = strstr(xml, "<memory snapshot='external'") != NULL;
+        int int_memory = strstr(xml, "<memory snapshot='internal'") != NULL;
+        int ext_disk   = has_external_disk(xml);
+        cJSON_AddStringToObject(obj, "type", ext_disk ? "external" : "internal");
+        cJSON_AddBoolToObject(obj, "memory", ext_memory || int_memory);
+        free(xml);
+    }
+    return obj;
+}
+
+/**
+ * POST /snapshotlist  { "uri", "vmName" }
+ */
+char *handle_snapshotlist(const char *post_data)
+{
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    if (!root)
+        return make_error_json("invalid json");
+
+    virConnectPtr conn = NULL;
+    char *err_json = NULL;
+    virDomainPtr dom = open_domain(root, "handle_snapshotlist", &conn, &err_json);
+    if (!dom) {
+        cJSON_Delete(root);
+        return err_json;
+    }
+
+    virDomainSnapshotPtr *snaps = NULL;
+    int n = TRACE_VIRT(virDomainListAllSnapshots, dom, &snaps, VIR_DOMAIN_SNAPSHOT_LIST_TOPOLOGICAL);
+    if (n < 0) {
+        log_libvirt_error("handle_snapshotlist:virDomainListAllSnapshots");
+        virDomainFree(dom);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return make_error_json("cannot list snapshots");
+    }
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddBoolToObject(resp, "success", 1);
+    cJSON_AddStringToObject(resp, "vmName", virDomainGetName(dom));
+    cJSON *arr = cJSON_AddArrayToObject(resp, "snapshots");
+    for (int i = 0; i < n; i++) {
+        cJSON_AddItemToArray(arr, snapshot_to_json(snaps[i]));
+        virDomainSnapshotFree(snaps[i]);
+    }
+    free(snaps);
+
+    virDomainFree(dom);
+    virConnectClose(conn);
+    cJSON_Delete(root);
+    return print_and_free(resp);
+}
+
+/* --------------------------------------------------------------------------
+ * handle_snapshotrevert
+ * -------------------------------------------------------------------------- */
+
+/**
+ * POST /snapshotrevert
+ * {
+ *   "uri", "vmName",
+ *   "name": "clean-install",
+ *   "state": "running",     // optionnel : "running" ou "paused" après retour
+ *   "force": false          // optionnel : REVERT_FORCE (ex : config incompatible)
+ * }
+ */
+char *handle_snapshotrevert(const char *post_data)
+{
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    if (!root)
+        return make_error_json("invalid json");
+
+    virConnectPtr conn = NULL;
+    char *err_json = NULL;
+    virDomainPtr dom = open_domain(root, "handle_snapshotrevert", &conn, &err_json);
+    if (!dom) {
+        cJSON_Delete(root);
+        return err_json;
+    }
+
+    virDomainSnapshotPtr snap = lookup_snapshot(root, dom, &err_json);
+    if (!snap) {
+        virDomainFree(dom);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return err_json;
+    }
+
+    cJSON *j;
+    unsigned int flags = 0;
+    if ((j = cJSON_GetObjectItem(root, "state")) && cJSON_IsString(j)) {
+        if (strcmp(j->valuestring, "running") == 0)
+            flags |= VIR_DOMAIN_SNAPSHOT_REVERT_RUNNING;
+        else if (strcmp(j->valuestring, "paused") == 0)
+            flags |= VIR_DOMAIN_SNAPSHOT_REVERT_PAUSED;
+    }
+    if ((j = cJSON_GetObjectItem(root, "force")) && cJSON_IsTrue(j))
+        flags |= VIR_DOMAIN_SNAPSHOT_REVERT_FORCE;
+
+    LOG_INFO("[handle_snapshotrevert] %s -> '%s' (flags=0x%x)",
+             virDomainGetName(dom), virDomainSnapshotGetName(snap), flags);
+
+    char *out;
+    if (TRACE_VIRT(virDomainRevertToSnapshot, snap, flags) < 0) {
+        log_libvirt_error("handle_snapshotrevert:virDomainRevertToSnapshot");
+        out = make_libvirt_error_json("revert failed");
+    } else {
+        cJSON *resp = cJSON_CreateObject();
+        cJSON_AddBoolToObject(resp, "success", 1);
+        cJSON_AddStringToObject(resp, "vmName", virDomainGetName(dom));
+        cJSON_AddStringToObject(resp, "snapshot", virDomainSnapshotGetName(snap));
+        cJSON_AddBoolToObject(resp, "active", TRACE_VIRT(virDomainIsActive, dom) == 1);
+        out = print_and_free(resp);
+        inventory_invalidate(cJSON_GetObjectItem(root, "uri")->valuestring);
+    }
+
+    virDomainSnapshotFree(snap);
+    virDomainFree(dom);
+    virConnectClose(conn);
+    cJSON_Delete(root);
+    return out;
+}
+
+/* --------------------------------------------------------------------------
+ * handle_snapshotdelete
+ * -------------------------------------------------------------------------- */
+
+/**
+ * POST /snapshotdelete
+ * {
+ *   "uri", "vmName",
+ *   "name": "clean-install",
+ *   "children": false       // optionnel : supprime aussi les descendants
+ * }
+ */
+char *handle_snapshotdelete(const char *post_data)
+{
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    if (!root)
+        return make_error_json("invalid json");
+
+    virConnectPtr conn = NULL;
+    char *err_json = NULL;
+    virDomainPtr dom = open_domain(root, "handle_snapshotdelete", &conn, &err_json);
+    if (!dom) {
+        cJSON_Delete(root);
+        return err_json;
+    }
+
+    virDomainSnapshotPtr snap = lookup_snapshot(root, dom, &err_json);
+    if (!snap) {
+        virDomainFree(dom);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        return err_json;
+    }
+
+    cJSON *j = cJSON_GetObjectItem(root, "children");
+    unsigned int flags = cJSON_IsTrue(j) ? VIR_DOMAIN_SNAPSHOT_DELETE_CHILDREN : 0;
+
+    char *out;
+    if (TRACE_VIRT(virDomainSnapshotDelete, snap, flags) < 0) {
+        log_libvirt_error("handle_snapshotdelete:virDomainSnapshotDelete");
+        out = make_libvirt_error_json("snapshot deletion failed");
+    } else {
+        cJSON *resp = cJSON_CreateObject();
+        cJSON_AddBoolToObject(resp, "success", 1);
+        cJSON_AddStringToObject(resp, "vmName", virDomainGetName(dom));
+        cJSON_AddStringToObject(resp, "snapshot", cJSON_GetObjectItem(root, "name")->valuestring);
+        out = print_and_free(resp);
+    }
+
+    virDomainSnapshotFree(snap);
+    virDomainFree(dom);
+    virConnectClose(conn);
+    cJSON_Delete(root);
+    return out;
+}
@@ -0,0 +1,17 @@
+// snapshot_handler.h
+#ifndef SNAPSHOT_HANDLER_H
+#define SNAPSHOT_HANDLER_H
+
+/* Crée un snapshot interne (qcow2) ou externe (overlay disque, + mémoire) */
+char *handle_snapshotcreate(const char *post_data);
+
+/* Liste les snapshots d'une VM (du plus ancien au plus récent) */
+char *handle_snapshotlist(const char *post_data);
+
+/* Ramène la VM à l'état d'un snapshot (disque, et mémoire si capturée) */
+char *handle_snapshotrevert(const char *post_data);
+
+/* Supprime un snapshot (et éventuellement ses descendants) */
+char *handle_snapshotdelete(const char *post_data);
+
+#endif
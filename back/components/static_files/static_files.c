@@ -0,0 +1,290 @@
+// static_files.c
+#include "static_files.h"
+#define LOG_COMPONENT "static"
+#include "../logger/logger.h"
+#include <microhttpd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Un fichier ouvert et sa réponse MHD, partagée par toutes les connexions :
+ * MHD compte les références et lit le fd par sendfile/pread à l'offset de
+ * chaque connexion. Le fd est fermé avec la dernière référence.
+ */
+struct static_file {
+    char   path[1056];                  /* "" : place libre */
+    dev_t  dev;
+    ino_t  ino;
+    off_t  size;
+    struct timespec mtime;
+    char   etag[96];
+    struct MHD_Response *response;
+};
+
+struct mime_type {
+    const char *ext;
+    const char *type;
+    int compressible;                   /* variantes .br/.gz cherchées */
+};
+
+static const struct mime_type mime_types[] = {
+    { ".html",  "text/html; charset=utf-8",       1 },
+    { ".js",    "text/javascript; charset=utf-8", 1 },
+    { ".mjs",   "text/javascript; charset=utf-8", 1 },
+    { ".css",   "text/css; charset=utf-8",        1 },
+    { ".json",  "application/json",               1 },
+    { ".map",   "application/json",               1 },
+    { ".svg",   "image/svg+xml",                  1 },
+    { ".txt",   "text/plain; charset=utf-8",      1 },
+    { ".ico",   "image/x-icon",                   1 },
+    { ".wasm",  "application/wasm",               1 },
+    { ".ttf",   "font/ttf",                       1 },
+    { ".png",   "image/png",                      0 },
+    { ".jpg",   "image/jpeg",                     0 },
+    { ".jpeg",  "image/jpeg",                     0 },
+    { ".gif",   "image/gif",                      0 },
+    { ".webp",  "image/webp",                     0 },
+    { ".woff",  "font/woff",                      0 },
+    { ".woff2", "font/woff2",                     0 },
+};
+
+static struct static_file files[MAX_STATIC_FILES];
+static int evict_next;
+static pthread_mutex_t files_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *root_dir(void) {
+    const char *root = getenv("FRONT_DIST");
+    return root && root[0] ? root : STATIC_DEFAULT_ROOT;
+}
+
+/* Type d'après l'extension du dernier segment, NULL sans extension connue */
+static const struct mime_type *mime_of(const char *rel) {
+    const char *slash = strrchr(rel, '/');
+    const char *dot = strrchr(slash ? slash : rel, '.');
+    if (!dot)
+        return NULL;
+    for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++)
+        if (strcasecmp(dot, mime_types[i].ext) == 0)
+            return &mime_types[i];
+    return NULL;
+}
+
+/* Noms hachés par vite sous /assets : jamais modifiés, cache d'un an */
+static const char *cache_control_of(const char *rel) {
+    size_t len = strlen(rel);
+    if (strncmp(rel, "/assets/", 8) == 0)
+        return "public, max-age=31536000, immutable";
+    if (len >= 5 && strcmp(rel + len - 5, ".html") == 0)
+        return "no-cache";              /* revalidé par ETag à chaque chargement */
+    return "public, max-age=3600";
+}
+
+/* URL absolue sans segment caché ni remontée ("/." couvre "/..") */
+static int safe_url(const char *url) {
+    return url[0] == '/' && !strstr(url, "/.") && !strchr(url, '\\') && strlen(url) < 512;
+}
+
+/* coding présent dans Accept-Encoding et pas refusé par q=0 */
+static int accepts(const char *accept, const char *coding) {
+    size_t n = strlen(coding);
+    for (const char *p = accept; (p = strstr(p, coding)) != NULL; p += n) {
+        int start = p == accept || p[-1] == ',' || p[-1] == ' ';
+        char c = p[n];
+        if (!start || (c != '\0' && c != ',' && c != ';' && c != ' '))
+            continue;
+        const char *q = strstr(p + n, "q=");
+        const char *comma = strchr(p + n, ',');
+        if (q && (!comma || q < comma) && strtod(q + 2, NULL) <= 0.0)
+            return 0;
+        return 1;
+    }
+    return 0;
+}
+
+static int same_file(const struct static_file *f, const struct stat *st) {
+    return f->dev == st->st_dev && f->ino == st->st_ino && f->size == st->st_size &&
+           f->mtime.tv_sec == st->st_mtim.tv_sec && f->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static void drop_file(struct static_file *f) {
+    if (f->response)
+        MHD_destroy_response(f->response);  /* les envois en cours gardent leur référence */
+    memset(f, 0, sizeof(*f));
+}
+
+/*
+ * Fichier path à jour (rouvert s'il a changé sur disque : nouveau build),
+ * NULL s'il n'existe pas. rel donne le type et la durée de cache, encoding
+ * le Content-Encoding de la variante. Sous files_lock.
+ */
+static struct static_file *get_file(const char *path, const char *rel, const char *encoding) {
+    struct static_file *f = NULL, *slot = NULL;
+    for (int i = 0; i < MAX_STATIC_FILES && !f; i++)
+        if (files[i].path[0] && strcmp(files[i].path, path) == 0)
+            f = &files[i];
+
+    struct stat st;
+    if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+        if (f)
+            drop_file(f);
+        return NULL;
+    }
+    if (f && same_file(f, &st))
+        return f;
+
+    if (f) {
+        drop_file(f);
+        slot = f;
+    }
+    for (int i = 0; i < MAX_STATIC_FILES && !slot; i++)
+        if (!files[i].path[0])
+            slot = &files[i];
+    if (!slot) {
+        slot = &files[evict_next];
+        evict_next = (evict_next + 1) % MAX_STATIC_FILES;
+        drop_file(slot);
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        LOG_WARN("cannot open %s", path);
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    struct MHD_Response *resp = MHD_create_response_from_fd((size_t)st.st_size, fd);
+    if (!resp) {
+        close(fd);
+        return NULL;
+    }
+
+    snprintf(slot->path, sizeof(slot->path), "%s", path);
+    slot->dev = st.st_dev;
+    slot->ino = st.st_ino;
+    slot->size = st.st_size;
+    slot->mtime = st.st_mtim;
+    /* ETag fort : une représentation (variante comprise) = une valeur */
+    snprintf(slot->etag, sizeof(slot->etag), "\"%llx-%llx-%llx%s%s\"",
+             (unsigned long long)st.st_ino, (unsigned long long)st.st_size,
+             (unsigned long long)st.st_mtim.tv_sec * 1000000000ULL +
+                 (unsigned long long)st.st_mtim.tv_nsec,
+             encoding ? "-" : "", encoding ? encoding : "");
+    slot->response = resp;
+
+    const struct mime_type *mime = mime_of(rel);
+    MHD_add_response_header(resp, "Content-Type", mime ? mime->type : "application/octet-stream");
+    MHD_add_response_header(resp, "ETag", slot->etag);
+    MHD_add_response_header(resp, "Cache-Control", cache_control_of(rel));
+    MHD_add_response_header(resp, "X-Content-Type-Options", "nosniff");
+    if (mime && mime->compressible)
+        MHD_add_response_header(resp, "Vary", "Accept-Encoding");
+    if (encoding)
+        MHD_add_response_header(resp, "Content-Encoding", encoding);
+    LOG_DEBUG("opened %s (%lld bytes)", path, (long long)st.st_size);
+    return slot;
+}
+
+/* Variante précompressée acceptée par le client et au moins aussi récente */
+static struct static_file *pick_variant(struct MHD_Connection *connection,
+                                        const struct static_file *f, const char *rel) {
+    const struct mime_type *mime = mime_of(rel);
+    const char *accept = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+                                                     "Accept-Encoding");
+    if (!mime || !mime->compressible || !accept)
+        return NULL;
+
+    /* Copies : ouvrir une variante peut évincer l'original du cache */
+    char base[1040];
+    struct timespec mtime = f->mtime;
+    snprintf(base, sizeof(base), "%s", f->path);
+
+    static const char *const codings[][2] = { { "br", ".br" }, { "gzip", ".gz" } };
+    for (int i = 0; i < 2; i++) {
+        if (!accepts(accept, codings[i][0]))
+            continue;
+        char path[1048];
+        snprintf(path, sizeof(path), "%s%s", base, codings[i][1]);
+        struct static_file *v = get_file(path, rel, codings[i][0]);
+        /* Variante restée d'un build précédent : ignorée */
+        if (v && (v->mtime.tv_sec > mtime.tv_sec ||
+                  (v->mtime.tv_sec == mtime.tv_sec && v->mtime.tv_nsec >= mtime.tv_nsec)))
+            return v;
+    }
+    return NULL;
+}
+
+static enum MHD_Result send_not_found(struct MHD_Connection *connection, unsigned int *status) {
+    static const char body[] = "{\"error\":\"not found\"}";
+    struct MHD_Response *resp = MHD_create_response_from_buffer(
+        sizeof(body) - 1, (void *)body, MHD_RESPMEM_PERSISTENT);
+    if (!resp)
+        return MHD_NO;
+    MHD_add_response_header(resp, "Content-Type", "application/json");
+    *status = MHD_HTTP_NOT_FOUND;
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_NOT_FOUND, resp);
+    MHD_destroy_response(resp);
+    return ret;
+}
+
+enum MHD_Result static_files_serve(struct MHD_Connection *connection, const char *url,
+                                   unsigned int *status, uint64_t *bytes) {
+    *bytes = 0;
+    if (!safe_url(url))
+        return send_not_found(connection, status);
+
+    char rel[528], path[1040];
+    size_t len = strlen(url);
+    snprintf(rel, sizeof(rel), "%s%s", url, url[len - 1] == '/' ? "index.html" : "");
+    snprintf(path, sizeof(path), "%s%s", root_dir(), rel);
+
+    pthread_mutex_lock(&files_lock);
+    struct static_file *f = get_file(path, rel, NULL);
+    if (!f && !mime_of(rel)) {
+        /* Route du routeur React (/listallvms...) : l'application la résout */
+        snprintf(rel, sizeof(rel), "/index.html");
+        snprintf(path, sizeof(path), "%s%s", root_dir(), rel);
+        f = get_file(path, rel, NULL);
+    }
+    if (!f) {
+        pthread_mutex_unlock(&files_lock);
+        return send_not_found(connection, status);
+    }
+    struct static_file *v = pick_variant(connection, f, rel);
+    if (v)
+        f = v;
+    else if (strcmp(f->path, path) != 0 && !(f = get_file(path, rel, NULL))) {
+        pthread_mutex_unlock(&files_lock);
+        return send_not_found(connection, status);
+    }
+
+    enum MHD_Result ret;
+    const char *inm = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "If-None-Match");
+    if (inm && strstr(inm, f->etag)) {
+        struct MHD_Response *resp = MHD_create_response_from_buffer(0, "", MHD_RESPMEM_PERSISTENT);
+        if (!resp) {
+            pthread_mutex_unlock(&files_lock);
+            return MHD_NO;
+        }
+        const struct mime_type *mime = mime_of(rel);
+        MHD_add_response_header(resp, "ETag", f->etag);
+        MHD_add_response_header(resp, "Cache-Control", cache_control_of(rel));
+        if (mime && mime->compressible)
+            MHD_add_response_header(resp, "Vary", "Accept-Encoding");
+        *status = MHD_HTTP_NOT_MODIFIED;
+        ret = MHD_queue_response(connection, MHD_HTTP_NOT_MODIFIED, resp);
+        MHD_destroy_response(resp);
+    } else {
+        /* Sous verrou : un nouveau build ne peut pas la détruire avant que MHD la référence */
+        *status = MHD_HTTP_OK;
+        *bytes = (uint64_t)f->size;
+        ret = MHD_queue_response(connection, MHD_HTTP_OK, f->response);
+    }
+    pthread_mutex_unlock(&files_lock);
+    return ret;
+}
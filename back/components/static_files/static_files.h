@@ -0,0 +1,23 @@
+// static_files.h
+#ifndef STATIC_FILES_H
+#define STATIC_FILES_H
+
+#include <stdint.h>
+#include <microhttpd.h>
+
+/* Frontend construit (vite build), relatif au dossier de lancement ; env FRONT_DIST */
+#define STATIC_DEFAULT_ROOT "../front/dist"
+
+/* Fichiers (variantes .br/.gz comprises) gardés ouverts */
+#define MAX_STATIC_FILES 256
+
+/*
+ * Répond à un GET/HEAD avec un fichier du frontend : ouvert une fois et
+ * envoyé par sendfile, variante .br/.gz précompressée si le client
+ * l'accepte, ETag fort (304 sur If-None-Match). Les routes de l'application
+ * (sans extension) renvoient index.html. *status et *bytes servent au log.
+ */
+enum MHD_Result static_files_serve(struct MHD_Connection *connection, const char *url,
+                                   unsigned int *status, uint64_t *bytes);
+
+#endif
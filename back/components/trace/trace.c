@@ -0,0 +1,161 @@
+// trace.c
+#include "trace.h"
+#include "../logger/logger.h"
+#include <cjson/cJSON.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+struct trace_span {
+    uint64_t    ts;                     /* µs, CLOCK_MONOTONIC */
+    uint64_t    dur;
+    const char *cat;                    /* littéral : jamais copié */
+    char        name[TRACE_NAME_LEN];
+    long        tid;
+    char        request_id[LOG_REQUEST_ID_LEN];
+    char        detail[TRACE_DETAIL_LEN];
+};
+
+static struct trace_span spans[TRACE_BUFFER_SPANS];
+static unsigned long next_span;         /* spans écrits depuis le démarrage */
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int trace_enabled = 1;
+
+static _Thread_local long my_tid;
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* --------------------------------------------------------------------------
+ * Enregistrement
+ * -------------------------------------------------------------------------- */
+
+uint64_t trace_begin(void) {
+    if (!atomic_load_explicit(&trace_enabled, memory_order_relaxed) || !log_request_id()[0])
+        return 0;
+    return now_us();
+}
+
+void trace_end_detail(const char *cat, const char *name, uint64_t t0, const char *detail) {
+    if (t0 == 0)
+        return;
+    uint64_t end = now_us();
+    if (!my_tid)
+        my_tid = (long)syscall(SYS_gettid);
+
+    pthread_mutex_lock(&trace_lock);
+    struct trace_span *s = &spans[next_span++ % TRACE_BUFFER_SPANS];
+    s->ts = t0;
+    s->dur = end - t0;
+    s->cat = cat;
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    s->tid = my_tid;
+    snprintf(s->request_id, sizeof(s->request_id), "%s", log_request_id());
+    snprintf(s->detail, sizeof(s->detail), "%s", detail ? detail : "");
+    pthread_mutex_unlock(&trace_lock);
+}
+
+void trace_end(const char *cat, const char *name, uint64_t t0) {
+    trace_end_detail(cat, name, t0, NULL);
+}
+
+/* --------------------------------------------------------------------------
+ * Export
+ * -------------------------------------------------------------------------- */
+
+static cJSON *span_to_event(const struct trace_span *s, int pid) {
+    cJSON *ev = cJSON_CreateObject();
+    cJSON_AddStringToObject(ev, "name", s->name);
+    cJSON_AddStringToObject(ev, "cat", s->cat);
+    cJSON_AddStringToObject(ev, "ph", "X");
+    cJSON_AddNumberToObject(ev, "ts", (double)s->ts);
+    cJSON_AddNumberToObject(ev, "dur", (double)s->dur);
+    cJSON_AddNumberToObject(ev, "pid", pid);
+    cJSON_AddNumberToObject(ev, "tid", (double)s->tid);
+    cJSON *args = cJSON_AddObjectToObject(ev, "args");
+    cJSON_AddStringToObject(args, "requestId", s->request_id);
+    if (s->detail[0])
+        cJSON_AddStringToObject(args, "detail", s->detail);
+    return ev;
+}
+
+char *handle_traces(const char *post_data) {
+    cJSON *root = NULL;
+    if (post_data && post_data[0]) {
+        root = cJSON_Parse(post_data);
+        if (!root)
+            return make_json_error("invalid JSON");
+    }
+
+    cJSON *j;
+    const char *request_id = NULL;
+    long limit = TRACE_BUFFER_SPANS;
+    if (root && (j = cJSON_GetObjectItem(root, "requestId")) && cJSON_IsString(j) && j->valuestring[0])
+        request_id = j->valuestring;
+    if (root && (j = cJSON_GetObjectItem(root, "limit")) && cJSON_IsNumber(j) && j->valuedouble > 0 &&
+        j->valuedouble < TRACE_BUFFER_SPANS)
+        limit = (long)j->valuedouble;
+    if (root && (j = cJSON_GetObjectItem(root, "enabled")) && cJSON_IsBool(j))
+        atomic_store(&trace_enabled, cJSON_IsTrue(j));
+
+    /* Copie sous verrou, JSON construit hors verrou */
+    struct trace_span *copy = malloc(sizeof(spans));
+    if (!copy) {
+        cJSON_Delete(root);
+        return make_json_error("out of memory");
+    }
+    long n = 0;
+    pthread_mutex_lock(&trace_lock);
+    unsigned long first = next_span > TRACE_BUFFER_SPANS ? next_span - TRACE_BUFFER_SPANS : 0;
+    for (unsigned long i = next_span; i > first && n < limit; i--) {
+        const struct trace_span *s = &spans[(i - 1) % TRACE_BUFFER_SPANS];
+        if (!request_id || strcmp(s->request_id, request_id) == 0)
+            copy[n++] = *s;
+    }
+    if (root && (j = cJSON_GetObjectItem(root, "clear")) && cJSON_IsTrue(j))
+        next_span = 0;
+    pthread_mutex_unlock(&trace_lock);
+
+    int pid = (int)getpid();
+    cJSON *resp = cJSON_CreateObject();
+    cJSON *events = cJSON_AddArrayToObject(resp, "traceEvents");
+
+    cJSON *meta = cJSON_CreateObject();
+    cJSON_AddStringToObject(meta, "name", "process_name");
+    cJSON_AddStringToObject(meta, "ph", "M");
+    cJSON_AddNumberToObject(meta, "pid", pid);
+    cJSON_AddStringToObject(cJSON_AddObjectToObject(meta, "args"), "name", "vm-backend");
+    cJSON_AddItemToArray(events, meta);
+
+    /* copy est du plus récent au plus ancien : on remet dans l'ordre */
+    for (long i = n - 1; i >= 0; i--)
+        cJSON_AddItemToArray(events, span_to_event(&copy[i], pid));
+    free(copy);
+
+    cJSON_AddStringToObject(resp, "displayTimeUnit", "ms");
+    cJSON *other = cJSON_AddObjectToObject(resp, "otherData");
+    cJSON_AddBoolToObject(other, "enabled", atomic_load(&trace_enabled));
+    cJSON_AddNumberToObject(other, "spans", (double)n);
+
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    cJSON_Delete(root);
+    return out;
+}
@@ -0,0 +1,53 @@
+// trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Spans par requête : chaque appel libvirt, lancement de processus ou accès
+ * fichier instrumenté devient un intervalle (début, durée) rattaché à
+ * l'identifiant de requête du thread (voir logger.h). Les spans vont dans un
+ * anneau en mémoire, exporté par /traces au format Chrome trace-event
+ * (chrome://tracing, Perfetto, speedscope).
+ *
+ * Un thread sans identifiant de requête (tuner, échantillonneur...) n'est
+ * pas tracé : ses appels ne coûtent qu'une lecture atomique.
+ *
+ * Usage :
+ *   virConnectPtr conn = TRACE_VIRT(virConnectOpen, uri);
+ *   int rc = TRACE_CALL("exec", "qemu-img", system(cmd));
+ */
+
+/* Spans gardés en mémoire (les plus anciens sont écrasés) */
+#define TRACE_BUFFER_SPANS 16384
+
+/* Nom d'un span (fonction libvirt, route HTTP), tronqué au-delà */
+#define TRACE_NAME_LEN 48
+
+/* Détail libre d'un span (commande, chemin), tronqué au-delà */
+#define TRACE_DETAIL_LEN 96
+
+/* 0 si le thread courant n'est pas tracé, sinon horodatage de début (µs) */
+uint64_t trace_begin(void);
+
+/* Enregistre le span [t0, maintenant] ; sans effet si t0 == 0. cat doit être un littéral */
+void trace_end(const char *cat, const char *name, uint64_t t0);
+void trace_end_detail(const char *cat, const char *name, uint64_t t0, const char *detail);
+
+#define TRACE_CALL(cat, name, expr) ({                          \
+        uint64_t trace_t0_ = trace_begin();                     \
+        __typeof__(expr) trace_r_ = (expr);                     \
+        trace_end((cat), (name), trace_t0_);                    \
+        trace_r_; })
+
+#define TRACE_VIRT(fn, ...) TRACE_CALL("libvirt", #fn, fn(__VA_ARGS__))
+
+/*
+ * Export Chrome trace-event :
+ * { "requestId"?: "...", "limit"?: n, "clear"?: bool, "enabled"?: bool }
+ * Sans requestId, tous les spans en mémoire (les "limit" plus récents).
+ */
+char *handle_traces(const char *post_data);
+
+#endif
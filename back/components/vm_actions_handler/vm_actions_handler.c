@@ -2,6 +2,13 @@
 
 #include "vm_actions_handler.h"
 #include "../../libvirt-utils.h"
+#include "../inventory/inventory.h"
+#include "../reclaim/reclaim.h"
+#include "../domdesc/domdesc.h"
+#include "../balloon/balloon.h"
+#define LOG_COMPONENT "vm_actions"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
 
 #include <libvirt/libvirt.h>
 #include <libvirt/virterror.h>  // virGetLastError
@@ -10,7 +17,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <unistd.h>             // sleep, unlink
+#include <unistd.h>             // sleep
 
 /* --------------------------------------------------------------------------
  * Constantes
@@ -27,13 +34,11 @@ static void log_libvirt_error(const char *context)
 {
     virErrorPtr err = virGetLastError();
     if (err) {
-        fprintf(stderr,
-                "[%s] libvirt error (code=%d, domain=%d): %s\n",
-                context, err->code, err->domain,
-                err->message ? err->message : "(no message)");
+        LOG_ERROR("[%s] libvirt error (code=%d, domain=%d): %s",
+                  context, err->code, err->domain,
+                  err->message ? err->message : "(no message)");
     } else {
-        fprintf(stderr,
-                "[%s] libvirt error: (no details from virGetLastError)\n", context);
+        LOG_ERROR("[%s] libvirt error: (no details from virGetLastError)", context);
     }
 }
 
@@ -79,7 +84,7 @@ static char *make_ok_json(const char *vm_name, const char *action)
 
 char *handle_startvm(const char *post_data)
 {
-    fprintf(stderr, "[handle_startvm] body: %s\n", post_data ? post_data : "(null)");
+    LOG_DEBUG("[handle_startvm] body: %s", post_data ? post_data : "(null)");
 
     if (!post_data) {
         return make_error_json("missing body");
@@ -87,7 +92,7 @@ char *handle_startvm(const char *post_data)
 
     cJSON *root = cJSON_Parse(post_data);
     if (!root) {
-        fprintf(stderr, "[handle_startvm] invalid JSON\n");
+        LOG_WARN("[handle_startvm] invalid JSON");
         return make_error_json("invalid json");
     }
 
@@ -95,26 +100,26 @@ char *handle_startvm(const char *post_data)
     cJSON *name_item = cJSON_GetObjectItem(root, "vmName");
 
     if (!cJSON_IsString(uri_item) || !cJSON_IsString(name_item)) {
-        fprintf(stderr, "[handle_startvm] uri or vmName missing/not string\n");
+        LOG_WARN("[handle_startvm] uri or vmName missing/not string");
         cJSON_Delete(root);
         return make_error_json("missing uri or vmName");
     }
 
     const char *uri     = uri_item->valuestring;
     const char *vm_name = name_item->valuestring;
-    fprintf(stderr, "[handle_startvm] uri=%s, vmName=%s\n", uri, vm_name);
+    LOG_DEBUG("[handle_startvm] uri=%s, vmName=%s", uri, vm_name);
 
-    virConnectPtr conn = virConnectOpen(uri);
+    virConnectPtr conn = TRACE_VIRT(virConnectOpen, uri);
     if (!conn) {
-        fprintf(stderr, "[handle_startvm] cannot connect to hypervisor\n");
+        LOG_WARN("[handle_startvm] cannot connect to hypervisor");
         log_libvirt_error("handle_startvm:virConnectOpen");
         cJSON_Delete(root);
         return make_error_json("cannot connect to hypervisor");
     }
 
-    virDomainPtr dom = virDomainLookupByName(conn, vm_name);
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, vm_name);
     if (!dom) {
-        fprintf(stderr, "[handle_startvm] domain not found: %s\n", vm_name);
+        LOG_WARN("[handle_startvm] domain not found: %s", vm_name);
         log_libvirt_error("handle_startvm:virDomainLookupByName");
         virConnectClose(conn);
         cJSON_Delete(root);
@@ -122,22 +127,32 @@ char *handle_startvm(const char *post_data)
     }
 
     int state = -1, reason = -1;
-    if (virDomainGetState(dom, &state, &reason, 0) == 0) {
-        fprintf(stderr, "[handle_startvm] current state=%d, reason=%d\n", state, reason);
+    if (TRACE_VIRT(virDomainGetState, dom, &state, &reason, 0) == 0) {
+        LOG_DEBUG("[handle_startvm] current state=%d, reason=%d", state, reason);
         if (state == VIR_DOMAIN_RUNNING || state == VIR_DOMAIN_BLOCKED) {
-            fprintf(stderr, "[handle_startvm] domain already running\n");
+            LOG_INFO("[handle_startvm] domain already running");
             virDomainFree(dom);
             virConnectClose(conn);
             cJSON_Delete(root);
             return make_ok_json(vm_name, "already-running");
         }
     } else {
-        fprintf(stderr, "[handle_startvm] virDomainGetState failed\n");
+        LOG_WARN("[handle_startvm] virDomainGetState failed");
         log_libvirt_error("handle_startvm:virDomainGetState");
     }
 
-    if (virDomainCreate(dom) < 0) {
-        fprintf(stderr, "[handle_startvm] virDomainCreate failed\n");
+    /*
+     * Image de managed save présente : virDomainCreate restaure la RAM
+     * (reprise en quelques secondes), sauf "discardSave" qui force un boot.
+     */
+    cJSON *discard_item = cJSON_GetObjectItem(root, "discardSave");
+    unsigned int start_flags = cJSON_IsTrue(discard_item) ? VIR_DOMAIN_START_FORCE_BOOT : 0;
+    int restoring = !start_flags && TRACE_VIRT(virDomainHasManagedSaveImage, dom, 0) == 1;
+    if (restoring)
+        LOG_DEBUG("[handle_startvm] restoring from managed save image");
+
+    if (TRACE_VIRT(virDomainCreateWithFlags, dom, start_flags) < 0) {
+        LOG_WARN("[handle_startvm] virDomainCreate failed");
         log_libvirt_error("handle_startvm:virDomainCreate");
         virDomainFree(dom);
         virConnectClose(conn);
@@ -145,11 +160,12 @@ char *handle_startvm(const char *post_data)
         return make_error_json("failed to start domain");
     }
 
-    fprintf(stderr, "[handle_startvm] domain started successfully\n");
+    LOG_INFO("[handle_startvm] domain started successfully");
     virDomainFree(dom);
+    inventory_invalidate(uri);
     virConnectClose(conn);
     cJSON_Delete(root);
-    return make_ok_json(vm_name, "start");
+    return make_ok_json(vm_name, restoring ? "restore" : "start");
 }
 
 /* --------------------------------------------------------------------------
@@ -158,7 +174,7 @@ char *handle_startvm(const char *post_data)
 
 char *handle_stopvm(const char *post_data)
 {
-    fprintf(stderr, "[handle_stopvm] body: %s\n", post_data ? post_data : "(null)");
+    LOG_DEBUG("[handle_stopvm] body: %s", post_data ? post_data : "(null)");
 
     if (!post_data) {
         return make_error_json("missing body");
@@ -166,7 +182,7 @@ char *handle_stopvm(const char *post_data)
 
     cJSON *root = cJSON_Parse(post_data);
     if (!root) {
-        fprintf(stderr, "[handle_stopvm] invalid JSON\n");
+        LOG_WARN("[handle_stopvm] invalid JSON");
         return make_error_json("invalid json");
     }
 
@@ -174,26 +190,26 @@ char *handle_stopvm(const char *post_data)
     cJSON *name_item = cJSON_GetObjectItem(root, "vmName");
 
     if (!cJSON_IsString(uri_item) || !cJSON_IsString(name_item)) {
-        fprintf(stderr, "[handle_stopvm] uri or vmName missing/not string\n");
+        LOG_WARN("[handle_stopvm] uri or vmName missing/not string");
         cJSON_Delete(root);
         return make_error_json("missing uri or vmName");
     }
 
     const char *uri     = uri_item->valuestring;
     const char *vm_name = name_item->valuestring;
-    fprintf(stderr, "[handle_stopvm] uri=%s, vmName=%s\n", uri, vm_name);
+    LOG_DEBUG("[handle_stopvm] uri=%s, vmName=%s", uri, vm_name);
 
-    virConnectPtr conn = virConnectOpen(uri);
+    virConnectPtr conn = TRACE_VIRT(virConnectOpen, uri);
     if (!conn) {
-        fprintf(stderr, "[handle_stopvm] cannot connect to hypervisor\n");
+        LOG_WARN("[handle_stopvm] cannot connect to hypervisor");
         log_libvirt_error("handle_stopvm:virConnectOpen");
         cJSON_Delete(root);
         return make_error_json("cannot connect to hypervisor");
     }
 
-    virDomainPtr dom = virDomainLookupByName(conn, vm_name);
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, vm_name);
     if (!dom) {
-        fprintf(stderr, "[handle_stopvm] domain not found: %s\n", vm_name);
+        LOG_WARN("[handle_stopvm] domain not found: %s", vm_name);
         log_libvirt_error("handle_stopvm:virDomainLookupByName");
         virConnectClose(conn);
         cJSON_Delete(root);
@@ -201,17 +217,17 @@ char *handle_stopvm(const char *post_data)
     }
 
     int state_before = -1, reason_before = -1;
-    if (virDomainGetState(dom, &state_before, &reason_before, 0) == 0) {
-        fprintf(stderr, "[handle_stopvm] state BEFORE destroy: %d (reason=%d)\n",
-                state_before, reason_before);
+    if (TRACE_VIRT(virDomainGetState, dom, &state_before, &reason_before, 0) == 0) {
+        LOG_DEBUG("[handle_stopvm] state BEFORE destroy: %d (reason=%d)",
+                  state_before, reason_before);
     } else {
-        fprintf(stderr, "[handle_stopvm] virDomainGetState BEFORE failed\n");
+        LOG_WARN("[handle_stopvm] virDomainGetState BEFORE failed");
         log_libvirt_error("handle_stopvm:virDomainGetState(before)");
     }
 
     // Arrêt brutal (power off)
-    if (virDomainDestroy(dom) < 0) {
-        fprintf(stderr, "[handle_stopvm] virDomainDestroy failed\n");
+    if (TRACE_VIRT(virDomainDestroy, dom) < 0) {
+        LOG_WARN("[handle_stopvm] virDomainDestroy failed");
         log_libvirt_error("handle_stopvm:virDomainDestroy");
         virDomainFree(dom);
         virConnectClose(conn);
@@ -219,8 +235,9 @@ char *handle_stopvm(const char *post_data)
         return make_error_json("failed to destroy domain");
     }
 
-    fprintf(stderr, "[handle_stopvm] destroy sent successfully\n");
+    LOG_INFO("[handle_stopvm] destroy sent successfully");
     virDomainFree(dom);
+    inventory_invalidate(uri);
     virConnectClose(conn);
     cJSON_Delete(root);
     return make_ok_json(vm_name, "stop");
@@ -232,7 +249,7 @@ char *handle_stopvm(const char *post_data)
 
 char *handle_shutdownvm(const char *post_data)
 {
-    fprintf(stderr, "[handle_shutdownvm] body: %s\n", post_data ? post_data : "(null)");
+    LOG_DEBUG("[handle_shutdownvm] body: %s", post_data ? post_data : "(null)");
 
     if (!post_data) {
         return make_error_json("missing body");
@@ -240,7 +257,7 @@ char *handle_shutdownvm(const char *post_data)
 
     cJSON *root = cJSON_Parse(post_data);
     if (!root) {
-        fprintf(stderr, "[handle_shutdownvm] invalid JSON\n");
+        LOG_WARN("[handle_shutdownvm] invalid JSON");
         return make_error_json("invalid json");
     }
 
@@ -248,26 +265,26 @@ char *handle_shutdownvm(const char *post_data)
     cJSON *name_item = cJSON_GetObjectItem(root, "vmName");
 
     if (!cJSON_IsString(uri_item) || !cJSON_IsString(name_item)) {
-        fprintf(stderr, "[handle_shutdownvm] uri or vmName missing/not string\n");
+        LOG_WARN("[handle_shutdownvm] uri or vmName missing/not string");
         cJSON_Delete(root);
         return make_error_json("missing uri or vmName");
     }
 
     const char *uri     = uri_item->valuestring;
     const char *vm_name = name_item->valuestring;
-    fprintf(stderr, "[handle_shutdownvm] uri=%s, vmName=%s\n", uri, vm_name);
+    LOG_DEBUG("[handle_shutdownvm] uri=%s, vmName=%s", uri, vm_name);
 
-    virConnectPtr conn = virConnectOpen(uri);
+    virConnectPtr conn = TRACE_VIRT(virConnectOpen, uri);
     if (!conn) {
-        fprintf(stderr, "[handle_shutdownvm] cannot connect to hypervisor\n");
+        LOG_WARN("[handle_shutdownvm] cannot connect to hypervisor");
         log_libvirt_error("handle_shutdownvm:virConnectOpen");
         cJSON_Delete(root);
         return make_error_json("cannot connect to hypervisor");
     }
 
-    virDomainPtr dom = virDomainLookupByName(conn, vm_name);
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, vm_name);
     if (!dom) {
-        fprintf(stderr, "[handle_shutdownvm] domain not found: %s\n", vm_name);
+        LOG_WARN("[handle_shutdownvm] domain not found: %s", vm_name);
         log_libvirt_error("handle_shutdownvm:virDomainLookupByName");
         virConnectClose(conn);
         cJSON_Delete(root);
@@ -275,28 +292,28 @@ char *handle_shutdownvm(const char *post_data)
     }
 
     int state_before = -1, reason_before = -1;
-    if (virDomainGetState(dom, &state_before, &reason_before, 0) == 0) {
-        fprintf(stderr, "[handle_shutdownvm] state BEFORE shutdown: %d (reason=%d)\n",
-                state_before, reason_before);
+    if (TRACE_VIRT(virDomainGetState, dom, &state_before, &reason_before, 0) == 0) {
+        LOG_DEBUG("[handle_shutdownvm] state BEFORE shutdown: %d (reason=%d)",
+                  state_before, reason_before);
 
         // Déjà éteinte → rien à faire
         if (state_before == VIR_DOMAIN_SHUTOFF ||
             state_before == VIR_DOMAIN_CRASHED ||
             state_before == VIR_DOMAIN_PMSUSPENDED) {
-            fprintf(stderr, "[handle_shutdownvm] domain already not running\n");
+            LOG_INFO("[handle_shutdownvm] domain already not running");
             virDomainFree(dom);
             virConnectClose(conn);
             cJSON_Delete(root);
             return make_ok_json(vm_name, "already-shutoff");
         }
     } else {
-        fprintf(stderr, "[handle_shutdownvm] virDomainGetState BEFORE failed\n");
+        LOG_WARN("[handle_shutdownvm] virDomainGetState BEFORE failed");
         log_libvirt_error("handle_shutdownvm:virDomainGetState(before)");
     }
 
     // 1) Tentative d'arrêt propre (ACPI)
-    if (virDomainShutdown(dom) < 0) {
-        fprintf(stderr, "[handle_shutdownvm] virDomainShutdown failed\n");
+    if (TRACE_VIRT(virDomainShutdown, dom) < 0) {
+        LOG_WARN("[handle_shutdownvm] virDomainShutdown failed");
         log_libvirt_error("handle_shutdownvm:virDomainShutdown");
         virDomainFree(dom);
         virConnectClose(conn);
@@ -304,8 +321,7 @@ char *handle_shutdownvm(const char *post_data)
         return make_error_json("failed to shutdown domain");
     }
 
-    fprintf(stderr,
-            "[handle_shutdownvm] ACPI shutdown signal sent, waiting a bit...\n");
+    LOG_DEBUG("[handle_shutdownvm] ACPI shutdown signal sent, waiting a bit...");
 
     // 2) On attend quelques secondes (5s par ex.)
     int final_state  = state_before;
@@ -313,20 +329,21 @@ char *handle_shutdownvm(const char *post_data)
 
     for (int i = 0; i < 5; ++i) { // 5 * 1s = 5 secondes
         sleep(1);
-        if (virDomainGetState(dom, &final_state, &final_reason, 0) < 0) {
+        if (TRACE_VIRT(virDomainGetState, dom, &final_state, &final_reason, 0) < 0) {
             log_libvirt_error("handle_shutdownvm:virDomainGetState(loop)");
             break;
         }
 
-        fprintf(stderr, "[handle_shutdownvm] loop %d, state=%d, reason=%d\n",
-                i + 1, final_state, final_reason);
+        LOG_DEBUG("[handle_shutdownvm] loop %d, state=%d, reason=%d",
+                  i + 1, final_state, final_reason);
 
         if (final_state == VIR_DOMAIN_SHUTOFF ||
             final_state == VIR_DOMAIN_CRASHED ||
             final_state == VIR_DOMAIN_PMSUSPENDED) {
-            fprintf(stderr, "[handle_shutdownvm] domain is now stopped (state=%d)\n",
-                    final_state);
+            LOG_INFO("[handle_shutdownvm] domain is now stopped (state=%d)",
+                     final_state);
             virDomainFree(dom);
+            inventory_invalidate(uri);
             virConnectClose(conn);
             cJSON_Delete(root);
             return make_ok_json(vm_name, "shutdown");
@@ -334,10 +351,10 @@ char *handle_shutdownvm(const char *post_data)
     }
 
     // 3) Si on arrive ici, la VM n'a pas voulu s'éteindre, mais on NE FORCE PAS
-    fprintf(stderr,
-            "[handle_shutdownvm] domain still running after timeout, NOT forcing destroy.\n");
+    LOG_WARN("[handle_shutdownvm] domain still running after timeout, NOT forcing destroy.");
 
     virDomainFree(dom);
+    inventory_invalidate(uri);
     virConnectClose(conn);
     cJSON_Delete(root);
 
@@ -346,12 +363,132 @@ char *handle_shutdownvm(const char *post_data)
 }
 
 /* --------------------------------------------------------------------------
- * handle_deletevm  (stop + undefine + delete disk)
+ * Fichiers disque d'une VM supprimée
  * -------------------------------------------------------------------------- */
 
+/* Nombre max de fichiers (disques, overlays, mémoire) repris par VM */
+#define MAX_VM_FILES 32
+
+/*
+ * Un fichier appartient à la VM s'il est directement sous NFS_BASE et nommé
+ * <vm>.qcow2 ou <vm>.<...> (overlays et RAM des snapshots externes). Les
+ * images de base partagées (baseImage) et les ISO ne sont jamais supprimées.
+ */
+static int owned_by_vm(const char *path, const char *vm_name)
+{
+    size_t base_len = strlen(NFS_BASE);
+    size_t vm_len   = strlen(vm_name);
+
+    if (strncmp(path, NFS_BASE, base_len) != 0 || path[base_len] != '/')
+        return 0;
+    const char *name = path + base_len + 1;
+    return !strchr(name, '/') && !strstr(name, "..") &&
+           strncmp(name, vm_name, vm_len) == 0 && name[vm_len] == '.';
+}
+
+static void add_vm_file(char files[][1024], int *n, const char *path)
+{
+    for (int i = 0; i < *n; i++) {
+        if (strcmp(files[i], path) == 0)
+            return;
+    }
+    if (*n < MAX_VM_FILES)
+        snprintf(files[(*n)++], 1024, "%s", path);
+}
+
+/* Range path dans owned ou kept (kept NULL : ignoré s'il n'est pas à la VM) */
+static void classify_vm_file(const char *path, const char *vm_name,
+                             char owned[][1024], int *nowned,
+                             char kept[][1024], int *nkept)
+{
+    if (owned_by_vm(path, vm_name))
+        add_vm_file(owned, nowned, path);
+    else if (kept)
+        add_vm_file(kept, nkept, path);
+}
+
+/* Range chaque valeur file='...' de [start, end) dans owned ou kept */
+static void scan_file_attrs(const char *start, const char *end, const char *vm_name,
+                            char owned[][1024], int *nowned,
+                            char kept[][1024], int *nkept)
+{
+    const char *p = start;
+    while ((p = strstr(p, "file='")) != NULL && p < end) {
+        p += strlen("file='");
+        size_t len = strcspn(p, "'");
+        char path[1024];
+        if (len > 0 && len < sizeof(path)) {
+            memcpy(path, p, len);
+            path[len] = '\0';
+            classify_vm_file(path, vm_name, owned, nowned, kept, nkept);
+        }
+        p += len;
+    }
+}
+
+/*
+ * Liste, avant l'undefine, les fichiers de la VM : sources des disques
+ * (chaîne de backing comprise pour une VM active) et fichiers des snapshots
+ * externes. Les lecteurs CD, disques en lecture seule ou partagés sont ignorés.
+ * Le XML complet est parcouru plutôt que domdesc, borné en disques et en
+ * profondeur de backing : un fichier oublié ici ne serait jamais récupéré.
+ */
+static void collect_vm_files(virDomainPtr dom, const char *vm_name,
+                             char owned[][1024], int *nowned,
+                             char kept[][1024], int *nkept)
+{
+    char *xml = TRACE_VIRT(virDomainGetXMLDesc, dom, 0);
+    if (xml) {
+        const char *p = xml;
+        while ((p = strstr(p, "<disk ")) != NULL) {
+            const char *end = strstr(p, "</disk>");
+            const char *tag_end = strchr(p, '>');
+            if (!end || !tag_end)
+                break;
+            const char *device = strstr(p, "device='disk'");
+            const char *ro     = strstr(p, "<readonly/>");
+            const char *shared = strstr(p, "<shareable/>");
+            if (device && device < tag_end &&
+                !(ro && ro < end) && !(shared && shared < end))
+                scan_file_attrs(p, end, vm_name, owned, nowned, kept, nkept);
+            p = end;
+        }
+        free(xml);
+    } else {
+        log_libvirt_error("handle_deletevm:virDomainGetXMLDesc");
+    }
+
+    virDomainSnapshotPtr *snaps = NULL;
+    int nsnaps = TRACE_VIRT(virDomainListAllSnapshots, dom, &snaps, 0);
+    for (int i = 0; i < nsnaps; i++) {
+        char *snap_xml = TRACE_VIRT(virDomainSnapshotGetXMLDesc, snaps[i], 0);
+        if (snap_xml) {
+            scan_file_attrs(snap_xml, snap_xml + strlen(snap_xml), vm_name,
+                            owned, nowned, NULL, NULL);
+            free(snap_xml);
+        }
+        virDomainSnapshotFree(snaps[i]);
+    }
+    free(snaps);
+}
+
+/* --------------------------------------------------------------------------
+ * handle_deletevm  (stop + undefine + suppression des disques en tâche de fond)
+ * -------------------------------------------------------------------------- */
+
+/**
+ * POST /deletevm
+ * {
+ *   "uri", "vmName",
+ *   "secureDiscard": false   // optionnel : écrase les disques avant suppression
+ * }
+ *
+ * La VM est undefinie immédiatement ; ses fichiers sont confiés à la file
+ * de suppression (reclaim) et suivis avec /reclaimstatus.
+ */
 char *handle_deletevm(const char *post_data)
 {
-    fprintf(stderr, "[handle_deletevm] body: %s\n", post_data ? post_data : "(null)");
+    LOG_DEBUG("[handle_deletevm] body: %s", post_data ? post_data : "(null)");
 
     if (!post_data) {
         return make_error_json("missing body");
@@ -359,7 +496,7 @@ char *handle_deletevm(const char *post_data)
 
     cJSON *root = cJSON_Parse(post_data);
     if (!root) {
-        fprintf(stderr, "[handle_deletevm] invalid JSON\n");
+        LOG_WARN("[handle_deletevm] invalid JSON");
         return make_error_json("invalid json");
     }
 
@@ -367,37 +504,55 @@ char *handle_deletevm(const char *post_data)
     cJSON *name_item = cJSON_GetObjectItem(root, "vmName");
 
     if (!cJSON_IsString(uri_item) || !cJSON_IsString(name_item)) {
-        fprintf(stderr, "[handle_deletevm] uri or vmName missing/not string\n");
+        LOG_WARN("[handle_deletevm] uri or vmName missing/not string");
         cJSON_Delete(root);
         return make_error_json("missing uri or vmName");
     }
 
     const char *uri     = uri_item->valuestring;
     const char *vm_name = name_item->valuestring;
-    fprintf(stderr, "[handle_deletevm] uri=%s, vmName=%s\n", uri, vm_name);
+    int secure = cJSON_IsTrue(cJSON_GetObjectItem(root, "secureDiscard"));
+    LOG_DEBUG("[handle_deletevm] uri=%s, vmName=%s", uri, vm_name);
 
-    virConnectPtr conn = virConnectOpen(uri);
+    // Le nom sert à construire des chemins sous NFS_BASE : ni '/' ni ".."
+    if (!vm_name[0] || strchr(vm_name, '/') || strstr(vm_name, "..")) {
+        LOG_WARN("[handle_deletevm] invalid vmName %s", vm_name);
+        cJSON_Delete(root);
+        return make_error_json("invalid vmName");
+    }
+
+    virConnectPtr conn = TRACE_VIRT(virConnectOpen, uri);
     if (!conn) {
-        fprintf(stderr, "[handle_deletevm] cannot connect to hypervisor\n");
+        LOG_WARN("[handle_deletevm] cannot connect to hypervisor");
         log_libvirt_error("handle_deletevm:virConnectOpen");
         cJSON_Delete(root);
         return make_error_json("cannot connect to hypervisor");
     }
 
-    virDomainPtr dom = virDomainLookupByName(conn, vm_name);
+    char owned[MAX_VM_FILES][1024];
+    char kept[MAX_VM_FILES][1024];
+    int nowned = 0, nkept = 0;
+
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, vm_name);
     if (dom) {
+        collect_vm_files(dom, vm_name, owned, &nowned, kept, &nkept);
+
+        // VMs de createVM : transitoires, le destroy suffit à les faire disparaître
+        int persistent = TRACE_VIRT(virDomainIsPersistent, dom) == 1;
+
         int state = -1, reason = -1;
-        if (virDomainGetState(dom, &state, &reason, 0) == 0) {
-            fprintf(stderr, "[handle_deletevm] current state=%d, reason=%d\n",
-                    state, reason);
+        if (TRACE_VIRT(virDomainGetState, dom, &state, &reason, 0) == 0) {
+            LOG_DEBUG("[handle_deletevm] current state=%d, reason=%d",
+                      state, reason);
 
             // Si la VM tourne, on la stoppe brutalement
             if (state == VIR_DOMAIN_RUNNING ||
                 state == VIR_DOMAIN_BLOCKED ||
                 state == VIR_DOMAIN_PAUSED) {
-                fprintf(stderr, "[handle_deletevm] domain is running, destroying...\n");
-                if (virDomainDestroy(dom) < 0) {
-                    fprintf(stderr, "[handle_deletevm] virDomainDestroy failed\n");
+                LOG_DEBUG("[handle_deletevm] domain is running, destroying...");
+                if (TRACE_VIRT(virDomainDestroy, dom) < 0 &&
+                    !(virGetLastError() && virGetLastError()->code == VIR_ERR_NO_DOMAIN)) {
+                    LOG_WARN("[handle_deletevm] virDomainDestroy failed");
                     log_libvirt_error("handle_deletevm:virDomainDestroy");
                     virDomainFree(dom);
                     virConnectClose(conn);
@@ -406,36 +561,413 @@ char *handle_deletevm(const char *post_data)
                 }
             }
         } else {
-            fprintf(stderr, "[handle_deletevm] virDomainGetState failed\n");
+            LOG_WARN("[handle_deletevm] virDomainGetState failed");
             log_libvirt_error("handle_deletevm:virDomainGetState");
         }
 
-        // Undefine (supprime la définition libvirt)
-        fprintf(stderr, "[handle_deletevm] undefining domain...\n");
-        if (virDomainUndefine(dom) < 0) {
-            fprintf(stderr, "[handle_deletevm] virDomainUndefine failed\n");
+        // Undefine (supprime la définition libvirt, snapshots, checkpoints et managed save compris)
+        // Domaine déjà disparu (transitoire détruit entre-temps) : rien à undefine
+        LOG_DEBUG("[handle_deletevm] undefining domain (persistent=%d)...", persistent);
+        if (persistent &&
+            TRACE_VIRT(virDomainUndefineFlags, dom, VIR_DOMAIN_UNDEFINE_SNAPSHOTS_METADATA |
+                                        VIR_DOMAIN_UNDEFINE_CHECKPOINTS_METADATA |
+                                        VIR_DOMAIN_UNDEFINE_MANAGED_SAVE) < 0 &&
+            !(virGetLastError() && virGetLastError()->code == VIR_ERR_NO_DOMAIN)) {
+            // Domaine toujours défini : ses disques ne doivent pas disparaître
+            LOG_WARN("[handle_deletevm] virDomainUndefine failed");
             log_libvirt_error("handle_deletevm:virDomainUndefine");
-            // On continue quand même pour tenter de supprimer le disque
+            virDomainFree(dom);
+            inventory_invalidate(uri);
+            virConnectClose(conn);
+            cJSON_Delete(root);
+            return make_error_json("failed to undefine domain");
         }
 
         virDomainFree(dom);
     } else {
-        fprintf(stderr, "[handle_deletevm] domain not found in libvirt, continue to disk removal.\n");
+        LOG_WARN("[handle_deletevm] domain not found in libvirt, continue to disk removal.");
         log_libvirt_error("handle_deletevm:virDomainLookupByName");
     }
 
-    // Suppression du disque qcow2 supposé être NFS_BASE/vmName.qcow2
-    char disk_path[1024];
-    snprintf(disk_path, sizeof(disk_path), "%s/%s.qcow2", NFS_BASE, vm_name);
-    fprintf(stderr, "[handle_deletevm] trying to remove disk file: %s\n", disk_path);
+    // Disque par défaut de createVM (seul candidat si le domaine n'existe plus)
+    char default_disk[1024];
+    snprintf(default_disk, sizeof(default_disk), "%s/%s.qcow2", NFS_BASE, vm_name);
+    if (owned_by_vm(default_disk, vm_name))
+        add_vm_file(owned, &nowned, default_disk);
+
+    inventory_invalidate(uri);
+    virConnectClose(conn);
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddBoolToObject(resp, "success", 1);
+    cJSON_AddStringToObject(resp, "vmName", vm_name);
+    cJSON_AddStringToObject(resp, "action", "deleted");
+
+    cJSON *reclaim = cJSON_AddArrayToObject(resp, "reclaim");
+    for (int i = 0; i < nowned; i++) {
+        int task_id = reclaim_enqueue(vm_name, owned[i], secure);
+        LOG_INFO("[handle_deletevm] queued removal of %s (task %d)", owned[i], task_id);
+
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "path", owned[i]);
+        if (task_id >= 0)
+            cJSON_AddNumberToObject(item, "taskId", task_id);
+        else
+            cJSON_AddStringToObject(item, "error", "reclaim queue full");
+        cJSON_AddItemToArray(reclaim, item);
+    }
+
+    cJSON *kept_arr = cJSON_AddArrayToObject(resp, "kept");
+    for (int i = 0; i < nkept; i++)
+        cJSON_AddItemToArray(kept_arr, cJSON_CreateString(kept[i]));
+
+    cJSON_Delete(root);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
+
+/* --------------------------------------------------------------------------
+ * Pause / reprise / suspend-to-disk
+ * -------------------------------------------------------------------------- */
+
+/*
+ * Parse le body { "uri", "vmName" } et ouvre le domaine.
+ * Retourne NULL (et *err_json alloué) en cas d'échec ; sinon l'appelant
+ * libère dom, conn et *root_out.
+ */
+static virDomainPtr open_vm(const char *post_data, const char *context,
+                            cJSON **root_out, virConnectPtr *conn_out, char **err_json)
+{
+    LOG_DEBUG("[%s] body: %s", context, post_data ? post_data : "(null)");
+
+    cJSON *root = post_data ? cJSON_Parse(post_data) : NULL;
+    if (!root) {
+        *err_json = make_error_json("invalid json");
+        return NULL;
+    }
+
+    cJSON *uri_item  = cJSON_GetObjectItem(root, "uri");
+    cJSON *name_item = cJSON_GetObjectItem(root, "vmName");
+    if (!cJSON_IsString(uri_item) || !cJSON_IsString(name_item)) {
+        cJSON_Delete(root);
+        *err_json = make_error_json("missing uri or vmName");
+        return NULL;
+    }
 
-    if (unlink(disk_path) != 0) {
-        perror("[handle_deletevm] unlink(disk_path) failed");
-        // On log seulement, on peut quand même considérer que la VM est supprimée de libvirt
+    virConnectPtr conn = TRACE_VIRT(virConnectOpen, uri_item->valuestring);
+    if (!conn) {
+        log_libvirt_error(context);
+        cJSON_Delete(root);
+        *err_json = make_error_json("cannot connect to hypervisor");
+        return NULL;
     }
 
+    virDomainPtr dom = TRACE_VIRT(virDomainLookupByName, conn, name_item->valuestring);
+    if (!dom) {
+        log_libvirt_error(context);
+        virConnectClose(conn);
+        cJSON_Delete(root);
+        *err_json = make_error_json("domain not found");
+        return NULL;
+    }
+
+    *root_out = root;
+    *conn_out = conn;
+    return dom;
+}
+
+static char *finish_vm_action(cJSON *root, virConnectPtr conn, virDomainPtr dom,
+                              int ok, const char *action, const char *error)
+{
+    const char *vm_name = cJSON_GetObjectItem(root, "vmName")->valuestring;
+    char *out = ok ? make_ok_json(vm_name, action) : make_error_json(error);
+
+    if (ok)
+        inventory_invalidate(cJSON_GetObjectItem(root, "uri")->valuestring);
+    virDomainFree(dom);
     virConnectClose(conn);
     cJSON_Delete(root);
+    return out;
+}
+
+/* handle_pausevm : gèle les vCPUs, la RAM reste allouée sur l'hôte */
+char *handle_pausevm(const char *post_data)
+{
+    cJSON *root = NULL;
+    virConnectPtr conn = NULL;
+    char *err_json = NULL;
+    virDomainPtr dom = open_vm(post_data, "handle_pausevm", &root, &conn, &err_json);
+    if (!dom)
+        return err_json;
+
+    int ok = TRACE_VIRT(virDomainSuspend, dom) == 0;
+    if (!ok)
+        log_libvirt_error("handle_pausevm:virDomainSuspend");
+    return finish_vm_action(root, conn, dom, ok, "pause", "failed to pause domain");
+}
+
+/* handle_resumevm : reprend une VM mise en pause */
+char *handle_resumevm(const char *post_data)
+{
+    cJSON *root = NULL;
+    virConnectPtr conn = NULL;
+    char *err_json = NULL;
+    virDomainPtr dom = open_vm(post_data, "handle_resumevm", &root, &conn, &err_json);
+    if (!dom)
+        return err_json;
+
+    int ok = TRACE_VIRT(virDomainResume, dom) == 0;
+    if (!ok)
+        log_libvirt_error("handle_resumevm:virDomainResume");
+    return finish_vm_action(root, conn, dom, ok, "resume", "failed to resume domain");
+}
+
+/*
+ * Managed save avec format d'image compressé, si la version de libvirt
+ * permet de le choisir par appel (VIR_DOMAIN_SAVE_PARAM_IMAGE_FORMAT).
+ * Retourne 0, ou -1 si le format n'est pas supporté (repli sans format).
+ */
+static int managed_save_compressed(virDomainPtr dom, const char *format, unsigned int flags,
+                                   int *done)
+{
+    *done = 0;
+#ifdef VIR_DOMAIN_SAVE_PARAM_IMAGE_FORMAT
+    virTypedParameterPtr params = NULL;
+    int nparams = 0, maxparams = 0;
+
+    /* Pas de VIR_DOMAIN_SAVE_PARAM_FILE : libvirt fait un managed save */
+    if (virTypedParamsAddString(&params, &nparams, &maxparams,
+                                VIR_DOMAIN_SAVE_PARAM_IMAGE_FORMAT, format) < 0)
+        return -1;
+
+    int rc = TRACE_VIRT(virDomainSaveParams, dom, params, nparams, flags);
+    virTypedParamsFree(params, nparams);
+    if (rc == 0) {
+        *done = 1;
+        return 0;
+    }
+
+    virErrorPtr err = virGetLastError();
+    if (err && (err->code == VIR_ERR_NO_SUPPORT ||
+                err->code == VIR_ERR_ARGUMENT_UNSUPPORTED ||
+                err->code == VIR_ERR_INVALID_ARG ||
+                err->code == VIR_ERR_CONFIG_UNSUPPORTED)) {
+        LOG_WARN("[handle_suspendvm] image format '%s' not supported: %s",
+                 format, err->message ? err->message : "");
+        return -1;
+    }
+    return 0;   /* vraie erreur de sauvegarde, pas de repli */
+#else
+    (void)dom; (void)format; (void)flags;
+    return -1;
+#endif
+}
+
+/**
+ * handle_suspendvm : suspend-to-disk (managed save). La RAM de la VM est
+ * écrite sur disque et libérée sur l'hôte ; /startvm la restaure. Réservé
+ * aux VMs persistantes (définies), les VMs transitoires sont refusées.
+ *
+ * {
+ *   "uri", "vmName",
+ *   "format": "zstd",      // optionnel : format d'image (défaut zstd)
+ *   "bypassCache": false   // optionnel : O_DIRECT, ne pollue pas le cache de l'hôte
+ * }
+ */
+char *handle_suspendvm(const char *post_data)
+{
+    cJSON *root = NULL;
+    virConnectPtr conn = NULL;
+    char *err_json = NULL;
+    virDomainPtr dom = open_vm(post_data, "handle_suspendvm", &root, &conn, &err_json);
+    if (!dom)
+        return err_json;
+
+    /* L'image managed save est liée à la définition : une VM transitoire n'en a pas */
+    if (TRACE_VIRT(virDomainIsPersistent, dom) != 1)
+        return finish_vm_action(root, conn, dom, 0, "suspend",
+                                "transient domain cannot be suspended to disk (use pause)");
+
+    cJSON *j;
+    const char *format = (j = cJSON_GetObjectItem(root, "format")) && cJSON_IsString(j)
+                         ? j->valuestring : "zstd";
+    unsigned int flags = (j = cJSON_GetObjectItem(root, "bypassCache")) && cJSON_IsTrue(j)
+                         ? VIR_DOMAIN_SAVE_BYPASS_CACHE : 0;
+
+    int done = 0;
+    int ok;
+    if (managed_save_compressed(dom, format, flags, &done) < 0) {
+        /* Format imposé par save_image_format de qemu.conf */
+        ok = TRACE_VIRT(virDomainManagedSave, dom, flags) == 0;
+    } else {
+        ok = done;
+    }
+    if (!ok)
+        log_libvirt_error("handle_suspendvm:virDomainManagedSave");
+
+    return finish_vm_action(root, conn, dom, ok, "suspend", "failed to save domain state");
+}
+
+/* --------------------------------------------------------------------------
+ * Redimensionnement à chaud (vCPUs / mémoire)
+ * -------------------------------------------------------------------------- */
+
+/* Taille minimale (et granularité) d'une barrette DIMM ajoutée à chaud, MiB */
+#define DIMM_ALIGN_MIB 128
+
+/* Live si la VM tourne, config si elle est persistante */
+static unsigned int resize_flags(virDomainPtr dom)
+{
+    unsigned int flags = 0;
+    if (TRACE_VIRT(virDomainIsActive, dom) == 1)
+        flags |= VIR_DOMAIN_AFFECT_LIVE;
+    if (TRACE_VIRT(virDomainIsPersistent, dom) == 1)
+        flags |= VIR_DOMAIN_AFFECT_CONFIG;
+    return flags;
+}
+
+/* Plafond de hotplug DIMM (<maxMemory slots=...>, KiB), 0 si absent */
+static unsigned long long hotplug_max_kib(const char *uri, virDomainPtr dom)
+{
+    struct domdesc *desc = malloc(sizeof(*desc));
+    unsigned long long kib = 0;
+    if (desc && domdesc_get(uri, dom, 0, desc) == 0)
+        kib = desc->max_memory_kib;
+    free(desc);
+    return kib;
+}
+
+/*
+ * Mémoire : en dessous du maximum du domaine, simple ballon ; au-delà,
+ * barrette DIMM (si créée avec "memoryHotplug") puis ajustement au ballon.
+ */
+static const char *resize_memory(const char *uri, virDomainPtr dom,
+                                 unsigned long long target_kib,
+                                 unsigned int flags, const char **method)
+{
+    unsigned long long max_kib = TRACE_VIRT(virDomainGetMaxMemory, dom);
+    if (max_kib == 0)
+        return "cannot read maximum memory";
+
+    *method = "balloon";
+    if (target_kib > max_kib) {
+        unsigned long long limit = hotplug_max_kib(uri, dom);
+        if (limit == 0)
+            return "memory above maximum (create the VM with maxMemory or memoryHotplug)";
+        if (target_kib > limit)
+            return "memory above hotplug limit";
+
+        unsigned long long missing_mib = (target_kib - max_kib + 1023) / 1024;
+        unsigned long long dimm_mib =
+            (missing_mib + DIMM_ALIGN_MIB - 1) / DIMM_ALIGN_MIB * DIMM_ALIGN_MIB;
+        if (max_kib + dimm_mib * 1024 > limit)
+            return "memory above hotplug limit";
+
+        char dimm[256];
+        snprintf(dimm, sizeof(dimm),
+                 "<memory model='dimm'><target><size unit='MiB'>%llu</size>"
+                 "<node>0</node></target></memory>", dimm_mib);
+        if (TRACE_VIRT(virDomainAttachDeviceFlags, dom, dimm, flags) < 0) {
+            log_libvirt_error("handle_resizevm:virDomainAttachDeviceFlags");
+            return "failed to hotplug memory";
+        }
+        *method = "dimm";
+        /* Barrette arrondie : le ballon rend l'excédent */
+        if (max_kib + dimm_mib * 1024 == target_kib)
+            return NULL;
+    }
+
+    if (TRACE_VIRT(virDomainSetMemoryFlags, dom, (unsigned long)target_kib, flags) < 0) {
+        log_libvirt_error("handle_resizevm:virDomainSetMemoryFlags");
+        return "failed to set memory";
+    }
+    return NULL;
+}
+
+/**
+ * handle_resizevm : change les vCPUs et/ou la mémoire sans redémarrage.
+ *
+ * {
+ *   "uri", "vmName",
+ *   "vcpus": 4,        // optionnel : hotplug/unplug jusqu'à maxCpu
+ *   "memory": 4096     // optionnel, MiB : ballon jusqu'à maxMemory, DIMM au-delà
+ * }
+ */
+char *handle_resizevm(const char *post_data)
+{
+    cJSON *root = NULL;
+    virConnectPtr conn = NULL;
+    char *err_json = NULL;
+    virDomainPtr dom = open_vm(post_data, "handle_resizevm", &root, &conn, &err_json);
+    if (!dom)
+        return err_json;
+
+    cJSON *vcpus_item  = cJSON_GetObjectItem(root, "vcpus");
+    cJSON *memory_item = cJSON_GetObjectItem(root, "memory");
+    int vcpus = cJSON_IsNumber(vcpus_item) ? vcpus_item->valueint : 0;
+    int memory_mib = cJSON_IsNumber(memory_item) ? memory_item->valueint : 0;
+
+    const char *error = NULL;
+    if (!vcpus && !memory_mib)
+        error = "missing vcpus or memory";
+    else if ((vcpus_item && vcpus < 1) || (memory_item && memory_mib < 128))
+        error = "field values out of bounds";
+
+    unsigned int flags = resize_flags(dom);
+    int active = (flags & VIR_DOMAIN_AFFECT_LIVE) != 0;
+
+    if (!error && vcpus) {
+        int max = active ? TRACE_VIRT(virDomainGetMaxVcpus, dom)
+                         : TRACE_VIRT(virDomainGetVcpusFlags, dom, VIR_DOMAIN_VCPU_MAXIMUM |
+                                                       VIR_DOMAIN_AFFECT_CONFIG);
+        if (max < 0) {
+            log_libvirt_error("handle_resizevm:virDomainGetMaxVcpus");
+            error = "cannot read maximum vcpus";
+        } else if (vcpus > max) {
+            error = "vcpus above maximum (create the VM with maxCpu)";
+        } else if (TRACE_VIRT(virDomainSetVcpusFlags, dom, (unsigned int)vcpus, flags) < 0) {
+            log_libvirt_error("handle_resizevm:virDomainSetVcpusFlags");
+            error = "failed to set vcpus";
+        }
+    }
+
+    const char *uri = cJSON_GetObjectItem(root, "uri")->valuestring;
+    const char *method = NULL;
+    if (!error && memory_mib) {
+        error = resize_memory(uri, dom, (unsigned long long)memory_mib * 1024, flags, &method);
+        /* Sans ça, le rééquilibreur de ballon ramènerait la VM à sa marge cible */
+        if (!error)
+            balloon_set_target(uri, cJSON_GetObjectItem(root, "vmName")->valuestring,
+                               (unsigned long long)memory_mib * 1024);
+    }
 
-    return make_ok_json(vm_name, "deleted");
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddBoolToObject(resp, "success", error == NULL);
+    cJSON_AddStringToObject(resp, "vmName", cJSON_GetObjectItem(root, "vmName")->valuestring);
+    if (error) {
+        cJSON_AddStringToObject(resp, "error", error);
+    } else {
+        cJSON_AddStringToObject(resp, "action", "resize");
+        if (method)
+            cJSON_AddStringToObject(resp, "memoryMethod", method);
+    }
+
+    /* État effectif, y compris après un échec partiel (vCPUs posés, mémoire refusée) */
+    virDomainInfo info;
+    if (TRACE_VIRT(virDomainGetInfo, dom, &info) == 0) {
+        cJSON_AddNumberToObject(resp, "vcpus", info.nrVirtCpu);
+        cJSON_AddNumberToObject(resp, "memoryMiB", (double)(info.memory / 1024));
+        cJSON_AddNumberToObject(resp, "maxMemoryMiB", (double)(info.maxMem / 1024));
+    }
+
+    /* Pas d'événement libvirt pour un changement de vCPUs */
+    domdesc_invalidate_dom(uri, dom);
+    inventory_invalidate(uri);
+    virDomainFree(dom);
+    virConnectClose(conn);
+    cJSON_Delete(root);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
 }
@@ -7,4 +7,14 @@ char *handle_stopvm(const char *post_data);
 char *handle_shutdownvm(const char *post_data);
 char *handle_deletevm(const char *post_data);
 
+/* Pause / reprise en mémoire (virDomainSuspend / virDomainResume) */
+char *handle_pausevm(const char *post_data);
+char *handle_resumevm(const char *post_data);
+
+/* Suspend-to-disk (managed save) ; /startvm restaure l'état sauvegardé */
+char *handle_suspendvm(const char *post_data);
+
+/* vCPUs / mémoire à chaud (virDomainSetVcpusFlags, ballon ou DIMM) */
+char *handle_resizevm(const char *post_data);
+
 #endif
\ No newline at end of file
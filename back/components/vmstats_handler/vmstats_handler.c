@@ -0,0 +1,465 @@
+// vmstats_handler.c
+#include "vmstats_handler.h"
+#include "../../libvirt-utils.h"
+#include "../placement/placement.h"
+#define LOG_COMPONENT "vmstats"
+#include "../logger/logger.h"
+#include "../trace/trace.h"
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cjson/cJSON.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Historique d'une VM : un tableau par compteur (struct-of-arrays) indexé
+ * par la même position d'anneau. Aucune allocation par échantillon ; les
+ * compteurs sont cumulés, les débits sont calculés à la lecture.
+ */
+struct vm_series {
+    int    in_use;
+    int    active;                      /* vue au dernier passage du sampler */
+    char   uri[512];
+    char   uuid[VIR_UUID_STRING_BUFLEN];
+    char   name[256];
+    int    vcpus;
+    unsigned int head;                  /* prochain slot écrit */
+    unsigned int count;                 /* slots valides */
+
+    long long          t_ms[VMSTATS_RING];
+    unsigned long long cpu_ns[VMSTATS_RING];
+    unsigned long long mem_kib[VMSTATS_RING];   /* jauge : RSS, sinon balloon */
+    unsigned long long rd_bytes[VMSTATS_RING];
+    unsigned long long wr_bytes[VMSTATS_RING];
+    unsigned long long rx_bytes[VMSTATS_RING];
+    unsigned long long tx_bytes[VMSTATS_RING];
+};
+
+static struct vm_series series[MAX_VMSTATS_SERIES];
+static pthread_mutex_t series_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t sampler_once = PTHREAD_ONCE_INIT;
+
+/* Un relevé, décodé hors verrou */
+struct vm_sample {
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    char name[256];
+    int  vcpus;
+    unsigned long long cpu_ns, mem_kib, rd_bytes, wr_bytes, rx_bytes, tx_bytes;
+    int  has_block, has_net;            /* absents si la VM est occupée (NOWAIT) */
+};
+
+/* Tampon du sampler (un seul thread écrit dedans) */
+static struct vm_sample scratch[MAX_VMSTATS_SERIES];
+
+static void log_libvirt_error(const char *prefix) {
+    virErrorPtr err = virGetLastError();
+    if (err) {
+        LOG_ERROR("[%s] Libvirt error: %s (code=%d domain=%d)",
+                  prefix, err->message, err->code, err->domain);
+    } else {
+        LOG_ERROR("[%s] Unknown libvirt error", prefix);
+    }
+}
+
+static char *make_json_error(const char *msg) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "error");
+    cJSON_AddStringToObject(root, "message", msg);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* --------------------------------------------------------------------------
+ * Collecte (hors verrou)
+ * -------------------------------------------------------------------------- */
+
+static unsigned long long param_ull(const virTypedParameter *p) {
+    switch (p->type) {
+    case VIR_TYPED_PARAM_ULLONG: return p->value.ul;
+    case VIR_TYPED_PARAM_LLONG:  return p->value.l > 0 ? (unsigned long long)p->value.l : 0;
+    case VIR_TYPED_PARAM_UINT:   return p->value.ui;
+    case VIR_TYPED_PARAM_INT:    return p->value.i > 0 ? (unsigned long long)p->value.i : 0;
+    default:                     return 0;
+    }
+}
+
+/* "block.<n>.rd.bytes" => prefix "block.", suffix ".rd.bytes" */
+static int field_matches(const char *field, const char *prefix, const char *suffix) {
+    size_t lf = strlen(field), lp = strlen(prefix), ls = strlen(suffix);
+    return lf > lp + ls &&
+           strncmp(field, prefix, lp) == 0 &&
+           strcmp(field + lf - ls, suffix) == 0;
+}
+
+static void parse_record(virDomainStatsRecordPtr rec, struct vm_sample *s) {
+    unsigned long long rss = 0, balloon = 0;
+
+    memset(s, 0, sizeof(*s));
+    const char *name = virDomainGetName(rec->dom);
+    snprintf(s->name, sizeof(s->name), "%s", name ? name : "");
+    virDomainGetUUIDString(rec->dom, s->uuid);
+
+    for (int i = 0; i < rec->nparams; i++) {
+        const virTypedParameter *p = &rec->params[i];
+        const char *f = p->field;
+
+        if (strcmp(f, "cpu.time") == 0)
+            s->cpu_ns = param_ull(p);
+        else if (strcmp(f, "balloon.rss") == 0)
+            rss = param_ull(p);
+        else if (strcmp(f, "balloon.current") == 0)
+            balloon = param_ull(p);
+        else if (strcmp(f, "vcpu.current") == 0)
+            s->vcpus = (int)param_ull(p);
+        else if (field_matches(f, "block.", ".rd.bytes")) {
+            s->rd_bytes += param_ull(p);
+            s->has_block = 1;
+        } else if (field_matches(f, "block.", ".wr.bytes")) {
+            s->wr_bytes += param_ull(p);
+            s->has_block = 1;
+        } else if (field_matches(f, "net.", ".rx.bytes")) {
+            s->rx_bytes += param_ull(p);
+            s->has_net = 1;
+        } else if (field_matches(f, "net.", ".tx.bytes")) {
+            s->tx_bytes += param_ull(p);
+            s->has_net = 1;
+        }
+    }
+    s->mem_kib = rss ? rss : balloon;
+}
+
+/* Relève toutes les VMs actives d'un hôte ; retourne leur nombre, -1 si erreur */
+static int collect_host(const char *uri, struct vm_sample *out, int max) {
+    virConnectPtr conn = libvirt_pool_open(uri);
+    if (!conn)
+        return -1;
+
+    virDomainStatsRecordPtr *recs = NULL;
+    unsigned int stats = VIR_DOMAIN_STATS_STATE | VIR_DOMAIN_STATS_CPU_TOTAL |
+                         VIR_DOMAIN_STATS_BALLOON | VIR_DOMAIN_STATS_VCPU |
+                         VIR_DOMAIN_STATS_INTERFACE | VIR_DOMAIN_STATS_BLOCK;
+    /* NOWAIT : ne pas rester bloqué derrière un job (migration, backup...) */
+    int n = TRACE_VIRT(virConnectGetAllDomainStats, conn, stats, &recs,
+                                                    VIR_CONNECT_GET_ALL_DOMAINS_STATS_ACTIVE |
+                                                    VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT);
+    if (n < 0) {
+        log_libvirt_error("vmstats:virConnectGetAllDomainStats");
+        virConnectClose(conn);
+        libvirt_pool_drop(uri);
+        return -1;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < n && kept < max; i++)
+        parse_record(recs[i], &out[kept++]);
+
+    virDomainStatsRecordListFree(recs);
+    virConnectClose(conn);
+    return kept;
+}
+
+/* --------------------------------------------------------------------------
+ * Anneau (series_lock tenu)
+ * -------------------------------------------------------------------------- */
+
+/* Index de l'échantillon pris k passages avant le dernier */
+static unsigned int ring_index(const struct vm_series *v, unsigned int k) {
+    return (v->head + VMSTATS_RING - 1 - k) % VMSTATS_RING;
+}
+
+static long long last_sample_ms(const struct vm_series *v) {
+    return v->count > 0 ? v->t_ms[ring_index(v, 0)] : 0;
+}
+
+static struct vm_series *find_or_add_series(const char *uri, const char *uuid) {
+    struct vm_series *free_slot = NULL, *stalest = NULL;
+
+    for (int i = 0; i < MAX_VMSTATS_SERIES; i++) {
+        struct vm_series *v = &series[i];
+        if (!v->in_use) {
+            if (!free_slot)
+                free_slot = v;
+            continue;
+        }
+        if (strcmp(v->uuid, uuid) == 0 && strcmp(v->uri, uri) == 0)
+            return v;
+        if (!v->active && (!stalest || last_sample_ms(v) < last_sample_ms(stalest)))
+            stalest = v;
+    }
+
+    /* Table pleine : on recycle l'historique de la VM arrêtée la plus ancienne */
+    struct vm_series *v = free_slot ? free_slot : stalest;
+    if (!v)
+        return NULL;
+
+    v->in_use = 1;
+    v->head = 0;
+    v->count = 0;
+    snprintf(v->uri, sizeof(v->uri), "%s", uri);
+    snprintf(v->uuid, sizeof(v->uuid), "%s", uuid);
+    return v;
+}
+
+static void push_sample(struct vm_series *v, long long t, const struct vm_sample *s) {
+    unsigned int i = v->head;
+    unsigned int prev = ring_index(v, 0);
+    int carry = v->count > 0;
+
+    snprintf(v->name, sizeof(v->name), "%s", s->name);
+    v->vcpus = s->vcpus;
+    v->active = 1;
+
+    v->t_ms[i]     = t;
+    v->cpu_ns[i]   = s->cpu_ns;
+    v->mem_kib[i]  = s->mem_kib;
+    /* Compteurs non relevés ce passage : on reprend la valeur précédente
+     * plutôt que 0, qui ferait un faux pic au passage suivant */
+    v->rd_bytes[i] = s->has_block || !carry ? s->rd_bytes : v->rd_bytes[prev];
+    v->wr_bytes[i] = s->has_block || !carry ? s->wr_bytes : v->wr_bytes[prev];
+    v->rx_bytes[i] = s->has_net || !carry ? s->rx_bytes : v->rx_bytes[prev];
+    v->tx_bytes[i] = s->has_net || !carry ? s->tx_bytes : v->tx_bytes[prev];
+
+    v->head = (i + 1) % VMSTATS_RING;
+    if (v->count < VMSTATS_RING)
+        v->count++;
+}
+
+static void record_host(const char *uri, const struct vm_sample *samples, int n, long long t) {
+    pthread_mutex_lock(&series_lock);
+
+    for (int k = 0; k < n; k++) {
+        struct vm_series *v = find_or_add_series(uri, samples[k].uuid);
+        if (v)
+            push_sample(v, t, &samples[k]);
+    }
+
+    /* VMs de cet hôte absentes de ce passage : arrêtées ou migrées */
+    for (int i = 0; i < MAX_VMSTATS_SERIES; i++) {
+        if (series[i].in_use && strcmp(series[i].uri, uri) == 0 &&
+            last_sample_ms(&series[i]) != t)
+            series[i].active = 0;
+    }
+
+    pthread_mutex_unlock(&series_lock);
+}
+
+/* Oublie les VMs arrêtées (ou hôtes retirés) depuis plus d'une fenêtre */
+static void expire_series(long long t) {
+    long long horizon = (long long)VMSTATS_RING * VMSTATS_INTERVAL_S * 1000;
+
+    pthread_mutex_lock(&series_lock);
+    for (int i = 0; i < MAX_VMSTATS_SERIES; i++) {
+        if (series[i].in_use && t - last_sample_ms(&series[i]) > horizon)
+            series[i].in_use = 0;
+    }
+    pthread_mutex_unlock(&series_lock);
+}
+
+/* --------------------------------------------------------------------------
+ * Thread d'échantillonnage
+ * -------------------------------------------------------------------------- */
+
+static void *vmstats_sampler_thread(void *arg) {
+    (void)arg;
+    static char uris[MAX_PLACEMENT_HOSTS][512];
+
+    for (;;) {
+        int nhosts = placement_list_hosts(uris, MAX_PLACEMENT_HOSTS);
+        long long t = now_ms();
+
+        for (int h = 0; h < nhosts; h++) {
+            int n = collect_host(uris[h], scratch, MAX_VMSTATS_SERIES);
+            /* Hôte injoignable : ses VMs passent inactives, l'historique reste */
+            record_host(uris[h], scratch, n > 0 ? n : 0, t);
+        }
+        expire_series(t);
+
+        sleep(VMSTATS_INTERVAL_S);
+    }
+    return NULL;
+}
+
+static void start_sampler(void) {
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, vmstats_sampler_thread, NULL) != 0)
+        LOG_ERROR("cannot start sampler thread");
+    pthread_attr_destroy(&attr);
+}
+
+void vmstats_start_sampler(void) {
+    pthread_once(&sampler_once, start_sampler);
+}
+
+/* --------------------------------------------------------------------------
+ * Débits (series_lock tenu)
+ * -------------------------------------------------------------------------- */
+
+struct vm_rates {
+    long long t_ms;
+    double cpu_percent;                 /* % des vCPUs alloués */
+    double mem_mib;
+    double rd_bps, wr_bps, rx_bps, tx_bps;
+};
+
+static double counter_rate(unsigned long long newer, unsigned long long older, long long dt_ms) {
+    /* Compteur remis à zéro (redémarrage de la VM) : pas de débit négatif */
+    return newer >= older ? (double)(newer - older) * 1000.0 / (double)dt_ms : 0.0;
+}
+
+/* Débits entre les échantillons pris a et b passages avant le dernier (a < b) */
+static int rates_between(const struct vm_series *v, unsigned int a, unsigned int b,
+                         struct vm_rates *r) {
+    if (b >= v->count)
+        return -1;
+
+    unsigned int ia = ring_index(v, a), ib = ring_index(v, b);
+    long long dt = v->t_ms[ia] - v->t_ms[ib];
+    if (dt <= 0)
+        return -1;
+
+    int vcpus = v->vcpus > 0 ? v->vcpus : 1;
+    r->t_ms = v->t_ms[ia];
+    r->cpu_percent = counter_rate(v->cpu_ns[ia], v->cpu_ns[ib], dt) / 1e9 * 100.0 / vcpus;
+    r->mem_mib = (double)v->mem_kib[ia] / 1024.0;
+    r->rd_bps = counter_rate(v->rd_bytes[ia], v->rd_bytes[ib], dt);
+    r->wr_bps = counter_rate(v->wr_bytes[ia], v->wr_bytes[ib], dt);
+    r->rx_bps = counter_rate(v->rx_bytes[ia], v->rx_bytes[ib], dt);
+    r->tx_bps = counter_rate(v->tx_bytes[ia], v->tx_bytes[ib], dt);
+    return 0;
+}
+
+static void add_rates(cJSON *obj, const struct vm_rates *r) {
+    cJSON_AddNumberToObject(obj, "time", (double)(r->t_ms / 1000));
+    cJSON_AddNumberToObject(obj, "cpuPercent", r->cpu_percent);
+    cJSON_AddNumberToObject(obj, "memoryMiB", r->mem_mib);
+    cJSON_AddNumberToObject(obj, "diskReadBps", r->rd_bps);
+    cJSON_AddNumberToObject(obj, "diskWriteBps", r->wr_bps);
+    cJSON_AddNumberToObject(obj, "netRxBps", r->rx_bps);
+    cJSON_AddNumberToObject(obj, "netTxBps", r->tx_bps);
+}
+
+/*
+ * Fenêtre sous-échantillonnée : un point par pas de step_s secondes, du plus
+ * ancien au plus récent, un tableau par métrique. Chaque point est le débit
+ * moyen sur son pas (les compteurs étant cumulés, deux lectures suffisent).
+ */
+static cJSON *window_json(const struct vm_series *v, int window_s, int step_s) {
+    unsigned int stride = step_s / VMSTATS_INTERVAL_S;
+    int points = window_s / step_s;
+
+    cJSON *w = cJSON_CreateObject();
+    cJSON_AddNumberToObject(w, "step", step_s);
+    cJSON *t   = cJSON_AddArrayToObject(w, "time");
+    cJSON *cpu = cJSON_AddArrayToObject(w, "cpuPercent");
+    cJSON *mem = cJSON_AddArrayToObject(w, "memoryMiB");
+    cJSON *rd  = cJSON_AddArrayToObject(w, "diskReadBps");
+    cJSON *wr  = cJSON_AddArrayToObject(w, "diskWriteBps");
+    cJSON *rx  = cJSON_AddArrayToObject(w, "netRxBps");
+    cJSON *tx  = cJSON_AddArrayToObject(w, "netTxBps");
+
+    for (int j = points - 1; j >= 0; j--) {
+        struct vm_rates r;
+        unsigned int a = (unsigned int)j * stride;
+        if (rates_between(v, a, a + stride, &r) < 0)
+            continue;
+        cJSON_AddItemToArray(t,   cJSON_CreateNumber((double)(r.t_ms / 1000)));
+        cJSON_AddItemToArray(cpu, cJSON_CreateNumber(r.cpu_percent));
+        cJSON_AddItemToArray(mem, cJSON_CreateNumber(r.mem_mib));
+        cJSON_AddItemToArray(rd,  cJSON_CreateNumber(r.rd_bps));
+        cJSON_AddItemToArray(wr,  cJSON_CreateNumber(r.wr_bps));
+        cJSON_AddItemToArray(rx,  cJSON_CreateNumber(r.rx_bps));
+        cJSON_AddItemToArray(tx,  cJSON_CreateNumber(r.tx_bps));
+    }
+    return w;
+}
+
+/* --------------------------------------------------------------------------
+ * Handler HTTP
+ * -------------------------------------------------------------------------- */
+
+/**
+ * POST /vmstats
+ * BODY JSON (tous les champs sont optionnels) :
+ * {
+ *   "uri": "qemu:///system",   // limite à un hyperviseur
+ *   "vmName": "vm1",           // limite à une VM
+ *   "history": true            // ajoute les fenêtres 1 min / 1 h (défaut : si vmName)
+ * }
+ *
+ * Réponse : débits courants (dernier intervalle) par VM, lus en mémoire
+ * sans appel libvirt.
+ */
+char *handle_vmstats(const char *post_data) {
+    cJSON *root = (post_data && post_data[0]) ? cJSON_Parse(post_data) : cJSON_CreateObject();
+    if (!root)
+        return make_json_error("Invalid JSON");
+
+    vmstats_start_sampler();
+
+    cJSON *j;
+    const char *uri = (j = cJSON_GetObjectItem(root, "uri")) && cJSON_IsString(j)
+                      ? j->valuestring : NULL;
+    const char *vm_name = (j = cJSON_GetObjectItem(root, "vmName")) && cJSON_IsString(j)
+                          ? j->valuestring : NULL;
+    int history = (j = cJSON_GetObjectItem(root, "history")) && cJSON_IsBool(j)
+                  ? cJSON_IsTrue(j) : vm_name != NULL;
+
+    cJSON *resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, "status", "ok");
+    cJSON_AddNumberToObject(resp, "interval", VMSTATS_INTERVAL_S);
+    cJSON *arr = cJSON_AddArrayToObject(resp, "vms");
+
+    pthread_mutex_lock(&series_lock);
+    for (int i = 0; i < MAX_VMSTATS_SERIES; i++) {
+        const struct vm_series *v = &series[i];
+        if (!v->in_use)
+            continue;
+        if (uri && strcmp(v->uri, uri) != 0)
+            continue;
+        if (vm_name && strcmp(v->name, vm_name) != 0)
+            continue;
+
+        cJSON *obj = cJSON_CreateObject();
+        cJSON_AddStringToObject(obj, "uri", v->uri);
+        cJSON_AddStringToObject(obj, "name", v->name);
+        cJSON_AddStringToObject(obj, "uuid", v->uuid);
+        cJSON_AddBoolToObject(obj, "active", v->active);
+        cJSON_AddNumberToObject(obj, "vcpus", v->vcpus);
+
+        struct vm_rates r;
+        if (v->active && rates_between(v, 0, 1, &r) == 0) {
+            cJSON *cur = cJSON_CreateObject();
+            add_rates(cur, &r);
+            cJSON_AddItemToObject(obj, "current", cur);
+        }
+
+        if (history) {
+            cJSON *h = cJSON_CreateObject();
+            cJSON_AddItemToObject(h, "1m", window_json(v, 60, VMSTATS_INTERVAL_S));
+            cJSON_AddItemToObject(h, "1h", window_json(v, VMSTATS_WINDOW_S, 60));
+            cJSON_AddItemToObject(obj, "history", h);
+        }
+
+        cJSON_AddItemToArray(arr, obj);
+    }
+    pthread_mutex_unlock(&series_lock);
+
+    cJSON_Delete(root);
+    char *out = cJSON_PrintUnformatted(resp);
+    cJSON_Delete(resp);
+    return out;
+}
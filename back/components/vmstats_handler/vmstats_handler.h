@@ -0,0 +1,25 @@
+// vmstats_handler.h
+#ifndef VMSTATS_HANDLER_H
+#define VMSTATS_HANDLER_H
+
+/*
+ * Intervalle d'échantillonnage (s) et profondeur d'historique : une heure
+ * de pas, plus le relevé qui ouvre le premier (60 débits d'1 min = 721 relevés)
+ */
+#define VMSTATS_INTERVAL_S 5
+#define VMSTATS_WINDOW_S   3600
+#define VMSTATS_RING       (VMSTATS_WINDOW_S / VMSTATS_INTERVAL_S + 1)
+
+/* Nombre max de VMs suivies, tous hôtes confondus */
+#define MAX_VMSTATS_SERIES 256
+
+/*
+ * Démarre le thread d'échantillonnage (idempotent). Il interroge toutes
+ * les VMs actives des hôtes enregistrés auprès du service de placement.
+ */
+void vmstats_start_sampler(void);
+
+/* Débits courants par VM et historique sous-échantillonné (1 min, 1 h) */
+char *handle_vmstats(const char *post_data);
+
+#endif
@@ -1,9 +1,41 @@
 #include "libvirt-utils.h"
+#define LOG_COMPONENT "libvirt"
+#include "components/logger/logger.h"
+#include "components/trace/trace.h"
 #include <libvirt/libvirt.h>
 #include <libvirt/virterror.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+/* Nombre max d'hyperviseurs gardés ouverts dans le pool */
+#define LIBVIRT_POOL_SIZE 32
+
+struct pool_entry {
+    char uri[512];
+    virConnectPtr conn;
+};
+
+static struct pool_entry pool[LIBVIRT_POOL_SIZE];
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* URI sondées récemment (en cours ou en échec) */
+#define LIBVIRT_PROBE_SLOTS 64
+
+struct probe_entry {
+    char uri[512];
+    int  running;                       /* un thread est dans virConnectOpen */
+    long long started_ms;
+    long long failed_ms;                /* 0 : pas d'échec récent */
+    char error[256];
+};
+
+static struct probe_entry probes[LIBVIRT_PROBE_SLOTS];
+static pthread_mutex_t probe_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t probe_done = PTHREAD_COND_INITIALIZER;
 
 /* ------------------------------------------------------------------ */
 /* URI builder                                                        */
@@ -39,21 +71,273 @@ void build_libvirt_uri(char *uri, size_t size,
 /* ------------------------------------------------------------------ */
 int test_libvirt_connection(const char *uri)
 {
-    fprintf(stderr, "Attempting to connect to %s\n", uri);
+    return libvirt_probe(uri, LIBVIRT_PROBE_TIMEOUT_MS, NULL) == LIBVIRT_PROBE_OK ? 0 : -1;
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Connection pool                                                    */
+/* ------------------------------------------------------------------ */
+virConnectPtr libvirt_pool_open(const char *uri)
+{
+    pthread_mutex_lock(&pool_lock);
+    for (int i = 0; i < LIBVIRT_POOL_SIZE; i++) {
+        if (!pool[i].conn || strcmp(pool[i].uri, uri) != 0)
+            continue;
+
+        if (virConnectIsAlive(pool[i].conn) == 1) {
+            virConnectRef(pool[i].conn);
+            virConnectPtr conn = pool[i].conn;
+            pthread_mutex_unlock(&pool_lock);
+            return conn;
+        }
+
+        /* Connexion morte : on la jette et on en rouvre une */
+        virConnectClose(pool[i].conn);
+        pool[i].conn = NULL;
+        break;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    /* Ouverture hors verrou : peut prendre le timeout SSH/TCP complet */
+    virConnectPtr conn = TRACE_VIRT(virConnectOpen, uri);
+    if (!conn)
+        return NULL;
+
+    pthread_mutex_lock(&pool_lock);
+    int slot = -1;
+    for (int i = 0; i < LIBVIRT_POOL_SIZE; i++) {
+        if (pool[i].conn && strcmp(pool[i].uri, uri) == 0) {
+            /* Un autre thread a ouvert la même entre-temps : on garde la sienne */
+            virConnectRef(pool[i].conn);
+            virConnectPtr shared = pool[i].conn;
+            pthread_mutex_unlock(&pool_lock);
+            virConnectClose(conn);
+            return shared;
+        }
+        if (!pool[i].conn && slot < 0)
+            slot = i;
+    }
+
+    if (slot >= 0) {
+        snprintf(pool[slot].uri, sizeof(pool[slot].uri), "%s", uri);
+        pool[slot].conn = conn;
+        virConnectRef(conn);   /* référence gardée par le pool */
+    }
+    /* Pool plein : connexion non partagée, fermée par l'appelant */
+    pthread_mutex_unlock(&pool_lock);
+    return conn;
+}
+
+void libvirt_pool_drop(const char *uri)
+{
+    virConnectPtr conn = NULL;
+
+    pthread_mutex_lock(&pool_lock);
+    for (int i = 0; i < LIBVIRT_POOL_SIZE; i++) {
+        if (pool[i].conn && strcmp(pool[i].uri, uri) == 0) {
+            conn = pool[i].conn;
+            pool[i].conn = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (conn)
+        virConnectClose(conn);
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Connection probes                                                  */
+/* ------------------------------------------------------------------ */
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Connexion vivante déjà dans le pool (sans rien ouvrir) */
+static int pool_has_live(const char *uri)
+{
+    int alive = 0;
+    pthread_mutex_lock(&pool_lock);
+    for (int i = 0; i < LIBVIRT_POOL_SIZE; i++) {
+        if (pool[i].conn && strcmp(pool[i].uri, uri) == 0) {
+            alive = virConnectIsAlive(pool[i].conn) == 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return alive;
+}
+
+/* Place pour uri : la sienne, une libre, sinon le plus vieil échec (sous probe_lock) */
+static struct probe_entry *probe_slot(const char *uri)
+{
+    struct probe_entry *oldest = NULL;
+    for (int i = 0; i < LIBVIRT_PROBE_SLOTS; i++)
+        if (probes[i].uri[0] && strcmp(probes[i].uri, uri) == 0)
+            return &probes[i];
+    for (int i = 0; i < LIBVIRT_PROBE_SLOTS; i++) {
+        struct probe_entry *p = &probes[i];
+        if (!p->uri[0] || (!p->running && !p->failed_ms)) {
+            oldest = p;
+            break;
+        }
+        if (!p->running && (!oldest || p->failed_ms < oldest->failed_ms))
+            oldest = p;
+    }
+    if (oldest) {
+        memset(oldest, 0, sizeof(*oldest));
+        snprintf(oldest->uri, sizeof(oldest->uri), "%s", uri);
+    }
+    return oldest;
+}
+
+/*
+ * Ouverture réelle, hors du thread HTTP : l'entrée ne peut pas être
+ * réutilisée tant que running est posé.
+ */
+static void *probe_thread(void *arg)
+{
+    struct probe_entry *p = arg;
+    char uri[512];
+    pthread_mutex_lock(&probe_lock);
+    snprintf(uri, sizeof(uri), "%s", p->uri);
+    pthread_mutex_unlock(&probe_lock);
 
-    virConnectPtr conn = virConnectOpen(uri);
-    if (!conn) {
-        fprintf(stderr, "Failed to connect to %s\n", uri);
-        return -1;
+    char error[256] = "";
+    virConnectPtr conn = libvirt_pool_open(uri);
+    if (conn) {
+        virConnectClose(conn);          /* le pool garde sa propre référence */
+    } else {
+        virErrorPtr err = virGetLastError();
+        snprintf(error, sizeof(error), "%s",
+                 err && err->message ? err->message : "failed to connect to hypervisor");
+        LOG_WARN("probe %s failed: %s", uri, error);
     }
 
-    fprintf(stdout, "Connected successfully to %s\n", uri);
-    virConnectClose(conn);
-    return 0;
+    pthread_mutex_lock(&probe_lock);
+    p->running = 0;
+    p->failed_ms = conn ? 0 : now_ms();
+    snprintf(p->error, sizeof(p->error), "%s", error);
+    LOG_DEBUG("probe %s done in %lld ms", uri, now_ms() - p->started_ms);
+    pthread_cond_broadcast(&probe_done);
+    pthread_mutex_unlock(&probe_lock);
+    return NULL;
+}
+
+static int start_probe(struct probe_entry *p)
+{
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    p->running = 1;
+    p->started_ms = now_ms();
+    int rc = pthread_create(&tid, &attr, probe_thread, p);
+    pthread_attr_destroy(&attr);
+    if (rc != 0)
+        p->running = 0;
+    return rc == 0 ? 0 : -1;
+}
+
+/* Échec récent : secondes avant qu'il soit oublié, 0 sinon (sous probe_lock) */
+static int negative_left_s(const struct probe_entry *p, long long now)
+{
+    if (p->running || !p->failed_ms)
+        return 0;
+    long long left = p->failed_ms + LIBVIRT_PROBE_NEGATIVE_TTL_S * 1000LL - now;
+    return left > 0 ? (int)((left + 999) / 1000) : 0;
 }
 
+int libvirt_probe(const char *uri, int timeout_ms, struct libvirt_probe_result *res)
+{
+    struct libvirt_probe_result local;
+    if (!res)
+        res = &local;
+    memset(res, 0, sizeof(*res));
+    long long t0 = now_ms();
+
+    /* Hôte déjà connecté : réponse immédiate */
+    if (pool_has_live(uri)) {
+        res->cached = 1;
+        return LIBVIRT_PROBE_OK;
+    }
+
+    if (timeout_ms <= 0 || timeout_ms > LIBVIRT_PROBE_MAX_TIMEOUT_MS)
+        timeout_ms = timeout_ms <= 0 ? LIBVIRT_PROBE_TIMEOUT_MS : LIBVIRT_PROBE_MAX_TIMEOUT_MS;
+
+    pthread_mutex_lock(&probe_lock);
+    struct probe_entry *p = probe_slot(uri);
+    if (!p) {
+        pthread_mutex_unlock(&probe_lock);
+        snprintf(res->error, sizeof(res->error), "too many pending probes");
+        res->retry_after_s = 1;
+        return LIBVIRT_PROBE_FAILED;
+    }
 
+    int left = negative_left_s(p, t0);
+    if (left > 0) {
+        res->cached = 1;
+        res->retry_after_s = left;
+        snprintf(res->error, sizeof(res->error), "%s", p->error);
+        pthread_mutex_unlock(&probe_lock);
+        return LIBVIRT_PROBE_FAILED;
+    }
 
+    if (p->running) {
+        /* Ouverture déjà en vol depuis plus que notre délai : inutile d'attendre */
+        if (t0 - p->started_ms >= timeout_ms) {
+            res->cached = 1;
+            res->retry_after_s = 1;
+            snprintf(res->error, sizeof(res->error), "connection attempt still in progress");
+            pthread_mutex_unlock(&probe_lock);
+            return LIBVIRT_PROBE_TIMEOUT;
+        }
+    } else if (start_probe(p) < 0) {
+        pthread_mutex_unlock(&probe_lock);
+        snprintf(res->error, sizeof(res->error), "cannot start probe");
+        return LIBVIRT_PROBE_FAILED;
+    }
 
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    uint64_t trace_t0 = trace_begin();
+    while (p->running && strcmp(p->uri, uri) == 0) {
+        if (pthread_cond_timedwait(&probe_done, &probe_lock, &deadline) == ETIMEDOUT)
+            break;
+    }
 
+    /* Entrée reprise par une autre URI après la fin de la sonde : le pool tranche */
+    int mine = strcmp(p->uri, uri) == 0;
+    int status;
+    if (mine && p->running) {
+        status = LIBVIRT_PROBE_TIMEOUT;
+        res->retry_after_s = 1;
+        snprintf(res->error, sizeof(res->error), "no answer within %d ms", timeout_ms);
+    } else if (mine && p->failed_ms) {
+        status = LIBVIRT_PROBE_FAILED;
+        res->retry_after_s = LIBVIRT_PROBE_NEGATIVE_TTL_S;
+        snprintf(res->error, sizeof(res->error), "%s", p->error);
+    } else {
+        status = LIBVIRT_PROBE_OK;
+    }
+    pthread_mutex_unlock(&probe_lock);
+    if (!mine && !pool_has_live(uri)) {
+        status = LIBVIRT_PROBE_FAILED;
+        snprintf(res->error, sizeof(res->error), "failed to connect to hypervisor");
+    }
+    trace_end_detail("libvirt", "probe", trace_t0, uri);
 
+    res->elapsed_ms = now_ms() - t0;
+    return status;
+}
@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <libvirt/libvirt.h>
 
 void build_libvirt_uri(char *uri, size_t size,
                        const char *protocol,
@@ -13,9 +14,45 @@ void build_libvirt_uri(char *uri, size_t size,
 
 int test_libvirt_connection(const char *uri);
 
+/* Sondes de connexion (/connect) : délai par défaut / max, échec gardé en cache */
+#define LIBVIRT_PROBE_TIMEOUT_MS 3000
+#define LIBVIRT_PROBE_MAX_TIMEOUT_MS 15000
+#define LIBVIRT_PROBE_NEGATIVE_TTL_S 15
+
+enum libvirt_probe_status {
+    LIBVIRT_PROBE_OK = 0,               /* connexion ouverte, gardée dans le pool */
+    LIBVIRT_PROBE_FAILED = -1,          /* échec (récent : servi depuis le cache) */
+    LIBVIRT_PROBE_TIMEOUT = -2          /* toujours en cours, en tâche de fond */
+};
+
+struct libvirt_probe_result {
+    int  cached;                        /* réponse sans nouvelle tentative */
+    int  retry_after_s;                 /* avant une vraie nouvelle tentative */
+    long long elapsed_ms;
+    char error[256];
+};
+
+/*
+ * Teste uri en timeout_ms au plus. Une seule ouverture en vol par URI : les
+ * appels concurrents attendent la même. Une ouverture qui dépasse le délai
+ * continue seule et alimente le pool ou le cache d'échecs à sa fin.
+ * res peut être NULL.
+ */
+int libvirt_probe(const char *uri, int timeout_ms, struct libvirt_probe_result *res);
+
 /* Liste tous les VMs (actifs et inactifs) */
 char *list_all_vms(const char *uri);
 
+/*
+ * Pool de connexions libvirt partagé (une connexion par URI).
+ * Retourne une référence sur la connexion du pool (ouverte si besoin) :
+ * l'appelant la rend avec virConnectClose() comme une connexion classique.
+ */
+virConnectPtr libvirt_pool_open(const char *uri);
+
+/* Ferme et oublie la connexion du pool pour cet URI (hôte retiré / mort) */
+void libvirt_pool_drop(const char *uri);
+
 
 
 
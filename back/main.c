@@ -1,6 +1,12 @@
 #include "./components/server/http-server.h"
+#include "./components/vmstats_handler/vmstats_handler.h"
+#include "./components/logger/logger.h"
+#include "./components/domdesc/domdesc.h"
 
 int main() {
+    log_init();
+    domdesc_init();     /* boucle d'événements libvirt, avant toute connexion */
+    vmstats_start_sampler();
     start_http_server(8080);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+// scripts/compress-dist.js
+// Après `vite build` : variantes .br et .gz des fichiers texte de dist/,
+// servies telles quelles par le backend selon Accept-Encoding.
+const fs = require('fs');
+const path = require('path');
+const zlib = require('zlib');
+
+const DIST = path.join(__dirname, '..', 'dist');
+const COMPRESSIBLE = /\.(html|js|mjs|css|json|map|svg|txt|ico|wasm|ttf)$/i;
+const MIN_SIZE = 1024; // en dessous, les en-têtes coûtent plus que le gain
+
+function* walk(dir) {
+  for (const entry of fs.readdirSync(dir, { withFileTypes: true })) {
+    const full = path.join(dir, entry.name);
+    if (entry.isDirectory()) yield* walk(full);
+    else if (entry.isFile()) yield full;
+  }
+}
+
+let count = 0;
+for (const file of walk(DIST)) {
+  if (!COMPRESSIBLE.test(file)) continue;
+  const data = fs.readFileSync(file);
+  if (data.length < MIN_SIZE) continue;
+
+  const br = zlib.brotliCompressSync(data, {
+    params: {
+      [zlib.constants.BROTLI_PARAM_QUALITY]: zlib.constants.BROTLI_MAX_QUALITY,
+      [zlib.constants.BROTLI_PARAM_SIZE_HINT]: data.length,
+    },
+  });
+  const gz = zlib.gzipSync(data, { level: zlib.constants.Z_BEST_COMPRESSION });
+
+  // Variante inutile si elle ne fait pas gagner au moins 10 %
+  if (br.length < data.length * 0.9) fs.writeFileSync(`${file}.br`, br);
+  if (gz.length < data.length * 0.9) fs.writeFileSync(`${file}.gz`, gz);
+  count++;
+}
+console.log(`compress-dist: ${count} file(s) precompressed in ${DIST}`);
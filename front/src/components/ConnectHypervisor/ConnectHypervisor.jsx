@@ -1,4 +1,4 @@
-import React, { useState } from 'react';
+import React, { useEffect, useState } from 'react';
 import { connectHypervisor } from '../../services/api';
 import { useNavigate } from 'react-router-dom';
 import { setSession } from '../../utils/session';
@@ -15,6 +15,17 @@ export default function ConnectHypervisor() {
   const [loading, setLoading] = useState(false);
   const [resp, setResp] = useState(null);
   const [error, setError] = useState(null);
+  // Échec récent : le backend répond depuis son cache, inutile de relancer avant
+  const [cooldown, setCooldown] = useState(0);
+
+  useEffect(() => {
+    if (cooldown <= 0) return undefined;
+    const t = setTimeout(() => setCooldown((c) => c - 1), 1000);
+    return () => clearTimeout(t);
+  }, [cooldown]);
+
+  // Autre hyperviseur : pas concerné par l'échec précédent
+  useEffect(() => setCooldown(0), [protocol, user, host, port, path]);
 
   const colors = { blue: "#003366", red: "#dc2626" };
 
@@ -41,7 +52,8 @@ export default function ConnectHypervisor() {
         setSession(payload);
         navigate('/listallvms');
       } else {
-        setError(data.message || 'Connection failed');
+        setError(data.error ? `${data.message}: ${data.error}` : data.message || 'Connection failed');
+        setCooldown(data.retryAfterS || 0);
       }
     } catch (err) {
       console.error(err);
@@ -97,10 +109,10 @@ export default function ConnectHypervisor() {
 
                     {/* Buttons */}
                     <div className="d-flex gap-2">
-                      <button type="submit" className="btn btn-primary flex-grow-1" disabled={loading} style={{ backgroundColor: colors.blue, borderColor: colors.blue }}>
-                        {loading ? 'Connecting…' : 'Connect'}
+                      <button type="submit" className="btn btn-primary flex-grow-1" disabled={loading || cooldown > 0} style={{ backgroundColor: colors.blue, borderColor: colors.blue }}>
+                        {loading ? 'Connecting…' : cooldown > 0 ? `Retry in ${cooldown}s` : 'Connect'}
                       </button>
-                      <button type="button" className="btn btn-outline-secondary" onClick={() => { setUser(''); setHost(''); setPort(''); setResp(null); setError(null); }}>
+                      <button type="button" className="btn btn-outline-secondary" onClick={() => { setUser(''); setHost(''); setPort(''); setResp(null); setError(null); setCooldown(0); }}>
                         Reset
                       </button>
                     </div>
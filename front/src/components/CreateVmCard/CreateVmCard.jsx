@@ -1,6 +1,6 @@
 // File: CreateVmCard.jsx
-import React, { useState } from "react";
-import { createVm } from "../../services/api"; // adapte le chemin si besoin
+import React, { useEffect, useState } from "react";
+import { createVm, getHostInfo } from "../../services/api"; // adapte le chemin si besoin
 
 const CreateVmCard = () => {
   const colors = {
@@ -15,9 +15,27 @@ const CreateVmCard = () => {
   const [iso, setIso] = useState("");
   const [diskSize, setDiskSize] = useState(8192); // 8 Go par défaut (en MB)
   const [network, setNetwork] = useState("default"); // pour l'instant un seul réseau
+  const [cpuModel, setCpuModel] = useState(""); // "" = modèle par défaut de libvirt
+  const [machine, setMachine] = useState(""); // "" = machine par défaut
+  const [hostInfo, setHostInfo] = useState(null);
   const [message, setMessage] = useState(null);
   const [loading, setLoading] = useState(false);
 
+  // Capabilities de l'hôte : bornes du formulaire, modèles CPU, machines
+  useEffect(() => {
+    getHostInfo()
+      .then((info) => {
+        if (info.status === "ok") setHostInfo(info);
+      })
+      .catch((err) => console.error(err));
+  }, []);
+
+  const maxCpu = hostInfo
+    ? Math.min(hostInfo.host.cpus || 32, hostInfo.domain.vcpuMax || 32)
+    : 32;
+  const maxMemory = hostInfo ? hostInfo.host.memoryMiB || 4096 : 4096;
+  const nativeGuest = hostInfo?.guests.find((g) => g.arch === hostInfo.host.arch);
+
   // Exemple d’ISOs disponibles
   const isoList = [
     "ubuntu-11.04-server-amd64.iso",
@@ -31,15 +49,16 @@ const CreateVmCard = () => {
     if (
       !vmName ||
       cpu < 1 ||
+      cpu > maxCpu ||
       memory < 256 ||
-      memory > 4096 ||
+      memory > maxMemory ||
       !iso ||
       diskSize < 1024 || // 1 Go minimum
       diskSize > 102400 // 100 Go max (adaptable)
     ) {
       setMessage({
         type: "error",
-        text: "Veuillez remplir correctement tous les champs. Mémoire : 256-4096 MB, Disque : 1024-102400 MB",
+        text: `Veuillez remplir correctement tous les champs. CPU : 1-${maxCpu}, Mémoire : 256-${maxMemory} MB, Disque : 1024-102400 MB`,
       });
       return;
     }
@@ -52,6 +71,8 @@ const CreateVmCard = () => {
       disk_size: diskSize, // ⚠️ correspond à j_disk_size côté C
       network, // nouveau champ pour le backend
     };
+    if (cpuModel) payload.cpuModel = cpuModel;
+    if (machine) payload.machine = machine;
 
     try {
       setLoading(true);
@@ -72,6 +93,8 @@ const CreateVmCard = () => {
         setIso("");
         setDiskSize(8192);
         setNetwork("default");
+        setCpuModel("");
+        setMachine("");
       } else {
         setMessage({
           type: "error",
@@ -130,7 +153,7 @@ const CreateVmCard = () => {
                   className="form-control form-control-sm"
                   value={cpu}
                   min={1}
-                  max={32}
+                  max={maxCpu}
                   onChange={(e) => setCpu(parseInt(e.target.value, 10) || 1)}
                 />
               </div>
@@ -141,12 +164,12 @@ const CreateVmCard = () => {
                   className="form-control form-control-sm"
                   value={memory}
                   min={256}
-                  max={4096}
+                  max={maxMemory}
                   onChange={(e) =>
                     setMemory(parseInt(e.target.value, 10) || 256)
                   }
                 />
-                <small className="text-muted">256 - 4096</small>
+                <small className="text-muted">256 - {maxMemory}</small>
               </div>
             </div>
 
@@ -178,6 +201,50 @@ const CreateVmCard = () => {
               </div>
             </div>
 
+            {/* CPU model & machine, d'après les capabilities de l'hôte */}
+            {hostInfo && (
+              <div className="row">
+                <div className="col-6 mb-2">
+                  <label className="form-label fw-semibold">CPU Model</label>
+                  <select
+                    className="form-select form-select-sm"
+                    value={cpuModel}
+                    onChange={(e) => setCpuModel(e.target.value)}
+                  >
+                    <option value="">default</option>
+                    {hostInfo.domain.hostPassthrough && (
+                      <option value="host-passthrough">host-passthrough</option>
+                    )}
+                    {hostInfo.domain.cpuModels.map((m) => (
+                      <option key={m} value={m}>
+                        {m}
+                      </option>
+                    ))}
+                  </select>
+                </div>
+                <div className="col-6 mb-2">
+                  <label className="form-label fw-semibold">Machine</label>
+                  <select
+                    className="form-select form-select-sm"
+                    value={machine}
+                    onChange={(e) => setMachine(e.target.value)}
+                  >
+                    <option value="">default</option>
+                    {(nativeGuest?.machines || []).map((m) => (
+                      <option key={m} value={m}>
+                        {m}
+                      </option>
+                    ))}
+                  </select>
+                </div>
+                <small className="text-muted mb-2">
+                  {hostInfo.host.arch} · {hostInfo.domain.type || "qemu"} ·{" "}
+                  {hostInfo.host.cpus} CPUs · {hostInfo.host.freeMemoryMiB} /{" "}
+                  {hostInfo.host.memoryMiB} MB free
+                </small>
+              </div>
+            )}
+
             {/* ISO */}
             <div className="mb-3">
               <label className="form-label fw-semibold">Select ISO</label>
@@ -218,6 +285,8 @@ const CreateVmCard = () => {
                   setIso("");
                   setDiskSize(8192);
                   setNetwork("default");
+                  setCpuModel("");
+                  setMachine("");
                   setMessage(null);
                 }}
               >
@@ -5,9 +5,20 @@ import {
   startVm,
   stopVm,
   shutdownVm,
+  pauseVm,
+  resumeVm,
+  suspendVm,
+  resizeVm,
   deleteVm,
   openConsole,
   migrateVm,
+  getMigrationStatus,
+  cancelMigration,
+  getVmStats,
+  createSnapshot,
+  listSnapshots,
+  revertSnapshot,
+  startBackup,
 } from "../../services/api";
 
 import { useNavigate } from "react-router-dom";
@@ -15,8 +26,19 @@ import { getSession, clearSession } from "../../utils/session";
 import CreateVmCard from "../CreateVmCard/CreateVmCard";
 import MigrateVmCard from "../MigrateVmCard/MigrateVmCard";
 
+// taille d'une page renvoyée par /listallvms
+const PAGE_SIZE = 50;
+
 const ListAllVms = () => {
   const [vms, setVms] = useState([]);
+  const [nextCursor, setNextCursor] = useState(null);
+  // filtres et tri évalués côté backend
+  const [filters, setFilters] = useState({
+    name: "",
+    state: "",
+    sort: "name",
+    order: "asc",
+  });
   const [loading, setLoading] = useState(true);
   const [error, setError] = useState(null);
 
@@ -28,6 +50,10 @@ const ListAllVms = () => {
   const [migrationStatus, setMigrationStatus] = useState(null); // 'running' | 'success' | 'error'
   const [migrationMessage, setMigrationMessage] = useState("");
   const [migrationSubmitting, setMigrationSubmitting] = useState(false);
+  const [migrationJob, setMigrationJob] = useState(null); // dernier état renvoyé par /migratestatus
+
+  // métriques par VM (nom -> débits courants renvoyés par /vmstats)
+  const [vmStats, setVmStats] = useState({});
 
   const navigate = useNavigate();
   const colors = { blue: "#003366", red: "#dc2626", greenDark: "#0b7a3b" };
@@ -35,7 +61,8 @@ const ListAllVms = () => {
   // ============================================================
   // 🔹 FETCH VMs
   // ============================================================
-  const fetchVms = async () => {
+  // reset = true : première page (après un changement de filtre ou une action)
+  const fetchVms = async (reset = true) => {
     const connection = getSession();
     if (!connection) {
       clearSession();
@@ -46,10 +73,17 @@ const ListAllVms = () => {
     setLoading(true);
     setError(null);
 
+    const query = { sort: filters.sort, order: filters.order, limit: PAGE_SIZE, withQos: true };
+    if (filters.name) query.name = filters.name;
+    if (filters.state) query.state = filters.state;
+    if (!reset && nextCursor) query.cursor = nextCursor;
+
     try {
-      const data = await listAllVms(connection);
-      if (data && Array.isArray(data.vms)) setVms(data.vms);
-      else setError("Invalid response from backend");
+      const data = await listAllVms({ ...connection, ...query });
+      if (data && Array.isArray(data.vms)) {
+        setVms((prev) => (reset ? data.vms : [...prev, ...data.vms]));
+        setNextCursor(data.nextCursor || null);
+      } else setError("Invalid response from backend");
     } catch (err) {
       console.error(err);
       setError("Failed to fetch VMs.");
@@ -58,9 +92,62 @@ const ListAllVms = () => {
     }
   };
 
+  // petit délai pour ne pas requêter à chaque frappe dans le filtre nom
+  useEffect(() => {
+    const timer = setTimeout(() => fetchVms(true), 300);
+    return () => clearTimeout(timer);
+  }, [navigate, filters]);
+
+  const updateFilter = (field) => (e) =>
+    setFilters((prev) => ({ ...prev, [field]: e.target.value }));
+
+  // ============================================================
+  // 🔹 METRICS (rafraîchies au rythme du sampler backend)
+  // ============================================================
   useEffect(() => {
-    fetchVms();
-  }, [navigate]);
+    const fetchStats = async () => {
+      const connection = getSession();
+      if (!connection) return;
+      try {
+        const data = await getVmStats(connection);
+        if (data.status !== "ok") return;
+        const byName = {};
+        data.vms.forEach((vm) => {
+          if (vm.active && vm.current) byName[vm.name] = vm.current;
+        });
+        setVmStats(byName);
+      } catch (err) {
+        console.error("Stats error:", err);
+      }
+    };
+
+    fetchStats();
+    const timer = setInterval(fetchStats, 5000);
+    return () => clearInterval(timer);
+  }, []);
+
+  const formatRate = (bps) => {
+    if (bps >= 1024 * 1024) return `${(bps / (1024 * 1024)).toFixed(1)} MiB/s`;
+    if (bps >= 1024) return `${(bps / 1024).toFixed(1)} KiB/s`;
+    return `${Math.round(bps)} B/s`;
+  };
+
+  // limites QoS du premier disque / de la première interface + CPU
+  const formatQos = (qos) => {
+    if (!qos) return "-";
+    const parts = [];
+    const disk = Object.values(qos.disks || {})[0] || {};
+    const iops = disk.totalIops || disk.readIops || disk.writeIops;
+    const bytes = disk.totalBytesSec || disk.readBytesSec || disk.writeBytesSec;
+    if (iops) parts.push(`${iops} IOPS`);
+    if (bytes) parts.push(`disk ${formatRate(bytes)}`);
+    const net = Object.values(qos.interfaces || {})[0] || {};
+    if (net.inboundKBps || net.outboundKBps)
+      parts.push(`net ${net.inboundKBps || "∞"}/${net.outboundKBps || "∞"} KiB/s`);
+    if (qos.cpu && qos.cpu.shares) parts.push(`${qos.cpu.shares} shares`);
+    if (qos.cpu && qos.cpu.vcpuQuotaPercent) parts.push(`${qos.cpu.vcpuQuotaPercent}% / vCPU`);
+    return parts.length ? parts.join(" · ") : "none";
+  };
 
   // ============================================================
   // 🔥 OPEN CONSOLE HANDLER (noVNC)
@@ -135,6 +222,45 @@ const ListAllVms = () => {
     }
   };
 
+  const handlePause = async (vmName) => {
+    try {
+      setLoading(true);
+      const connection = getSession();
+      await pauseVm(connection, vmName);
+      await fetchVms();
+    } catch (err) {
+      setError(`Failed to pause VM "${vmName}".`);
+    } finally {
+      setLoading(false);
+    }
+  };
+
+  const handleResume = async (vmName) => {
+    try {
+      setLoading(true);
+      const connection = getSession();
+      await resumeVm(connection, vmName);
+      await fetchVms();
+    } catch (err) {
+      setError(`Failed to resume VM "${vmName}".`);
+    } finally {
+      setLoading(false);
+    }
+  };
+
+  const handleSuspend = async (vmName) => {
+    try {
+      setLoading(true);
+      const connection = getSession();
+      await suspendVm(connection, vmName);
+      await fetchVms();
+    } catch (err) {
+      setError(`Failed to suspend VM "${vmName}".`);
+    } finally {
+      setLoading(false);
+    }
+  };
+
   const handleDelete = async (vmName) => {
     if (!window.confirm(`Delete VM "${vmName}" ?`)) return;
 
@@ -150,6 +276,81 @@ const ListAllVms = () => {
     }
   };
 
+  // ============================================================
+  // 🔹 SNAPSHOTS
+  // ============================================================
+  const handleSnapshot = async (vmName) => {
+    const name = window.prompt(`Snapshot name for "${vmName}" (empty = timestamp):`, "");
+    if (name === null) return;
+
+    try {
+      setLoading(true);
+      const connection = getSession();
+      const result = await createSnapshot(connection, vmName, name.trim());
+      if (!result.success) setError(`Snapshot failed: ${result.error}`);
+    } catch (err) {
+      setError(`Failed to snapshot VM "${vmName}".`);
+    } finally {
+      setLoading(false);
+    }
+  };
+
+  // Sauvegarde incrémentale (full si la VM n'a pas encore de checkpoint)
+  const handleBackup = async (vmName) => {
+    try {
+      const connection = getSession();
+      const result = await startBackup(connection, vmName);
+      if (result.status !== "ok") setError(`Backup failed: ${result.message}`);
+    } catch (err) {
+      setError(`Failed to back up VM "${vmName}".`);
+    }
+  };
+
+  // vCPUs / mémoire à chaud, dans la limite de maxCpu / maxMemory
+  const handleResize = async (vm) => {
+    const input = window.prompt(
+      `New size for "${vm.name}" as "vCPUs,memory MiB" (e.g. 4,8192):`,
+      `${vm.vcpus},${vm.memoryMiB}`
+    );
+    if (input === null) return;
+    const [vcpus, memory] = input.split(",").map((v) => parseInt(v, 10));
+    const sizes = {};
+    if (vcpus > 0) sizes.vcpus = vcpus;
+    if (memory > 0) sizes.memory = memory;
+
+    try {
+      const connection = getSession();
+      const result = await resizeVm(connection, vm.name, sizes);
+      if (!result.success) setError(`Resize failed: ${result.error}`);
+      await fetchVms(true);
+    } catch (err) {
+      setError(`Failed to resize VM "${vm.name}".`);
+    }
+  };
+
+  // Retour au snapshot courant (le dernier pris ou restauré)
+  const handleRollback = async (vmName) => {
+    try {
+      const connection = getSession();
+      const list = await listSnapshots(connection, vmName);
+      const current = list.success && list.snapshots.find((snap) => snap.current);
+      if (!current) {
+        alert(`No snapshot for "${vmName}".`);
+        return;
+      }
+      if (!window.confirm(`Revert "${vmName}" to snapshot "${current.name}" ?`)) return;
+
+      setLoading(true);
+      const result = await revertSnapshot(connection, vmName, current.name);
+      if (!result.success) setError(`Revert failed: ${result.error}`);
+      await fetchVms();
+    } catch (err) {
+      setError(`Failed to revert VM "${vmName}".`);
+    } finally {
+      setLoading(false);
+    }
+  };
+
   // ============================================================
   // 🔥 MIGRATION HANDLERS
   // ============================================================
@@ -167,19 +368,50 @@ const ListAllVms = () => {
     setMigrationSubmitting(false);
   };
 
-  const handleConfirmMigrate = async (destUri) => {
+  // Attend la fin du job en interrogeant /migratestatus chaque seconde
+  const waitForMigration = async (jobId) => {
+    for (;;) {
+      await new Promise((resolve) => setTimeout(resolve, 1000));
+      const result = await getMigrationStatus(jobId);
+      if (result.status !== "ok" || !result.job) return result;
+
+      setMigrationJob(result.job);
+      const { state, progress } = result.job;
+      if (state !== "starting" && state !== "running") return result;
+
+      setMigrationMessage(
+        `Migrating "${result.job.vmName}" to ${result.job.destUri} ... ` +
+          `${Math.round(progress.percent)}% (iteration ${progress.iteration})`
+      );
+    }
+  };
+
+  const handleConfirmMigrate = async (destUri, profile) => {
     try {
       setMigrationSubmitting(true);
+      setMigrationJob(null);
       setMigrationStatus("running");
       setMigrationMessage(
         `Migrating "${vmToMigrate}" to ${destUri} ...`
       );
 
       const connection = getSession();
-      const result = await migrateVm(connection, vmToMigrate, destUri);
+      const started = await migrateVm(connection, vmToMigrate, destUri, profile);
+      console.log("Migration started:", started);
+
+      if (started.status !== "ok") {
+        setMigrationStatus("error");
+        setMigrationMessage(
+          `Migration error: ${started.message || "unknown error"}`
+        );
+        return;
+      }
+
+      setMigrationJob(started);
+      const result = await waitForMigration(started.jobId);
       console.log("Migration result:", result);
 
-      if (result.status === "ok") {
+      if (result.status === "ok" && result.job.state === "completed") {
         setMigrationStatus("success");
         setMigrationMessage(
           `Migration of "${vmToMigrate}" to ${destUri} successful.`
@@ -191,9 +423,10 @@ const ListAllVms = () => {
         // fermer la carte de migration
         closeMigrateModal();
       } else {
+        const message = result.job ? result.job.message : result.message;
         setMigrationStatus("error");
         setMigrationMessage(
-          `Migration error: ${result.message || "unknown error"}`
+          `Migration error: ${message || "unknown error"}`
         );
       }
     } catch (err) {
@@ -202,6 +435,16 @@ const ListAllVms = () => {
       setMigrationMessage("Failed to migrate VM.");
     } finally {
       setMigrationSubmitting(false);
+      setMigrationJob(null);
+    }
+  };
+
+  const handleAbortMigration = async () => {
+    if (!migrationJob) return;
+    try {
+      await cancelMigration(migrationJob.jobId);
+    } catch (err) {
+      console.error("Cancel migration error:", err);
     }
   };
 
@@ -239,7 +482,9 @@ const ListAllVms = () => {
               vmName={vmToMigrate}
               onConfirm={handleConfirmMigrate}
               onCancel={closeMigrateModal}
+              onAbort={handleAbortMigration}
               isSubmitting={migrationSubmitting}
+              progress={migrationJob ? migrationJob.progress : null}
             />
           </div>
         </div>
@@ -280,6 +525,51 @@ const ListAllVms = () => {
                 </div>
               )}
 
+              {/* Filtres / tri (appliqués par le backend) */}
+              <div className="d-flex flex-wrap gap-2 p-3 border-bottom">
+                <input
+                  type="text"
+                  className="form-control form-control-sm"
+                  style={{ maxWidth: "220px" }}
+                  placeholder="Name prefix or glob (web-*)"
+                  value={filters.name}
+                  onChange={updateFilter("name")}
+                />
+                <select
+                  className="form-select form-select-sm"
+                  style={{ maxWidth: "160px" }}
+                  value={filters.state}
+                  onChange={updateFilter("state")}
+                >
+                  <option value="">All states</option>
+                  <option value="active">Active</option>
+                  <option value="inactive">Inactive</option>
+                  <option value="running">Running</option>
+                  <option value="paused">Paused</option>
+                  <option value="shutoff">Shut off</option>
+                </select>
+                <select
+                  className="form-select form-select-sm"
+                  style={{ maxWidth: "160px" }}
+                  value={filters.sort}
+                  onChange={updateFilter("sort")}
+                >
+                  <option value="name">Sort by name</option>
+                  <option value="memory">Sort by memory</option>
+                  <option value="vcpus">Sort by vCPUs</option>
+                  <option value="state">Sort by state</option>
+                </select>
+                <select
+                  className="form-select form-select-sm"
+                  style={{ maxWidth: "120px" }}
+                  value={filters.order}
+                  onChange={updateFilter("order")}
+                >
+                  <option value="asc">Ascending</option>
+                  <option value="desc">Descending</option>
+                </select>
+              </div>
+
               <div className="table-responsive flex-grow-1">
                 <table className="table table-hover mb-0">
                   <thead className="table-light">
@@ -287,6 +577,11 @@ const ListAllVms = () => {
                       <th className="text-center">#</th>
                       <th>VM Name</th>
                       <th>Status</th>
+                      <th>CPU</th>
+                      <th>Memory</th>
+                      <th>Disk R/W</th>
+                      <th>Net RX/TX</th>
+                      <th>Limits</th>
                       <th className="text-center">Actions</th>
                     </tr>
                   </thead>
@@ -300,13 +595,45 @@ const ListAllVms = () => {
                         <td>
                           <span
                             className={`badge ${
-                              vm.active ? "bg-success" : "bg-secondary"
+                              vm.state === "paused"
+                                ? "bg-warning"
+                                : vm.active
+                                ? "bg-success"
+                                : "bg-secondary"
                             }`}
                           >
-                            {vm.active ? "Running" : "Stopped"}
+                            {vm.state === "paused"
+                              ? "Paused"
+                              : vm.active
+                              ? "Running"
+                              : "Stopped"}
                           </span>
                         </td>
 
+                        {vm.active && vmStats[vm.name] ? (
+                          <>
+                            <td>{vmStats[vm.name].cpuPercent.toFixed(1)} %</td>
+                            <td>{Math.round(vmStats[vm.name].memoryMiB)} MiB</td>
+                            <td className="small">
+                              {formatRate(vmStats[vm.name].diskReadBps)} /{" "}
+                              {formatRate(vmStats[vm.name].diskWriteBps)}
+                            </td>
+                            <td className="small">
+                              {formatRate(vmStats[vm.name].netRxBps)} /{" "}
+                              {formatRate(vmStats[vm.name].netTxBps)}
+                            </td>
+                          </>
+                        ) : (
+                          <>
+                            <td className="text-muted">-</td>
+                            <td className="text-muted">-</td>
+                            <td className="text-muted">-</td>
+                            <td className="text-muted">-</td>
+                          </>
+                        )}
+
+                        <td className="small text-muted">{formatQos(vm.qos)}</td>
+
                         <td className="text-center">
                           {vm.active && (
                             <button
@@ -339,8 +666,61 @@ const ListAllVms = () => {
                             Migrate
                           </button>
 
+                          <button
+                            className="btn btn-outline-secondary btn-sm me-2"
+                            onClick={() => handleSnapshot(vm.name)}
+                          >
+                            Snapshot
+                          </button>
+
+                          <button
+                            className="btn btn-outline-secondary btn-sm me-2"
+                            onClick={() => handleRollback(vm.name)}
+                          >
+                            Rollback
+                          </button>
+
+                          {vm.active && (
+                            <button
+                              className="btn btn-outline-secondary btn-sm me-2"
+                              onClick={() => handleBackup(vm.name)}
+                            >
+                              Backup
+                            </button>
+                          )}
+
+                          <button
+                            className="btn btn-outline-secondary btn-sm me-2"
+                            onClick={() => handleResize(vm)}
+                          >
+                            Resize
+                          </button>
+
                           {vm.active ? (
                             <>
+                              {vm.state === "paused" ? (
+                                <button
+                                  className="btn btn-outline-success btn-sm me-2"
+                                  onClick={() => handleResume(vm.name)}
+                                >
+                                  Resume
+                                </button>
+                              ) : (
+                                <button
+                                  className="btn btn-outline-secondary btn-sm me-2"
+                                  onClick={() => handlePause(vm.name)}
+                                >
+                                  Pause
+                                </button>
+                              )}
+
+                              <button
+                                className="btn btn-outline-secondary btn-sm me-2"
+                                onClick={() => handleSuspend(vm.name)}
+                              >
+                                Suspend
+                              </button>
+
                               <button
                                 className="btn btn-outline-warning btn-sm me-2"
                                 onClick={() => handleStop(vm.name)}
@@ -384,6 +764,18 @@ const ListAllVms = () => {
                     ))}
                   </tbody>
                 </table>
+
+                {nextCursor && (
+                  <div className="text-center py-2">
+                    <button
+                      className="btn btn-outline-secondary btn-sm"
+                      disabled={loading}
+                      onClick={() => fetchVms(false)}
+                    >
+                      Load more
+                    </button>
+                  </div>
+                )}
               </div>
             </div>
 
@@ -1,8 +1,16 @@
 // File: src/components/MigrateVmCard/MigrateVmCard.jsx
 import React, { useState } from "react";
 
-const MigrateVmCard = ({ vmName, onConfirm, onCancel, isSubmitting }) => {
+const MigrateVmCard = ({
+  vmName,
+  onConfirm,
+  onCancel,
+  onAbort,
+  isSubmitting,
+  progress,
+}) => {
   const [destUri, setDestUri] = useState("");
+  const [profile, setProfile] = useState("plain");
 
   // Couleurs de ton projet
   const colors = {
@@ -18,7 +26,7 @@ const MigrateVmCard = ({ vmName, onConfirm, onCancel, isSubmitting }) => {
       );
       return;
     }
-    onConfirm(destUri.trim());
+    onConfirm(destUri.trim(), profile);
   };
 
   const migrateButtonStyle = {
@@ -65,15 +73,64 @@ const MigrateVmCard = ({ vmName, onConfirm, onCancel, isSubmitting }) => {
             />
           </div>
 
-          <div className="d-flex justify-content-end">
-            <button
-              type="button"
-              className="btn btn-secondary me-2"
-              onClick={onCancel}
+          {/* Profil de migration (presets côté backend) */}
+          <div className="mb-3">
+            <label className="form-label">Migration profile</label>
+            <select
+              className="form-select"
+              value={profile}
+              onChange={(e) => setProfile(e.target.value)}
               disabled={isSubmitting}
             >
-              Cancel
-            </button>
+              <option value="plain">Plain (live)</option>
+              <option value="compressed">Compressed (xbzrle + auto-converge)</option>
+              <option value="multifd">Multifd (parallel streams)</option>
+              <option value="postcopy">Postcopy (switch after 3 iterations)</option>
+            </select>
+          </div>
+
+          {/* Progression remontée par /migratestatus */}
+          {isSubmitting && progress && (
+            <div className="mb-3">
+              <div className="progress" style={{ height: "1.25rem" }}>
+                <div
+                  className="progress-bar progress-bar-striped progress-bar-animated"
+                  role="progressbar"
+                  style={{
+                    width: `${Math.round(progress.percent)}%`,
+                    backgroundColor: colors.greenDark,
+                  }}
+                >
+                  {Math.round(progress.percent)}%
+                </div>
+              </div>
+              <small className="text-muted">
+                Iteration {progress.iteration} · remaining{" "}
+                {(progress.dataRemaining / (1024 * 1024)).toFixed(0)} MiB ·
+                dirty rate {(progress.dirtyRateBps / (1024 * 1024)).toFixed(1)}{" "}
+                MiB/s · expected downtime {progress.expectedDowntimeMs} ms
+              </small>
+            </div>
+          )}
+
+          <div className="d-flex justify-content-end">
+            {isSubmitting ? (
+              <button
+                type="button"
+                className="btn btn-outline-danger me-2"
+                onClick={onAbort}
+              >
+                Abort migration
+              </button>
+            ) : (
+              <button
+                type="button"
+                className="btn btn-secondary me-2"
+                onClick={onCancel}
+              >
+                Cancel
+              </button>
+            )}
 
             {/* Bouton Migrate vert foncé + effet "pressed" quand en cours */}
             <button
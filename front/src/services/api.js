@@ -1,7 +1,22 @@
 // src/services/api.js
 import axios from 'axios';
 
-const API_BASE = 'http://192.168.160.136:8080';
+// Même origine que l'UI servie par le backend (pas de preflight CORS) ;
+// en dev (vite), VITE_API_BASE pointe vers le backend (.env.development)
+const API_BASE = import.meta.env.VITE_API_BASE ?? '';
+
+// 429 : le backend a refusé la requête sans l'exécuter (file pleine) ;
+// on la rejoue après le délai Retry-After, deux fois au plus
+axios.interceptors.response.use(undefined, async (error) => {
+  const { config, response } = error;
+  if (!config || response?.status !== 429 || (config.retries429 ?? 0) >= 2) {
+    throw error;
+  }
+  config.retries429 = (config.retries429 ?? 0) + 1;
+  const wait = Number(response.headers['retry-after']) || 1;
+  await new Promise((resolve) => setTimeout(resolve, Math.min(wait, 30) * 1000));
+  return axios(config);
+});
 
 /**
  * Helper : construit l'URI libvirt à partir de la session
@@ -83,6 +98,16 @@ export async function createVm(payload) {
   return res.data;
 }
 
+/**
+ * Capabilities de l'hôte (archs, machines, modèles CPU, NUMA, mémoire libre)
+ * pour remplir le formulaire de création. Sans session : qemu:///system.
+ */
+export async function getHostInfo(session, refresh = false) {
+  const uri = buildLibvirtUri(session);
+  const res = await axios.post(`${API_BASE}/hostinfo`, uri ? { uri, refresh } : { refresh });
+  return res.data;
+}
+
 /**
  * Start VM
  */
@@ -114,7 +139,46 @@ export async function shutdownVm(session, vmName) {
 }
 
 /**
- * Delete VM (undefine + delete disk)
+ * Pause VM (vCPUs gelés, RAM conservée)
+ */
+export async function pauseVm(session, vmName) {
+  const uri = buildLibvirtUri(session);
+  const payload = { uri, vmName };
+  const res = await axios.post(`${API_BASE}/pausevm`, payload);
+  return res.data;
+}
+
+/**
+ * Resume a paused VM
+ */
+export async function resumeVm(session, vmName) {
+  const uri = buildLibvirtUri(session);
+  const payload = { uri, vmName };
+  const res = await axios.post(`${API_BASE}/resumevm`, payload);
+  return res.data;
+}
+
+/**
+ * Suspend VM to disk (managed save) — startVm restores it
+ */
+export async function suspendVm(session, vmName) {
+  const uri = buildLibvirtUri(session);
+  const payload = { uri, vmName };
+  const res = await axios.post(`${API_BASE}/suspendvm`, payload);
+  return res.data;
+}
+
+/**
+ * Resize VM without reboot: { vcpus, memory } (memory in MiB, each optional)
+ */
+export async function resizeVm(session, vmName, sizes) {
+  const uri = buildLibvirtUri(session);
+  const res = await axios.post(`${API_BASE}/resizevm`, { uri, vmName, ...sizes });
+  return res.data;
+}
+
+/**
+ * Delete VM (undefine, disks removed in the background)
  */
 export async function deleteVm(session, vmName) {
   const uri = buildLibvirtUri(session);
@@ -123,6 +187,15 @@ export async function deleteVm(session, vmName) {
   return res.data;
 }
 
+/**
+ * Suppression des disques en tâche de fond (après deleteVm)
+ */
+export async function getReclaimStatus(vmName) {
+  const payload = vmName ? { vmName } : {};
+  const res = await axios.post(`${API_BASE}/reclaimstatus`, payload);
+  return res.data;
+}
+
 
 export async function openConsole(session, vmName) {
   const uri = buildLibvirtUri(session);
@@ -132,9 +205,114 @@ export async function openConsole(session, vmName) {
   return res.data;
 }
 
-export async function migrateVm(session, vmName, destUri) {
+export async function migrateVm(session, vmName, destUri, profile = "plain") {
   const uri = buildLibvirtUri(session);
-  const payload = { uri, vmName, destUri };
+  const payload = { uri, vmName, destUri, profile };
   const res = await axios.post(`${API_BASE}/migratevm`, payload);
   return res.data;
-}
\ No newline at end of file
+}
+/**
+ * Progression d'une migration lancée par migrateVm (jobId)
+ */
+export async function getMigrationStatus(jobId) {
+  const res = await axios.post(`${API_BASE}/migratestatus`, { jobId });
+  return res.data;
+}
+
+/**
+ * Annulation d'une migration en cours
+ */
+export async function cancelMigration(jobId) {
+  const res = await axios.post(`${API_BASE}/migratecancel`, { jobId });
+  return res.data;
+}
+
+/**
+ * Débits courants des VMs de l'hyperviseur (échantillonnés par le backend)
+ */
+export async function getVmStats(session, vmName) {
+  const uri = buildLibvirtUri(session);
+  const payload = vmName ? { uri, vmName } : { uri };
+  const res = await axios.post(`${API_BASE}/vmstats`, payload);
+  return res.data;
+}
+
+/**
+ * Vue cluster : VMs de tous les hôtes enregistrés, taguées par "host".
+ * Les hôtes qui ne répondent pas dans timeoutMs sont marqués "stale".
+ */
+export async function listFleetVms(timeoutMs = 3000) {
+  const res = await axios.post(`${API_BASE}/fleetvms`, { timeoutMs });
+  return res.data;
+}
+
+/**
+ * Snapshots : type "internal" (défaut) ou "external", memory pour l'état RAM
+ */
+export async function createSnapshot(session, vmName, name, type = "internal", memory = true) {
+  const uri = buildLibvirtUri(session);
+  const payload = { uri, vmName, type, memory };
+  if (name) payload.name = name;
+  const res = await axios.post(`${API_BASE}/snapshotcreate`, payload);
+  return res.data;
+}
+
+export async function listSnapshots(session, vmName) {
+  const uri = buildLibvirtUri(session);
+  const res = await axios.post(`${API_BASE}/snapshotlist`, { uri, vmName });
+  return res.data;
+}
+
+export async function revertSnapshot(session, vmName, name) {
+  const uri = buildLibvirtUri(session);
+  const res = await axios.post(`${API_BASE}/snapshotrevert`, { uri, vmName, name });
+  return res.data;
+}
+
+export async function deleteSnapshot(session, vmName, name) {
+  const uri = buildLibvirtUri(session);
+  const res = await axios.post(`${API_BASE}/snapshotdelete`, { uri, vmName, name });
+  return res.data;
+}
+
+/**
+ * Sauvegardes : "incremental" (défaut, full si aucun checkpoint) ou "full"
+ */
+export async function startBackup(session, vmName, type = "incremental") {
+  const uri = buildLibvirtUri(session);
+  const res = await axios.post(`${API_BASE}/backupstart`, { uri, vmName, type });
+  return res.data;
+}
+
+export async function getBackupStatus(jobId) {
+  const res = await axios.post(`${API_BASE}/backupstatus`, { jobId });
+  return res.data;
+}
+
+export async function listBackups(session, vmName) {
+  const uri = buildLibvirtUri(session);
+  const res = await axios.post(`${API_BASE}/backuplist`, { uri, vmName });
+  return res.data;
+}
+
+export async function scheduleBackup(session, vmName, schedule) {
+  const uri = buildLibvirtUri(session);
+  const res = await axios.post(`${API_BASE}/backupschedule`, { uri, vmName, ...schedule });
+  return res.data;
+}
+
+/**
+ * Limites QoS (IOPS / débit disque, bande passante réseau, parts CPU)
+ * qos = { disk: {...}, net: {...}, cpu: {...} }, 0 retire une limite
+ */
+export async function setVmQos(session, vmName, qos, disk) {
+  const uri = buildLibvirtUri(session);
+  const res = await axios.post(`${API_BASE}/vmqos`, { uri, vmName, qos, ...(disk ? { disk } : {}) });
+  return res.data;
+}
+
+export async function getVmQos(session, vmName) {
+  const uri = buildLibvirtUri(session);
+  const res = await axios.post(`${API_BASE}/vmqosget`, { uri, vmName });
+  return res.data;
+}